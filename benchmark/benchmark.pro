@@ -0,0 +1,25 @@
+#standalone benchmark of the calculation stages. Does not need OCTproZ, the OCTproZ_DevKit or QCustomPlot
+QT -= gui
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+TARGET = phaseextractionbenchmark
+TEMPLATE = app
+
+include(../calculator.pri)
+
+DEFINES += \
+	QT_DEPRECATED_WARNINGS #emit warnings if depracted Qt features are used
+
+SOURCES += \
+	$$PWD/../src/calibrationsignalgenerator.cpp \
+	benchmarkrunner.cpp \
+	benchmarkreport.cpp \
+	kernelcheck.cpp \
+	main.cpp
+
+HEADERS += \
+	$$PWD/../src/calibrationsignalgenerator.h \
+	benchmarkrunner.h \
+	benchmarkreport.h \
+	kernelcheck.h
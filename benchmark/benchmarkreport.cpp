@@ -0,0 +1,183 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#include "benchmarkreport.h"
+#include "kerneldispatch.h"
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QDateTime>
+#include <QSysInfo>
+
+
+QByteArray BenchmarkReport::toJson(const QVector<BenchmarkCase>& cases, const BenchmarkSettings& settings) {
+	QJsonArray results;
+	for(const BenchmarkCase& benchmarkCase : cases){
+		QJsonObject result;
+		result["kernel"] = benchmarkCase.kernel;
+		result["samplesPerLine"] = benchmarkCase.samplesPerLine;
+		result["lines"] = benchmarkCase.lines;
+		result["repetitions"] = benchmarkCase.repetitions;
+		result["minNs"] = static_cast<double>(benchmarkCase.minNs);
+		result["medianNs"] = static_cast<double>(benchmarkCase.medianNs);
+		result["meanNs"] = static_cast<double>(benchmarkCase.meanNs);
+		result["nsPerSample"] = static_cast<double>(benchmarkCase.medianNs)/(static_cast<double>(benchmarkCase.samplesPerLine)*qMax(1, benchmarkCase.lines));
+		if(benchmarkCase.maxError >= 0){
+			result["maxError"] = benchmarkCase.maxError;
+		}
+		results.append(result);
+	}
+
+	QJsonObject report;
+	report["format"] = BENCHMARK_REPORT_FORMAT;
+	report["date"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+	report["host"] = QSysInfo::machineHostName();
+	report["cpuArchitecture"] = QSysInfo::currentCpuArchitecture();
+	report["os"] = QSysInfo::prettyProductName();
+	report["qtVersion"] = QString(qVersion());
+	report["precision"] = settings.precision == SINGLE_PRECISION ? "single" : "double";
+	report["bytesPerSample"] = settings.bytesPerSample;
+	report["padToSmoothSize"] = settings.padToSmoothSize;
+	report["upsamplingFactor"] = settings.upsamplingFactor;
+	report["multithreadedFft"] = settings.multithreadedFft;
+	report["isa"] = QString(KernelDispatch::getIsaName(KernelDispatch::getActiveIsa()));
+	report["results"] = results;
+	return QJsonDocument(report).toJson(QJsonDocument::Indented);
+}
+
+bool BenchmarkReport::load(const QString& fileName, QVector<BenchmarkCase>* cases, BenchmarkSettings* settings, QString* isa) {
+	QFile file(fileName);
+	if(!file.open(QIODevice::ReadOnly)){
+		return false;
+	}
+	QJsonDocument document = QJsonDocument::fromJson(file.readAll());
+	if(!document.isObject() || document.object().value("format").toInt() != BENCHMARK_REPORT_FORMAT){
+		return false;
+	}
+	//only the settings that change the measured durations or errors are loaded, keys that are missing keep the defaults of BenchmarkSettings
+	QJsonObject report = document.object();
+	*settings = BenchmarkSettings();
+	settings->precision = report.value("precision").toString() == "single" ? SINGLE_PRECISION : DOUBLE_PRECISION;
+	settings->bytesPerSample = report.value("bytesPerSample").toInt(settings->bytesPerSample);
+	settings->padToSmoothSize = report.value("padToSmoothSize").toBool(settings->padToSmoothSize);
+	settings->upsamplingFactor = report.value("upsamplingFactor").toInt(settings->upsamplingFactor);
+	settings->multithreadedFft = report.value("multithreadedFft").toBool(settings->multithreadedFft);
+	*isa = report.value("isa").toString();
+
+	cases->clear();
+	QJsonArray results = report.value("results").toArray();
+	for(const QJsonValue& value : results){
+		QJsonObject result = value.toObject();
+		BenchmarkCase benchmarkCase;
+		benchmarkCase.kernel = result.value("kernel").toString();
+		benchmarkCase.samplesPerLine = result.value("samplesPerLine").toInt();
+		benchmarkCase.lines = result.value("lines").toInt();
+		benchmarkCase.repetitions = result.value("repetitions").toInt();
+		benchmarkCase.minNs = static_cast<qint64>(result.value("minNs").toDouble());
+		benchmarkCase.medianNs = static_cast<qint64>(result.value("medianNs").toDouble());
+		benchmarkCase.meanNs = static_cast<qint64>(result.value("meanNs").toDouble());
+		benchmarkCase.maxError = result.value("maxError").toDouble(-1);
+		cases->append(benchmarkCase);
+	}
+	return true;
+}
+
+QStringList BenchmarkReport::compareSettings(const BenchmarkSettings& baseline, const QString& baselineIsa, const BenchmarkSettings& current) {
+	//cases are only comparable if they were measured with the same calculation settings and kernels
+	QStringList differences;
+	QString currentIsa(KernelDispatch::getIsaName(KernelDispatch::getActiveIsa()));
+	if(baseline.precision != current.precision){
+		differences.append(QString("precision: %1 -> %2").arg(baseline.precision == SINGLE_PRECISION ? "single" : "double", current.precision == SINGLE_PRECISION ? "single" : "double"));
+	}
+	if(!baselineIsa.isEmpty() && baselineIsa != currentIsa){
+		differences.append(QString("isa: %1 -> %2").arg(baselineIsa, currentIsa));
+	}
+	if(baseline.bytesPerSample != current.bytesPerSample){
+		differences.append(QString("bytesPerSample: %1 -> %2").arg(baseline.bytesPerSample).arg(current.bytesPerSample));
+	}
+	if(baseline.padToSmoothSize != current.padToSmoothSize){
+		differences.append(QString("padToSmoothSize: %1 -> %2").arg(baseline.padToSmoothSize ? "true" : "false", current.padToSmoothSize ? "true" : "false"));
+	}
+	if(baseline.upsamplingFactor != current.upsamplingFactor){
+		differences.append(QString("upsamplingFactor: %1 -> %2").arg(baseline.upsamplingFactor).arg(current.upsamplingFactor));
+	}
+	if(baseline.multithreadedFft != current.multithreadedFft){
+		differences.append(QString("multithreadedFft: %1 -> %2").arg(baseline.multithreadedFft ? "true" : "false", current.multithreadedFft ? "true" : "false"));
+	}
+	return differences;
+}
+
+QVector<BenchmarkComparison> BenchmarkReport::compare(const QVector<BenchmarkCase>& baseline, const QVector<BenchmarkCase>& current, double tolerance) {
+	//cases are matched by kernel and input size, cases that only exist in one of the reports are not compared. The settings of both reports have to be checked with compareSettings first
+	QVector<BenchmarkComparison> comparisons;
+	for(const BenchmarkCase& currentCase : current){
+		for(const BenchmarkCase& baselineCase : baseline){
+			if(baselineCase.kernel != currentCase.kernel || baselineCase.samplesPerLine != currentCase.samplesPerLine || baselineCase.lines != currentCase.lines || baselineCase.medianNs <= 0){
+				continue;
+			}
+			BenchmarkComparison comparison;
+			comparison.kernel = currentCase.kernel;
+			comparison.samplesPerLine = currentCase.samplesPerLine;
+			comparison.lines = currentCase.lines;
+			comparison.baselineNs = baselineCase.medianNs;
+			comparison.currentNs = currentCase.medianNs;
+			comparison.ratio = static_cast<double>(currentCase.medianNs)/static_cast<double>(baselineCase.medianNs);
+			comparison.regression = comparison.ratio > 1.0 + tolerance;
+
+			//a faster kernel must not make the result worse. The synthetic signal is seeded, so the error of an unchanged kernel is reproducible
+			comparison.baselineError = baselineCase.maxError;
+			comparison.currentError = currentCase.maxError;
+			comparison.accuracyRegression = baselineCase.maxError >= 0 && currentCase.maxError > baselineCase.maxError*(1.0 + tolerance) + BENCHMARK_ERROR_TOLERANCE;
+			comparisons.append(comparison);
+			break;
+		}
+	}
+	return comparisons;
+}
+
+QString BenchmarkReport::formatComparison(const QVector<BenchmarkComparison>& comparisons) {
+	QString table;
+	for(const BenchmarkComparison& comparison : comparisons){
+		QString size = QString::number(comparison.samplesPerLine) + (comparison.lines > 0 ? " x " + QString::number(comparison.lines) : QString());
+		QString error;
+		if(comparison.baselineError >= 0 && comparison.currentError >= 0){
+			error = "  error " + QString::number(comparison.baselineError, 'g', 3) + " -> " + QString::number(comparison.currentError, 'g', 3) + " samples";
+		}
+		table += QString("%1 %2 %3 us -> %4 us %5%6%7%8\n")
+				.arg(comparison.kernel, -26)
+				.arg(size, -18)
+				.arg(QString::number(comparison.baselineNs/1000.0, 'f', 2), 12)
+				.arg(QString::number(comparison.currentNs/1000.0, 'f', 2), 12)
+				.arg(QString::number((comparison.ratio - 1.0)*100.0, 'f', 1) + " %", 9)
+				.arg(error)
+				.arg(comparison.regression ? "  REGRESSION" : "")
+				.arg(comparison.accuracyRegression ? "  ACCURACY REGRESSION" : "");
+	}
+	return table;
+}
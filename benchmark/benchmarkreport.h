@@ -0,0 +1,69 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+
+#ifndef BENCHMARKREPORT_H
+#define BENCHMARKREPORT_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "benchmarkrunner.h"
+
+#define BENCHMARK_REPORT_FORMAT 1
+#define BENCHMARK_ERROR_TOLERANCE 0.001 //absolute curve error in samples that is always accepted on top of the relative tolerance
+
+//Comparison of the median duration and the curve error of one case with the same kernel and input size in a baseline report
+struct BenchmarkComparison {
+	BenchmarkComparison() : samplesPerLine(0), lines(0), baselineNs(0), currentNs(0), ratio(1.0), regression(false), baselineError(-1), currentError(-1), accuracyRegression(false) {}
+
+	QString kernel;
+	int samplesPerLine;
+	int lines;
+	qint64 baselineNs;
+	qint64 currentNs;
+	double ratio; //current/baseline, > 1 is slower
+	bool regression;
+	double baselineError;
+	double currentError;
+	bool accuracyRegression;
+};
+
+//JSON report of a benchmark run: settings, machine and one entry per measured case
+class BenchmarkReport
+{
+public:
+	static QByteArray toJson(const QVector<BenchmarkCase>& cases, const BenchmarkSettings& settings);
+	static bool load(const QString& fileName, QVector<BenchmarkCase>* cases, BenchmarkSettings* settings, QString* isa);
+	static QStringList compareSettings(const BenchmarkSettings& baseline, const QString& baselineIsa, const BenchmarkSettings& current);
+	static QVector<BenchmarkComparison> compare(const QVector<BenchmarkCase>& baseline, const QVector<BenchmarkCase>& current, double tolerance);
+	static QString formatComparison(const QVector<BenchmarkComparison>& comparisons);
+};
+
+#endif // BENCHMARKREPORT_H
@@ -0,0 +1,280 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#include "benchmarkrunner.h"
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <algorithm>
+#include <cstring>
+
+
+BenchmarkRunner::BenchmarkRunner(const BenchmarkSettings& settings) {
+	this->settings = settings;
+	this->input = nullptr;
+	this->inputCapacity = 0;
+	this->inputSamplesPerLine = 0;
+	this->inputLines = 0;
+	this->threadPolicy.setEnabled(settings.multithreadedFft && FftwThreadPolicy::isAvailable());
+}
+
+BenchmarkRunner::~BenchmarkRunner() {
+	free(this->input);
+}
+
+QStringList BenchmarkRunner::getKernelNames() {
+	return getAveragingKernelNames() << "windowAndIFFT" << "calculatePhase" << "unwrapPhase" << "calculateResamplingCurve" << "fitResamplingCurve" << "Polynomial::getData";
+}
+
+QStringList BenchmarkRunner::getAveragingKernelNames() {
+	return QStringList() << "average" << "averageAndFFT";
+}
+
+QVector<BenchmarkCase> BenchmarkRunner::run() {
+	this->results.clear();
+	for(int samplesPerLine : this->settings.lineLengths){
+		for(int lines : this->settings.lineCounts){
+			this->runAveragingKernels(samplesPerLine, lines);
+		}
+		this->runSingleLineKernels(samplesPerLine);
+	}
+	return this->results;
+}
+
+template <typename Setup, typename Kernel>
+int BenchmarkRunner::measure(const QString& kernel, int samplesPerLine, int lines, Setup setup, Kernel run) {
+	//returns the index of the new entry in results, -1 if the kernel is not selected
+	if(!this->isSelected(kernel)){
+		return -1;
+	}
+
+	//the first run is not measured, it pages in the input and touches all buffers once
+	setup();
+	run();
+
+	QVector<qint64> durations;
+	QElapsedTimer caseTimer;
+	QElapsedTimer timer;
+	caseTimer.start();
+	while(durations.size() < this->settings.repetitions || (caseTimer.elapsed() < BENCHMARK_MIN_CASE_TIME_MS && durations.size() < BENCHMARK_MAX_REPETITIONS)){
+		setup();
+		timer.start();
+		run();
+		durations.append(timer.nsecsElapsed());
+	}
+	std::sort(durations.begin(), durations.end());
+	qint64 sum = 0;
+	for(qint64 duration : durations){
+		sum += duration;
+	}
+
+	BenchmarkCase result;
+	result.kernel = kernel;
+	result.samplesPerLine = samplesPerLine;
+	result.lines = lines;
+	result.repetitions = durations.size();
+	result.minNs = durations.first();
+	result.medianNs = durations.at(durations.size()/2);
+	result.meanNs = sum/durations.size();
+	this->results.append(result);
+	QTextStream(stderr) << kernel << " " << samplesPerLine << " samples" << (lines > 0 ? " x " + QString::number(lines) + " lines" : QString()) << ": "
+						<< QString::number(result.medianNs/1000.0, 'f', 2) << " us (median of " << result.repetitions << ")\n";
+	return this->results.size()-1;
+}
+
+void BenchmarkRunner::runAveragingKernels(int samplesPerLine, int lines) {
+	bool selected = false;
+	for(const QString& kernel : getAveragingKernelNames()){
+		selected = selected || this->isSelected(kernel);
+	}
+	if(!selected){
+		return;
+	}
+	if(!this->prepareInput(samplesPerLine, lines)){
+		QTextStream(stderr) << "skipped " << samplesPerLine << " samples x " << lines << " lines: raw input exceeds the memory limit\n";
+		return;
+	}
+	int bytesPerSample = this->settings.bytesPerSample;
+
+	//accumulation of the raw lines into the fft buffer. This is the former copyLine loop of the calculator
+	PhaseExtractionEngineBase* engine = this->createEngine();
+	engine->setFftParams(this->settings.padToSmoothSize, this->settings.upsamplingFactor);
+	engine->setData(this->input, bytesPerSample, samplesPerLine, lines);
+	this->measure("average", samplesPerLine, lines, [](){}, [&](){
+		engine->average(0, lines, false, nullptr);
+	});
+	delete engine;
+
+	//complete averaging job of the calculator including fft, spectrum copy and result snapshot. setData invalidates the stage cache, otherwise every repetition would be a cache hit
+	PhaseExtractionCalculator calculator;
+	calculator.setPrecision(this->settings.precision);
+	calculator.setFftParams(this->settings.padToSmoothSize, this->settings.upsamplingFactor, this->threadPolicy.isEnabled());
+	size_t size = static_cast<size_t>(samplesPerLine)*static_cast<size_t>(lines)*bytesPerSample;
+	this->measure("averageAndFFT", samplesPerLine, lines, [&](){
+		calculator.setData(this->input, size, bytesPerSample, samplesPerLine);
+	}, [&](){
+		calculator.averageAndFFT(0, lines-1, true, false);
+	});
+}
+
+void BenchmarkRunner::runSingleLineKernels(int samplesPerLine) {
+	int lines = BENCHMARK_SINGLE_LINE_SETUP_LINES;
+	if(!this->prepareInput(samplesPerLine, lines)){
+		QTextStream(stderr) << "skipped " << samplesPerLine << " samples: raw input exceeds the memory limit\n";
+		return;
+	}
+
+	//every kernel gets the output of the previous stages as input, so the stages are prepared once even if they are not measured
+	PhaseExtractionEngineBase* engine = this->createEngine();
+	engine->setFftParams(this->settings.padToSmoothSize, this->settings.upsamplingFactor);
+	engine->setData(this->input, this->settings.bytesPerSample, samplesPerLine, lines);
+	engine->average(0, lines, true, nullptr);
+	engine->forwardFft();
+	int fftSize = engine->getFftSize();
+	int startPos = fftSize/8 - fftSize/32;
+	int endPos = fftSize/8 + fftSize/32;
+	engine->selectBand(startPos, endPos, true);
+	engine->inverseFft();
+
+	QVector<qreal> selectedSignal;
+	QVector<qreal> analyticalSignalReal;
+	QVector<qreal> analyticalSignalImag;
+	this->measure("windowAndIFFT", samplesPerLine, 0, [](){}, [&](){
+		engine->selectBand(startPos, endPos, true);
+		engine->getSelectedSignal(&selectedSignal);
+		engine->inverseFft();
+		engine->getAnalyticalSignal(&analyticalSignalReal, &analyticalSignalImag);
+	});
+	this->measure("calculatePhase", samplesPerLine, 0, [](){}, [&](){
+		engine->calculatePhase();
+	});
+	//unwrapping works in place, every repetition starts from the wrapped phase
+	this->measure("unwrapPhase", samplesPerLine, 0, [&](){
+		engine->calculatePhase();
+	}, [&](){
+		engine->unwrapPhase();
+	});
+	engine->calculatePhase();
+	engine->unwrapPhase();
+	engine->calculateNonLinearPhase();
+
+	QVector<qreal> curve;
+	int curveIndex = this->measure("calculateResamplingCurve", samplesPerLine, 0, [](){}, [&](){
+		engine->calculateResamplingCurve();
+		engine->getResamplingCurve(&curve);
+	});
+	engine->calculateResamplingCurve();
+	engine->getResamplingCurve(&curve);
+	delete engine;
+	int margin = samplesPerLine/BENCHMARK_ERROR_MARGIN_DIVISOR;
+	if(curveIndex >= 0){
+		this->results[curveIndex].maxError = this->generator.getCurveError(curve, margin);
+	}
+
+	//same steps as PhaseExtractionCalculator::fitResamplingCurve
+	Polynomial polynomial;
+	polynomial.setSize(samplesPerLine);
+	QVector<qreal> coeffs;
+	QVector<float> fittedCurve(samplesPerLine);
+	PhaseExtractionCalculator::fitPolynomial(curve, 0, 0, 3, &coeffs);
+	for(int i = 0; i < coeffs.size(); i++){
+		polynomial.setCoeff(coeffs.at(i), i);
+	}
+	int fitIndex = this->measure("fitResamplingCurve", samplesPerLine, 0, [](){}, [&](){
+		if(PhaseExtractionCalculator::fitPolynomial(curve, 0, 0, 3, &coeffs)){
+			for(int i = 0; i < coeffs.size(); i++){
+				polynomial.setCoeff(coeffs.at(i), i);
+			}
+			memcpy(fittedCurve.data(), polynomial.getData(), samplesPerLine*sizeof(float));
+		}
+	});
+	if(fitIndex >= 0){
+		QVector<double> fittedCurveDouble(samplesPerLine);
+		for(int i = 0; i < samplesPerLine; i++){
+			fittedCurveDouble[i] = fittedCurve.at(i);
+		}
+		this->results[fitIndex].maxError = this->generator.getCurveError(fittedCurveDouble, margin);
+	}
+	//getData only evaluates the polynomial if a coefficient changed since the last call
+	this->measure("Polynomial::getData", samplesPerLine, 0, [&](){
+		polynomial.setCoeff(polynomial.getCoeff(0), 0);
+	}, [&](){
+		polynomial.getData();
+	});
+}
+
+bool BenchmarkRunner::prepareInput(int samplesPerLine, int lines) {
+	size_t lineBytes = static_cast<size_t>(samplesPerLine)*this->settings.bytesPerSample;
+	size_t size = lineBytes*static_cast<size_t>(lines);
+	if(samplesPerLine <= 1 || lines <= 0 || static_cast<qint64>(size) > this->settings.maxInputBytes){
+		return false;
+	}
+	if(samplesPerLine == this->inputSamplesPerLine && lines <= this->inputLines){
+		return true;
+	}
+	if(size > this->inputCapacity){
+		unsigned char* newInput = static_cast<unsigned char*>(realloc(this->input, size));
+		if(newInput == nullptr){
+			return false;
+		}
+		this->input = newInput;
+		this->inputCapacity = size;
+	}
+
+	//fringe at an eighth of the sampling rate with a cubic k-nonlinearity, so the band around fftSize/8 contains the whole signal. Lines only depend on their line number, so a longer input starts with the same lines
+	CalibrationSignalParameters parameters;
+	parameters.samplesPerLine = samplesPerLine;
+	parameters.linesPerBuffer = lines;
+	parameters.bitDepth = this->settings.bytesPerSample <= 1 ? 8 : (this->settings.bytesPerSample <= 2 ? 12 : 16);
+	parameters.fringeCycles = samplesPerLine/8.0;
+	parameters.nonlinearity << 0.1 << -0.05;
+	parameters.sweepJitter = 0.1;
+	parameters.dcLevel = 0.4;
+	parameters.fringeAmplitude = 0.3;
+	parameters.envelopeWidth = 0.5;
+	parameters.shotNoise = 1.0;
+	if(!this->generator.setParameters(parameters)){
+		return false;
+	}
+	this->generator.generate(this->input, 0);
+	this->inputSamplesPerLine = samplesPerLine;
+	this->inputLines = lines;
+	return true;
+}
+
+bool BenchmarkRunner::isSelected(const QString& kernel) {
+	return this->settings.kernels.isEmpty() || this->settings.kernels.contains(kernel);
+}
+
+PhaseExtractionEngineBase* BenchmarkRunner::createEngine() {
+#ifdef PHASEEXTRACTION_FFTW_FLOAT
+	if(this->settings.precision == SINGLE_PRECISION){
+		return new PhaseExtractionEngine<float>(&this->threadPolicy);
+	}
+#endif
+	return new PhaseExtractionEngine<double>(&this->threadPolicy);
+}
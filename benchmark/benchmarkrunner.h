@@ -0,0 +1,104 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+
+#ifndef BENCHMARKRUNNER_H
+#define BENCHMARKRUNNER_H
+
+#include <QVector>
+#include <QStringList>
+#include "phaseextractionengine.h"
+#include "phaseextractioncalculator.h"
+#include "calibrationsignalgenerator.h"
+
+#define BENCHMARK_MIN_CASE_TIME_MS 100 //fast kernels are repeated until this time has passed, so timer resolution does not dominate the result
+#define BENCHMARK_MAX_REPETITIONS 100000
+#define BENCHMARK_SINGLE_LINE_SETUP_LINES 64 //lines averaged once to prepare the input of the single line kernels
+#define BENCHMARK_ERROR_MARGIN_DIVISOR 16 //curve errors are measured without the first and last samplesPerLine/16 samples
+
+//Measurement of one kernel at one input size. lines is 0 for kernels that only work on the averaged line
+struct BenchmarkCase {
+	BenchmarkCase() : samplesPerLine(0), lines(0), repetitions(0), minNs(0), medianNs(0), meanNs(0), maxError(-1) {}
+
+	QString kernel;
+	int samplesPerLine;
+	int lines;
+	int repetitions;
+	qint64 minNs;
+	qint64 medianNs;
+	qint64 meanNs;
+	double maxError; //deviation of the resulting curve from the ground truth of the synthetic signal in samples, -1 for kernels without curve output
+};
+
+struct BenchmarkSettings {
+	BenchmarkSettings() : repetitions(10), maxInputBytes(2048ll*1024*1024), bytesPerSample(2), precision(DOUBLE_PRECISION), padToSmoothSize(false), upsamplingFactor(1), multithreadedFft(false) {}
+
+	QVector<int> lineLengths;
+	QVector<int> lineCounts;
+	QStringList kernels; //empty: all kernels
+	int repetitions; //minimum number of measured runs per case
+	qint64 maxInputBytes; //cases with larger raw input are skipped
+	int bytesPerSample;
+	CalculationPrecision precision;
+	bool padToSmoothSize;
+	int upsamplingFactor;
+	bool multithreadedFft;
+};
+
+//Runs the calculation stages of PhaseExtractionCalculator and PhaseExtractionEngine on a synthetic calibration signal from CalibrationSignalGenerator without the OCTproZ host.
+//Kernels that depend on the number of lines (average, averageAndFFT) are measured for every line length and line count, all others once per line length on the averaged line
+class BenchmarkRunner
+{
+public:
+	BenchmarkRunner(const BenchmarkSettings& settings);
+	~BenchmarkRunner();
+
+	static QStringList getKernelNames();
+	static QStringList getAveragingKernelNames();
+	QVector<BenchmarkCase> run();
+
+private:
+	void runAveragingKernels(int samplesPerLine, int lines);
+	void runSingleLineKernels(int samplesPerLine);
+	bool prepareInput(int samplesPerLine, int lines);
+	bool isSelected(const QString& kernel);
+	template <typename Setup, typename Kernel>
+	int measure(const QString& kernel, int samplesPerLine, int lines, Setup setup, Kernel run);
+	PhaseExtractionEngineBase* createEngine();
+
+	BenchmarkSettings settings;
+	FftwThreadPolicy threadPolicy;
+	CalibrationSignalGenerator generator;
+	unsigned char* input;
+	size_t inputCapacity;
+	int inputSamplesPerLine;
+	int inputLines;
+	QVector<BenchmarkCase> results;
+};
+
+#endif // BENCHMARKRUNNER_H
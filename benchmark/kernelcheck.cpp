@@ -0,0 +1,178 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#include "kernelcheck.h"
+#include "kerneldispatch.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+template <typename T>
+double maxDeviation(const std::vector<T>& reference, const std::vector<T>& result) {
+	double deviation = 0;
+	for(size_t i = 0; i < reference.size(); i++){
+		deviation = std::max(deviation, std::abs(static_cast<double>(result[i]) - static_cast<double>(reference[i])));
+	}
+	return deviation;
+}
+
+template <typename T>
+double maxPhaseDeviation(const std::vector<T>& reference, const std::vector<T>& result) {
+	//-pi and pi are the same phase
+	double deviation = 0;
+	for(size_t i = 0; i < reference.size(); i++){
+		double difference = std::abs(static_cast<double>(result[i]) - static_cast<double>(reference[i]));
+		deviation = std::max(deviation, std::min(difference, std::abs(difference - 2.0*M_PI)));
+	}
+	return deviation;
+}
+
+template <typename T>
+double maxAbs(const std::vector<T>& values) {
+	double value = 0;
+	for(size_t i = 0; i < values.size(); i++){
+		value = std::max(value, std::abs(static_cast<double>(values[i])));
+	}
+	return value;
+}
+
+struct KernelResult {
+	KernelResult() : deviation(0), tolerance(0) {}
+	void add(double deviation, double tolerance) {
+		this->deviation = std::max(this->deviation, deviation);
+		this->tolerance = std::max(this->tolerance, tolerance);
+	}
+	double deviation;
+	double tolerance;
+};
+
+}
+
+
+bool KernelCheck::run(QStringList* report) {
+	bool ok = true;
+	report->append(QString("Supported instruction set: ") + KernelDispatch::getIsaName(KernelDispatch::getSupportedIsa()) + ", active: " + KernelDispatch::getIsaName(KernelDispatch::getActiveIsa()));
+	for(int isa = KERNEL_ISA_SCALAR + 1; isa < KERNEL_ISA_COUNT; isa++){
+		if(KernelDispatch::getKernels<float>(static_cast<KernelIsa>(isa)) == nullptr){
+			report->append(QString(KernelDispatch::getIsaName(static_cast<KernelIsa>(isa))) + ": not supported");
+			continue;
+		}
+		//the vectorized atan2 is a single precision approximation
+		ok = compare<float>(isa, 1e-6, report) && ok;
+		ok = compare<double>(isa, 1e-6, report) && ok;
+	}
+	return ok;
+}
+
+template <typename T>
+bool KernelCheck::compare(int isa, double phaseTolerance, QStringList* report) {
+	const KernelTable<T>& reference = *KernelDispatch::getKernels<T>(KERNEL_ISA_SCALAR);
+	const KernelTable<T>& kernels = *KernelDispatch::getKernels<T>(static_cast<KernelIsa>(isa));
+	const double epsilon = std::numeric_limits<T>::epsilon();
+	const char* kernelNames[] = {"decodeLine", "accumulateLines", "applyWindow", "calculatePhase", "unwrapPhase", "evaluatePolynomial"};
+	KernelResult results[6];
+	std::mt19937 random(KERNELCHECK_SEED);
+	std::uniform_int_distribution<int> sampleDistribution(0, 65535);
+	std::uniform_real_distribution<double> realDistribution(-1.0, 1.0);
+
+	for(int size : KERNELCHECK_SIZES){
+		std::vector<uint16_t> samples(static_cast<size_t>(size)*KERNELCHECK_LINES);
+		for(uint16_t& sample : samples){
+			sample = static_cast<uint16_t>(sampleDistribution(random));
+		}
+
+		//decoding, summing up integers and multiplying element wise are exact in every instruction set
+		std::vector<T> expected(size);
+		std::vector<T> result(size);
+		reference.decodeLine(samples.data(), size, expected.data());
+		kernels.decodeLine(samples.data(), size, result.data());
+		results[0].add(maxDeviation(expected, result), 0);
+
+		std::fill(expected.begin(), expected.end(), T(0));
+		std::fill(result.begin(), result.end(), T(0));
+		reference.accumulateLines(samples.data(), size, 1, KERNELCHECK_LINES/2, 2, size, expected.data());
+		kernels.accumulateLines(samples.data(), size, 1, KERNELCHECK_LINES/2, 2, size, result.data());
+		results[1].add(maxDeviation(expected, result), 0);
+
+		//block of columns that starts within the line, like in PhaseExtractionCore::sumLines
+		std::fill(expected.begin(), expected.end(), T(0));
+		std::fill(result.begin(), result.end(), T(0));
+		reference.accumulateLines(samples.data() + 1, size, 1, KERNELCHECK_LINES/2, 2, size - 1, expected.data());
+		kernels.accumulateLines(samples.data() + 1, size, 1, KERNELCHECK_LINES/2, 2, size - 1, result.data());
+		results[1].add(maxDeviation(expected, result), 0);
+
+		std::vector<T> window(size);
+		PhaseExtractionCore::hanningWindow(window.data(), size);
+		std::vector<T> signal(size);
+		for(T& value : signal){
+			value = static_cast<T>(realDistribution(random));
+		}
+		expected = signal;
+		result = signal;
+		reference.applyWindow(expected.data(), size, window.data());
+		kernels.applyWindow(result.data(), size, window.data());
+		results[2].add(maxDeviation(expected, result), 0);
+
+		//chirp with noise and some exact zeros and axis values, so every octant and the special cases of atan2 are covered
+		std::vector<T> complexSignal(2*static_cast<size_t>(size));
+		for(int i = 0; i < size; i++){
+			double amplitude = 1.0 + 0.5*realDistribution(random);
+			double phase = 0.002*i*i + 0.3*realDistribution(random);
+			complexSignal[2*i] = i % 97 == 3 ? T(0) : static_cast<T>(amplitude*std::cos(phase));
+			complexSignal[2*i+1] = i % 89 == 5 ? T(0) : static_cast<T>(amplitude*std::sin(phase));
+		}
+		const T (*complexValues)[2] = reinterpret_cast<const T (*)[2]>(complexSignal.data());
+		reference.calculatePhase(complexValues, size, expected.data());
+		kernels.calculatePhase(complexValues, size, result.data());
+		results[3].add(maxPhaseDeviation(expected, result), phaseTolerance);
+
+		//both unwrap the same wrapped phase, so only the cycle counting and the final addition are compared
+		result = expected;
+		reference.unwrapPhase(expected.data(), size);
+		kernels.unwrapPhase(result.data(), size);
+		results[4].add(maxDeviation(expected, result), 4*epsilon*maxAbs(expected));
+
+		//coefficients of a typical resampling curve
+		const T coeffs[] = {static_cast<T>(0.4), static_cast<T>(1.0), static_cast<T>(3e-5), static_cast<T>(-2e-9)};
+		reference.evaluatePolynomial(coeffs, 3, expected.data(), size);
+		kernels.evaluatePolynomial(coeffs, 3, result.data(), size);
+		results[5].add(maxDeviation(expected, result), 8*epsilon*maxAbs(expected));
+	}
+
+	bool ok = true;
+	QString prefix = QString(KernelDispatch::getIsaName(static_cast<KernelIsa>(isa))) + (sizeof(T) == sizeof(float) ? " float " : " double ");
+	for(int i = 0; i < 6; i++){
+		bool kernelOk = results[i].deviation <= results[i].tolerance;
+		ok = ok && kernelOk;
+		report->append(prefix + kernelNames[i] + ": max deviation " + QString::number(results[i].deviation, 'g', 3) + ", tolerance " + QString::number(results[i].tolerance, 'g', 3) + (kernelOk ? "" : "  FAILED"));
+	}
+	return ok;
+}
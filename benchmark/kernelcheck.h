@@ -0,0 +1,49 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#ifndef KERNELCHECK_H
+#define KERNELCHECK_H
+
+#include <QStringList>
+
+#define KERNELCHECK_SIZES {1, 7, 33, 1021, 4099} //odd sizes, so every vector tail is covered
+#define KERNELCHECK_LINES 9
+#define KERNELCHECK_SEED 12345
+
+//Compares the vectorized kernels of every instruction set the cpu supports with the scalar reference of KernelDispatch
+class KernelCheck
+{
+public:
+	static bool run(QStringList* report); //false if a kernel deviates more than its tolerance. report gets one line per instruction set, precision and kernel
+
+private:
+	template <typename T>
+	static bool compare(int isa, double phaseTolerance, QStringList* report);
+};
+
+#endif // KERNELCHECK_H
@@ -0,0 +1,195 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QTextStream>
+#include "benchmarkrunner.h"
+#include "benchmarkreport.h"
+#include "kernelcheck.h"
+#include "kerneldispatch.h"
+
+#define BENCHMARK_DEFAULT_LINE_LENGTHS "1024,4096,16384,65536"
+#define BENCHMARK_DEFAULT_LINE_COUNTS "1000,10000,100000,1000000"
+#define BENCHMARK_DEFAULT_TOLERANCE_PERCENT "10"
+
+
+static bool parseList(const QString& text, QVector<int>* values) {
+	values->clear();
+	for(const QString& item : text.split(',')){
+		if(item.trimmed().isEmpty()){
+			continue;
+		}
+		bool ok = false;
+		int value = item.trimmed().toInt(&ok);
+		if(!ok || value <= 0){
+			return false;
+		}
+		values->append(value);
+	}
+	return !values->isEmpty();
+}
+
+int main(int argc, char *argv[]) {
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("phaseextractionbenchmark");
+	QTextStream err(stderr);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Measures the calculation stages of PhaseExtractionExtension on a synthetic calibration signal and writes the results as JSON.");
+	parser.addHelpOption();
+	QCommandLineOption outputOption(QStringList() << "o" << "output", "Write the JSON report to <file> instead of stdout.", "file");
+	QCommandLineOption baselineOption(QStringList() << "b" << "baseline", "Compare the median durations and curve errors with the report in <file>. The exit code is 1 if a case got slower or less accurate than the tolerance and 2 if the baseline was measured with other settings.", "file");
+	QCommandLineOption toleranceOption(QStringList() << "t" << "tolerance", "Allowed slowdown and error increase against the baseline in percent.", "percent", BENCHMARK_DEFAULT_TOLERANCE_PERCENT);
+	QCommandLineOption lineLengthsOption("line-lengths", "Comma separated samples per line.", "list", BENCHMARK_DEFAULT_LINE_LENGTHS);
+	QCommandLineOption lineCountsOption("line-counts", "Comma separated numbers of averaged lines.", "list", BENCHMARK_DEFAULT_LINE_COUNTS);
+	QCommandLineOption kernelsOption(QStringList() << "k" << "kernels", "Comma separated kernels to measure: " + BenchmarkRunner::getKernelNames().join(", ") + ". Default: all.", "list");
+	QCommandLineOption repetitionsOption(QStringList() << "r" << "repetitions", "Minimum number of measured runs per case.", "n", "10");
+	QCommandLineOption maxInputOption("max-input-mb", "Cases with more raw input are skipped.", "MB", "2048");
+	QCommandLineOption bytesPerSampleOption("bytes-per-sample", "Raw sample size: 1, 2 or 4.", "bytes", "2");
+	QCommandLineOption singlePrecisionOption("single", "Use single precision calculation.");
+	QCommandLineOption padOption("pad", "Pad the fft to the next smooth size.");
+	QCommandLineOption upsamplingOption("upsampling", "Upsampling factor of the analytical signal.", "factor", "1");
+	QCommandLineOption fftThreadsOption("fft-threads", "Allow multithreaded ffts.");
+	QCommandLineOption isaOption("isa", "Instruction set of the calculation kernels: scalar, sse2, avx2 or avx512. Overrides the environment variable " KERNELDISPATCH_ISA_ENV ". Default: best supported.", "name");
+	QCommandLineOption checkKernelsOption("check-kernels", "Compare the vectorized kernels of all supported instruction sets with the scalar reference and exit. The exit code is 1 if a kernel deviates more than its tolerance.");
+	parser.addOption(outputOption);
+	parser.addOption(baselineOption);
+	parser.addOption(toleranceOption);
+	parser.addOption(lineLengthsOption);
+	parser.addOption(lineCountsOption);
+	parser.addOption(kernelsOption);
+	parser.addOption(repetitionsOption);
+	parser.addOption(maxInputOption);
+	parser.addOption(bytesPerSampleOption);
+	parser.addOption(singlePrecisionOption);
+	parser.addOption(padOption);
+	parser.addOption(upsamplingOption);
+	parser.addOption(fftThreadsOption);
+	parser.addOption(isaOption);
+	parser.addOption(checkKernelsOption);
+	parser.process(app);
+
+	if(parser.isSet(checkKernelsOption)){
+		QStringList kernelReport;
+		bool ok = KernelCheck::run(&kernelReport);
+		err << kernelReport.join("\n") << "\n";
+		return ok ? 0 : 1;
+	}
+	if(parser.isSet(isaOption)){
+		KernelIsa isa;
+		if(!KernelDispatch::parseIsaName(parser.value(isaOption).toLatin1().constData(), &isa)){
+			err << "Unknown instruction set: " << parser.value(isaOption) << "\n";
+			return 2;
+		}
+		if(!KernelDispatch::setActiveIsa(isa)){
+			err << "Instruction set " << parser.value(isaOption) << " is not supported by this cpu\n";
+			return 2;
+		}
+	}
+
+	BenchmarkSettings settings;
+	if(!parseList(parser.value(lineLengthsOption), &settings.lineLengths) || !parseList(parser.value(lineCountsOption), &settings.lineCounts)){
+		err << "Invalid line lengths or line counts\n";
+		return 2;
+	}
+	if(parser.isSet(kernelsOption)){
+		for(const QString& item : parser.value(kernelsOption).split(',')){
+			QString kernel = item.trimmed();
+			if(kernel.isEmpty()){
+				continue;
+			}
+			if(!BenchmarkRunner::getKernelNames().contains(kernel)){
+				err << "Unknown kernel: " << kernel << "\n";
+				return 2;
+			}
+			settings.kernels.append(kernel);
+		}
+	}
+	settings.repetitions = qMax(1, parser.value(repetitionsOption).toInt());
+	settings.maxInputBytes = parser.value(maxInputOption).toLongLong()*1024*1024;
+	settings.bytesPerSample = parser.value(bytesPerSampleOption).toInt();
+	if(settings.bytesPerSample != 1 && settings.bytesPerSample != 2 && settings.bytesPerSample != 4){
+		err << "Bytes per sample has to be 1, 2 or 4\n";
+		return 2;
+	}
+	settings.precision = parser.isSet(singlePrecisionOption) ? SINGLE_PRECISION : DOUBLE_PRECISION;
+	if(!PhaseExtractionCalculator::isPrecisionAvailable(settings.precision)){
+		err << "Single precision is not available. Benchmark was built without fftw3f.\n";
+		return 2;
+	}
+	settings.padToSmoothSize = parser.isSet(padOption);
+	settings.upsamplingFactor = qMax(1, parser.value(upsamplingOption).toInt());
+	settings.multithreadedFft = parser.isSet(fftThreadsOption);
+	if(settings.multithreadedFft && !FftwThreadPolicy::isAvailable()){
+		err << "Multithreaded FFT is not available. Benchmark was built without fftw3_threads.\n";
+		settings.multithreadedFft = false;
+	}
+
+	//load the baseline first, so a wrong file name or different settings are noticed before the measurement
+	QVector<BenchmarkCase> baseline;
+	if(parser.isSet(baselineOption)){
+		BenchmarkSettings baselineSettings;
+		QString baselineIsa;
+		if(!BenchmarkReport::load(parser.value(baselineOption), &baseline, &baselineSettings, &baselineIsa)){
+			err << "Could not read baseline report: " << parser.value(baselineOption) << "\n";
+			return 2;
+		}
+		QStringList differences = BenchmarkReport::compareSettings(baselineSettings, baselineIsa, settings);
+		if(!differences.isEmpty()){
+			err << "Baseline report " << parser.value(baselineOption) << " was measured with different settings, run the benchmark with the settings of the baseline:\n  " << differences.join("\n  ") << "\n";
+			return 2;
+		}
+	}
+
+	BenchmarkRunner runner(settings);
+	QVector<BenchmarkCase> cases = runner.run();
+	QByteArray report = BenchmarkReport::toJson(cases, settings);
+	if(parser.isSet(outputOption)){
+		QFile file(parser.value(outputOption));
+		if(!file.open(QIODevice::WriteOnly) || file.write(report) != report.size()){
+			err << "Could not save file to: " << parser.value(outputOption) << "\n";
+			return 2;
+		}
+	}else{
+		QTextStream(stdout) << report;
+	}
+
+	if(!parser.isSet(baselineOption)){
+		return 0;
+	}
+	QVector<BenchmarkComparison> comparisons = BenchmarkReport::compare(baseline, cases, parser.value(toleranceOption).toDouble()/100.0);
+	int regressions = 0;
+	for(const BenchmarkComparison& comparison : comparisons){
+		regressions += (comparison.regression || comparison.accuracyRegression) ? 1 : 0;
+	}
+	err << "\nComparison with " << parser.value(baselineOption) << " (median):\n" << BenchmarkReport::formatComparison(comparisons);
+	err << comparisons.size() << " cases compared, " << regressions << " regressions\n";
+	return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,73 @@
+#calculation sources without gui and without OCTproZ_DevKit dependencies. Included by the extension and by the standalone targets (benchmark)
+QT += core concurrent
+
+#multithreaded fft support is off by default. Enable it with "qmake CONFIG+=fftw_threads" if your fftw build provides fftw3_threads
+
+#single precision calculation mode is off by default. Enable it with "qmake CONFIG+=fftw_float". Needs fftw3f (on windows libfftw3f-3.lib/.dll in thirdparty/fftw)
+
+SOURCES += \
+	$$PWD/src/phaseextractioncalculator.cpp \
+	$$PWD/src/fftwthreadpolicy.cpp \
+	$$PWD/src/phaseextractionengine.cpp \
+	$$PWD/src/pipelinestagecache.cpp \
+	$$PWD/src/calculatorjobscheduler.cpp \
+	$$PWD/src/calibrationverifier.cpp \
+	$$PWD/src/resamplinglut.cpp \
+	$$PWD/src/tracer.cpp \
+	$$PWD/src/polynomial.cpp \
+	$$PWD/src/kerneldispatch.cpp \
+	$$PWD/src/simdkernelssse2.cpp \
+	$$PWD/src/simdkernelsavx2.cpp \
+	$$PWD/src/simdkernelsavx512.cpp
+
+HEADERS += \
+	$$PWD/thirdparty/fftw/fftw3.h \
+	$$PWD/thirdparty/Eigen/src/Core/util/DisableStupidWarnings.h \
+	$$PWD/src/phaseextractioncalculator.h \
+	$$PWD/src/fftwthreadpolicy.h \
+	$$PWD/src/fftwtraits.h \
+	$$PWD/src/phaseextractioncore.h \
+	$$PWD/src/phaseextractionengine.h \
+	$$PWD/src/pipelinestagecache.h \
+	$$PWD/src/calculatorjobscheduler.h \
+	$$PWD/src/analysisresult.h \
+	$$PWD/src/resampling.h \
+	$$PWD/src/calibrationverifier.h \
+	$$PWD/src/resamplinglut.h \
+	$$PWD/src/stagetimings.h \
+	$$PWD/src/tracer.h \
+	$$PWD/src/polynomial.h \
+	$$PWD/src/kerneldispatch.h \
+	$$PWD/src/simdkernels.h
+
+INCLUDEPATH += \
+	$$PWD/src \
+	$$PWD/thirdparty
+
+fftw_threads{
+	DEFINES += PHASEEXTRACTION_FFTW_THREADS
+	unix{
+		LIBS += -lfftw3_threads
+	}
+	#the precompiled fftw dlls for windows already contain the threads library
+}
+fftw_float{
+	unix{
+		DEFINES += PHASEEXTRACTION_FFTW_FLOAT
+		fftw_threads{
+			LIBS += -lfftw3f_threads
+		}
+		LIBS += -lfftw3f
+	}
+	win32:exists($$PWD/thirdparty/fftw/libfftw3f-3.lib){
+		DEFINES += PHASEEXTRACTION_FFTW_FLOAT
+		LIBS += -L$$PWD/thirdparty/fftw/ -llibfftw3f-3
+	}
+}
+unix{
+	LIBS += -lfftw3
+}
+win32{
+	LIBS += -L$$PWD/thirdparty/fftw/ -llibfftw3-3
+	DEPENDPATH += $$PWD/thirdparty/fftw
+}
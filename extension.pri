@@ -0,0 +1,54 @@
+#extension sources with gui, QCustomPlot and OCTproZ_DevKit. Included by the plugin and by the mock host (tools/mockhost)
+include($$PWD/calculator.pri)
+QT += gui widgets printsupport
+
+#define path of OCTproZ_DevKit share directory
+SHAREDIR = $$shell_path($$PWD/../../octproz_share_dev)
+QCUSTOMPLOTDIR = $$shell_path($$PWD/../../thirdparty/QCustomPlot)
+
+SOURCES += \
+	$$QCUSTOMPLOTDIR/qcustomplot.cpp \
+	$$PWD/src/spectrumpreviewworker.cpp \
+	$$PWD/src/recalibrationmonitor.cpp \
+	$$PWD/src/npyarchive.cpp \
+	$$PWD/src/sessionfile.cpp \
+	$$PWD/src/latencyhistogram.cpp \
+	$$PWD/src/minicurveplot.cpp \
+	$$PWD/src/phaseextractionextension.cpp \
+	$$PWD/src/phaseextractionextensionform.cpp
+
+HEADERS += \
+	$$QCUSTOMPLOTDIR/qcustomplot.h \
+	$$PWD/src/spectrumpreviewworker.h \
+	$$PWD/src/recalibrationmonitor.h \
+	$$PWD/src/npyarchive.h \
+	$$PWD/src/sessionfile.h \
+	$$PWD/src/latencyhistogram.h \
+	$$PWD/src/minicurveplot.h \
+	$$PWD/src/phaseextractionextension.h \
+	$$PWD/src/extensionparameters.h \
+	$$PWD/src/phaseextractionextensionform.h
+
+FORMS += \
+	$$PWD/src/phaseextractionextensionform.ui
+
+INCLUDEPATH += $$SHAREDIR \
+	$$QCUSTOMPLOTDIR
+
+#specifie OCTproZ_DevKit libraries to be linked to extension project
+CONFIG(debug, debug|release) {
+	unix{
+		LIBS += $$shell_path($$SHAREDIR/debug/libOCTproZ_DevKit.a)
+	}
+	win32{
+		LIBS += $$shell_path($$SHAREDIR/debug/OCTproZ_DevKit.lib)
+	}
+}
+CONFIG(release, debug|release) {
+	unix{
+		LIBS += $$shell_path($$SHAREDIR/release/libOCTproZ_DevKit.a)
+	}
+	win32{
+		LIBS += $$shell_path($$SHAREDIR/release/OCTproZ_DevKit.lib)
+	}
+}
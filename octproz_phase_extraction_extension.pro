@@ -1,14 +1,15 @@
-QT += core gui widgets printsupport
+QT += core gui widgets printsupport concurrent
 QMAKE_PROJECT_DEPTH = 0
 
+#extension sources, OCTproZ_DevKit and QCustomPlot paths are shared with the mock host. Calculation sources and fftw options (multithreaded fft, single precision) come from calculator.pri, which is shared with the benchmark target
+include(extension.pri)
+
 TARGET = phaseextractionextension
 TEMPLATE = lib
 CONFIG += plugin
 
-#define path of OCTproZ_DevKit share directory, plugin/extension directory
-SHAREDIR = $$shell_path($$PWD/../../octproz_share_dev)
+#define path of plugin/extension directory
 PLUGINEXPORTDIR = $$shell_path($$SHAREDIR/plugins)
-QCUSTOMPLOTDIR = $$shell_path($$PWD/../../thirdparty/QCustomPlot)
 
 
 CONFIG(debug, debug|release) {
@@ -30,41 +31,6 @@ DEFINES += \
 	PHASEEXTRACTIONEXTENSION_LIBRARY \
 	QT_DEPRECATED_WARNINGS #emit warnings if depracted Qt features are used
 
-SOURCES += \
-	$$QCUSTOMPLOTDIR/qcustomplot.cpp \
-	src/phaseextractioncalculator.cpp \
-	src/minicurveplot.cpp \
-	src/phaseextractionextension.cpp \
-	src/phaseextractionextensionform.cpp \
-	src/polynomial.cpp
-
-HEADERS += \
-	$$QCUSTOMPLOTDIR/qcustomplot.h \
-	thirdparty/fftw/fftw3.h \
-	thirdparty/Eigen/src/Core/util/DisableStupidWarnings.h \
-	src/phaseextractioncalculator.h \
-	src/minicurveplot.h \
-	src/phaseextractionextension.h \
-	src/phaseextractionextensionform.h \
-	src/polynomial.h
-
-FORMS += \
-	src/phaseextractionextensionform.ui
-
-INCLUDEPATH += $$SHAREDIR \
-	$$QCUSTOMPLOTDIR \
-	src \
-	thirdparty
-
-unix{
-	LIBS += -lfftw3
-}
-win32{
-	LIBS += -L$$PWD/thirdparty/fftw/ -llibfftw3-3
-	DEPENDPATH += $$PWD/thirdparty/fftw
-}
-
-
 #set system specific output directory for extension
 unix{
 	OUTFILE = $$shell_path($$OUT_PWD/lib$$TARGET'.'$${QMAKE_EXTENSION_SHLIB})
@@ -79,26 +45,6 @@ win32{
 }
 
 
-#specifie OCTproZ_DevKit libraries to be linked to extension project
-CONFIG(debug, debug|release) {
-	unix{
-		LIBS += $$shell_path($$SHAREDIR/debug/libOCTproZ_DevKit.a)
-	}
-	win32{
-		LIBS += $$shell_path($$SHAREDIR/debug/OCTproZ_DevKit.lib)
-	}
-}
-CONFIG(release, debug|release) {
-	PLUGINEXPORTDIR = $$shell_path($$SHAREDIR/plugins/release)
-	unix{
-		LIBS += $$shell_path($$SHAREDIR/release/libOCTproZ_DevKit.a)
-	}
-	win32{
-		LIBS += $$shell_path($$SHAREDIR/release/OCTproZ_DevKit.lib)
-	}
-}
-
-
 ##Copy extension to "PLUGINEXPORTDIR"
 unix{
 	QMAKE_POST_LINK += $$QMAKE_COPY $$quote($${OUTFILE}) $$quote($$PLUGINEXPORTDIR) $$escape_expand(\\n\\t)
@@ -0,0 +1,124 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#ifndef ANALYSISRESULT_H
+#define ANALYSISRESULT_H
+
+#include <QVector>
+#include <QSharedPointer>
+#include <QMetaType>
+#include "pipelinestagecache.h"
+#include "resampling.h"
+
+//Properties of the calibration peak (point spread function) in the averaged magnitude spectrum of resampled lines
+struct PsfMetrics
+{
+	PsfMetrics() : peakPosition(0), peakHeight(0), fwhm(0), sideLobeLevel(0) {}
+
+	double peakPosition; //fft bins
+	double peakHeight;
+	double fwhm; //fft bins
+	double sideLobeLevel; //dB relative to peak height
+};
+
+//Result of CalibrationVerifier
+struct VerificationResult
+{
+	VerificationResult() : valid(false), interpolation(LINEAR_INTERPOLATION), lines(0), accepted(false), durationMs(0) {}
+
+	bool valid;
+	InterpolationMethod interpolation;
+	int lines;
+	PsfMetrics beforeLinearization;
+	PsfMetrics rawCurve;
+	PsfMetrics fittedCurve;
+	bool accepted;
+	qint64 durationMs;
+};
+
+//Convergence of the iterative refinement of the resampling curve
+struct RefinementStats
+{
+	RefinementStats() : iterations(0), converged(false), diverged(false), initialRms(0), finalRms(0), durationMs(0) {}
+
+	int iterations; //number of corrections that were composed into the resampling curve
+	bool converged;
+	bool diverged; //last correction increased the residual and was discarded
+	qreal initialRms; //nonlinear phase rms in rad before refinement
+	qreal finalRms; //residual nonlinear phase rms in rad of the last iteration
+	QVector<qreal> rmsHistory;
+	qint64 durationMs;
+};
+
+//Immutable snapshot of all calculation results of one calculator run.
+//The calculator publishes exactly one snapshot per run. All vectors are implicitly shared with the buffers of the calculator, the calculator detaches as soon as it overwrites one of them, so a published snapshot never changes and can be read from any thread without copies.
+struct AnalysisResult
+{
+	AnalysisResult() : runId(0), updatedStages(0), spectrumMinAfterDC(0), spectrumMaxAfterDC(0), fitValid(false), k0(0), k1(0), k2(0), k3(0) {}
+
+	bool isUpdated(PipelineStage stage) const {return (this->updatedStages & (1 << stage)) != 0;}
+
+	quint64 runId;
+	int updatedStages; //bit mask of the stages that were (re)published by this run, the other members still hold the results of earlier runs
+	QVector<qreal> averagedRaw;
+	QVector<qreal> spectrum;
+	qreal spectrumMinAfterDC;
+	qreal spectrumMaxAfterDC;
+	QVector<qreal> selectedSignal;
+	QVector<qreal> analyticalSignalReal;
+	QVector<qreal> analyticalSignalImag;
+	QVector<qreal> unwrappedPhase;
+	QVector<qreal> nonLinearPhase;
+	QVector<qreal> resamplingCurve;
+	RefinementStats refinement; //iterations is 0 if refinement was disabled
+	QVector<float> fittedResamplingCurve;
+	bool fitValid;
+	double k0; //coefficients with OCTproZ scaling
+	double k1;
+	double k2;
+	double k3;
+	VerificationResult verification;
+};
+
+typedef QSharedPointer<const AnalysisResult> AnalysisResultPtr;
+Q_DECLARE_METATYPE(AnalysisResultPtr)
+
+//One measurement of RecalibrationMonitor
+struct DriftSample {
+	qint64 timestamp; //ms since start of monitoring
+	double k0;
+	double k1;
+	double k2;
+	double k3;
+	double nonLinearPhaseRms;
+	double drift; //max deviation in samples between current and reference resampling curve
+};
+
+Q_DECLARE_METATYPE(DriftSample)
+
+#endif // ANALYSISRESULT_H
@@ -0,0 +1,119 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#include "calculatorjobscheduler.h"
+
+
+CalculatorJobScheduler::CalculatorJobScheduler(QObject *parent) : QObject(parent)
+{
+	this->dispatchPending = false;
+	this->nextGeneration = 1;
+	for(int i = 0; i < NUMBER_OF_JOB_TYPES; i++){
+		this->jobPending[i] = false;
+		this->invalidatedGeneration[i].storeRelease(0);
+	}
+}
+
+bool CalculatorJobScheduler::takeNextJob(CalculatorJob* job) {
+	//called on calculator thread. Jobs are executed in pipeline order, so a pending averaging always runs before a pending analysis
+	QMutexLocker locker(&this->mutex);
+	for(int i = 0; i < NUMBER_OF_JOB_TYPES; i++){
+		if(this->jobPending[i]){
+			this->jobPending[i] = false;
+			*job = this->pendingJobs[i];
+			return true;
+		}
+	}
+	this->dispatchPending = false;
+	return false;
+}
+
+bool CalculatorJobScheduler::isStale(const CalculatorJob& job) {
+	//lock free, so it can be checked between every calculation stage
+	return this->invalidatedGeneration[job.type].loadAcquire() > job.generation;
+}
+
+void CalculatorJobScheduler::submit(CalculatorJob job) {
+	bool dispatch = false;
+	{
+		QMutexLocker locker(&this->mutex);
+		job.generation = this->nextGeneration++;
+
+		//a new request supersedes pending and running jobs of the same type and of all downstream types
+		for(int i = job.type; i < NUMBER_OF_JOB_TYPES; i++){
+			this->jobPending[i] = false;
+			this->invalidatedGeneration[i].storeRelease(job.generation);
+		}
+		this->pendingJobs[job.type] = job;
+		this->jobPending[job.type] = true;
+
+		if(!this->dispatchPending){
+			this->dispatchPending = true;
+			dispatch = true;
+		}
+	}
+	if(dispatch){
+		emit jobsPending();
+	}
+}
+
+void CalculatorJobScheduler::requestAveraging(int firstLine, int lastLine, bool windowRaw, bool useBackground) {
+	CalculatorJob job = CalculatorJob();
+	job.type = JOB_AVERAGING;
+	job.firstLine = firstLine;
+	job.lastLine = lastLine;
+	job.windowRaw = windowRaw;
+	job.useBackground = useBackground;
+	this->submit(job);
+}
+
+void CalculatorJobScheduler::requestAnalysis(int startPos, int endPos, bool windowPeak) {
+	CalculatorJob job = CalculatorJob();
+	job.type = JOB_ANALYSIS;
+	job.startPos = startPos;
+	job.endPos = endPos;
+	job.windowPeak = windowPeak;
+	this->submit(job);
+}
+
+void CalculatorJobScheduler::requestFit(int ignoreStart, int ignoreEnd) {
+	CalculatorJob job = CalculatorJob();
+	job.type = JOB_FIT;
+	job.ignoreStart = ignoreStart;
+	job.ignoreEnd = ignoreEnd;
+	this->submit(job);
+}
+
+void CalculatorJobScheduler::cancelAll() {
+	QMutexLocker locker(&this->mutex);
+	quint64 generation = this->nextGeneration++;
+	for(int i = 0; i < NUMBER_OF_JOB_TYPES; i++){
+		this->jobPending[i] = false;
+		this->invalidatedGeneration[i].storeRelease(generation);
+	}
+}
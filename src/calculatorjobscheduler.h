@@ -0,0 +1,89 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#ifndef CALCULATORJOBSCHEDULER_H
+#define CALCULATORJOBSCHEDULER_H
+
+#include <QObject>
+#include <QMutex>
+#include <QAtomicInteger>
+
+enum CalculatorJobType {
+	JOB_AVERAGING,
+	JOB_ANALYSIS,
+	JOB_FIT,
+	NUMBER_OF_JOB_TYPES
+};
+
+struct CalculatorJob {
+	CalculatorJobType type;
+	quint64 generation;
+	int firstLine;
+	int lastLine;
+	bool windowRaw;
+	bool useBackground;
+	int startPos;
+	int endPos;
+	bool windowPeak;
+	int ignoreStart;
+	int ignoreEnd;
+};
+
+//Collects averaging, analysis and fit requests from the GUI thread and hands them to the calculator thread with latest-wins semantics.
+//Every request gets a generation number. Only the latest pending request of each type is kept and at most one dispatch is queued to the calculator thread at any time.
+//A new request also makes running jobs of the same or a downstream type stale (averaging -> analysis -> fit), which the calculator checks between its stages.
+class CalculatorJobScheduler : public QObject
+{
+	Q_OBJECT
+public:
+	explicit CalculatorJobScheduler(QObject *parent = nullptr);
+
+	bool takeNextJob(CalculatorJob* job);
+	bool isStale(const CalculatorJob& job);
+
+private:
+	void submit(CalculatorJob job);
+
+	QMutex mutex;
+	CalculatorJob pendingJobs[NUMBER_OF_JOB_TYPES];
+	bool jobPending[NUMBER_OF_JOB_TYPES];
+	bool dispatchPending;
+	quint64 nextGeneration;
+	QAtomicInteger<quint64> invalidatedGeneration[NUMBER_OF_JOB_TYPES];
+
+public slots:
+	void requestAveraging(int firstLine, int lastLine, bool windowRaw, bool useBackground);
+	void requestAnalysis(int startPos, int endPos, bool windowPeak);
+	void requestFit(int ignoreStart, int ignoreEnd);
+	void cancelAll();
+
+signals:
+	void jobsPending();
+};
+
+#endif // CALCULATORJOBSCHEDULER_H
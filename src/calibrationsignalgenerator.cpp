@@ -0,0 +1,273 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#include "calibrationsignalgenerator.h"
+#include <QtConcurrent>
+#include <QThread>
+#include <QtMath>
+#include <cmath>
+
+
+FastRandom::FastRandom(quint64 seed, quint64 stream) {
+	quint64 seedState = seed ^ (stream * Q_UINT64_C(0x9E3779B97F4A7C15));
+	for(int lane = 0; lane < FASTRANDOM_LANES; lane++){
+		this->state[lane] = splitMix64(&seedState) | 1; //xorshift state must not be zero
+	}
+}
+
+void FastRandom::fillGaussian(float* dest, int size) {
+	//sum of four uniform 16 bit numbers (Irwin-Hall) with mean 131070 and standard deviation 37837.2. Close enough to a gaussian for detector noise and much cheaper than Box-Muller
+	const float scale = 1.0f/37837.2f;
+	quint64 lanes[FASTRANDOM_LANES];
+	for(int lane = 0; lane < FASTRANDOM_LANES; lane++){
+		lanes[lane] = this->state[lane];
+	}
+	for(int i = 0; i < size; i += FASTRANDOM_LANES){
+		int count = qMin(FASTRANDOM_LANES, size-i);
+		for(int lane = 0; lane < count; lane++){
+			quint64 x = lanes[lane];
+			x ^= x >> 12;
+			x ^= x << 25;
+			x ^= x >> 27;
+			lanes[lane] = x;
+			x *= Q_UINT64_C(0x2545F4914F6CDD1D);
+			quint32 sum = static_cast<quint32>(x & 0xFFFF) + static_cast<quint32>((x >> 16) & 0xFFFF) + static_cast<quint32>((x >> 32) & 0xFFFF) + static_cast<quint32>(x >> 48);
+			dest[i+lane] = (static_cast<float>(sum) - 131070.0f)*scale;
+		}
+	}
+	for(int lane = 0; lane < FASTRANDOM_LANES; lane++){
+		this->state[lane] = lanes[lane];
+	}
+}
+
+quint64 FastRandom::splitMix64(quint64* state) {
+	quint64 z = (*state += Q_UINT64_C(0x9E3779B97F4A7C15));
+	z = (z ^ (z >> 30)) * Q_UINT64_C(0xBF58476D1CE4E5B9);
+	z = (z ^ (z >> 27)) * Q_UINT64_C(0x94D049BB133111EB);
+	return z ^ (z >> 31);
+}
+
+
+struct GeneratorChunk {
+	int firstLine;
+	int numberOfLines;
+};
+
+CalibrationSignalGenerator::CalibrationSignalGenerator() {
+	this->bytesPerSample = 0;
+	this->maxValue = 0;
+	this->phasePerSample = 0;
+}
+
+bool CalibrationSignalGenerator::setParameters(const CalibrationSignalParameters& parameters) {
+	int size = parameters.samplesPerLine;
+	if(size < 2 || parameters.linesPerBuffer < 1 || parameters.bitDepth < 1 || parameters.bitDepth > 32){
+		return false;
+	}
+	this->parameters = parameters;
+	this->bytesPerSample = bytesPerSampleFor(parameters.bitDepth);
+	double fullScale = std::ldexp(1.0, parameters.bitDepth) - 1.0;
+	double maxValue = fullScale*qBound(0.0, parameters.saturationLevel, 1.0);
+	this->maxValue = static_cast<float>(maxValue);
+	if(static_cast<double>(this->maxValue) > maxValue){
+		this->maxValue = std::nextafter(this->maxValue, 0.0f); //float rounding must not push 32 bit full scale beyond the range of the sample type
+	}
+
+	//ground truth resampling curve
+	this->groundTruthCurve.resize(size);
+	for(int i = 0; i < size; i++){
+		this->groundTruthCurve[i] = this->curveAt(i);
+		if(i > 0 && this->groundTruthCurve.at(i) <= this->groundTruthCurve.at(i-1)){
+			this->groundTruthCurve.clear();
+			return false;
+		}
+	}
+
+	//the calculator finds c(i) with phase(c(i)) linear in i, so the raw phase at sample j is linear in the inverse curve c^-1(j). The inverse is interpolated linearly on a fine grid and extrapolated with the outer segments
+	double step = 1.0/CALIBRATIONSIGNAL_CURVE_OVERSAMPLING;
+	int lastSegment = (size-1)*CALIBRATIONSIGNAL_CURVE_OVERSAMPLING - 1;
+	int segment = 0;
+	this->phasePerSample = static_cast<float>(2.0*M_PI*parameters.fringeCycles/(size-1));
+	this->fringeCos.resize(size);
+	this->fringeSin.resize(size);
+	this->background.resize(size);
+	this->amplitude.resize(size);
+	for(int j = 0; j < size; j++){
+		while(segment < lastSegment && this->curveAt((segment+1)*step) < j){
+			segment++;
+		}
+		double start = this->curveAt(segment*step);
+		double end = this->curveAt((segment+1)*step);
+		double position = (segment + (j - start)/(end - start))*step;
+		double phase = 2.0*M_PI*parameters.fringeCycles*position/(size-1);
+		this->fringeCos[j] = static_cast<float>(qCos(phase));
+		this->fringeSin[j] = static_cast<float>(qSin(phase));
+
+		double x = static_cast<double>(j)/(size-1) - 0.5;
+		double envelope = parameters.envelopeWidth > 0 ? qExp(-(x*x)/(parameters.envelopeWidth*parameters.envelopeWidth)) : 1.0;
+		this->background[j] = static_cast<float>(parameters.dcLevel*fullScale*envelope);
+		this->amplitude[j] = static_cast<float>(parameters.fringeAmplitude*fullScale*envelope);
+	}
+	return true;
+}
+
+size_t CalibrationSignalGenerator::getBufferSizeInBytes() const {
+	return static_cast<size_t>(this->parameters.samplesPerLine)*static_cast<size_t>(this->parameters.linesPerBuffer)*this->bytesPerSample;
+}
+
+double CalibrationSignalGenerator::getCurveError(const QVector<double>& curve, int margin) const {
+	//max deviation from the ground truth in samples, ignoring margin samples at both ends. An affine difference only shifts and scales the depth axis and is removed by a least squares line before comparing.
+	//This is needed because the calculator connects the phase of the first and last sample, which are distorted by the window
+	int size = this->groundTruthCurve.size();
+	int first = qMax(0, margin);
+	int last = size - 1 - qMax(0, margin);
+	if(curve.size() != size || last - first < 2){
+		return -1;
+	}
+	double sumX = 0;
+	double sumY = 0;
+	double sumXX = 0;
+	double sumXY = 0;
+	int count = last - first + 1;
+	for(int i = first; i <= last; i++){
+		double difference = curve.at(i) - this->groundTruthCurve.at(i);
+		sumX += i;
+		sumY += difference;
+		sumXX += static_cast<double>(i)*i;
+		sumXY += i*difference;
+	}
+	double slope = (count*sumXY - sumX*sumY)/(count*sumXX - sumX*sumX);
+	double offset = (sumY - slope*sumX)/count;
+	double maxError = 0;
+	for(int i = first; i <= last; i++){
+		double difference = curve.at(i) - this->groundTruthCurve.at(i);
+		maxError = qMax(maxError, qAbs(difference - (offset + slope*i)));
+	}
+	return maxError;
+}
+
+void CalibrationSignalGenerator::generate(unsigned char* buffer, quint64 bufferNr) const {
+	//split lines into chunks, a few more chunks than threads keeps all threads busy until the end
+	int numberOfLines = this->parameters.linesPerBuffer;
+	int numberOfChunks = qMin(numberOfLines, qMax(1, QThread::idealThreadCount()*2));
+	QVector<GeneratorChunk> chunks(numberOfChunks);
+	for(int i = 0; i < numberOfChunks; i++){
+		chunks[i].firstLine = static_cast<int>(static_cast<qint64>(i)*numberOfLines/numberOfChunks);
+		chunks[i].numberOfLines = static_cast<int>(static_cast<qint64>(i+1)*numberOfLines/numberOfChunks) - chunks[i].firstLine;
+	}
+	size_t lineSize = static_cast<size_t>(this->parameters.samplesPerLine)*this->bytesPerSample;
+	quint64 firstLineOfBuffer = bufferNr*static_cast<quint64>(numberOfLines);
+	QtConcurrent::blockingMap(chunks, [&](GeneratorChunk& chunk) {
+		this->generateLines(buffer + chunk.firstLine*lineSize, firstLineOfBuffer + chunk.firstLine, chunk.numberOfLines);
+	});
+}
+
+void CalibrationSignalGenerator::generateLines(unsigned char* dest, quint64 firstLine, int numberOfLines) const {
+	//uchar
+	if(this->bytesPerSample <= 1){
+		this->generateTypedLines(dest, firstLine, numberOfLines);
+	}
+	//ushort
+	else if(this->bytesPerSample <= 2){
+		this->generateTypedLines(reinterpret_cast<quint16*>(dest), firstLine, numberOfLines);
+	}
+	//uint
+	else{
+		this->generateTypedLines(reinterpret_cast<quint32*>(dest), firstLine, numberOfLines);
+	}
+}
+
+int CalibrationSignalGenerator::bytesPerSampleFor(int bitDepth) {
+	//same container sizes as OCTproZ
+	int bytes = (bitDepth + 7)/8;
+	return bytes <= 2 ? bytes : 4;
+}
+
+double CalibrationSignalGenerator::curveAt(double position) const {
+	int size = this->parameters.samplesPerLine;
+	const QVector<double>& custom = this->parameters.customCurve;
+	if(custom.size() == size){
+		int index = qBound(0, static_cast<int>(position), size-2);
+		return custom.at(index) + (position - index)*(custom.at(index+1) - custom.at(index));
+	}
+	double x = position/(size-1);
+	double value = x;
+	double power = x;
+	for(int m = 0; m < this->parameters.nonlinearity.size(); m++){
+		power *= x;
+		value += this->parameters.nonlinearity.at(m)*(power - x);
+	}
+	return value*(size-1);
+}
+
+template <typename S>
+void CalibrationSignalGenerator::generateTypedLines(S* dest, quint64 firstLine, int numberOfLines) const {
+	int size = this->parameters.samplesPerLine;
+	bool jitter = this->parameters.sweepJitter > 0;
+	bool noise = this->parameters.shotNoise > 0;
+	float noiseScale = static_cast<float>(this->parameters.shotNoise);
+	float maxValue = this->maxValue;
+	const float* fringeCos = this->fringeCos.constData();
+	const float* fringeSin = this->fringeSin.constData();
+	const float* background = this->background.constData();
+	const float* amplitude = this->amplitude.constData();
+	QVector<float> line(size);
+	QVector<float> random(size);
+
+	for(int n = 0; n < numberOfLines; n++){
+		//every line has its own random stream, derived from the seed and its absolute line number
+		FastRandom generator(this->parameters.seed, firstLine + n);
+		float cosOffset = 1.0f;
+		float sinOffset = 0.0f;
+		if(jitter){
+			float offset;
+			generator.fillGaussian(&offset, 1);
+			offset *= static_cast<float>(this->parameters.sweepJitter)*this->phasePerSample;
+			cosOffset = std::cos(offset);
+			sinOffset = std::sin(offset);
+		}
+
+		//fringe with the jitter applied as rotation: cos(a + b) = cos(a)cos(b) - sin(a)sin(b)
+		float* values = line.data();
+		for(int j = 0; j < size; j++){
+			values[j] = background[j] + amplitude[j]*(fringeCos[j]*cosOffset - fringeSin[j]*sinOffset);
+		}
+		if(noise){
+			generator.fillGaussian(random.data(), size);
+			for(int j = 0; j < size; j++){
+				values[j] += noiseScale*std::sqrt(qMax(values[j], 0.0f))*random.at(j);
+			}
+		}
+
+		//quantization with saturation
+		S* out = dest + static_cast<size_t>(n)*size;
+		for(int j = 0; j < size; j++){
+			out[j] = static_cast<S>(qBound(0.0f, values[j] + 0.5f, maxValue));
+		}
+	}
+}
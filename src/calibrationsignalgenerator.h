@@ -0,0 +1,103 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+
+#ifndef CALIBRATIONSIGNALGENERATOR_H
+#define CALIBRATIONSIGNALGENERATOR_H
+
+#include <QtGlobal>
+#include <QVector>
+
+#define CALIBRATIONSIGNAL_CURVE_OVERSAMPLING 16 //the ground truth curve is inverted on a grid this much finer than the sample grid
+#define FASTRANDOM_LANES 8
+
+struct CalibrationSignalParameters {
+	CalibrationSignalParameters() : samplesPerLine(1024), linesPerBuffer(1024), bitDepth(12), fringeCycles(128.0), sweepJitter(0.0), dcLevel(0.5), fringeAmplitude(0.3), envelopeWidth(0.0), shotNoise(0.0), saturationLevel(1.0), seed(1) {}
+
+	int samplesPerLine;
+	int linesPerBuffer;
+	int bitDepth; //1 to 32 bit, stored in 1, 2 or 4 bytes per sample like in OCTproZ
+	double fringeCycles; //fringe periods per line on the linear wavenumber axis. The peak is at this bin of an unpadded fft
+	QVector<double> nonlinearity; //coefficients of x^2, x^3, ... of the normalized resampling curve c(x) = x + sum n_m*(x^m - x) with x in [0, 1]. First and last sample stay in place
+	QVector<double> customCurve; //arbitrary resampling curve in samples, used instead of nonlinearity if it has samplesPerLine values. Has to increase monotonically
+	double sweepJitter; //rms of a random wavenumber offset of every sweep in samples
+	double dcLevel; //background relative to full scale
+	double fringeAmplitude; //relative to full scale
+	double envelopeWidth; //1/e half width of a gaussian source spectrum relative to the line length. 0: flat spectrum
+	double shotNoise; //noise standard deviation in units of sqrt(counts). 1 corresponds to the poisson noise of a detector with one count per photoelectron
+	double saturationLevel; //relative to full scale, samples above are clipped
+	quint64 seed;
+};
+
+//Pseudo random numbers from xorshift64* generators in FASTRANDOM_LANES independent lanes.
+//Neighbouring samples are drawn from different lanes, so there is no dependency between consecutive loop iterations and the compiler can vectorize the fill loop
+class FastRandom
+{
+public:
+	FastRandom(quint64 seed, quint64 stream);
+	void fillGaussian(float* dest, int size);
+
+private:
+	static quint64 splitMix64(quint64* state);
+	quint64 state[FASTRANDOM_LANES];
+};
+
+//Raw OCT buffers of a calibration measurement with a known k-nonlinearity: every line is a fringe that, resampled with the ground truth curve, becomes a pure cosine.
+//Sweep jitter, dc background, source envelope, shot noise and saturation can be added. Every line only depends on the seed and its absolute line number, so buffers are reproducible and independent of the number of threads
+class CalibrationSignalGenerator
+{
+public:
+	CalibrationSignalGenerator();
+
+	bool setParameters(const CalibrationSignalParameters& parameters); //returns false if a size is invalid or the resampling curve does not increase monotonically
+	const CalibrationSignalParameters& getParameters() const { return this->parameters; }
+	const QVector<double>& getGroundTruthCurve() const { return this->groundTruthCurve; } //resampling curve that PhaseExtractionCalculator should find for this signal
+	double getCurveError(const QVector<double>& curve, int margin) const;
+	int getBytesPerSample() const { return this->bytesPerSample; }
+	size_t getBufferSizeInBytes() const;
+	void generate(unsigned char* buffer, quint64 bufferNr) const; //linesPerBuffer lines, multithreaded
+	void generateLines(unsigned char* dest, quint64 firstLine, int numberOfLines) const; //numberOfLines lines starting at absolute line number firstLine, single threaded
+	static int bytesPerSampleFor(int bitDepth);
+
+private:
+	double curveAt(double position) const;
+	template <typename S>
+	void generateTypedLines(S* dest, quint64 firstLine, int numberOfLines) const;
+
+	CalibrationSignalParameters parameters;
+	int bytesPerSample;
+	float maxValue;
+	float phasePerSample; //fringe phase per sample on the linear wavenumber axis, converts the sweep jitter into a phase offset
+	QVector<double> groundTruthCurve;
+	QVector<float> fringeCos; //cosine and sine of the fringe phase at every raw sample without jitter. A jittered line only needs one rotation per line instead of a cosine per sample
+	QVector<float> fringeSin;
+	QVector<float> background;
+	QVector<float> amplitude;
+};
+
+#endif // CALIBRATIONSIGNALGENERATOR_H
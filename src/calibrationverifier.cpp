@@ -0,0 +1,235 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#include "calibrationverifier.h"
+#include "phaseextractionengine.h"
+#include "fftwthreadpolicy.h"
+#include <QtConcurrent>
+#include <QElapsedTimer>
+#include <QThread>
+#include <cstring>
+
+
+struct VerificationChunk {
+	int firstIndex;
+	int numberOfLines;
+	QVector<double> magnitudeSum;
+};
+
+CalibrationVerifier::CalibrationVerifier() {
+	this->paddedFftSize = 0;
+	this->plan = nullptr;
+}
+
+CalibrationVerifier::~CalibrationVerifier() {
+	if(this->plan != nullptr){
+		QMutexLocker plannerLocker(FftwThreadPolicy::getPlannerMutex());
+		FftwTraits<double>::destroyPlan(this->plan);
+	}
+}
+
+VerificationResult CalibrationVerifier::verify(const unsigned char* data, int bytesPerSample, int samplesPerLine, qint64 linesInData, qint64 firstLine, qint64 numberOfLines, const QVector<qreal>& rawCurve, const QVector<qreal>& fittedCurve, int fftSize, int startPos, int endPos, InterpolationMethod method) {
+	VerificationResult result;
+	if(data == nullptr || numberOfLines <= 0 || rawCurve.size() != samplesPerLine || fittedCurve.size() != samplesPerLine){
+		return result;
+	}
+	//all averaged lines have to be inside of the data
+	if(firstLine < 0 || firstLine >= linesInData || numberOfLines > linesInData-firstLine){
+		return result;
+	}
+	QElapsedTimer timer;
+	timer.start();
+
+	//zero padding makes the fwhm measurement independent of the bin width
+	this->updatePlan(fftSize*VERIFICATION_ZERO_PADDING);
+	qint64 lineStep = qMax(static_cast<qint64>(1), numberOfLines/VERIFICATION_MAX_LINES);
+	int lines = static_cast<int>(numberOfLines/lineStep);
+
+	QVector<double> before = this->averageMagnitudeSpectrum(data, bytesPerSample, samplesPerLine, firstLine, lines, lineStep, nullptr, method);
+	QVector<double> raw = this->averageMagnitudeSpectrum(data, bytesPerSample, samplesPerLine, firstLine, lines, lineStep, rawCurve.constData(), method);
+	QVector<double> fitted = this->averageMagnitudeSpectrum(data, bytesPerSample, samplesPerLine, firstLine, lines, lineStep, fittedCurve.constData(), method);
+
+	result.beforeLinearization = measurePsf(before, startPos, endPos, VERIFICATION_ZERO_PADDING);
+	result.rawCurve = measurePsf(raw, startPos, endPos, VERIFICATION_ZERO_PADDING);
+	result.fittedCurve = measurePsf(fitted, startPos, endPos, VERIFICATION_ZERO_PADDING);
+	result.interpolation = method;
+	result.lines = lines;
+	result.valid = true;
+	result.accepted = isAccepted(result);
+	result.durationMs = timer.elapsed();
+	return result;
+}
+
+bool CalibrationVerifier::isAccepted(const VerificationResult& result) {
+	//the fitted curve has to sharpen the peak, must not be noticeably worse than the raw curve and must not create strong side lobes
+	return result.valid
+			&& result.fittedCurve.fwhm > 0
+			&& result.fittedCurve.fwhm <= result.beforeLinearization.fwhm
+			&& result.fittedCurve.fwhm <= result.rawCurve.fwhm*VERIFICATION_MAX_FWHM_RATIO
+			&& result.fittedCurve.sideLobeLevel <= VERIFICATION_MAX_SIDELOBE_DB;
+}
+
+void CalibrationVerifier::updatePlan(int size) {
+	if(size == this->paddedFftSize && this->plan != nullptr){
+		return;
+	}
+	//the buffer is only needed for planning, chunks execute the plan on their own buffers with the same alignment
+	QMutexLocker plannerLocker(FftwThreadPolicy::getPlannerMutex());
+	if(this->plan != nullptr){
+		FftwTraits<double>::destroyPlan(this->plan);
+	}
+	FftwTraits<double>::Complex* buffer = FftwTraits<double>::allocComplex(size);
+	this->plan = FftwTraits<double>::planDft1d(size, buffer, buffer, FFTW_FORWARD);
+	FftwTraits<double>::free(buffer);
+	this->paddedFftSize = size;
+}
+
+QVector<double> CalibrationVerifier::averageMagnitudeSpectrum(const unsigned char* data, int bytesPerSample, int samplesPerLine, qint64 firstLine, int numberOfLines, qint64 lineStep, const qreal* curve, InterpolationMethod method) {
+	int size = this->paddedFftSize;
+	int spectrumSize = size/2;
+	QVector<qreal> window = PhaseExtractionEngineBase::getHanningWindow(samplesPerLine);
+
+	//split lines into chunks, a few more chunks than threads keeps all threads busy until the end
+	int numberOfChunks = qMin(numberOfLines, qMax(1, QThread::idealThreadCount()*2));
+	QVector<VerificationChunk> chunks(numberOfChunks);
+	for(int i = 0; i < numberOfChunks; i++){
+		chunks[i].firstIndex = static_cast<int>(static_cast<qint64>(i)*numberOfLines/numberOfChunks);
+		chunks[i].numberOfLines = static_cast<int>(static_cast<qint64>(i+1)*numberOfLines/numberOfChunks) - chunks[i].firstIndex;
+	}
+
+	FftwTraits<double>::Plan sharedPlan = this->plan;
+	QtConcurrent::blockingMap(chunks, [&](VerificationChunk& chunk) {
+		FftwTraits<double>::Complex* buffer = FftwTraits<double>::allocComplex(size);
+		QVector<double> line(samplesPerLine);
+		QVector<double> resampledLine(samplesPerLine);
+		chunk.magnitudeSum.fill(0, spectrumSize);
+		for(int n = chunk.firstIndex; n < chunk.firstIndex+chunk.numberOfLines; n++){
+			size_t lineNumber = static_cast<size_t>(firstLine) + static_cast<size_t>(n)*static_cast<size_t>(lineStep);
+			KernelDispatch::decodeLine(data, bytesPerSample, lineNumber*samplesPerLine, samplesPerLine, line.data());
+
+			//remove dc, resample, window and zero pad
+			double mean = 0;
+			for(int i = 0; i < samplesPerLine; i++){
+				mean += line.at(i);
+			}
+			mean /= samplesPerLine;
+			for(int i = 0; i < samplesPerLine; i++){
+				line[i] -= mean;
+			}
+			const double* src = line.constData();
+			if(curve != nullptr){
+				Resampling::resampleLine(line.constData(), samplesPerLine, curve, method, resampledLine.data());
+				src = resampledLine.constData();
+			}
+			memset(buffer, 0, size*sizeof(FftwTraits<double>::Complex));
+			for(int i = 0; i < samplesPerLine; i++){
+				buffer[i][REAL] = src[i]*window.at(i);
+			}
+
+			FftwTraits<double>::executeDft(sharedPlan, buffer, buffer);
+			for(int k = 0; k < spectrumSize; k++){
+				chunk.magnitudeSum[k] += qSqrt(buffer[k][REAL]*buffer[k][REAL] + buffer[k][IMAG]*buffer[k][IMAG]);
+			}
+		}
+		FftwTraits<double>::free(buffer);
+	});
+
+	QVector<double> magnitude(spectrumSize, 0.0);
+	for(const VerificationChunk& chunk : chunks){
+		for(int k = 0; k < spectrumSize; k++){
+			magnitude[k] += chunk.magnitudeSum.at(k);
+		}
+	}
+	for(int k = 0; k < spectrumSize; k++){
+		magnitude[k] /= numberOfLines;
+	}
+	return magnitude;
+}
+
+PsfMetrics CalibrationVerifier::measurePsf(const QVector<double>& magnitude, int startPos, int endPos, int zeroPadding) {
+	PsfMetrics metrics;
+	int size = magnitude.size();
+	if(size < 3){
+		return metrics;
+	}
+
+	//peak is searched within the peak range selected by the user
+	int first = qBound(0, startPos*zeroPadding, size-1);
+	int last = qBound(0, endPos*zeroPadding + zeroPadding-1, size-1);
+	int peak = first;
+	for(int i = first; i <= last; i++){
+		if(magnitude.at(i) > magnitude.at(peak)){
+			peak = i;
+		}
+	}
+	double height = magnitude.at(peak);
+	if(height <= 0){
+		return metrics;
+	}
+
+	//full width at half maximum, half maximum crossings are linearly interpolated between bins
+	double halfMax = height/2.0;
+	int left = peak;
+	while(left > 0 && magnitude.at(left) > halfMax){
+		left--;
+	}
+	int right = peak;
+	while(right < size-1 && magnitude.at(right) > halfMax){
+		right++;
+	}
+	double leftDelta = magnitude.at(left+1) - magnitude.at(left);
+	double rightDelta = magnitude.at(right-1) - magnitude.at(right);
+	double leftCrossing = left + (leftDelta != 0 ? (halfMax - magnitude.at(left))/leftDelta : 0);
+	double rightCrossing = right - (rightDelta != 0 ? (halfMax - magnitude.at(right))/rightDelta : 0);
+
+	//main lobe ends at the first minimum on each side. Highest maximum beyond that within VERIFICATION_SIDELOBE_RANGE main lobe widths is the side lobe level
+	int lobeStart = peak;
+	while(lobeStart > 0 && magnitude.at(lobeStart-1) < magnitude.at(lobeStart)){
+		lobeStart--;
+	}
+	int lobeEnd = peak;
+	while(lobeEnd < size-1 && magnitude.at(lobeEnd+1) < magnitude.at(lobeEnd)){
+		lobeEnd++;
+	}
+	int range = qMax(1, lobeEnd-lobeStart)*VERIFICATION_SIDELOBE_RANGE;
+	int searchStart = qMax(SPECTRUM_POS_AFTER_DC*zeroPadding, lobeStart-range);
+	int searchEnd = qMin(size-1, lobeEnd+range);
+	double sideLobe = 0;
+	for(int i = searchStart; i < lobeStart; i++){
+		sideLobe = qMax(sideLobe, magnitude.at(i));
+	}
+	for(int i = lobeEnd+1; i <= searchEnd; i++){
+		sideLobe = qMax(sideLobe, magnitude.at(i));
+	}
+
+	metrics.peakPosition = static_cast<double>(peak)/zeroPadding;
+	metrics.peakHeight = height;
+	metrics.fwhm = (rightCrossing - leftCrossing)/zeroPadding;
+	metrics.sideLobeLevel = sideLobe > 0 ? 20.0*log10(sideLobe/height) : -200.0;
+	return metrics;
+}
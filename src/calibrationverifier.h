@@ -0,0 +1,62 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#ifndef CALIBRATIONVERIFIER_H
+#define CALIBRATIONVERIFIER_H
+
+#include <QVector>
+#include "analysisresult.h"
+#include "fftwtraits.h"
+
+#define VERIFICATION_ZERO_PADDING 4
+#define VERIFICATION_MAX_LINES 4096
+#define VERIFICATION_SIDELOBE_RANGE 8 //side lobes are searched within this many main lobe widths around the peak
+#define VERIFICATION_MAX_FWHM_RATIO 1.1 //the fitted curve may broaden the peak by at most 10% compared to the raw curve
+#define VERIFICATION_MAX_SIDELOBE_DB -25.0
+
+//Closed loop check of a resampling curve: lines are resampled with the curve, windowed and transformed, and the calibration peak of the averaged magnitude spectrum is measured.
+//This is done without resampling, with the raw resampling curve and with the fitted resampling curve. Lines are split into chunks that are processed in parallel, every chunk has its own fft buffer and uses the shared plan with fftw_execute_dft.
+class CalibrationVerifier
+{
+public:
+	CalibrationVerifier();
+	~CalibrationVerifier();
+
+	VerificationResult verify(const unsigned char* data, int bytesPerSample, int samplesPerLine, qint64 linesInData, qint64 firstLine, qint64 numberOfLines, const QVector<qreal>& rawCurve, const QVector<qreal>& fittedCurve, int fftSize, int startPos, int endPos, InterpolationMethod method);
+	static bool isAccepted(const VerificationResult& result);
+	static PsfMetrics measurePsf(const QVector<double>& magnitude, int startPos, int endPos, int zeroPadding);
+
+private:
+	void updatePlan(int size);
+	QVector<double> averageMagnitudeSpectrum(const unsigned char* data, int bytesPerSample, int samplesPerLine, qint64 firstLine, int numberOfLines, qint64 lineStep, const qreal* curve, InterpolationMethod method);
+
+	int paddedFftSize;
+	FftwTraits<double>::Plan plan;
+};
+
+#endif // CALIBRATIONVERIFIER_H
@@ -0,0 +1,90 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+
+#ifndef EXTENSIONPARAMETERS_H
+#define EXTENSIONPARAMETERS_H
+
+//keys of the stored settings, used by OCTproZ settings, session files and the batch tool
+#define START_WITH_FIRST_BUFFER "start_with_first_buffer"
+#define BUFFERS_TO_FETCH "buffer_to_fetch"
+#define SELECT_ALL_ASCANS "select_all_ascans"
+#define WINDOW_RAW "window_raw_data"
+#define FIRST_ASCAN "first_ascan"
+#define LAST_ASCAN "last_ascan"
+#define PEAK_START "peak_start"
+#define PEAK_END "peak_end"
+#define IGNORE_START "ignore_start"
+#define IGNORE_END "ignore_end"
+#define PAD_FFT "pad_fft_to_smooth_size"
+#define UPSAMPLING_FACTOR "upsampling_factor"
+#define MULTITHREADED_FFT "multithreaded_fft"
+#define CALCULATION_PRECISION "calculation_precision"
+#define LIVE_PREVIEW "live_preview"
+#define PREVIEW_INTERVAL "preview_interval"
+#define WINDOW_PEAK "window_selected_peak"
+#define DRIFT_INTERVAL "drift_interval"
+#define DRIFT_THRESHOLD "drift_threshold"
+#define VERIFICATION_INTERPOLATION "verification_interpolation"
+#define REFINEMENT_ITERATIONS "refinement_iterations"
+#define REFINEMENT_TOLERANCE "refinement_tolerance"
+#define LUT_HALF_PRECISION "lut_half_precision"
+#define COMPRESS_SESSION "compress_session"
+#define SHOW_TIMINGS "show_timings"
+
+//user parameters of the extension. Plain data without gui dependencies, so worker threads and command line tools can use them
+struct PhaseExtractionExtensionParameters {
+	bool startWithFirstBuffer;
+	int buffersToFetch;
+	bool useAllAscans;
+	bool windowRaw;
+	int firstLine;
+	int lastLine;
+	int startPos;
+	int endPos;
+	int ignoreStart;
+	int ignoreEnd;
+	bool padToSmoothSize;
+	int upsamplingFactor;
+	bool multithreadedFft;
+	int precision;
+	bool livePreview;
+	int previewInterval;
+	bool windowPeak;
+	bool driftMonitor;
+	int driftInterval; //seconds
+	double driftThreshold; //samples
+	int verificationInterpolation;
+	int refinementIterations; //0: no refinement
+	double refinementTolerance; //rad
+	bool lutHalfPrecision;
+	bool compressSession;
+	bool showTimings;
+};
+
+#endif // EXTENSIONPARAMETERS_H
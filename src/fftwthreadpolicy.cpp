@@ -0,0 +1,137 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#include "fftwthreadpolicy.h"
+#include "fftw/fftw3.h"
+#include <QThread>
+#include <QElapsedTimer>
+#include <cstring>
+#include <climits>
+
+#define MIN_MEASURED_EXPONENT 10
+#define MAX_MEASURED_EXPONENT 16
+#define MEASUREMENT_REPETITIONS 5
+
+
+FftwThreadPolicy::FftwThreadPolicy() {
+	this->enabled = false;
+	this->maxThreads = qMax(1, QThread::idealThreadCount());
+	this->crossoverSize = 0;
+}
+
+bool FftwThreadPolicy::isAvailable() {
+	static bool available = initThreads();
+	return available;
+}
+
+void FftwThreadPolicy::setEnabled(bool enable) {
+	this->enabled = enable && isAvailable() && this->maxThreads > 1;
+}
+
+int FftwThreadPolicy::getCrossoverSize() {
+	if(this->crossoverSize == 0){
+		this->crossoverSize = this->measureCrossoverSize();
+	}
+	return this->crossoverSize;
+}
+
+int FftwThreadPolicy::threadsFor(int fftSize) {
+	if(!this->enabled){
+		return 1;
+	}
+	return fftSize >= this->getCrossoverSize() ? this->maxThreads : 1;
+}
+
+void FftwThreadPolicy::applyTo(int threads) {
+#ifdef PHASEEXTRACTION_FFTW_THREADS
+	if(isAvailable()){
+		fftw_plan_with_nthreads(threads);
+#ifdef PHASEEXTRACTION_FFTW_FLOAT
+		fftwf_plan_with_nthreads(threads);
+#endif
+	}
+#else
+	Q_UNUSED(threads)
+#endif
+}
+
+QMutex* FftwThreadPolicy::getPlannerMutex() {
+	static QMutex plannerMutex;
+	return &plannerMutex;
+}
+
+bool FftwThreadPolicy::initThreads() {
+#ifdef PHASEEXTRACTION_FFTW_THREADS
+#ifdef PHASEEXTRACTION_FFTW_FLOAT
+	return fftw_init_threads() != 0 && fftwf_init_threads() != 0;
+#else
+	return fftw_init_threads() != 0;
+#endif
+#else
+	return false;
+#endif
+}
+
+int FftwThreadPolicy::measureCrossoverSize() {
+	//find smallest power of two for which a multithreaded transform is faster than a single threaded one
+	for(int exponent = MIN_MEASURED_EXPONENT; exponent <= MAX_MEASURED_EXPONENT; exponent++){
+		int fftSize = 1 << exponent;
+		qint64 singleThreadTime = this->measureExecutionTime(fftSize, 1);
+		qint64 multiThreadTime = this->measureExecutionTime(fftSize, this->maxThreads);
+		if(multiThreadTime < singleThreadTime){
+			return fftSize;
+		}
+	}
+	return INT_MAX;
+}
+
+qint64 FftwThreadPolicy::measureExecutionTime(int fftSize, int threads) {
+	fftw_complex* buffer = fftw_alloc_complex(fftSize);
+	memset(buffer, 0, fftSize * sizeof(fftw_complex));
+	QMutexLocker plannerLocker(getPlannerMutex());
+	this->applyTo(threads);
+	fftw_plan plan = fftw_plan_dft_1d(fftSize, buffer, buffer, FFTW_FORWARD, FFTW_ESTIMATE);
+	this->applyTo(1);
+	plannerLocker.unlock();
+
+	//first execution is not timed as it includes thread startup and cache warmup. Best of the remaining executions is used
+	fftw_execute(plan);
+	qint64 bestTime = LLONG_MAX;
+	QElapsedTimer timer;
+	for(int i = 0; i < MEASUREMENT_REPETITIONS; i++){
+		timer.start();
+		fftw_execute(plan);
+		bestTime = qMin(bestTime, timer.nsecsElapsed());
+	}
+
+	plannerLocker.relock();
+	fftw_destroy_plan(plan);
+	plannerLocker.unlock();
+	fftw_free(buffer);
+	return bestTime;
+}
@@ -0,0 +1,61 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#ifndef FFTWTHREADPOLICY_H
+#define FFTWTHREADPOLICY_H
+
+#include <QtGlobal>
+#include <QMutex>
+
+//FFTW can split a single transform over several threads if it is linked against fftw3_threads (CONFIG += fftw_threads in the .pro file).
+//This only pays off above a certain transform size. The crossover size is measured once on the machine the plugin is running on.
+class FftwThreadPolicy
+{
+public:
+	FftwThreadPolicy();
+
+	static bool isAvailable();
+	void setEnabled(bool enable);
+	bool isEnabled() { return this->enabled; }
+	int getMaxThreads() { return this->maxThreads; }
+	int getCrossoverSize();
+	int threadsFor(int fftSize);
+	void applyTo(int threads); //sets number of threads used by all subsequently created plans
+	static QMutex* getPlannerMutex(); //the fftw planner is not thread safe. Has to be held while setting the thread count and creating or destroying plans
+
+private:
+	static bool initThreads();
+	int measureCrossoverSize();
+	qint64 measureExecutionTime(int fftSize, int threads);
+
+	bool enabled;
+	int maxThreads;
+	int crossoverSize;
+};
+
+#endif // FFTWTHREADPOLICY_H
@@ -0,0 +1,69 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#ifndef FFTWTRAITS_H
+#define FFTWTRAITS_H
+
+#include <stddef.h>
+#include "fftw/fftw3.h"
+
+//Maps the scalar type used for calculations to the corresponding fftw API (fftw_* for double, fftwf_* for float)
+template <typename T>
+struct FftwTraits;
+
+template <>
+struct FftwTraits<double>
+{
+	typedef fftw_complex Complex;
+	typedef fftw_plan Plan;
+
+	static Complex* allocComplex(size_t size) { return fftw_alloc_complex(size); }
+	static void free(void* data) { fftw_free(data); }
+	static Plan planDft1d(int size, Complex* in, Complex* out, int sign) { return fftw_plan_dft_1d(size, in, out, sign, FFTW_ESTIMATE); }
+	static void execute(Plan plan) { fftw_execute(plan); }
+	static void executeDft(Plan plan, Complex* in, Complex* out) { fftw_execute_dft(plan, in, out); } //thread safe, buffers need same alignment and in-place-ness as the ones used for planning
+	static void destroyPlan(Plan plan) { fftw_destroy_plan(plan); }
+};
+
+#ifdef PHASEEXTRACTION_FFTW_FLOAT
+template <>
+struct FftwTraits<float>
+{
+	typedef fftwf_complex Complex;
+	typedef fftwf_plan Plan;
+
+	static Complex* allocComplex(size_t size) { return fftwf_alloc_complex(size); }
+	static void free(void* data) { fftwf_free(data); }
+	static Plan planDft1d(int size, Complex* in, Complex* out, int sign) { return fftwf_plan_dft_1d(size, in, out, sign, FFTW_ESTIMATE); }
+	static void execute(Plan plan) { fftwf_execute(plan); }
+	static void executeDft(Plan plan, Complex* in, Complex* out) { fftwf_execute_dft(plan, in, out); }
+	static void destroyPlan(Plan plan) { fftwf_destroy_plan(plan); }
+};
+#endif
+
+#endif // FFTWTRAITS_H
@@ -0,0 +1,208 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#include "kerneldispatch.h"
+#include <cstdlib>
+#include <cstring>
+#if defined(KERNELDISPATCH_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+
+namespace {
+
+template <typename T>
+void fillScalarKernels(KernelTable<T>* kernels) {
+	kernels->decodeLine = [](const uint16_t* src, int size, T* dest) {
+		PhaseExtractionCore::decodeSamples(src, size, dest, 1);
+	};
+	kernels->accumulateLines = [](const uint16_t* src, int samplesPerLine, size_t firstLine, int numberOfLines, int lineStep, int size, T* dest) {
+		PhaseExtractionCore::accumulateTypedLines(src, samplesPerLine, firstLine, numberOfLines, lineStep, size, dest, 1);
+	};
+	kernels->applyWindow = [](T* signal, int size, const T* window) {
+		PhaseExtractionCore::applyWindow(signal, size, window, 1);
+	};
+	kernels->calculatePhase = &PhaseExtractionCore::calculatePhase<T>;
+	kernels->unwrapPhase = &PhaseExtractionCore::unwrapPhase<T>;
+	kernels->evaluatePolynomial = &PhaseExtractionCore::evaluatePolynomial<T, T>;
+}
+
+KernelIsa detectIsa() {
+#ifdef KERNELDISPATCH_X86
+#if defined(_MSC_VER)
+	//cpuid reports what the cpu can do, xgetbv whether the os saves the avx and avx-512 registers on context switches
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+	__cpuid(info, 1);
+	bool sse2 = (info[3] & (1 << 26)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	bool fma = (info[2] & (1 << 12)) != 0;
+	unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+	bool avxState = (xcr0 & 0x06) == 0x06;
+	bool avx512State = (xcr0 & 0xE6) == 0xE6;
+	bool avx2 = false;
+	bool avx512 = false;
+	if(maxLeaf >= 7){
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+		avx512 = (info[1] & (1 << 16)) != 0;
+	}
+	if(avx512 && avx2 && fma && avx && avx512State){
+		return KERNEL_ISA_AVX512;
+	}
+	if(avx2 && fma && avx && avxState){
+		return KERNEL_ISA_AVX2;
+	}
+	return sse2 ? KERNEL_ISA_SSE2 : KERNEL_ISA_SCALAR;
+#else
+	//__builtin_cpu_supports also checks the os support of the avx registers
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")){
+		return KERNEL_ISA_AVX512;
+	}
+	if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")){
+		return KERNEL_ISA_AVX2;
+	}
+	return __builtin_cpu_supports("sse2") ? KERNEL_ISA_SSE2 : KERNEL_ISA_SCALAR;
+#endif
+#else
+	return KERNEL_ISA_SCALAR;
+#endif
+}
+
+struct KernelDispatchState {
+	KernelDispatchState() {
+		//every table starts with the scalar reference, the instruction set specific fill functions only replace what they vectorize
+		for(int i = 0; i < KERNEL_ISA_COUNT; i++){
+			fillScalarKernels(&this->floatKernels[i]);
+			fillScalarKernels(&this->doubleKernels[i]);
+			this->available[i] = i == KERNEL_ISA_SCALAR;
+		}
+		KernelIsa cpuIsa = detectIsa();
+		this->available[KERNEL_ISA_SSE2] = cpuIsa >= KERNEL_ISA_SSE2 && fillSse2Kernels(&this->floatKernels[KERNEL_ISA_SSE2], &this->doubleKernels[KERNEL_ISA_SSE2]);
+		this->available[KERNEL_ISA_AVX2] = cpuIsa >= KERNEL_ISA_AVX2 && fillAvx2Kernels(&this->floatKernels[KERNEL_ISA_AVX2], &this->doubleKernels[KERNEL_ISA_AVX2]);
+		this->available[KERNEL_ISA_AVX512] = cpuIsa >= KERNEL_ISA_AVX512 && fillAvx512Kernels(&this->floatKernels[KERNEL_ISA_AVX512], &this->doubleKernels[KERNEL_ISA_AVX512]);
+		this->supported = KERNEL_ISA_SCALAR;
+		for(int i = 0; i < KERNEL_ISA_COUNT; i++){
+			if(this->available[i]){
+				this->supported = static_cast<KernelIsa>(i);
+			}
+		}
+
+		//an instruction set that is forced by the environment but not supported falls back to the best supported one below it
+		this->active = this->supported;
+		KernelIsa forced;
+		const char* forcedName = getenv(KERNELDISPATCH_ISA_ENV);
+		if(forcedName != nullptr && KernelDispatch::parseIsaName(forcedName, &forced)){
+			while(!this->available[forced]){
+				forced = static_cast<KernelIsa>(forced-1);
+			}
+			this->active = forced;
+		}
+	}
+
+	KernelTable<float> floatKernels[KERNEL_ISA_COUNT];
+	KernelTable<double> doubleKernels[KERNEL_ISA_COUNT];
+	bool available[KERNEL_ISA_COUNT];
+	KernelIsa supported;
+	KernelIsa active;
+};
+
+KernelDispatchState& getState() {
+	static KernelDispatchState state;
+	return state;
+}
+
+//detection runs when the plugin or program is loaded, not within the first calculation
+struct LoadTimeDetection {
+	LoadTimeDetection() { getState(); }
+} loadTimeDetection;
+
+}
+
+
+KernelIsa KernelDispatch::getSupportedIsa() {
+	return getState().supported;
+}
+
+KernelIsa KernelDispatch::getActiveIsa() {
+	return getState().active;
+}
+
+bool KernelDispatch::setActiveIsa(KernelIsa isa) {
+	if(isa < 0 || isa >= KERNEL_ISA_COUNT || !getState().available[isa]){
+		return false;
+	}
+	getState().active = isa;
+	return true;
+}
+
+const char* KernelDispatch::getIsaName(KernelIsa isa) {
+	switch(isa){
+		case KERNEL_ISA_SSE2: return "sse2";
+		case KERNEL_ISA_AVX2: return "avx2";
+		case KERNEL_ISA_AVX512: return "avx512";
+		case KERNEL_ISA_SCALAR:
+		default: return "scalar";
+	}
+}
+
+bool KernelDispatch::parseIsaName(const char* name, KernelIsa* isa) {
+	for(int i = 0; i < KERNEL_ISA_COUNT; i++){
+		if(strcmp(name, getIsaName(static_cast<KernelIsa>(i))) == 0){
+			*isa = static_cast<KernelIsa>(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+template <>
+const KernelTable<float>& KernelDispatch::getKernels<float>() {
+	KernelDispatchState& state = getState();
+	return state.floatKernels[state.active];
+}
+
+template <>
+const KernelTable<double>& KernelDispatch::getKernels<double>() {
+	KernelDispatchState& state = getState();
+	return state.doubleKernels[state.active];
+}
+
+template <>
+const KernelTable<float>* KernelDispatch::getKernels<float>(KernelIsa isa) {
+	return (isa >= 0 && isa < KERNEL_ISA_COUNT && getState().available[isa]) ? &getState().floatKernels[isa] : nullptr;
+}
+
+template <>
+const KernelTable<double>* KernelDispatch::getKernels<double>(KernelIsa isa) {
+	return (isa >= 0 && isa < KERNEL_ISA_COUNT && getState().available[isa]) ? &getState().doubleKernels[isa] : nullptr;
+}
@@ -0,0 +1,113 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#ifndef KERNELDISPATCH_H
+#define KERNELDISPATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include "phaseextractioncore.h"
+
+#define KERNELDISPATCH_ISA_ENV "PHASEEXTRACTION_ISA" //scalar, sse2, avx2 or avx512. Forces an instruction set, e.g. to compare them in benchmarks. Instruction sets that the cpu does not support fall back to the best supported one
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define KERNELDISPATCH_X86
+#endif
+
+enum KernelIsa {
+	KERNEL_ISA_SCALAR,
+	KERNEL_ISA_SSE2,
+	KERNEL_ISA_AVX2, //with FMA
+	KERNEL_ISA_AVX512, //AVX-512F
+	KERNEL_ISA_COUNT
+};
+
+//Hot kernels of PhaseExtractionCore for one scalar type. The scalar table consists of the PhaseExtractionCore functions and is the reference for all other instruction sets.
+//Kernels that have no vectorized version for an instruction set (8 and 32 bit samples, double precision phase) keep the scalar function
+template <typename T>
+struct KernelTable {
+	void (*decodeLine)(const uint16_t* src, int size, T* dest);
+	void (*accumulateLines)(const uint16_t* src, int samplesPerLine, size_t firstLine, int numberOfLines, int lineStep, int size, T* dest); //dest[i] += sample i (i < size) of every lineStep-th line
+	void (*applyWindow)(T* signal, int size, const T* window);
+	void (*calculatePhase)(const T (*signal)[2], int size, T* phase);
+	void (*unwrapPhase)(T* phase, int size);
+	void (*evaluatePolynomial)(const T* coeffs, int order, T* dest, int size);
+};
+
+//Selects the kernels for the instruction sets of the cpu when the library is loaded. The vectorized kernels are compiled with target attributes in their own translation units,
+//so the binary runs on every x86 cpu and no -march flags are needed
+class KernelDispatch
+{
+public:
+	static KernelIsa getSupportedIsa(); //best instruction set of the cpu that this build contains kernels for
+	static KernelIsa getActiveIsa();
+	static bool setActiveIsa(KernelIsa isa); //false if not supported. Not thread safe, only for tools and benchmarks before calculations start
+	static const char* getIsaName(KernelIsa isa);
+	static bool parseIsaName(const char* name, KernelIsa* isa);
+
+	template <typename T>
+	static const KernelTable<T>& getKernels(); //kernels of the active instruction set
+	template <typename T>
+	static const KernelTable<T>* getKernels(KernelIsa isa); //nullptr if not supported
+
+	//same as the PhaseExtractionCore functions with the active kernels for 16 bit samples
+	template <typename T>
+	static void decodeLine(const unsigned char* data, int bytesPerSample, size_t firstSample, int size, T* dest) {
+		if(bytesPerSample == 2){
+			getKernels<T>().decodeLine(reinterpret_cast<const uint16_t*>(data) + firstSample, size, dest);
+		}else{
+			PhaseExtractionCore::decodeLine(data, bytesPerSample, firstSample, size, dest);
+		}
+	}
+
+	template <typename T, typename B>
+	static void averageLines(const unsigned char* data, int bytesPerSample, int samplesPerLine, size_t firstLine, size_t numberOfLines, int lineStep, const B* background, double* sum, T* dest) {
+		if(bytesPerSample != 2){
+			PhaseExtractionCore::averageLines(data, bytesPerSample, samplesPerLine, firstLine, numberOfLines, lineStep, background, sum, dest);
+			return;
+		}
+		const uint16_t* samples = reinterpret_cast<const uint16_t*>(data);
+		const KernelTable<T>& kernels = getKernels<T>();
+		PhaseExtractionCore::sumLines<T>(samplesPerLine, firstLine, numberOfLines, lineStep, PhaseExtractionCore::getChunkLines<T>(bytesPerSample), [&](size_t chunkFirstLine, int chunkLines, int firstSample, int size, T* partial) {
+			kernels.accumulateLines(samples + firstSample, samplesPerLine, chunkFirstLine, chunkLines, lineStep, size, partial);
+		}, sum);
+		PhaseExtractionCore::normalizeSum(sum, samplesPerLine, numberOfLines, background, dest);
+	}
+};
+
+template <> const KernelTable<float>& KernelDispatch::getKernels<float>();
+template <> const KernelTable<double>& KernelDispatch::getKernels<double>();
+template <> const KernelTable<float>* KernelDispatch::getKernels<float>(KernelIsa isa);
+template <> const KernelTable<double>* KernelDispatch::getKernels<double>(KernelIsa isa);
+
+//filled by the translation unit of each instruction set, return false if the build does not contain kernels for it
+bool fillSse2Kernels(KernelTable<float>* floatKernels, KernelTable<double>* doubleKernels);
+bool fillAvx2Kernels(KernelTable<float>* floatKernels, KernelTable<double>* doubleKernels);
+bool fillAvx512Kernels(KernelTable<float>* floatKernels, KernelTable<double>* doubleKernels);
+
+#endif // KERNELDISPATCH_H
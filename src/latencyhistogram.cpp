@@ -0,0 +1,93 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#include "latencyhistogram.h"
+#include <QtAlgorithms>
+#include <cmath>
+
+
+LatencyHistogram::LatencyHistogram() {
+	this->reset();
+}
+
+int LatencyHistogram::indexFor(quint64 value) {
+	//values below the linear range have their own bucket. Above, every power of two is split into 2^LATENCYHISTOGRAM_SUB_BUCKET_BITS buckets of equal width
+	if(value < LATENCYHISTOGRAM_LINEAR_RANGE){
+		return static_cast<int>(value);
+	}
+	int exponent = 63 - static_cast<int>(qCountLeadingZeroBits(value));
+	if(exponent >= LATENCYHISTOGRAM_MAX_EXPONENT){
+		return LATENCYHISTOGRAM_BUCKETS - 1;
+	}
+	int shift = exponent - LATENCYHISTOGRAM_SUB_BUCKET_BITS;
+	int subBucket = static_cast<int>(value >> shift) - (1 << LATENCYHISTOGRAM_SUB_BUCKET_BITS);
+	return LATENCYHISTOGRAM_LINEAR_RANGE + (exponent - LATENCYHISTOGRAM_SUB_BUCKET_BITS - 1)*(1 << LATENCYHISTOGRAM_SUB_BUCKET_BITS) + subBucket;
+}
+
+quint64 LatencyHistogram::highestEquivalentValue(int index) {
+	if(index < LATENCYHISTOGRAM_LINEAR_RANGE){
+		return static_cast<quint64>(index);
+	}
+	int offset = index - LATENCYHISTOGRAM_LINEAR_RANGE;
+	int shift = offset/(1 << LATENCYHISTOGRAM_SUB_BUCKET_BITS) + 1;
+	quint64 subBucket = static_cast<quint64>(offset % (1 << LATENCYHISTOGRAM_SUB_BUCKET_BITS) + (1 << LATENCYHISTOGRAM_SUB_BUCKET_BITS));
+	return ((subBucket + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(qint64 ns) {
+	quint64 value = static_cast<quint64>(qMax(ns, static_cast<qint64>(0)));
+	this->counts[indexFor(value)].fetchAndAddRelaxed(1);
+	this->totalCount.fetchAndAddOrdered(1);
+	if(ns > this->maxValue.loadAcquire()){
+		this->maxValue.storeRelease(ns); //only one thread records, so there is no competing writer
+	}
+}
+
+void LatencyHistogram::reset() {
+	for(int i = 0; i < LATENCYHISTOGRAM_BUCKETS; i++){
+		this->counts[i].storeRelease(0);
+	}
+	this->totalCount.storeRelease(0);
+	this->maxValue.storeRelease(0);
+}
+
+qint64 LatencyHistogram::getPercentile(double percentile) const {
+	quint64 total = this->getCount();
+	if(total == 0){
+		return 0;
+	}
+	quint64 rank = qMax(static_cast<quint64>(1), static_cast<quint64>(std::ceil(qBound(0.0, percentile, 100.0)/100.0*total)));
+	quint64 sum = 0;
+	for(int i = 0; i < LATENCYHISTOGRAM_BUCKETS; i++){
+		sum += this->counts[i].loadAcquire();
+		if(sum >= rank){
+			return qMin(static_cast<qint64>(highestEquivalentValue(i)), this->getMax());
+		}
+	}
+	return this->getMax();
+}
@@ -0,0 +1,76 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <QtGlobal>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+
+#define LATENCYHISTOGRAM_SUB_BUCKET_BITS 5 //32 buckets per power of two, values are resolved to about 3 %
+#define LATENCYHISTOGRAM_LINEAR_RANGE (2 << LATENCYHISTOGRAM_SUB_BUCKET_BITS) //values below are counted exactly
+#define LATENCYHISTOGRAM_MAX_EXPONENT 40 //about 18 minutes in ns, larger values are counted in the last bucket
+#define LATENCYHISTOGRAM_BUCKETS (LATENCYHISTOGRAM_LINEAR_RANGE + (LATENCYHISTOGRAM_MAX_EXPONENT - LATENCYHISTOGRAM_SUB_BUCKET_BITS - 1)*(1 << LATENCYHISTOGRAM_SUB_BUCKET_BITS))
+
+//Log-linear histogram of durations in ns with fixed memory, in the style of HdrHistogram.
+//One thread records, any thread may read percentiles at the same time. Counters are atomic, so a concurrent read sees every count at most once but not necessarily all counts of the latest record() calls
+class LatencyHistogram
+{
+public:
+	LatencyHistogram();
+
+	void record(qint64 ns);
+	void reset();
+	quint64 getCount() const { return this->totalCount.loadAcquire(); }
+	qint64 getMax() const { return this->maxValue.loadAcquire(); }
+	qint64 getPercentile(double percentile) const; //percentile in %, returns the upper bound of the bucket that contains it
+
+	static int indexFor(quint64 value);
+	static quint64 highestEquivalentValue(int index);
+
+private:
+	QAtomicInteger<quint64> counts[LATENCYHISTOGRAM_BUCKETS];
+	QAtomicInteger<quint64> totalCount;
+	QAtomicInteger<qint64> maxValue;
+};
+
+//Records its lifetime in a LatencyHistogram
+class LatencyScope
+{
+public:
+	explicit LatencyScope(LatencyHistogram* histogram) : histogram(histogram) { this->timer.start(); }
+	~LatencyScope() { this->histogram->record(this->timer.nsecsElapsed()); }
+
+private:
+	LatencyHistogram* histogram;
+	QElapsedTimer timer;
+};
+
+#endif // LATENCYHISTOGRAM_H
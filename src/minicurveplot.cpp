@@ -26,9 +26,25 @@
 **/
 
 #include "minicurveplot.h"
+#include "tracer.h"
 #include <QPainterPathStroker>
 
 MiniCurvePlot::MiniCurvePlot(QWidget *parent) : QCustomPlot(parent){
+	//replots are coalesced and rendered at most once per frame
+	this->replotPending = false;
+	this->dataDirty = false;
+	this->rescalePending = false;
+	this->restoreCustomRange = false;
+	this->replotting = false;
+	this->replotTimer.setSingleShot(true);
+	this->lastReplot.start();
+	connect(&this->replotTimer, &QTimer::timeout, this, &MiniCurvePlot::replotFrame);
+
+	//optional measurement of every replot, including replots triggered by zooming and dragging
+	this->timingEnabled = false;
+	connect(this, &QCustomPlot::beforeReplot, this, &MiniCurvePlot::onBeforeReplot);
+	connect(this, &QCustomPlot::afterReplot, this, &MiniCurvePlot::onAfterReplot);
+
 	//default colors
 	this->referenceCurveAlpha = 100;
 	this->setBackground( QColor(50, 50, 50));
@@ -59,10 +75,17 @@ MiniCurvePlot::MiniCurvePlot(QWidget *parent) : QCustomPlot(parent){
 	this->addGraph();
 	this->setReferenceCurveColor(referenceCurveColor);
 
+	//data containers. Full resolution containers are shared with the graphs as long as no decimation is necessary
+	this->curveData = QSharedPointer<QCPGraphDataContainer>(new QCPGraphDataContainer());
+	this->referenceCurveData = QSharedPointer<QCPGraphDataContainer>(new QCPGraphDataContainer());
+	this->decimatedCurveData = QSharedPointer<QCPGraphDataContainer>(new QCPGraphDataContainer());
+	this->decimatedReferenceCurveData = QSharedPointer<QCPGraphDataContainer>(new QCPGraphDataContainer());
+
 	//configure axis
 	this->yAxis->setVisible(false);
 	this->xAxis->setVisible(false);
 	this->setAxisColor(Qt::white);
+	connect(this->xAxis, static_cast<void (QCPAxis::*)(const QCPRange&)>(&QCPAxis::rangeChanged), this, &MiniCurvePlot::onXRangeChanged);
 
 	//user interactions
 	this->setInteractions(QCP::iRangeDrag | QCP::iRangeZoom);
@@ -113,110 +136,26 @@ void MiniCurvePlot::setReferenceCurveColor(QColor color) {
 
 void MiniCurvePlot::setCurveName(QString name) {
 	this->graph(0)->setName(name);
-	this->replot();
+	this->scheduleReplot();
 }
 
 void MiniCurvePlot::setReferenceCurveName(QString name) {
 	this->graph(1)->setName(name);
-	this->replot();
+	this->scheduleReplot();
 }
 
 void MiniCurvePlot::setLegendVisible(bool visible) {
 	this->legend->setVisible(visible);
-	this->replot();
-}
-
-void MiniCurvePlot::plotCurves(double *curve, double *referenceCurve, unsigned int samples) {
-	if(samples == 0){return;}
-	int size = static_cast<int>(samples);
-
-	 //set values for x-axis
-	 if(this->sampleNumbers.size() != size){
-		 this->sampleNumbers.resize(size);
-		 for(int i = 0; i<size; i++){
-			 this->sampleNumbers[i] = i;
-		 }
-	 }
-
-	 //fill curve data
-	 if(curve != nullptr){
-		 this->curveUsed = true;
-		 if(this->curve.size() != size){
-			 this->curve.resize(size);
-		 }
-		 for(int i = 0; i<size; i++){
-			 this->curve[i] = static_cast<double>(curve[i]);
-		 }
-		 this->graph(0)->setData(this->sampleNumbers, this->curve, true);
-	 }
-
-	 //fill reference curve data
-	 if(referenceCurve != nullptr){
-		 this->referenceCurveUsed = true;
-		 if(this->referenceCurve.size() != size){
-			 this->referenceCurve.resize(size);
-		 }
-		 for(int i = 0; i<size; i++){
-			 this->referenceCurve[i] = static_cast<double>(referenceCurve[i]);
-		 }
-		 this->graph(1)->setData(this->sampleNumbers, this->referenceCurve, true);
-	 }
-
-	 //update plot
-	 this->rescaleAxes();
-	 this->zoomOutSlightly();
-	 this->replot();
-}
-
-void MiniCurvePlot::plotCurves(float *curve, float *referenceCurve, unsigned int samples) {
-	if(samples == 0){return;}
-	int size = static_cast<int>(samples);
-
-	 //set values for x-axis
-	 if(this->sampleNumbers.size() != size){
-		 this->sampleNumbers.resize(size);
-		 for(int i = 0; i<size; i++){
-			 this->sampleNumbers[i] = i;
-		 }
-	 }
-
-	 //fill curve data
-	 if(curve != nullptr){
-		 this->curveUsed = true;
-		 if(this->curve.size() != size){
-			 this->curve.resize(size);
-		 }
-		 for(int i = 0; i<size; i++){
-			 this->curve[i] = static_cast<double>(curve[i]);
-		 }
-		 this->graph(0)->setData(this->sampleNumbers, this->curve, true);
-	 }
-
-	 //fill reference curve data
-	 if(referenceCurve != nullptr){
-		 this->referenceCurveUsed = true;
-		 if(this->referenceCurve.size() != size){
-			 this->referenceCurve.resize(size);
-		 }
-		 for(int i = 0; i<size; i++){
-			 this->referenceCurve[i] = static_cast<double>(referenceCurve[i]);
-		 }
-		 this->graph(1)->setData(this->sampleNumbers, this->referenceCurve, true);
-	 }
-
-	 //update plot
-	 this->rescaleAxes();
-	 this->zoomOutSlightly();
-	 this->replot();
+	this->scheduleReplot();
 }
 
 void MiniCurvePlot::clearPlot() {
 	float dummyValue = 0.0;
 	if(this->curveUsed){
-		this->plotCurves(&dummyValue, nullptr, 1);
+		this->plotCurves<float>(&dummyValue, nullptr, 1);
 	}
 	if(this->referenceCurveUsed){
-		this->plotCurves(nullptr, &dummyValue, 1);
+		this->plotCurves<float>(nullptr, &dummyValue, 1);
 	}
 }
 
@@ -238,6 +177,136 @@ void MiniCurvePlot::zoomOutSlightly() {
 	this->xAxis->scaleRange(1.1, this->xAxis->range().center());
 }
 
+void MiniCurvePlot::applyCustomYRange() {
+	this->yAxis->setRange(this->customRangeLower, this->customRangeUpper);
+	this->yAxis2->setRange(this->customRangeLower, this->customRangeUpper);
+	this->zoomOutSlightly();
+}
+
+void MiniCurvePlot::scheduleReplot() {
+	//every call only marks the plot dirty. The actual replot happens at most once per frame, no matter how many updates arrive in between
+	this->replotPending = true;
+	if(this->replotting || this->replotTimer.isActive()){
+		return;
+	}
+	qint64 elapsed = this->lastReplot.elapsed();
+	this->replotTimer.start(static_cast<int>(qMax(qint64(0), MINICURVEPLOT_FRAME_INTERVAL_MS - elapsed)));
+}
+
+void MiniCurvePlot::replotFrame() {
+	this->replotting = true;
+	if(this->rescalePending){
+		//axes are rescaled on the decimated data of the full range, min/max decimation keeps the extrema so the result is identical to rescaling on the full data
+		this->updateGraphData(true);
+		this->rescaleAxes();
+		this->zoomOutSlightly();
+		if(this->restoreCustomRange && this->customRange){
+			this->applyCustomYRange();
+		}
+		this->rescalePending = false;
+		this->restoreCustomRange = false;
+		this->dataDirty = true;
+	}
+	if(this->dataDirty){
+		this->updateGraphData(false);
+	}
+	if(this->replotPending){
+		this->replotPending = false;
+		this->replot(QCustomPlot::rpQueuedReplot);
+		this->lastReplot.restart();
+	}
+	this->replotting = false;
+}
+
+void MiniCurvePlot::onXRangeChanged() {
+	//the visible range changed (zoom, drag, rescale), so the decimation has to be redone for the new range
+	if(!this->replotting){
+		this->dataDirty = true;
+		this->scheduleReplot();
+	}
+}
+
+void MiniCurvePlot::onBeforeReplot() {
+	Tracer::begin("MiniCurvePlot::replot");
+	if(this->timingEnabled){
+		this->replotDuration.start();
+	}
+}
+
+void MiniCurvePlot::onAfterReplot() {
+	Tracer::end("MiniCurvePlot::replot");
+	if(this->timingEnabled && this->replotDuration.isValid()){
+		emit replotTimed(this->replotDuration.nsecsElapsed());
+		this->replotDuration.invalidate();
+	}
+}
+
+void MiniCurvePlot::updateGraphData(bool fullRange) {
+	if(this->curveUsed){
+		this->updateGraph(this->graph(0), this->curveData, this->decimatedCurveData, fullRange);
+	}
+	if(this->referenceCurveUsed){
+		this->updateGraph(this->graph(1), this->referenceCurveData, this->decimatedReferenceCurveData, fullRange);
+	}
+	this->dataDirty = false;
+}
+
+void MiniCurvePlot::updateGraph(QCPGraph* graph, const QSharedPointer<QCPGraphDataContainer>& fullData, const QSharedPointer<QCPGraphDataContainer>& decimatedData, bool fullRange) {
+	int size = fullData->size();
+	int first = 0;
+	int last = size-1;
+	if(!fullRange && size > 0){
+		//sample numbers are the keys, so the visible range maps directly to indices. One additional sample on each side keeps the line going to the plot border
+		first = qBound(0, static_cast<int>(qFloor(this->xAxis->range().lower))-1, size-1);
+		last = qBound(0, static_cast<int>(qCeil(this->xAxis->range().upper))+1, size-1);
+	}
+	int columns = qMax(1, this->axisRect()->width());
+
+	//few samples are plotted directly from the full resolution container without any copy
+	if(last-first+1 <= 2*columns){
+		if(graph->data() != fullData){
+			graph->setData(fullData);
+		}
+		return;
+	}
+	this->decimate(fullData.data(), decimatedData.data(), first, last, columns);
+	if(graph->data() != decimatedData){
+		graph->setData(decimatedData);
+	}
+}
+
+void MiniCurvePlot::decimate(const QCPGraphDataContainer* fullData, QCPGraphDataContainer* decimatedData, int first, int last, int columns) {
+	//min/max decimation: for every pixel column of the visible range only the minimum and the maximum sample are plotted. Peaks stay visible while the number of plotted points depends on the widget width only
+	//every column always gets two points, so the decimated container keeps its size and is overwritten in place
+	if(decimatedData->size() != 2*columns){
+		decimatedData->set(QVector<QCPGraphData>(2*columns), true);
+	}
+	QCPGraphDataContainer::const_iterator data = fullData->constBegin();
+	QCPGraphDataContainer::iterator out = decimatedData->begin();
+	int count = last-first+1;
+	for(int column = 0; column < columns; column++){
+		int start = first + static_cast<int>(static_cast<qint64>(column)*count/columns);
+		int end = first + static_cast<int>(static_cast<qint64>(column+1)*count/columns);
+		int minPos = start;
+		int maxPos = start;
+		for(int i = start+1; i < end; i++){
+			if(data[i].value < data[minPos].value){
+				minPos = i;
+			}
+			if(data[i].value > data[maxPos].value){
+				maxPos = i;
+			}
+		}
+		//keep both extrema in sample order
+		int firstPos = qMin(minPos, maxPos);
+		int secondPos = qMax(minPos, maxPos);
+		*out = data[firstPos];
+		++out;
+		*out = data[secondPos];
+		++out;
+	}
+}
+
 
 void MiniCurvePlot::contextMenuEvent(QContextMenuEvent *event) {
 #if defined(Q_OS_WIN) || defined(__aarch64__)
@@ -271,6 +340,10 @@ void MiniCurvePlot::resizeEvent(QResizeEvent *event) {
 		this->setMask(mask);
 	}
 	QCustomPlot::resizeEvent(event);
+
+	//number of pixel columns changed, so decimation has to be redone
+	this->dataDirty = true;
+	this->scheduleReplot();
 }
 
 void MiniCurvePlot::changeEvent(QEvent *event) {
@@ -280,13 +353,13 @@ void MiniCurvePlot::changeEvent(QEvent *event) {
 			this->referenceCurveColor.setAlpha(25);
 			this->setCurveColor(this->curveColor);
 			this->setReferenceCurveColor(this->referenceCurveColor);
-			this->replot();
+			this->scheduleReplot();
 		} else {
 			this->curveColor.setAlpha(255);
 			this->referenceCurveColor.setAlpha(this->referenceCurveAlpha);
 			this->setCurveColor(this->curveColor);
 			this->setReferenceCurveColor(this->referenceCurveColor);
-			this->replot();
+			this->scheduleReplot();
 		}
 	}
 	QCustomPlot::changeEvent(event);
@@ -294,12 +367,10 @@ void MiniCurvePlot::changeEvent(QEvent *event) {
 }
 
 void MiniCurvePlot::mouseDoubleClickEvent(QMouseEvent *event) {
-	this->rescaleAxes();
-	this->zoomOutSlightly();
-	if(customRange){
-		this->scaleYAxis(this->customRangeLower, this->customRangeUpper);
-	}
-	this->replot();
+	Q_UNUSED(event)
+	this->rescalePending = true;
+	this->restoreCustomRange = true;
+	this->scheduleReplot();
 }
 
 void MiniCurvePlot::slot_saveToDisk() {
@@ -337,10 +408,13 @@ void MiniCurvePlot::scaleYAxis(double min, double max) {
 	this->customRange = true;
 	this->customRangeLower = min;
 	this->customRangeUpper = max;
-	this->yAxis->setRange(min, max);
-	this->yAxis2->setRange(min, max);
-	this->zoomOutSlightly();
-	this->replot();
+	if(this->rescalePending){
+		//new data is waiting for the next frame, apply custom range after its rescale
+		this->restoreCustomRange = true;
+	}else{
+		this->applyCustomYRange();
+	}
+	this->scheduleReplot();
 }
 
 bool MiniCurvePlot::saveCurveDataToFile(QString fileName) {
@@ -349,12 +423,9 @@ bool MiniCurvePlot::saveCurveDataToFile(QString fileName) {
 	if (file.open(QFile::WriteOnly|QFile::Truncate)) {
 		QTextStream stream(&file);
 		stream << "Sample Number" << ";" << "Sample Value" << "\n";
-		for(int i = 0; i < this->sampleNumbers.size(); i++){
-			if(this->curve.size() > 0 && this->sampleNumbers.size() > 0) {
-				stream << QString::number(this->sampleNumbers.at(i)) << ";" << QString::number(this->curve.at(i)) << "\n";
-			} else if(this->referenceCurve.size() > 0 && this->sampleNumbers.size() > 0) {
-				stream << QString::number(this->sampleNumbers.at(i)) << ";" << QString::number(this->referenceCurve.at(i)) << "\n";
-			}
+		const QSharedPointer<QCPGraphDataContainer>& data = this->curveData->isEmpty() ? this->referenceCurveData : this->curveData;
+		for(QCPGraphDataContainer::const_iterator it = data->constBegin(); it != data->constEnd(); ++it){
+			stream << QString::number(it->key) << ";" << QString::number(it->value) << "\n";
 		}
 	file.close();
 	saved = true;
@@ -363,7 +434,7 @@ bool MiniCurvePlot::saveCurveDataToFile(QString fileName) {
 }
 
 bool MiniCurvePlot::saveAllCurvesToFile(QString fileName) {
-	if(this->curve.size() != this->referenceCurve.size()){
+	if(this->curveData->size() != this->referenceCurveData->size()){
 		return this->saveCurveDataToFile(fileName);
 	}else{
 		bool saved = false;
@@ -371,8 +442,10 @@ bool MiniCurvePlot::saveAllCurvesToFile(QString fileName) {
 		if (file.open(QFile::WriteOnly|QFile::Truncate)) {
 			QTextStream stream(&file);
 			stream << "Sample Number" << ";" << this->graph(0)->name() << ";" << this->graph(1)->name() << "\n";
-			for(int i = 0; i < this->sampleNumbers.size(); i++){
-				stream << QString::number(this->sampleNumbers.at(i)) << ";" << QString::number(this->curve.at(i)) << ";" << QString::number(this->referenceCurve.at(i)) << "\n";
+			QCPGraphDataContainer::const_iterator curveIt = this->curveData->constBegin();
+			QCPGraphDataContainer::const_iterator referenceIt = this->referenceCurveData->constBegin();
+			for(; curveIt != this->curveData->constEnd(); ++curveIt, ++referenceIt){
+				stream << QString::number(curveIt->key) << ";" << QString::number(curveIt->value) << ";" << QString::number(referenceIt->value) << "\n";
 			}
 		file.close();
 		saved = true;
@@ -384,12 +457,12 @@ bool MiniCurvePlot::saveAllCurvesToFile(QString fileName) {
 void MiniCurvePlot::setVerticalLineA(double xPos) {
 	this->lineA->point1->setCoords(xPos, 0);
 	this->lineA->point2->setCoords(xPos, 1);
-	this->replot();
+	this->scheduleReplot();
 }
 
 void MiniCurvePlot::setVerticalLineB(double xPos) {
 	this->lineB->point1->setCoords(xPos, 0);
 	this->lineB->point2->setCoords(xPos, 1);
-	this->replot();
+	this->scheduleReplot();
 }
 
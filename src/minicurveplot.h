@@ -29,6 +29,11 @@
 #define MINICURVEPLOT_H
 
 #include "qcustomplot.h"
+#include <QTimer>
+#include <QElapsedTimer>
+#include <type_traits>
+
+#define MINICURVEPLOT_FRAME_INTERVAL_MS 16
 
 class MiniCurvePlot : public QCustomPlot
 {
@@ -42,19 +47,69 @@ public:
 	void setCurveName(QString name);
 	void setReferenceCurveName(QString name);
 	void setLegendVisible(bool visible);
-	void plotCurves(double* curve, double* referenceCurve, unsigned int samples); //todo: maybe use one template function instead instead one function for double* and one for float*
-	void plotCurves(float* curve, float* referenceCurve, unsigned int samples);
+	template <typename T>
+	void plotCurves(const T* curve, const T* referenceCurve, unsigned int samples, int stride = 1) {
+		//curve and referenceCurve may be nullptr, in this case call plotCurves<T>(...) explicitly. Every stride-th element of the input is plotted, this allows plotting e.g. the real part of interleaved complex data directly
+		static_assert(std::is_arithmetic<T>::value, "MiniCurvePlot can only plot arithmetic types");
+		if(samples == 0){return;}
+		if(curve != nullptr){
+			this->curveUsed = true;
+			fillContainer(this->curveData.data(), curve, static_cast<int>(samples), stride);
+		}
+		if(referenceCurve != nullptr){
+			this->referenceCurveUsed = true;
+			fillContainer(this->referenceCurveData.data(), referenceCurve, static_cast<int>(samples), stride);
+		}
+
+		//graph data is decimated and axes are rescaled with the next frame
+		this->dataDirty = true;
+		this->rescalePending = true;
+		this->restoreCustomRange = false;
+		this->scheduleReplot();
+	}
 	void roundCorners(bool enable){this->drawRoundCorners = enable;}
+	void setTimingEnabled(bool enabled){this->timingEnabled = enabled;}
 	void clearPlot();
 
 
 private:
 	void setAxisColor(QColor color);
 	void zoomOutSlightly();
+	void applyCustomYRange();
+	void scheduleReplot();
+	void updateGraphData(bool fullRange);
+	void updateGraph(QCPGraph* graph, const QSharedPointer<QCPGraphDataContainer>& fullData, const QSharedPointer<QCPGraphDataContainer>& decimatedData, bool fullRange);
+	void decimate(const QCPGraphDataContainer* fullData, QCPGraphDataContainer* decimatedData, int first, int last, int columns);
 
-	QVector<qreal> sampleNumbers;
-	QVector<qreal> curve;
-	QVector<qreal> referenceCurve;
+	template <typename T>
+	static void fillContainer(QCPGraphDataContainer* container, const T* data, int size, int stride) {
+		//the container is only reallocated if the number of samples changed. Otherwise keys are kept and values are overwritten in place, so an update is a single pass without allocations
+		if(container->size() != size){
+			QVector<QCPGraphData> points(size);
+			for(int i = 0; i < size; i++){
+				points[i].key = i;
+			}
+			container->set(points, true);
+		}
+		QCPGraphDataContainer::iterator it = container->begin();
+		for(int i = 0; i < size; i++, ++it){
+			it->value = static_cast<double>(data[static_cast<size_t>(i)*stride]);
+		}
+	}
+
+	QSharedPointer<QCPGraphDataContainer> curveData; //full resolution data, used for export
+	QSharedPointer<QCPGraphDataContainer> referenceCurveData;
+	QSharedPointer<QCPGraphDataContainer> decimatedCurveData;
+	QSharedPointer<QCPGraphDataContainer> decimatedReferenceCurveData;
+	QTimer replotTimer;
+	QElapsedTimer lastReplot;
+	QElapsedTimer replotDuration;
+	bool timingEnabled;
+	bool replotPending;
+	bool dataDirty;
+	bool rescalePending;
+	bool restoreCustomRange;
+	bool replotting;
 	bool drawRoundCorners;
 	QColor curveColor;
 	QColor referenceCurveColor;
@@ -76,6 +131,7 @@ protected:
 signals:
 	void info(QString info);
 	void error(QString error);
+	void replotTimed(qint64 ns); //only emitted if timing is enabled
 
 
 public slots:
@@ -88,6 +144,12 @@ public slots:
 	void scaleYAxis(double min, double max);
 	bool saveCurveDataToFile(QString fileName);
 	bool saveAllCurvesToFile(QString fileName);
+
+private slots:
+	void replotFrame();
+	void onXRangeChanged();
+	void onBeforeReplot();
+	void onAfterReplot();
 };
 
 
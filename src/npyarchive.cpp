@@ -0,0 +1,362 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#include "npyarchive.h"
+#include <QFile>
+#include <QtEndian>
+#include <cstring>
+
+#define NPY_HEADER_ALIGNMENT 64
+#define ZIP_LOCAL_HEADER_SIGNATURE 0x04034b50
+#define ZIP_CENTRAL_HEADER_SIGNATURE 0x02014b50
+#define ZIP_END_SIGNATURE 0x06054b50
+#define ZIP_VERSION 20
+#define ZIP_DOS_DATE 0x0021 //1980-01-01, timestamps are not needed
+
+
+void NpyArchive::addArray(const QString& name, const QVector<qreal>& data) {
+	this->addArray(name, data.constData(), data.size());
+}
+
+void NpyArchive::addArray(const QString& name, const QVector<float>& data) {
+	QByteArray bytes(data.size()*static_cast<int>(sizeof(float)), 0);
+	for(int i = 0; i < data.size(); i++){
+		quint32 bits;
+		memcpy(&bits, &data.at(i), sizeof(bits));
+		qToLittleEndian<quint32>(bits, bytes.data() + i*sizeof(quint32));
+	}
+	this->addRawArray(name, "<f4", QVector<qint64>() << data.size(), bytes);
+}
+
+void NpyArchive::addArray(const QString& name, const qreal* data, int size) {
+	QByteArray bytes(size*static_cast<int>(sizeof(double)), 0);
+	for(int i = 0; i < size; i++){
+		quint64 bits;
+		double value = data[i];
+		memcpy(&bits, &value, sizeof(bits));
+		qToLittleEndian<quint64>(bits, bytes.data() + i*sizeof(quint64));
+	}
+	this->addRawArray(name, "<f8", QVector<qint64>() << size, bytes);
+}
+
+void NpyArchive::addComplexArray(const QString& name, const QVector<qreal>& real, const QVector<qreal>& imag) {
+	//complex128 is stored as interleaved real and imaginary double
+	int size = qMin(real.size(), imag.size());
+	QByteArray bytes(size*2*static_cast<int>(sizeof(double)), 0);
+	for(int i = 0; i < size; i++){
+		quint64 bits;
+		double value = real.at(i);
+		memcpy(&bits, &value, sizeof(bits));
+		qToLittleEndian<quint64>(bits, bytes.data() + (2*i)*sizeof(quint64));
+		value = imag.at(i);
+		memcpy(&bits, &value, sizeof(bits));
+		qToLittleEndian<quint64>(bits, bytes.data() + (2*i+1)*sizeof(quint64));
+	}
+	this->addRawArray(name, "<c16", QVector<qint64>() << size, bytes);
+}
+
+void NpyArchive::addRawArray(const QString& name, const QString& descr, const QVector<qint64>& shape, const QByteArray& data) {
+	Entry entry;
+	entry.name = name + ".npy";
+	entry.data = npyHeader(descr, shape) + data;
+	this->entries.append(entry);
+}
+
+void NpyArchive::addAnalysisResult(const AnalysisResult& result, const QString& prefix) {
+	//every stage is written, stages that were not calculated yet are empty arrays so the set of names is always the same
+	this->addArray(prefix + "averaged_raw", result.averagedRaw);
+	this->addArray(prefix + "spectrum", result.spectrum);
+	this->addArray(prefix + "selected_band", result.selectedSignal);
+	this->addComplexArray(prefix + "analytic_signal", result.analyticalSignalReal, result.analyticalSignalImag);
+	this->addArray(prefix + "unwrapped_phase", result.unwrappedPhase);
+	this->addArray(prefix + "nonlinear_phase", result.nonLinearPhase);
+	this->addArray(prefix + "raw_resampling_curve", result.resamplingCurve);
+	this->addArray(prefix + "fitted_resampling_curve", result.fittedResamplingCurve);
+	QVector<qreal> coeffs;
+	if(result.fitValid){
+		coeffs << result.k0 << result.k1 << result.k2 << result.k3;
+	}
+	this->addArray(prefix + "coefficients", coeffs); //k0..k3 with OCTproZ scaling
+	this->addArray(prefix + "refinement_rms", result.refinement.rmsHistory);
+}
+
+QByteArray NpyArchive::npyHeader(const QString& descr, const QVector<qint64>& shape) {
+	//npy format version 1.0: magic string, version, header length and a python dict literal padded with spaces and terminated by a newline
+	QString shapeString = "(";
+	for(int i = 0; i < shape.size(); i++){
+		shapeString += QString::number(shape.at(i)) + ",";
+		if(i < shape.size()-1){
+			shapeString += " ";
+		}
+	}
+	shapeString += ")";
+	QByteArray dict = QString("{'descr': '%1', 'fortran_order': False, 'shape': %2, }").arg(descr, shapeString).toLatin1();
+	const int preambleSize = 10;
+	int paddedSize = ((preambleSize + dict.size() + 1 + NPY_HEADER_ALIGNMENT-1)/NPY_HEADER_ALIGNMENT)*NPY_HEADER_ALIGNMENT;
+	dict += QByteArray(paddedSize - preambleSize - dict.size() - 1, ' ');
+	dict += '\n';
+
+	QByteArray header("\x93NUMPY\x01\x00", 8);
+	char length[2];
+	qToLittleEndian<quint16>(static_cast<quint16>(dict.size()), length);
+	header.append(length, 2);
+	header += dict;
+	return header;
+}
+
+quint32 NpyArchive::crc32(const QByteArray& data) {
+	//crc32 as used by zip (reflected polynomial 0xedb88320)
+	static quint32 table[256];
+	static bool tableReady = false;
+	if(!tableReady){
+		for(quint32 i = 0; i < 256; i++){
+			quint32 value = i;
+			for(int bit = 0; bit < 8; bit++){
+				value = (value & 1) ? (0xedb88320u ^ (value >> 1)) : (value >> 1);
+			}
+			table[i] = value;
+		}
+		tableReady = true;
+	}
+	quint32 crc = 0xffffffffu;
+	const uchar* bytes = reinterpret_cast<const uchar*>(data.constData());
+	for(int i = 0; i < data.size(); i++){
+		crc = table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+	}
+	return crc ^ 0xffffffffu;
+}
+
+bool NpyArchive::save(const QString& fileName) const {
+	QFile file(fileName);
+	if(!file.open(QFile::WriteOnly|QFile::Truncate)){
+		return false;
+	}
+	QByteArray archive = this->toByteArray();
+	bool written = file.write(archive) == archive.size();
+	file.close();
+	return written;
+}
+
+QByteArray NpyArchive::toByteArray() const {
+	//every entry is stored without compression, followed by the central directory and the end of central directory record
+	QByteArray archive;
+	QByteArray centralDirectory;
+	quint32 offset = 0;
+	foreach(const Entry& entry, this->entries){
+		QByteArray name = entry.name.toUtf8();
+		quint32 crc = crc32(entry.data);
+		quint32 size = static_cast<quint32>(entry.data.size());
+
+		QByteArray localHeader(30, 0);
+		char* local = localHeader.data();
+		qToLittleEndian<quint32>(ZIP_LOCAL_HEADER_SIGNATURE, local);
+		qToLittleEndian<quint16>(ZIP_VERSION, local + 4);
+		qToLittleEndian<quint16>(ZIP_DOS_DATE, local + 12);
+		qToLittleEndian<quint32>(crc, local + 14);
+		qToLittleEndian<quint32>(size, local + 18);
+		qToLittleEndian<quint32>(size, local + 22);
+		qToLittleEndian<quint16>(static_cast<quint16>(name.size()), local + 26);
+		archive += localHeader + name + entry.data;
+
+		QByteArray centralHeader(46, 0);
+		char* central = centralHeader.data();
+		qToLittleEndian<quint32>(ZIP_CENTRAL_HEADER_SIGNATURE, central);
+		qToLittleEndian<quint16>(ZIP_VERSION, central + 4);
+		qToLittleEndian<quint16>(ZIP_VERSION, central + 6);
+		qToLittleEndian<quint16>(ZIP_DOS_DATE, central + 14);
+		qToLittleEndian<quint32>(crc, central + 16);
+		qToLittleEndian<quint32>(size, central + 20);
+		qToLittleEndian<quint32>(size, central + 24);
+		qToLittleEndian<quint16>(static_cast<quint16>(name.size()), central + 28);
+		qToLittleEndian<quint32>(offset, central + 42);
+		centralDirectory += centralHeader + name;
+
+		offset += static_cast<quint32>(localHeader.size() + name.size()) + size;
+	}
+
+	QByteArray end(22, 0);
+	char* record = end.data();
+	qToLittleEndian<quint32>(ZIP_END_SIGNATURE, record);
+	qToLittleEndian<quint16>(static_cast<quint16>(this->entries.size()), record + 8);
+	qToLittleEndian<quint16>(static_cast<quint16>(this->entries.size()), record + 10);
+	qToLittleEndian<quint32>(static_cast<quint32>(centralDirectory.size()), record + 12);
+	qToLittleEndian<quint32>(offset, record + 16);
+	archive += centralDirectory + end;
+	return archive;
+}
+
+bool NpyArchive::fromByteArray(const QByteArray& archive) {
+	//local headers are walked from the start, the central directory is not needed for uncompressed entries
+	this->entries.clear();
+	const char* data = archive.constData();
+	qint64 size = archive.size();
+	qint64 position = 0;
+	while(position + 30 <= size && qFromLittleEndian<quint32>(data + position) == ZIP_LOCAL_HEADER_SIGNATURE){
+		quint16 method = qFromLittleEndian<quint16>(data + position + 8);
+		quint32 storedSize = qFromLittleEndian<quint32>(data + position + 18);
+		quint16 nameSize = qFromLittleEndian<quint16>(data + position + 26);
+		quint16 extraSize = qFromLittleEndian<quint16>(data + position + 28);
+		qint64 dataStart = position + 30 + nameSize + extraSize;
+		if(method != 0 || dataStart + storedSize > size){
+			this->entries.clear();
+			return false;
+		}
+		Entry entry;
+		entry.name = QString::fromUtf8(data + position + 30, nameSize);
+		entry.data = archive.mid(static_cast<int>(dataStart), static_cast<int>(storedSize));
+		if(crc32(entry.data) != qFromLittleEndian<quint32>(data + position + 14)){
+			this->entries.clear();
+			return false;
+		}
+		this->entries.append(entry);
+		position = dataStart + storedSize;
+	}
+	return true;
+}
+
+bool NpyArchive::getRawArray(const QString& name, QString* descr, qint64* size, const char** data) const {
+	foreach(const Entry& entry, this->entries){
+		if(entry.name != name + ".npy"){
+			continue;
+		}
+		const int preambleSize = 10;
+		if(entry.data.size() < preambleSize || !entry.data.startsWith("\x93NUMPY")){
+			return false;
+		}
+		quint16 headerSize = qFromLittleEndian<quint16>(entry.data.constData() + 8);
+		if(preambleSize + headerSize > entry.data.size()){
+			return false;
+		}
+
+		//only one dimensional arrays in c order are written, so descr and the first shape entry are sufficient
+		QString header = QString::fromLatin1(entry.data.constData() + preambleSize, headerSize);
+		int descrStart = header.indexOf("'descr': '") + 10;
+		int shapeStart = header.indexOf("'shape': (") + 10;
+		if(descrStart < 10 || shapeStart < 10){
+			return false;
+		}
+		*descr = header.mid(descrStart, header.indexOf('\'', descrStart) - descrStart);
+		QString shape = header.mid(shapeStart, header.indexOf(')', shapeStart) - shapeStart);
+		*size = shape.section(',', 0, 0).trimmed().isEmpty() ? 0 : shape.section(',', 0, 0).trimmed().toLongLong();
+		if(*size < 0){
+			return false;
+		}
+		*data = entry.data.constData() + preambleSize + headerSize;
+		qint64 itemSize = *descr == "<c16" ? 16 : (*descr == "<f8" ? 8 : 4);
+		return *size <= (entry.data.size() - preambleSize - headerSize)/itemSize;
+	}
+	return false;
+}
+
+QVector<qreal> NpyArchive::getArray(const QString& name) const {
+	QVector<qreal> result;
+	QString descr;
+	qint64 size = 0;
+	const char* data = nullptr;
+	if(this->getRawArray(name, &descr, &size, &data) && descr == "<f8"){
+		result.resize(static_cast<int>(size));
+		for(int i = 0; i < result.size(); i++){
+			quint64 bits = qFromLittleEndian<quint64>(data + i*sizeof(quint64));
+			memcpy(&result[i], &bits, sizeof(bits));
+		}
+	}
+	return result;
+}
+
+QVector<float> NpyArchive::getFloatArray(const QString& name) const {
+	QVector<float> result;
+	QString descr;
+	qint64 size = 0;
+	const char* data = nullptr;
+	if(this->getRawArray(name, &descr, &size, &data) && descr == "<f4"){
+		result.resize(static_cast<int>(size));
+		for(int i = 0; i < result.size(); i++){
+			quint32 bits = qFromLittleEndian<quint32>(data + i*sizeof(quint32));
+			memcpy(&result[i], &bits, sizeof(bits));
+		}
+	}
+	return result;
+}
+
+bool NpyArchive::getComplexArray(const QString& name, QVector<qreal>* real, QVector<qreal>* imag) const {
+	QString descr;
+	qint64 size = 0;
+	const char* data = nullptr;
+	if(!this->getRawArray(name, &descr, &size, &data) || descr != "<c16"){
+		return false;
+	}
+	real->resize(static_cast<int>(size));
+	imag->resize(static_cast<int>(size));
+	for(int i = 0; i < real->size(); i++){
+		quint64 bits = qFromLittleEndian<quint64>(data + (2*i)*sizeof(quint64));
+		memcpy(&(*real)[i], &bits, sizeof(bits));
+		bits = qFromLittleEndian<quint64>(data + (2*i+1)*sizeof(quint64));
+		memcpy(&(*imag)[i], &bits, sizeof(bits));
+	}
+	return true;
+}
+
+void NpyArchive::getAnalysisResult(AnalysisResult* result, const QString& prefix) const {
+	//counterpart of addAnalysisResult. Stages with data are marked as updated, so a gui that receives the result shows all of them
+	result->averagedRaw = this->getArray(prefix + "averaged_raw");
+	result->spectrum = this->getArray(prefix + "spectrum");
+	result->selectedSignal = this->getArray(prefix + "selected_band");
+	this->getComplexArray(prefix + "analytic_signal", &result->analyticalSignalReal, &result->analyticalSignalImag);
+	result->unwrappedPhase = this->getArray(prefix + "unwrapped_phase");
+	result->nonLinearPhase = this->getArray(prefix + "nonlinear_phase");
+	result->resamplingCurve = this->getArray(prefix + "raw_resampling_curve");
+	result->fittedResamplingCurve = this->getFloatArray(prefix + "fitted_resampling_curve");
+	result->refinement.rmsHistory = this->getArray(prefix + "refinement_rms");
+	QVector<qreal> coeffs = this->getArray(prefix + "coefficients");
+	result->fitValid = coeffs.size() == 4 && !result->fittedResamplingCurve.isEmpty();
+	if(result->fitValid){
+		result->k0 = coeffs.at(0);
+		result->k1 = coeffs.at(1);
+		result->k2 = coeffs.at(2);
+		result->k3 = coeffs.at(3);
+	}
+	result->updatedStages = 0;
+	if(!result->averagedRaw.isEmpty()){
+		result->updatedStages |= (1 << STAGE_AVERAGE);
+	}
+	if(!result->spectrum.isEmpty()){
+		result->updatedStages |= (1 << STAGE_FFT);
+	}
+	if(!result->selectedSignal.isEmpty()){
+		result->updatedStages |= (1 << STAGE_BAND);
+	}
+	if(!result->nonLinearPhase.isEmpty()){
+		result->updatedStages |= (1 << STAGE_PHASE);
+	}
+	if(!result->resamplingCurve.isEmpty()){
+		result->updatedStages |= (1 << STAGE_CURVE);
+	}
+	if(result->fitValid){
+		result->updatedStages |= (1 << STAGE_FIT);
+	}
+}
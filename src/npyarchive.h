@@ -0,0 +1,73 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#ifndef NPYARCHIVE_H
+#define NPYARCHIVE_H
+
+#include <QVector>
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include "analysisresult.h"
+
+//Collects one dimensional arrays and writes them as NumPy .npz archive (uncompressed zip of .npy files) that can be loaded with numpy.load without any parsing.
+//Values are stored little endian at full precision: qreal as <f8, float as <f4 and complex signals as <c16.
+class NpyArchive
+{
+public:
+	void addArray(const QString& name, const QVector<qreal>& data);
+	void addArray(const QString& name, const QVector<float>& data);
+	void addArray(const QString& name, const qreal* data, int size);
+	void addComplexArray(const QString& name, const QVector<qreal>& real, const QVector<qreal>& imag);
+	void addRawArray(const QString& name, const QString& descr, const QVector<qint64>& shape, const QByteArray& data);
+	void addAnalysisResult(const AnalysisResult& result, const QString& prefix = QString());
+	void clear() { this->entries.clear(); }
+	bool save(const QString& fileName) const;
+	QByteArray toByteArray() const;
+
+	//reading supports archives written by this class (uncompressed entries, little endian <f8, <f4 and <c16)
+	bool fromByteArray(const QByteArray& archive);
+	QVector<qreal> getArray(const QString& name) const;
+	QVector<float> getFloatArray(const QString& name) const;
+	bool getComplexArray(const QString& name, QVector<qreal>* real, QVector<qreal>* imag) const;
+	void getAnalysisResult(AnalysisResult* result, const QString& prefix = QString()) const;
+
+	static QByteArray npyHeader(const QString& descr, const QVector<qint64>& shape);
+	static quint32 crc32(const QByteArray& data);
+
+private:
+	bool getRawArray(const QString& name, QString* descr, qint64* size, const char** data) const;
+
+	struct Entry {
+		QString name;
+		QByteArray data; //complete .npy file
+	};
+	QList<Entry> entries;
+};
+
+#endif // NPYARCHIVE_H
@@ -28,75 +28,135 @@
 #include "phaseextractioncalculator.h"
 #include <qcoreapplication.h>
 #include <QThread>
-
-#define REAL 0
-#define IMAG 1
+#include <QElapsedTimer>
 
 
 PhaseExtractionCalculator::PhaseExtractionCalculator(QObject *parent) : QObject(parent)
 {
 	this->inputData = nullptr;
 	this->numberOfSamples = 0;
-	this->rawSignal = nullptr;
-	this->selectedSignal = nullptr;
+	this->samplesPerLine = 0;
+	this->bytesPerSample = 0;
+	this->lines = 0;
 	this->polynomialFit = new Polynomial();
 	this->ignoreStart = 0;
 	this->ignoreEnd = 0;
+	this->refinementIterations = 0;
+	this->refinementTolerance = 0.001;
+	this->padToSmoothSize = false;
+	this->upsamplingFactor = 1;
+	this->spectrumMinAfterDC = 0;
+	this->spectrumMaxAfterDC = 0;
+	this->fitValid = false;
+	this->runCounter = 0;
+	this->dataGeneration = 0;
+	this->backgroundGeneration = 0;
+	this->scheduler = nullptr;
+	this->jobRunning = false;
+	this->timingEnabled = false;
+	this->activeTimings = nullptr;
+	this->engine = this->createEngine(DOUBLE_PRECISION);
 }
 
 PhaseExtractionCalculator::~PhaseExtractionCalculator()
 {
-	if(this->selectedSignal != nullptr){
-		fftw_free(this->selectedSignal);
+	delete this->engine;
+	delete this->polynomialFit;
+}
+
+bool PhaseExtractionCalculator::isPrecisionAvailable(CalculationPrecision precision) {
+#ifdef PHASEEXTRACTION_FFTW_FLOAT
+	Q_UNUSED(precision)
+	return true;
+#else
+	return precision == DOUBLE_PRECISION;
+#endif
+}
+
+void PhaseExtractionCalculator::setScheduler(CalculatorJobScheduler* scheduler) {
+	this->scheduler = scheduler;
+	connect(this->scheduler, &CalculatorJobScheduler::jobsPending, this, &PhaseExtractionCalculator::runScheduledJobs);
+}
+
+void PhaseExtractionCalculator::runScheduledJobs() {
+	TraceScope trace("runScheduledJobs");
+	//only the latest request of each type is handed out by the scheduler, everything that was requested in between has already been dropped
+	while(this->scheduler != nullptr && this->scheduler->takeNextJob(&this->currentJob)){
+		this->jobRunning = true;
+		switch(this->currentJob.type){
+			case JOB_AVERAGING:
+				this->averageAndFFT(this->currentJob.firstLine, this->currentJob.lastLine, this->currentJob.windowRaw, this->currentJob.useBackground);
+				break;
+			case JOB_ANALYSIS:
+				this->analyze(this->currentJob.startPos, this->currentJob.endPos, this->currentJob.windowPeak);
+				break;
+			case JOB_FIT:
+				this->reFitResamplingCurve(this->currentJob.ignoreStart, this->currentJob.ignoreEnd);
+				break;
+			default:
+				break;
+		}
+		this->jobRunning = false;
+		this->activeTimings = nullptr; //a cancelled job never publishes its record
 	}
-	if(this->rawSignal != nullptr){
-		fftw_free(this->rawSignal);
+}
+
+void PhaseExtractionCalculator::beginTimings() {
+	//every job starts a new record, stages that are skipped because of a valid cache stay unmeasured. With timing disabled activeTimings is nullptr and StageTimer does nothing
+	this->activeTimings = this->timingEnabled ? &this->timings : nullptr;
+	if(this->activeTimings == nullptr){
+		return;
+	}
+	this->timings = StageTimings();
+	this->timings.add(TIMING_FFT_PLAN, this->engine->getPlanningTime());
+	this->timings.forwardFftThreads = this->engine->getForwardFftThreads();
+	this->timings.backwardFftThreads = this->engine->getBackwardFftThreads();
+	this->timings.fftSize = this->engine->getFftSize();
+	this->timings.upsampledSize = this->engine->getUpsampledSize();
+}
+
+void PhaseExtractionCalculator::setTimingEnabled(bool enabled) {
+	this->timingEnabled = enabled;
+}
+
+bool PhaseExtractionCalculator::isCancelled() {
+	//cancellation token of the running job. Direct slot calls that do not come from the scheduler are never cancelled
+	return this->jobRunning && this->scheduler->isStale(this->currentJob);
+}
+
+PhaseExtractionEngineBase* PhaseExtractionCalculator::createEngine(CalculationPrecision precision) {
+#ifdef PHASEEXTRACTION_FFTW_FLOAT
+	if(precision == SINGLE_PRECISION){
+		return new PhaseExtractionEngine<float>(&this->fftThreadPolicy);
+	}
+#else
+	Q_UNUSED(precision)
+#endif
+	return new PhaseExtractionEngine<double>(&this->fftThreadPolicy);
+}
+
+void PhaseExtractionCalculator::configureEngine(PhaseExtractionEngineBase* engine) {
+	engine->setFftParams(this->padToSmoothSize, this->upsamplingFactor);
+	if(this->inputData != nullptr){
+		engine->setData(this->inputData, this->bytesPerSample, this->samplesPerLine, this->lines);
 	}
-	delete this->polynomialFit;
 }
 
 //todo: this background subtraction feature is a mess, refactor everything
 void PhaseExtractionCalculator::getBackgroundSignal(unsigned char *data, size_t size, size_t bytesPerSample, int samplesPerLine) {
 	emit info(tr("Calculating background signal..."));
-	this->numberOfSamples = size/bytesPerSample;
+	this->numberOfSamples = static_cast<qint64>(size/bytesPerSample);
 	this->samplesPerLine = samplesPerLine;
 	this->bytesPerSample = bytesPerSample;
-	this->lines = numberOfSamples/samplesPerLine;
+	this->lines = this->numberOfSamples/samplesPerLine;
 	this->backgroundSignal.resize(samplesPerLine);
 	this->backgroundSignal.fill(0);
-	void* input = static_cast<void*>(data);
-
-	//check buffer datatype and average background signal
-	//uchar
-	if(this->bytesPerSample <= 1){
-		unsigned char* src = static_cast<unsigned char*>(input);
-		for(int i = 0; i < this->numberOfSamples; i++){
-			this->backgroundSignal[i%samplesPerLine] += src[i];
-		}
-		for(int j = 0; j < this->samplesPerLine; j++){
-			this->backgroundSignal[j] /= (static_cast<double>(this->lines));
-		}
-	}
-	//ushort
-	else if(this->bytesPerSample > 1 && this->bytesPerSample <= 2){
-		unsigned short* src = static_cast<unsigned short*>(input);
-		for(int i = 0; i < this->numberOfSamples; i++){
-			this->backgroundSignal[i%samplesPerLine] += src[i];
-		}
-		for(int j = 0; j < this->samplesPerLine; j++){
-			this->backgroundSignal[j] /= (static_cast<double>(this->lines));
-		}
-	}
-	//unsigned long int
-	else if(this->bytesPerSample > 2 && this->bytesPerSample <= 4){
-		unsigned long int* src = static_cast<unsigned long int*>(input);
-		for(int i = 0; i < this->numberOfSamples; i++){
-			this->backgroundSignal[i%samplesPerLine] += src[i];
-		}
-		for(int j = 0; j < this->samplesPerLine; j++){
-			this->backgroundSignal[j] /= (static_cast<double>(this->lines));
-		}
+	//sum of all complete lines divided by the number of lines
+	if(this->lines > 0){
+		QVector<double> lineSum(samplesPerLine);
+		KernelDispatch::averageLines(data, this->bytesPerSample, this->samplesPerLine, 0, static_cast<size_t>(this->lines), 1, static_cast<const qreal*>(nullptr), lineSum.data(), this->backgroundSignal.data());
 	}
+	this->backgroundGeneration++;
 	emit info(tr("Background done!"));
 }
 
@@ -105,380 +165,486 @@ void PhaseExtractionCalculator::setFitParams(int ignoreStart, int ignoreEnd) {
 	this->ignoreEnd = ignoreEnd;
 }
 
-void PhaseExtractionCalculator::reFitResamplingCurve(int ignoreStart, int ignoreEnd) {
-	this->setFitParams(ignoreStart, ignoreEnd);
-	this->fitResamplingCurve();
+void PhaseExtractionCalculator::setRefinementParams(int maxIterations, double tolerance) {
+	this->refinementIterations = qMax(0, maxIterations);
+	this->refinementTolerance = qMax(0.0, tolerance);
 }
 
-void PhaseExtractionCalculator::copyLine(double *dest, int line) { //todo: refactor this method to avoid duplicate code
-	void* data = static_cast<void*>(this->inputData);
-	//check buffer datatype and copy single line to dest
-	//uchar
-	if(this->bytesPerSample <= 1){
-		unsigned char* src = static_cast<unsigned char*>(data);
-		for(int i = 0; i < this->samplesPerLine; i++){
-			dest[i] = src[line*this->samplesPerLine+i];
-		}
+void PhaseExtractionCalculator::setFftParams(bool padToSmoothSize, int upsamplingFactor, bool multithreadedFft) {
+	upsamplingFactor = qMax(1, upsamplingFactor);
+	if(multithreadedFft && !FftwThreadPolicy::isAvailable()){
+		emit error(tr("PhaseExtractionExtension: multithreaded FFT is not available. Extension was built without fftw3_threads."));
+		multithreadedFft = false;
 	}
-	//ushort
-	else if(this->bytesPerSample > 1 && this->bytesPerSample <= 2){
-		unsigned short* src = static_cast<unsigned short*>(data);
-		for(int i = 0; i < this->samplesPerLine; i++){
-			dest[i] = src[line*this->samplesPerLine+i];
-		}
+	if(this->padToSmoothSize == padToSmoothSize && this->upsamplingFactor == upsamplingFactor && this->fftThreadPolicy.isEnabled() == multithreadedFft){
+		return;
 	}
-	//unsigned long int
-	else if(this->bytesPerSample > 2 && this->bytesPerSample <= 4){
-		unsigned long int* src = static_cast<unsigned long int*>(data);
-		for(int i = 0; i < this->samplesPerLine; i++){
-			dest[i] = src[line*this->samplesPerLine+i];
+	bool fftSizeChanged = this->padToSmoothSize != padToSmoothSize;
+	this->padToSmoothSize = padToSmoothSize;
+	this->upsamplingFactor = upsamplingFactor;
+	this->fftThreadPolicy.setEnabled(multithreadedFft);
+	this->engine->setFftParams(this->padToSmoothSize, this->upsamplingFactor);
+
+	if(this->engine->hasData()){
+		this->reportFftThreads();
+		if(fftSizeChanged){
+			emit info(tr("FFT length changed to ") + QString::number(this->engine->getFftSize()) + tr(". Please average again."));
 		}
 	}
 }
 
-void PhaseExtractionCalculator::copyLine(fftw_complex* dest, int line) { //todo: refactor this method to avoid duplicate code
-	void* data = static_cast<void*>(this->inputData);
-	//check buffer datatype and copy single line to dest
-	//uchar
-	if(this->bytesPerSample <= 1){
-		unsigned char* src = static_cast<unsigned char*>(data);
-		for(int i = 0; i < this->samplesPerLine; i++){
-			dest[i][REAL] = src[line*this->samplesPerLine+i];
-			dest[i][IMAG] = 0;
-		}
+void PhaseExtractionCalculator::setPrecision(int precision) {
+	CalculationPrecision newPrecision = static_cast<CalculationPrecision>(precision);
+	if(!isPrecisionAvailable(newPrecision)){
+		emit error(tr("PhaseExtractionExtension: single precision is not available. Extension was built without fftw3f."));
+		return;
 	}
-	//ushort
-	else if(this->bytesPerSample > 1 && this->bytesPerSample <= 2){
-		unsigned short* src = static_cast<unsigned short*>(data);
-		for(int i = 0; i < this->samplesPerLine; i++){
-			dest[i][REAL] = src[line*this->samplesPerLine+i];
-			dest[i][IMAG] = 0;
-		}
+	if(newPrecision == this->engine->getPrecision()){
+		return;
 	}
-	//unsigned long int
-	else if(this->bytesPerSample > 2 && this->bytesPerSample <= 4){
-		unsigned long int* src = static_cast<unsigned long int*>(data);
-		for(int i = 0; i < this->samplesPerLine; i++){
-			dest[i][REAL] = src[line*this->samplesPerLine+i];
-			dest[i][IMAG] = 0;
-		}
+	delete this->engine;
+	this->engine = this->createEngine(newPrecision);
+	this->configureEngine(this->engine);
+	this->stageCache.invalidateAll();
+	if(this->engine->hasData()){
+		emit info(tr("Calculation precision changed. Please average again."));
 	}
 }
 
-void PhaseExtractionCalculator::calculatePhase() {
-	if(this->selectedSignal == nullptr){return;} //the analytical signal needs to be stored in "selectedSignal", i.e. fft -> windowing -> ifft has to be done before the phase can be retrieved.
-	for(int i = 0; i < this->samplesPerLine; i++){
-		this->phase[i] = atan2(this->selectedSignal[i][IMAG], this->selectedSignal[i][REAL]);
+void PhaseExtractionCalculator::reFitResamplingCurve(int ignoreStart, int ignoreEnd) {
+	this->beginTimings();
+	this->setFitParams(ignoreStart, ignoreEnd);
+	if(this->fitResamplingCurve() && !this->isCancelled()){
+		this->publishResult(1 << STAGE_FIT);
 	}
 }
 
-void PhaseExtractionCalculator::unwrapPhase() {
-	int size = this->phase.size();
-	double diff;
-	for(int i=1; i< size; i++){
-		diff = this->phase.at(i) - this->phase.at(i-1);
-		if(diff > M_PI){
-			for(int j=i; j<size; j++)
-				this->phase[j] = this->phase.at(j) - 2.0*M_PI;
+void PhaseExtractionCalculator::verifyCalibration(int firstLine, int lastLine, int startPos, int endPos, int interpolationMethod) {
+	if(this->inputData == nullptr || !this->fitValid){
+		emit error(tr("PhaseExtractionExtension: no fitted resampling curve available for verification. Please run the analysis first."));
+		return;
+	}
+	qint64 numberOfLines = this->getNumberOfLinesToAverage(&firstLine, lastLine);
+	InterpolationMethod method = static_cast<InterpolationMethod>(qBound(0, interpolationMethod, static_cast<int>(SINC_INTERPOLATION)));
+
+	//the fit key changes whenever the fitted curve changes, so a new fit always invalidates the verification
+	quint64 verificationKey = this->stageCache.keyFor(STAGE_VERIFICATION, firstLine, numberOfLines, startPos, endPos, method);
+	if(!this->stageCache.isValid(STAGE_VERIFICATION, verificationKey)){
+		QVector<qreal> fittedCurve(this->fittedResamplingCurve.size());
+		for(int i = 0; i < fittedCurve.size(); i++){
+			fittedCurve[i] = this->fittedResamplingCurve.at(i);
 		}
-		if(diff < (-1.0)*M_PI){
-			for(int j=i; j<size; j++)
-				this->phase[j] = this->phase.at(j) + 2.0*M_PI;
+		this->verification = this->verifier.verify(this->inputData, this->bytesPerSample, this->samplesPerLine, this->lines, firstLine, numberOfLines, this->rawResamplingCurve, fittedCurve, this->engine->getFftSize(), startPos, endPos, method);
+		if(!this->verification.valid){
+			emit error(tr("PhaseExtractionExtension: verification failed. Resampling curve does not match the current data."));
+			return;
 		}
+		this->stageCache.store(STAGE_VERIFICATION, verificationKey);
 	}
-	//emit unwrappedPhaseCalculated(this->phase);
-}
-
-void PhaseExtractionCalculator::generateLinearePhaseLine() {
-	int size = this->phase.size();
-	this->connectionLine.resize(size);
-	//generate line that connects start end end point of resampled phase. This correspons to the phase of a perfectly linear sine wave
-	for(int i=0; i<size; i++){
-		this->connectionLine[i] = ((this->phase.last() - this->phase.first()) / (size-1)) * i + this->phase.first();
+	if(this->isCancelled()){
+		return;
 	}
+
+	emit info(tr("Verification ") + (this->verification.accepted ? tr("passed") : tr("failed")) + tr(": FWHM ")
+			  + QString::number(this->verification.beforeLinearization.fwhm, 'f', 2) + tr(" (uncorrected), ")
+			  + QString::number(this->verification.rawCurve.fwhm, 'f', 2) + tr(" (raw curve), ")
+			  + QString::number(this->verification.fittedCurve.fwhm, 'f', 2) + tr(" (fitted curve) samples, side lobes ")
+			  + QString::number(this->verification.fittedCurve.sideLobeLevel, 'f', 1) + tr(" dB, ")
+			  + QString::number(this->verification.lines) + tr(" lines in ") + QString::number(this->verification.durationMs) + tr(" ms"));
+	this->publishResult(1 << STAGE_VERIFICATION);
 }
 
-void PhaseExtractionCalculator::generateNonLinearPhaseLine() {
-	int size = this->phase.size();
-	this->nonLinearPhase.resize(size);
-	this->nonLinearPhase.fill(0);
+void PhaseExtractionCalculator::saveResamplingLut(QString fileName, int interpolationMethod, bool halfPrecision) {
+	if(!this->fitValid){
+		emit error(tr("PhaseExtractionExtension: no fitted resampling curve available for LUT export. Please run the analysis first."));
+		return;
+	}
+	InterpolationMethod method = static_cast<InterpolationMethod>(qBound(0, interpolationMethod, static_cast<int>(SINC_INTERPOLATION)));
+	ResamplingLut lut;
+	lut.generate(this->fittedResamplingCurve.constData(), this->fittedResamplingCurve.size(), method);
+	if(!lut.save(fileName, halfPrecision ? LUT_FLOAT16 : LUT_FLOAT32)){
+		emit error(tr("Could not save file to: ") + fileName);
+		return;
+	}
+	emit info(tr("File saved to: ") + fileName);
 
-	for(int i = 0; i< size; i++){
-		this->nonLinearPhase[i] = this->phase.at(i) - this->connectionLine.at(i);
+	//compare LUT resampling with evaluating the fitted polynomial per sample on the fetched buffers
+	if(this->inputData != nullptr && this->samplesPerLine == lut.getSamplesPerLine()){
+		ResamplingLutBenchmark benchmark = ResamplingLut::benchmark(lut, this->polynomialFit, this->inputData, this->bytesPerSample, static_cast<int>(qMin(this->lines, static_cast<qint64>(RESAMPLINGLUT_BENCHMARK_LINES))));
+		emit info(tr("Resampling LUT: ") + QString::number(benchmark.lutNsPerLine/1000.0, 'f', 2) + tr(" us per line, polynomial evaluation: ")
+				  + QString::number(benchmark.polynomialNsPerLine/1000.0, 'f', 2) + tr(" us per line (") + QString::number(benchmark.lines)
+				  + tr(" lines), max deviation ") + QString::number(benchmark.maxDeviation, 'g', 3));
 	}
-	emit nonLinearPhaseCalculated((this->nonLinearPhase));
 }
 
-void PhaseExtractionCalculator::calculateResamplingCurve() {
-	int size = this->phase.size();
-	this->rawResamplingCurve.resize(size);
+void PhaseExtractionCalculator::publishResult(int updatedStages) {
+	//the snapshot shares the buffers of the calculator. They are detached on the next write, so the snapshot stays unchanged while the gui reads it
+	{
+		StageTimer emitTimer(this->activeTimings, TIMING_EMIT);
+		AnalysisResult* result = new AnalysisResult();
+		result->runId = ++this->runCounter;
+		result->updatedStages = updatedStages;
+		result->averagedRaw = this->averagedData;
+		result->spectrum = this->spectrumData;
+		result->spectrumMinAfterDC = this->spectrumMinAfterDC;
+		result->spectrumMaxAfterDC = this->spectrumMaxAfterDC;
+		result->selectedSignal = this->selectedSignalData;
+		result->analyticalSignalReal = this->analyticalSignalReal;
+		result->analyticalSignalImag = this->analyticalSignalImag;
+		result->unwrappedPhase = this->unwrappedPhase;
+		result->nonLinearPhase = this->nonLinearPhase;
+		result->resamplingCurve = this->rawResamplingCurve;
+		result->refinement = this->refinement;
+		result->fittedResamplingCurve = this->fittedResamplingCurve;
+		result->fitValid = this->fitValid && this->coeffs.size() >= 4;
+		result->verification = this->verification;
+		if(result->fitValid){
+			//coeffs with OCTproZ scaling factors
+			qreal size = this->rawResamplingCurve.size()-1;
+			result->k0 = this->coeffs.at(0);
+			result->k1 = this->coeffs.at(1)*size;
+			result->k2 = this->coeffs.at(2)*size*size;
+			result->k3 = this->coeffs.at(3)*size*size*size;
+		}
+		Tracer::flowStart("resultReady", result->runId); //ends in PhaseExtractionExtensionForm::showResult, shows the queued delivery to the gui thread
+		emit resultReady(AnalysisResultPtr(result));
+	}
 
+	//timings of the job are published after the result, so they include the time to emit it
+	if(this->activeTimings != nullptr){
+		this->activeTimings->runId = this->runCounter;
+		emit timingsMeasured(*this->activeTimings);
+		emit info(tr("Timings: ") + this->activeTimings->toString());
+		this->activeTimings = nullptr;
+	}
+}
 
-	//calculate resampling curve
-	this->rawResamplingCurve[0] = 0.0;
-	int j = 0;
-	for(int i=1; i<(size-1); i++){
-		while(this->phase.at(j)<this->connectionLine.at(i) && j<(size-1) ){
-			j++;
-		}
-		this->rawResamplingCurve[i] = (j-1) + ((this->connectionLine.at(i) - this->phase.at(j-1)) / (this->phase.at(j) - this->phase.at(j-1)));
+void PhaseExtractionCalculator::reportFftThreads() {
+	if(this->fftThreadPolicy.isEnabled()){
+		emit info(tr("FFT threads: ") + QString::number(this->engine->getForwardFftThreads()) + tr(" (FFT, ") + QString::number(this->engine->getFftSize()) + tr(" samples), ")
+				  + QString::number(this->engine->getBackwardFftThreads()) + tr(" (IFFT, ") + QString::number(this->engine->getUpsampledSize()) + tr(" samples), crossover at ")
+				  + QString::number(this->fftThreadPolicy.getCrossoverSize()) + tr(" samples"));
 	}
-	this->rawResamplingCurve[size-1] = size-1;
+}
 
-	emit resamplingCurveCalculated(this->rawResamplingCurve);
+qint64 PhaseExtractionCalculator::getNumberOfLinesToAverage(int* firstLine, int lastLine) {
+	//check how many lines should be used for averaging
+	qint64 numberOfLines = 0;
+	if(*firstLine == -1 && lastLine == -1){
+		numberOfLines = this->lines-1;
+		*firstLine = 0;
+	}else{
+		//first line and number of lines may come from the gui, the batch tool or an old session, so they are limited to the lines of the current data
+		*firstLine = static_cast<int>(qMax(static_cast<qint64>(0), qMin(static_cast<qint64>(*firstLine), this->lines-1)));
+		numberOfLines = static_cast<qint64>(lastLine) - *firstLine + 1;
+		numberOfLines = qMax(static_cast<qint64>(0), qMin(numberOfLines, qMin(this->lines-1, this->lines-*firstLine)));
+	}
+	return numberOfLines;
 }
 
-void PhaseExtractionCalculator::fitResamplingCurve() {
+bool PhaseExtractionCalculator::fitResamplingCurve() {
 	int size = this->rawResamplingCurve.size();
 
 	//ensure that ignored values are within size range of resampling curve
 	this->ignoreStart = qBound(0, this->ignoreStart, size);
 	this->ignoreEnd = qBound(0, this->ignoreEnd, size);
 
-
-	//check if if there are still values left after ignoring the start end end samples
-	int effectiveSize = this->rawResamplingCurve.size() - this->ignoreStart - this->ignoreEnd;
-	if (effectiveSize <= 0) {
-		emit error(tr("PhaseExtractionExtension: no samples available for fit."));
-		return;
-	}
-
-
 	int order = 3;
-	this->coeffs.resize(order + 1);
-
-	//prepare least squares fit
-	Eigen::MatrixXd A(effectiveSize, order + 1);
-	Eigen::VectorXd yv_mapped = Eigen::VectorXd::Map(&this->rawResamplingCurve[this->ignoreStart], effectiveSize);
-	Eigen::VectorXd result;
-
-	//create matrix
-	QVector<qreal> xValues;
-	xValues.resize(effectiveSize);
-	for (int i = 0; i < effectiveSize; i++) {
-		xValues[i] = i + this->ignoreStart;
-	}
-	for (int i = 0; i < effectiveSize; i++) {
-		for (int j = 0; j < order + 1; j++) {
-			A(i, j) = qPow(xValues.at(i), j);
+	quint64 fitKey = this->stageCache.keyFor(STAGE_FIT, this->ignoreStart, this->ignoreEnd, order);
+	if(!this->stageCache.isValid(STAGE_FIT, fitKey)){
+		StageTimer timer(this->activeTimings, TIMING_FIT);
+		this->fitValid = false;
+		this->verification = VerificationResult();
+		if(!fitPolynomial(this->rawResamplingCurve, this->ignoreStart, this->ignoreEnd, order, &this->coeffs)){
+			emit error(tr("PhaseExtractionExtension: no samples available for fit."));
+			return false;
+		}
+		for (int i = 0; i < order + 1; i++) {
+			this->polynomialFit->setCoeff(this->coeffs.at(i), i);
 		}
-	}
-
-	//solve for linear least squares fit
-	result = A.householderQr().solve(yv_mapped);
 
-	//copy coeffs and emit them with OCTproZ scaling factors to GUI
-	this->coeffs.resize(order + 1);
-	for (size_t i = 0; i < order + 1; i++) {
-		coeffs[i] = result[i];
+		//copy fitted curve out of the polynomial, its buffer is overwritten by the next fit
+		int fittedSize = static_cast<int>(this->polynomialFit->getSize());
+		this->fittedResamplingCurve.resize(fittedSize);
+		memcpy(this->fittedResamplingCurve.data(), this->polynomialFit->getData(), fittedSize*sizeof(float));
+		this->fitValid = true;
+		this->stageCache.store(STAGE_FIT, fitKey);
 	}
-	size = size -1;
-	emit coeffsCalculated(this->coeffs.at(0), this->coeffs.at(1)*size, this->coeffs.at(2)*size*size, this->coeffs.at(3)*size*size*size);
+	return this->fitValid;
+}
 
-	//fit resampling curve and emit fit to plot
-	for (int i = 0; i < order + 1; i++) {
-		this->polynomialFit->setCoeff(this->coeffs.at(i), i);
-	}
-	emit resamplingCurveFitted(this->polynomialFit->getData(), this->polynomialFit->getSize());
+bool PhaseExtractionCalculator::fitPolynomial(const QVector<qreal>& curve, int ignoreStart, int ignoreEnd, int order, QVector<qreal>* coeffs) {
+	coeffs->resize(order + 1);
+	return PhaseExtractionCore::fitPolynomial(curve.constData(), curve.size(), ignoreStart, ignoreEnd, order, coeffs->data());
 }
 
 void PhaseExtractionCalculator::setData(unsigned char* data, size_t size, size_t bytesPerSample, int samplesPerLine) {
+	TraceScope trace("setData");
 	this->inputData = data;
-	this->numberOfSamples = size/bytesPerSample;
+	this->numberOfSamples = static_cast<qint64>(size/bytesPerSample);
 	this->samplesPerLine = samplesPerLine;
 	this->bytesPerSample = bytesPerSample;
-	this->lines = numberOfSamples/samplesPerLine;
+	this->lines = this->numberOfSamples/samplesPerLine;
 	this->averagedData.resize(this->samplesPerLine);
 	this->averagedData.fill(0);
-	if(this->selectedSignal != nullptr){
-		fftw_free(this->selectedSignal);
-	}
-	this->selectedSignal = fftw_alloc_complex(this->samplesPerLine);
-	memset(this->selectedSignal, 0.0, this->samplesPerLine * sizeof(fftw_complex));
+	this->engine->setData(this->inputData, this->bytesPerSample, this->samplesPerLine, this->lines);
+	this->dataGeneration++;
+	this->stageCache.invalidateAll();
+	this->reportFftThreads();
+	this->polynomialFit->setSize(this->samplesPerLine);
+}
 
-	if(this->rawSignal != nullptr){
-		fftw_free(this->rawSignal);
+void PhaseExtractionCalculator::releaseData() {
+	//runs on the calculator thread before the fetched buffer is freed, either blocking from openSession or queued in front of the free. Jobs run on the calculator thread, so no job reads the buffer anymore after this
+	if(this->inputData == nullptr){
+		return;
 	}
-	this->rawSignal = fftw_alloc_complex(this->samplesPerLine);
-	memset(this->rawSignal, 0.0, this->samplesPerLine * sizeof(fftw_complex));
-
-	this->phase.resize(this->samplesPerLine);
-	this->phase.fill(0);
-	this->nonLinearPhase.resize(this->samplesPerLine);
-	this->nonLinearPhase.fill(0);
-	this->polynomialFit->setSize(this->samplesPerLine);
+	this->inputData = nullptr;
+	this->numberOfSamples = 0;
+	this->lines = 0;
+	this->engine->setData(nullptr, this->bytesPerSample, this->samplesPerLine, 0);
+	this->dataGeneration++;
+	this->stageCache.invalidateAll();
 }
 
 void PhaseExtractionCalculator::averageAndFFT(int firstLine, int lastLine, bool windowRaw, bool useBackground) {
-	//check how many lines should be used for averaging
-	int numberOfLines = 0;
-	if(firstLine == -1 && lastLine == -1){
-		numberOfLines = this->lines-1;
-		firstLine = 0;
-	}else{
-		numberOfLines = (lastLine - firstLine) + 1;
-		if(numberOfLines > (this->lines-1)){
-			numberOfLines = this->lines-1;
-		}
+	this->beginTimings();
+	qint64 numberOfLines = this->getNumberOfLinesToAverage(&firstLine, lastLine);
+
+	//calculate averaged signal, substract background and apply window. The fft size is part of the key because the averaged signal is written into the zero padded fft buffer
+	quint64 averageKey = this->stageCache.keyFor(STAGE_AVERAGE, this->dataGeneration, firstLine, numberOfLines, windowRaw, useBackground ? this->backgroundGeneration+1 : 0, this->engine->getFftSize(), this->engine->getPrecision());
+	if(!this->stageCache.isValid(STAGE_AVERAGE, averageKey)){
+		StageTimer timer(this->activeTimings, TIMING_AVERAGE);
+		this->engine->average(firstLine, numberOfLines, windowRaw, useBackground ? &this->backgroundSignal : nullptr);
+		this->engine->getAveragedRaw(&this->averagedData);
+		this->stageCache.store(STAGE_AVERAGE, averageKey);
+	}
+	if(this->isCancelled()){
+		return;
+	}
+
+	//fft
+	quint64 fftKey = this->stageCache.keyFor(STAGE_FFT);
+	if(!this->stageCache.isValid(STAGE_FFT, fftKey)){
+		StageTimer timer(this->activeTimings, TIMING_FFT);
+		this->engine->forwardFft();
+		this->engine->getSpectrum(&this->spectrumData);
+
+		//get max min values after DC peak to scale y axis of ascan select plot
+		PhaseExtractionEngineBase::getSpectrumRange(this->spectrumData, SPECTRUM_POS_AFTER_DC, &this->spectrumMinAfterDC, &this->spectrumMaxAfterDC);
+		this->stageCache.store(STAGE_FFT, fftKey);
+	}
+	if(this->isCancelled()){
+		return;
 	}
 
-	//create tmp array for average calculation and set signal array to zero
-	fftw_complex* tmp = fftw_alloc_complex(this->samplesPerLine);
-	memset(tmp, 0.0, this->samplesPerLine * sizeof(fftw_complex));
-	memset(this->rawSignal, 0.0, this->samplesPerLine * sizeof(fftw_complex));
+	this->publishResult((1 << STAGE_AVERAGE) | (1 << STAGE_FFT));
+}
 
-	// create plan.
-	fftw_plan plan = fftw_plan_dft_1d(this->samplesPerLine, this->rawSignal, this->rawSignal, FFTW_FORWARD, FFTW_ESTIMATE);
+void PhaseExtractionCalculator::analyze(int startPos, int endPos, bool windowPeak) {
+	this->beginTimings();
 
-	//calculate averaged signal
-	for(int i = 0; i < numberOfLines; i++){
-		this->copyLine(tmp, i+firstLine);
-		for(int j = 0; j < this->samplesPerLine; j++){
-			this->rawSignal[j][REAL] += tmp[j][REAL];
-		}
+	//every stage is only recalculated if its own parameters or one of its upstream stages changed
+	quint64 bandKey = this->stageCache.keyFor(STAGE_BAND, startPos, endPos, windowPeak, this->engine->getUpsampledSize());
+	if(!this->stageCache.isValid(STAGE_BAND, bandKey)){
+		this->windowAndIFFT(startPos, endPos, windowPeak);
+		this->stageCache.store(STAGE_BAND, bandKey);
 	}
-	for(int j = 0; j < this->samplesPerLine; j++){
-		//this->rawSignal[j][REAL] /= (static_cast<double>(numberOfLines)*16); //todo: make bitshift optional (multiplication by 16) also add unpacking option to restore packed 12bit raw data
-		this->rawSignal[j][REAL] /= (static_cast<double>(numberOfLines));
+	if(this->isCancelled()){
+		return;
 	}
 
-	//background substraction
-	if(useBackground){
-		for(int j = 0; j < this->samplesPerLine; j++){
-			this->rawSignal[j][REAL] -= this->backgroundSignal.at(j);
+	quint64 phaseKey = this->stageCache.keyFor(STAGE_PHASE);
+	if(!this->stageCache.isValid(STAGE_PHASE, phaseKey)){
+		{
+			StageTimer timer(this->activeTimings, TIMING_PHASE);
+			this->engine->calculatePhase();
 		}
+		StageTimer timer(this->activeTimings, TIMING_UNWRAP);
+		this->engine->unwrapPhase();
+		this->engine->calculateNonLinearPhase();
+		this->engine->getUnwrappedPhase(&this->unwrappedPhase);
+		this->engine->getNonLinearPhase(&this->nonLinearPhase);
+		this->stageCache.store(STAGE_PHASE, phaseKey);
+	}
+	if(this->isCancelled()){
+		return;
 	}
 
-	//window averaged raw data
-	if(windowRaw){
-		QVector<qreal> window = this->getHanningWindow(this->samplesPerLine);
-		for(int j = 0; j < this->samplesPerLine; j++){
-			this->rawSignal[j][REAL] *= window.at(j);
+	quint64 curveKey = this->stageCache.keyFor(STAGE_CURVE, this->refinementIterations, qRound64(this->refinementTolerance*1e9));
+	if(!this->stageCache.isValid(STAGE_CURVE, curveKey)){
+		StageTimer timer(this->activeTimings, TIMING_CURVE); //includes the refinement iterations
+		this->engine->calculateResamplingCurve();
+		this->engine->getResamplingCurve(&this->rawResamplingCurve);
+		this->refinement = RefinementStats();
+		if(this->refinementIterations > 0 && !this->refineResamplingCurve(startPos, endPos, windowPeak)){
+			return;
 		}
+		this->stageCache.store(STAGE_CURVE, curveKey);
 	}
-
-	//prepare data for plot of real part of averaged raw data
-	this->averagedData.resize(this->samplesPerLine);
-	this->averagedData.fill(0);
-	for(int j = 0; j < this->samplesPerLine; j++){
-		this->averagedData[j] += this->rawSignal[j][REAL];
+	if(this->isCancelled()){
+		return;
 	}
-	emit rawAveraged(this->averagedData);
-
-	//fft
-	fftw_execute(plan);
 
-	//calculate magnitude
-//	for(int j = 0; j < this->samplesPerLine/2; j++){
-//		double realVal = this->rawSignal[j][REAL];
-//		double imagVal = this->rawSignal[j][IMAG];
-
-//		this->rawSignal[j][REAL] = qSqrt(realVal*realVal+imagVal*imagVal);
-//	}
-
-	//prepare data for plot
-	this->averagedData.resize(this->samplesPerLine/2);
-	this->averagedData.fill(0);
-	for(int j = 0; j < this->samplesPerLine/2; j++){
-		this->averagedData[j] += this->rawSignal[j][REAL];
-	}
-	emit fftDataAveraged(this->averagedData);
-
-	//get max min values after DC peak to scale y axis of ascan select plot
-	int posAfterDC = 10;
-	if(this->averagedData.size() > posAfterDC){
-		qreal maxAfterDC = this->averagedData.at(posAfterDC);
-		qreal minAfterDC = this->averagedData.at(posAfterDC);
-		for(int i = posAfterDC; i < this->averagedData.size(); i++){
-			if(this->averagedData.at(i) > maxAfterDC){
-				maxAfterDC = this->averagedData.at(i);
-			}
-			if(this->averagedData.at(i) < minAfterDC){
-				minAfterDC = this->averagedData.at(i);
-			}
-		}
-		emit fftDataRangeFound(minAfterDC, maxAfterDC);
+	int updatedStages = (1 << STAGE_BAND) | (1 << STAGE_PHASE) | (1 << STAGE_CURVE);
+	if(this->fitResamplingCurve()){
+		updatedStages |= (1 << STAGE_FIT);
 	}
-
-	//release memory
-	fftw_destroy_plan(plan);
-	fftw_free(tmp);
+	if(this->isCancelled()){
+		return;
+	}
+	this->publishResult(updatedStages);
 }
 
-void PhaseExtractionCalculator::analyze(int startPos, int endPos, bool windowPeak) {
-	this->windowAndIFFT(startPos, endPos, windowPeak);
-	this->calculatePhase();
-	this->unwrapPhase();
-	this->generateLinearePhaseLine();
-	this->generateNonLinearPhaseLine();
-	this->calculateResamplingCurve();
-	this->fitResamplingCurve();
+bool PhaseExtractionCalculator::refineResamplingCurve(int startPos, int endPos, bool windowPeak) {
+	//every iteration resamples the averaged raw signal with the current curve and extracts the remaining nonlinearity with the same plans and buffers as the regular analysis.
+	//The resampling curve of the resampled signal maps to positions on the current curve, so both are composed: curve(i) = previousCurve(correction(i))
+	QElapsedTimer timer;
+	timer.start();
+	int size = this->rawResamplingCurve.size();
+	QVector<qreal> curve = this->rawResamplingCurve;
+	QVector<qreal> previousCurve = curve;
+	QVector<qreal> correction;
+	QVector<qreal> residualPhase;
+	qreal previousRms = PhaseExtractionEngineBase::getRms(this->nonLinearPhase);
+	this->refinement.initialRms = previousRms;
+	this->refinement.finalRms = previousRms;
+	this->refinement.rmsHistory.append(previousRms);
+	bool cancelled = false;
+	for(int n = 0; n < this->refinementIterations; n++){
+		if(this->isCancelled()){
+			cancelled = true;
+			break;
+		}
+		this->engine->resampleAveraged(&curve);
+		this->engine->forwardFft();
+		this->engine->selectBand(startPos, endPos, windowPeak);
+		this->engine->inverseFft();
+		this->engine->calculatePhase();
+		this->engine->unwrapPhase();
+		this->engine->calculateNonLinearPhase();
+		this->engine->calculateResamplingCurve();
+		this->engine->getNonLinearPhase(&residualPhase);
+		this->engine->getResamplingCurve(&correction);
+		qreal rms = PhaseExtractionEngineBase::getRms(residualPhase);
+		this->refinement.rmsHistory.append(rms);
+
+		//a correction that made the residual worse is discarded. The first iteration measures the raw curve itself and is always kept
+		if(n > 0 && rms > previousRms){
+			curve = previousCurve;
+			this->refinement.diverged = true;
+			this->refinement.iterations--;
+			break;
+		}
+		this->refinement.finalRms = rms;
+		previousCurve = curve;
+		for(int i = 0; i < size; i++){
+			curve[i] = Resampling::interpolate(previousCurve.constData(), size, correction.at(i), CUBIC_INTERPOLATION);
+		}
+		this->refinement.iterations++;
+		if(previousRms - rms < this->refinementTolerance){
+			this->refinement.converged = true;
+			break;
+		}
+		previousRms = rms;
+	}
+
+	//restore spectrum, band and phase of the unresampled signal, the cached upstream stages refer to them
+	this->engine->resampleAveraged(nullptr);
+	this->engine->forwardFft();
+	this->engine->selectBand(startPos, endPos, windowPeak);
+	this->engine->inverseFft();
+	this->engine->calculatePhase();
+	this->engine->unwrapPhase();
+	this->engine->calculateNonLinearPhase();
+	if(cancelled){
+		return false;
+	}
+
+	this->rawResamplingCurve = curve;
+	this->refinement.durationMs = timer.elapsed();
+	emit info(tr("Refinement ") + (this->refinement.converged ? tr("converged") : (this->refinement.diverged ? tr("stopped at increasing residual") : tr("reached iteration limit")))
+			  + tr(" after ") + QString::number(this->refinement.iterations) + tr(" iterations: nonlinear phase rms ")
+			  + QString::number(this->refinement.initialRms, 'g', 4) + tr(" rad -> ") + QString::number(this->refinement.finalRms, 'g', 4)
+			  + tr(" rad in ") + QString::number(this->refinement.durationMs) + tr(" ms"));
+	return true;
 }
 
-
 void PhaseExtractionCalculator::windowAndIFFT(int startPos, int endPos, bool windowPeak) {
-	QVector<qreal> window = this->getHanningWindow((endPos-startPos)+1);
-	//windowing (copy selected peak to selectedSignal array and set everything else, inlcuding imaginary part, to zero)
-	memset(this->selectedSignal, 0.0, this->samplesPerLine * sizeof(fftw_complex));
-	for(int i = 0; i < this->samplesPerLine; i++){
-		if(i >= startPos && i <= endPos){
-			if(windowPeak){
-				this->selectedSignal[i][REAL] = this->rawSignal[i][REAL]*window.at(i-startPos);
-				this->selectedSignal[i][IMAG] = this->rawSignal[i][IMAG]*window.at(i-startPos);
-			}else{
-				this->selectedSignal[i][REAL] = this->rawSignal[i][REAL];
-				this->selectedSignal[i][IMAG] = this->rawSignal[i][IMAG];
-			}
-			//this->selectedSignal[i][IMAG] = 0;
-		}else{
-			this->selectedSignal[i][REAL] = 0;
-			this->selectedSignal[i][IMAG] = 0;
-		}
-	}
-	//plot real part of selected signal
-	for(int j = 0; j < this->samplesPerLine/2; j++){
-		this->averagedData[j] = this->selectedSignal[j][REAL]; //todo: use differend qvector to store plot data
+	{
+		StageTimer timer(this->activeTimings, TIMING_WINDOW);
+		this->engine->selectBand(startPos, endPos, windowPeak);
+		this->engine->getSelectedSignal(&this->selectedSignalData);
 	}
-	emit signalSelected(this->averagedData);
 
 	//ifft
-	fftw_plan plan = fftw_plan_dft_1d(this->samplesPerLine, this->selectedSignal, this->selectedSignal, FFTW_BACKWARD, FFTW_ESTIMATE); //info: no need to normalize the signal after ifft because we are not interested in the amplitudes
-	fftw_execute(plan);
-
-	//plot analytical signal
-	this->analyticalSignalReal.resize(this->samplesPerLine);
-	this->analyticalSignalImag.resize(this->samplesPerLine);
-	for(int j = 0; j < this->samplesPerLine; j++){
-		this->analyticalSignalReal[j] = this->selectedSignal[j][REAL];
-		this->analyticalSignalImag[j] =  this->selectedSignal[j][IMAG];
-	}
-	emit analyticalSignalCalculated(this->analyticalSignalReal, this->analyticalSignalImag);
-
-	//cleanup
-	fftw_destroy_plan(plan);
+	StageTimer timer(this->activeTimings, TIMING_IFFT);
+	this->engine->inverseFft();
+	this->engine->getAnalyticalSignal(&this->analyticalSignalReal, &this->analyticalSignalImag);
 }
 
-QVector<qreal> PhaseExtractionCalculator::getHanningWindow(int size) {
-	QVector<qreal> window;
-	window.resize(size);
-	int width = size;
-	int center = static_cast<int>(width/2);
-	int minPos = center - width/2;
-	int maxPos = minPos + width;
-	if (maxPos < minPos) {
-		int tmp = minPos;
-		minPos = maxPos;
-		maxPos = tmp;
-	}
-	for (int i = 0; i<width; i++) {
-		int xi = i - minPos;
-		qreal xiNorm = (static_cast<qreal>(xi) / (static_cast<qreal>(width) - 1.0));
-		if (xiNorm > 0.999 || xiNorm < 0.0001) {
-			window[i] = 0.0;
+void PhaseExtractionCalculator::comparePrecisions(int firstLine, int lastLine, bool windowRaw, int startPos, int endPos, bool windowPeak) {
+	if(this->inputData == nullptr){
+		emit error(tr("PhaseExtractionExtension: no data available for precision comparison."));
+		return;
+	}
+	if(!isPrecisionAvailable(SINGLE_PRECISION)){
+		emit error(tr("PhaseExtractionExtension: single precision is not available. Extension was built without fftw3f."));
+		return;
+	}
+	emit info(tr("Comparing double and single precision..."));
+	qint64 numberOfLines = this->getNumberOfLinesToAverage(&firstLine, lastLine);
+
+	//run the same capture with the same parameters through one engine per precision
+	const int numberOfPrecisions = 2;
+	CalculationPrecision precisions[numberOfPrecisions] = {DOUBLE_PRECISION, SINGLE_PRECISION};
+	QVector<qreal> curves[numberOfPrecisions];
+	QVector<qreal> phases[numberOfPrecisions];
+	QVector<qreal> fitCoeffs[numberOfPrecisions];
+	qint64 durations[numberOfPrecisions];
+	for(int i = 0; i < numberOfPrecisions; i++){
+		PhaseExtractionEngineBase* engine = this->createEngine(precisions[i]);
+		this->configureEngine(engine);
+		QElapsedTimer timer;
+		timer.start();
+		engine->average(firstLine, numberOfLines, windowRaw, nullptr);
+		engine->forwardFft();
+		engine->selectBand(startPos, endPos, windowPeak);
+		engine->inverseFft();
+		engine->calculatePhase();
+		engine->unwrapPhase();
+		engine->calculateNonLinearPhase();
+		engine->calculateResamplingCurve();
+		durations[i] = timer.nsecsElapsed();
+		engine->getResamplingCurve(&curves[i]);
+		engine->getNonLinearPhase(&phases[i]);
+		delete engine;
+		int size = curves[i].size();
+		if(!fitPolynomial(curves[i], qBound(0, this->ignoreStart, size), qBound(0, this->ignoreEnd, size), 3, &fitCoeffs[i])){
+			emit error(tr("PhaseExtractionExtension: no samples available for fit."));
+			return;
 		}
-		else {
-			window[i] = (0.5) * (1 - cos(2.0 * M_PI * (xiNorm)));
+	}
+
+	//compare resampling curves, nonlinear phases and coefficients with OCTproZ scaling
+	qreal maxCurveDeviation = 0;
+	for(int i = 0; i < curves[0].size(); i++){
+		maxCurveDeviation = qMax(maxCurveDeviation, qAbs(curves[0].at(i) - curves[1].at(i)));
+	}
+	qreal phaseDeviationSum = 0;
+	for(int i = 0; i < phases[0].size(); i++){
+		qreal diff = phases[0].at(i) - phases[1].at(i);
+		phaseDeviationSum += diff*diff;
+	}
+	qreal phaseRmsDeviation = phases[0].isEmpty() ? 0 : qSqrt(phaseDeviationSum/phases[0].size());
+	qreal maxRelativeCoeffDeviation = 0;
+	for(int i = 0; i < fitCoeffs[0].size(); i++){
+		if(fitCoeffs[0].at(i) != 0){
+			maxRelativeCoeffDeviation = qMax(maxRelativeCoeffDeviation, qAbs((fitCoeffs[0].at(i) - fitCoeffs[1].at(i)) / fitCoeffs[0].at(i)));
 		}
 	}
-	return window;
+
+	emit info(tr("Precision comparison: max resampling curve deviation ") + QString::number(maxCurveDeviation, 'g', 3) + tr(" samples, nonlinear phase rms deviation ")
+			  + QString::number(phaseRmsDeviation, 'g', 3) + tr(" rad, max relative coefficient deviation ") + QString::number(maxRelativeCoeffDeviation, 'g', 3));
+	emit info(tr("Precision comparison: double ") + QString::number(durations[0]/1000000.0, 'f', 2) + tr(" ms, single ") + QString::number(durations[1]/1000000.0, 'f', 2) + tr(" ms"));
 }
@@ -32,8 +32,15 @@
 #include <QVector>
 #include <QtMath>
 #include "polynomial.h"
-#include "fftw/fftw3.h"
-#include "Eigen/QR"
+#include "phaseextractionengine.h"
+#include "pipelinestagecache.h"
+#include "calculatorjobscheduler.h"
+#include "analysisresult.h"
+#include "calibrationverifier.h"
+#include "resamplinglut.h"
+#include "stagetimings.h"
+
+#define RESAMPLINGLUT_BENCHMARK_LINES 1024
 
 
 class PhaseExtractionCalculator : public QObject
@@ -43,59 +50,83 @@ public:
 	explicit PhaseExtractionCalculator(QObject *parent = nullptr);
 	~PhaseExtractionCalculator();
 
+	static bool isPrecisionAvailable(CalculationPrecision precision);
+	static bool fitPolynomial(const QVector<qreal>& curve, int ignoreStart, int ignoreEnd, int order, QVector<qreal>* coeffs);
+	void setScheduler(CalculatorJobScheduler* scheduler);
+
 private:
 	unsigned char* inputData;
-	int numberOfSamples;
+	qint64 numberOfSamples;
 	int samplesPerLine;
 	int bytesPerSample;
-	int lines;
+	qint64 lines;
 	QVector<qreal> averagedData;
+	QVector<qreal> spectrumData;
+	qreal spectrumMinAfterDC;
+	qreal spectrumMaxAfterDC;
+	QVector<qreal> selectedSignalData;
 	QVector<qreal> analyticalSignalReal;
 	QVector<qreal> analyticalSignalImag;
-	fftw_complex* rawSignal;
-	fftw_complex* selectedSignal;
-	QVector<qreal> phase;
+	QVector<qreal> unwrappedPhase;
 	QVector<qreal> nonLinearPhase;
 	QVector<qreal> coeffs;
-	QVector<qreal> fittedResamplingCurve;
 	QVector<qreal> rawResamplingCurve;
-	QVector<qreal> connectionLine;
+	QVector<float> fittedResamplingCurve;
+	bool fitValid;
+	quint64 runCounter;
 	Polynomial* polynomialFit;
 	QVector<qreal> backgroundSignal;
 	int ignoreStart;
 	int ignoreEnd;
+	int refinementIterations;
+	qreal refinementTolerance;
+	RefinementStats refinement;
+	bool padToSmoothSize;
+	int upsamplingFactor;
+	FftwThreadPolicy fftThreadPolicy;
+	PhaseExtractionEngineBase* engine;
+	PipelineStageCache stageCache;
+	quint64 dataGeneration;
+	quint64 backgroundGeneration;
+	CalculatorJobScheduler* scheduler;
+	CalculatorJob currentJob;
+	bool jobRunning;
+	CalibrationVerifier verifier;
+	VerificationResult verification;
+	bool timingEnabled;
+	StageTimings timings;
+	StageTimings* activeTimings; //record of the running job, nullptr if timing is disabled
 
-	void copyLine(double* dest, int line);
-	void copyLine(fftw_complex* dest, int line);
-	void calculatePhase();
-	void unwrapPhase();
-	void generateLinearePhaseLine();
-	void generateNonLinearPhaseLine();
-	void calculateResamplingCurve();
-	void fitResamplingCurve();
+	PhaseExtractionEngineBase* createEngine(CalculationPrecision precision);
+	void configureEngine(PhaseExtractionEngineBase* engine);
+	qint64 getNumberOfLinesToAverage(int* firstLine, int lastLine);
+	bool fitResamplingCurve();
+	bool refineResamplingCurve(int startPos, int endPos, bool windowPeak);
+	void publishResult(int updatedStages);
 	void windowAndIFFT(int startPos, int endPos, bool windowPeak);
-	QVector<qreal> getHanningWindow(int size);
-
+	void reportFftThreads();
+	bool isCancelled();
+	void beginTimings();
 public slots:
+	void runScheduledJobs();
 	void setData(unsigned char* data, size_t size, size_t bytesPerSample, int samplesPerLine);
+	void releaseData();
 	void averageAndFFT(int firstLine, int lastLine, bool windowRaw, bool useBackground);
 	void analyze(int startPos, int endPos, bool windowPeak);
 	void getBackgroundSignal(unsigned char* data, size_t size, size_t bytesPerSample, int samplesPerLine);
 	void setFitParams(int ignoreStart, int ignoreEnd);
+	void setRefinementParams(int maxIterations, double tolerance);
+	void setFftParams(bool padToSmoothSize, int upsamplingFactor, bool multithreadedFft);
+	void setPrecision(int precision);
+	void comparePrecisions(int firstLine, int lastLine, bool windowRaw, int startPos, int endPos, bool windowPeak);
 	void reFitResamplingCurve(int ignoreStart, int ignoreEnd);
+	void verifyCalibration(int firstLine, int lastLine, int startPos, int endPos, int interpolationMethod);
+	void saveResamplingLut(QString fileName, int interpolationMethod, bool halfPrecision);
+	void setTimingEnabled(bool enabled);
 
 signals:
-	void fftDataAveraged(QVector<qreal> data);
-	void fftDataRangeFound(double min, double max);
-	void signalSelected(QVector<qreal> data);
-	void unwrappedPhaseCalculated(QVector<qreal> phase);
-	void phaseCalculated(QVector<qreal> phase);
-	void nonLinearPhaseCalculated(QVector<qreal> nonLinearPhase);
-	void analyticalSignalCalculated(QVector<qreal> signalReal, QVector<qreal> signalImag);
-	void resamplingCurveCalculated(QVector<qreal> data);
-	void resamplingCurveFitted(float* data, int size);
-	void rawAveraged(QVector<qreal> signal);
-	void coeffsCalculated(double k0, double k1, double k2, double k3);
+	void resultReady(AnalysisResultPtr result);
+	void timingsMeasured(StageTimings timings);
 	void error(QString);
 	void info(QString);
 
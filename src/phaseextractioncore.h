@@ -0,0 +1,340 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#ifndef PHASEEXTRACTIONCORE_H
+#define PHASEEXTRACTIONCORE_H
+
+#include <cmath>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+#include "Eigen/QR"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define PHASEEXTRACTIONCORE_CHUNK_LINES 256 //lines that are summed up before their sum is added to the double precision total
+#define PHASEEXTRACTIONCORE_BLOCK_SAMPLES 2048 //columns that are summed up at once. Partial sums and total of a block stay in the L1/L2 cache
+
+//Calculation kernels of the phase extraction without Qt dependencies: decode, average, window, band select, phase, unwrap, resampling curve and fit.
+//All kernels work on pointers and sizes of caller provided buffers and do not allocate, so they can run on any thread, in batches or in benchmarks.
+//Complex buffers are interleaved real/imaginary pairs like fftw_complex. The FFT itself is done with FftwTraits<T>::executeDft on the same buffers,
+//plans are created by the owner of the buffers because the fftw planner is not thread safe.
+namespace PhaseExtractionCore {
+
+template <typename T>
+using Complex = T[2];
+
+//smallest number >= size of the form 2^a*3^b*5^c*7^d. FFTW has optimized codelets for these radices
+inline int nextSmoothSize(int size) {
+	if(size <= 1){
+		return 1;
+	}
+	for(int candidate = size; ; candidate++){
+		int rest = candidate;
+		const int radices[] = {2, 3, 5, 7};
+		for(int radix : radices){
+			while(rest % radix == 0){
+				rest /= radix;
+			}
+		}
+		if(rest == 1){
+			return candidate;
+		}
+	}
+}
+
+template <typename S, typename T>
+inline void decodeSamples(const S* src, int size, T* dest, int destStride) {
+	for(int i = 0; i < size; i++){
+		dest[i*destStride] = static_cast<T>(src[i]);
+	}
+}
+
+//dest[i*destStride] = sample i, starting at sample firstSample of the raw data. Samples are stored in 1, 2 or 4 bytes like in OCTproZ
+template <typename T>
+inline void decodeLine(const unsigned char* data, int bytesPerSample, size_t firstSample, int size, T* dest, int destStride = 1) {
+	if(bytesPerSample <= 1){
+		decodeSamples(data + firstSample, size, dest, destStride);
+	}else if(bytesPerSample <= 2){
+		decodeSamples(reinterpret_cast<const uint16_t*>(data) + firstSample, size, dest, destStride);
+	}else{
+		decodeSamples(reinterpret_cast<const uint32_t*>(data) + firstSample, size, dest, destStride);
+	}
+}
+
+//dest[i*destStride] += sum of sample i (i < size) of numberOfLines lines starting at firstLine, taking every lineStep-th line. src may point into the first line to sum up a block of columns
+template <typename S, typename T>
+inline void accumulateTypedLines(const S* src, int samplesPerLine, size_t firstLine, int numberOfLines, int lineStep, int size, T* dest, int destStride) {
+	for(int n = 0; n < numberOfLines; n++){
+		const S* lineStart = src + (firstLine + static_cast<size_t>(n)*lineStep)*samplesPerLine;
+		for(int i = 0; i < size; i++){
+			dest[i*destStride] += static_cast<T>(lineStart[i]);
+		}
+	}
+}
+
+template <typename T>
+inline void accumulateLines(const unsigned char* data, int bytesPerSample, int samplesPerLine, size_t firstLine, int numberOfLines, int lineStep, int firstSample, int size, T* dest, int destStride = 1) {
+	if(bytesPerSample <= 1){
+		accumulateTypedLines(data + firstSample, samplesPerLine, firstLine, numberOfLines, lineStep, size, dest, destStride);
+	}else if(bytesPerSample <= 2){
+		accumulateTypedLines(reinterpret_cast<const uint16_t*>(data) + firstSample, samplesPerLine, firstLine, numberOfLines, lineStep, size, dest, destStride);
+	}else{
+		accumulateTypedLines(reinterpret_cast<const uint32_t*>(data) + firstSample, samplesPerLine, firstLine, numberOfLines, lineStep, size, dest, destStride);
+	}
+}
+
+//lines per chunk whose sum is exact in T for samples with bytesPerSample bytes, e.g. 256 lines of 16 bit samples in float. 32 bit samples are never exact in float
+template <typename T>
+inline int getChunkLines(int bytesPerSample) {
+	int spareBits = std::numeric_limits<T>::digits - 8*bytesPerSample;
+	if(spareBits <= 0){
+		return 1;
+	}
+	return spareBits >= 30 ? PHASEEXTRACTIONCORE_CHUNK_LINES : std::min(1 << spareBits, PHASEEXTRACTIONCORE_CHUNK_LINES);
+}
+
+//sum[i] = sum of sample i of numberOfLines lines starting at firstLine, taking every lineStep-th line. accumulate(chunkFirstLine, chunkLines, firstSample, size, partial) adds the samples
+//firstSample ... firstSample+size-1 of chunkLines lines to partial. Lines are processed in chunks of chunkLines lines and every chunk in blocks of PHASEEXTRACTIONCORE_BLOCK_SAMPLES columns,
+//so every raw sample is read once while partial and sum of the block stay in cache. Memory traffic grows linearly with the number of lines and the sum of a capture
+//with any number of lines is as accurate as the sum of one chunk
+template <typename T, typename Accumulate>
+inline void sumLines(int samplesPerLine, size_t firstLine, size_t numberOfLines, int lineStep, int chunkLines, Accumulate accumulate, double* sum) {
+	T partial[PHASEEXTRACTIONCORE_BLOCK_SAMPLES];
+	std::fill(sum, sum + samplesPerLine, 0.0);
+	for(size_t chunkStart = 0; chunkStart < numberOfLines; chunkStart += static_cast<size_t>(chunkLines)){
+		int linesInChunk = static_cast<int>(std::min(static_cast<size_t>(chunkLines), numberOfLines - chunkStart));
+		size_t chunkFirstLine = firstLine + chunkStart*static_cast<size_t>(lineStep);
+		for(int blockStart = 0; blockStart < samplesPerLine; blockStart += PHASEEXTRACTIONCORE_BLOCK_SAMPLES){
+			int blockSize = std::min(PHASEEXTRACTIONCORE_BLOCK_SAMPLES, samplesPerLine - blockStart);
+			std::fill(partial, partial + blockSize, T(0));
+			accumulate(chunkFirstLine, linesInChunk, blockStart, blockSize, partial);
+			for(int i = 0; i < blockSize; i++){
+				sum[blockStart + i] += static_cast<double>(partial[i]);
+			}
+		}
+	}
+}
+
+//dest[i*destStride] = sum[i]/numberOfLines - background[i] (nullptr: no background)
+template <typename T, typename B>
+inline void normalizeSum(const double* sum, int samplesPerLine, size_t numberOfLines, const B* background, T* dest, int destStride = 1) {
+	double normalization = numberOfLines > 0 ? 1.0 / static_cast<double>(numberOfLines) : 0.0;
+	for(int i = 0; i < samplesPerLine; i++){
+		double value = sum[i]*normalization;
+		if(background != nullptr){
+			value -= static_cast<double>(background[i]);
+		}
+		dest[i*destStride] = static_cast<T>(value);
+	}
+}
+
+//averages numberOfLines lines into dest and subtracts background (nullptr: none). sum is a scratch buffer of samplesPerLine elements
+template <typename T, typename B>
+inline void averageLines(const unsigned char* data, int bytesPerSample, int samplesPerLine, size_t firstLine, size_t numberOfLines, int lineStep, const B* background, double* sum, T* dest, int destStride = 1) {
+	sumLines<T>(samplesPerLine, firstLine, numberOfLines, lineStep, getChunkLines<T>(bytesPerSample), [&](size_t chunkFirstLine, int chunkLines, int firstSample, int size, T* partial) {
+		accumulateLines(data, bytesPerSample, samplesPerLine, chunkFirstLine, chunkLines, lineStep, firstSample, size, partial);
+	}, sum);
+	normalizeSum(sum, samplesPerLine, numberOfLines, background, dest, destStride);
+}
+
+template <typename T>
+inline void hanningWindow(T* dest, int size) {
+	int width = size;
+	int center = static_cast<int>(width/2);
+	int minPos = center - width/2;
+	int maxPos = minPos + width;
+	if (maxPos < minPos) {
+		int tmp = minPos;
+		minPos = maxPos;
+		maxPos = tmp;
+	}
+	for (int i = 0; i<width; i++) {
+		int xi = i - minPos;
+		double xiNorm = (static_cast<double>(xi) / (static_cast<double>(width) - 1.0));
+		if (xiNorm > 0.999 || xiNorm < 0.0001) {
+			dest[i] = 0;
+		}
+		else {
+			dest[i] = static_cast<T>((0.5) * (1 - std::cos(2.0 * M_PI * (xiNorm))));
+		}
+	}
+}
+
+template <typename T, typename W>
+inline void applyWindow(T* signal, int size, const W* window, int stride = 1) {
+	for(int i = 0; i < size; i++){
+		signal[i*stride] *= static_cast<T>(window[i]);
+	}
+}
+
+//copies bins startPos to endPos of spectrum into dest, multiplied with window (nullptr: rectangular window, otherwise endPos-startPos+1 values), and sets everything else to zero.
+//dest may be larger than the spectrum, the remaining bins stay zero so an inverse fft of dest interpolates the analytical signal
+template <typename T, typename W>
+inline void selectBand(const Complex<T>* spectrum, int spectrumSize, int startPos, int endPos, const W* window, Complex<T>* dest, int destSize) {
+	memset(dest, 0, destSize * sizeof(Complex<T>));
+	int first = startPos < 0 ? 0 : startPos;
+	int last = endPos < spectrumSize-1 ? endPos : spectrumSize-1;
+	for(int i = first; i <= last; i++){
+		T windowValue = window != nullptr ? static_cast<T>(window[i-startPos]) : static_cast<T>(1);
+		dest[i][0] = spectrum[i][0]*windowValue;
+		dest[i][1] = spectrum[i][1]*windowValue;
+	}
+}
+
+template <typename T>
+inline void calculatePhase(const Complex<T>* signal, int size, T* phase) {
+	for(int i = 0; i < size; i++){
+		phase[i] = std::atan2(signal[i][1], signal[i][0]);
+	}
+}
+
+//in place. The number of 2*pi jumps is carried along, so each sample is visited only once. Counting whole cycles instead of summing up 2*pi avoids accumulating rounding errors
+template <typename T>
+inline void unwrapPhase(T* phase, int size) {
+	const T twoPi = static_cast<T>(2.0*M_PI);
+	const T pi = static_cast<T>(M_PI);
+	int cycles = 0;
+	T previous = phase[0];
+	for(int i = 1; i < size; i++){
+		T current = phase[i];
+		T diff = current - previous;
+		if(diff > pi){
+			cycles--;
+		}
+		if(diff < -pi){
+			cycles++;
+		}
+		previous = current;
+		phase[i] = current + static_cast<T>(cycles)*twoPi;
+	}
+}
+
+//connectionLine is the line through first and last sample of the unwrapped phase. This corresponds to the phase of a perfectly linear sine wave
+template <typename T>
+inline void calculateNonLinearPhase(const T* phase, int size, T* connectionLine, T* nonLinearPhase) {
+	T first = phase[0];
+	T slope = (phase[size-1] - first) / static_cast<T>(size-1);
+	for(int i = 0; i < size; i++){
+		connectionLine[i] = slope * static_cast<T>(i) + first;
+		nonLinearPhase[i] = phase[i] - connectionLine[i];
+	}
+}
+
+//position at which the unwrapped phase reaches the connection line, on the upsampled grid of size phaseSize. Every upsamplingFactor-th value is mapped back to the samplesPerLine values of curve
+template <typename T>
+inline void calculateResamplingCurve(const T* phase, const T* connectionLine, int phaseSize, int upsamplingFactor, T* upsampledCurve, T* curve, int samplesPerLine) {
+	int size = phaseSize;
+	upsampledCurve[0] = 0;
+	int j = 0;
+	for(int i=1; i<(size-1); i++){
+		while(phase[j]<connectionLine[i] && j<(size-1) ){
+			j++;
+		}
+		upsampledCurve[i] = (j-1) + ((connectionLine[i] - phase[j-1]) / (phase[j] - phase[j-1]));
+	}
+	upsampledCurve[size-1] = size-1;
+
+	T scale = static_cast<T>(1.0 / static_cast<double>(upsamplingFactor));
+	for(int i = 0; i < samplesPerLine; i++){
+		curve[i] = upsampledCurve[i*upsamplingFactor] * scale;
+	}
+}
+
+//least squares fit of a polynomial of the given order to curve, samples within ignoreStart and ignoreEnd of the ends are not used. coeffs needs order+1 values
+inline bool fitPolynomial(const double* curve, int size, int ignoreStart, int ignoreEnd, int order, double* coeffs) {
+	int effectiveSize = size - ignoreStart - ignoreEnd;
+	if (effectiveSize <= 0) {
+		return false;
+	}
+	Eigen::MatrixXd A(effectiveSize, order + 1);
+	Eigen::VectorXd yv_mapped = Eigen::VectorXd::Map(curve + ignoreStart, effectiveSize);
+	for (int i = 0; i < effectiveSize; i++) {
+		double x = i + ignoreStart;
+		for (int j = 0; j < order + 1; j++) {
+			A(i, j) = std::pow(x, j);
+		}
+	}
+	Eigen::VectorXd result = A.householderQr().solve(yv_mapped);
+	for (int i = 0; i < order + 1; i++) {
+		coeffs[i] = result[i];
+	}
+	return true;
+}
+
+//dest[i] = polynomial at i, Horner's method
+template <typename T, typename C>
+inline void evaluatePolynomial(const C* coeffs, int order, T* dest, int size) {
+	for(int i = 0; i < size; i++){
+		T x = static_cast<T>(i);
+		T value = 0;
+		for(int j = order; j >= 0; j--){
+			value = std::fma(value, x, static_cast<T>(coeffs[j]));
+		}
+		dest[i] = value;
+	}
+}
+
+template <typename T>
+inline double rms(const T* signal, int size) {
+	if(size <= 0){
+		return 0;
+	}
+	double squareSum = 0;
+	for(int i = 0; i < size; i++){
+		squareSum += static_cast<double>(signal[i])*static_cast<double>(signal[i]);
+	}
+	return std::sqrt(squareSum/size);
+}
+
+//bins below firstBin contain the DC peak and are ignored
+template <typename T>
+inline bool spectrumRange(const T* spectrum, int size, int firstBin, T* min, T* max) {
+	if(size <= firstBin){
+		return false;
+	}
+	*min = spectrum[firstBin];
+	*max = spectrum[firstBin];
+	for(int i = firstBin; i < size; i++){
+		if(spectrum[i] > *max){
+			*max = spectrum[i];
+		}
+		if(spectrum[i] < *min){
+			*min = spectrum[i];
+		}
+	}
+	return true;
+}
+
+}
+
+#endif // PHASEEXTRACTIONCORE_H
@@ -0,0 +1,83 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#include "phaseextractionengine.h"
+
+
+PhaseExtractionEngineBase::PhaseExtractionEngineBase(FftwThreadPolicy* threadPolicy) {
+	this->threadPolicy = threadPolicy;
+	this->inputData = nullptr;
+	this->bytesPerSample = 0;
+	this->samplesPerLine = 0;
+	this->lines = 0;
+	this->padToSmoothSize = false;
+	this->upsamplingFactor = 1;
+	this->fftSize = 0;
+	this->upsampledSize = 0;
+	this->phaseSize = 0;
+	this->forwardFftThreads = 1;
+	this->backwardFftThreads = 1;
+	this->planningNs = 0;
+}
+
+void PhaseExtractionEngineBase::setData(unsigned char* data, int bytesPerSample, int samplesPerLine, qint64 lines) {
+	this->inputData = data;
+	this->bytesPerSample = bytesPerSample;
+	this->samplesPerLine = samplesPerLine;
+	this->lines = lines;
+	this->updateFftPlans();
+}
+
+void PhaseExtractionEngineBase::setFftParams(bool padToSmoothSize, int upsamplingFactor) {
+	this->padToSmoothSize = padToSmoothSize;
+	this->upsamplingFactor = qMax(1, upsamplingFactor);
+
+	//plans and buffers only exist after data has been fetched
+	if(this->samplesPerLine > 0){
+		this->updateFftPlans();
+	}
+}
+
+int PhaseExtractionEngineBase::nextSmoothSize(int size) {
+	return PhaseExtractionCore::nextSmoothSize(size);
+}
+
+QVector<qreal> PhaseExtractionEngineBase::getHanningWindow(int size) {
+	QVector<qreal> window(size);
+	PhaseExtractionCore::hanningWindow(window.data(), size);
+	return window;
+}
+
+bool PhaseExtractionEngineBase::getSpectrumRange(const QVector<qreal>& spectrum, int firstBin, qreal* min, qreal* max) {
+	//bins below firstBin contain the DC peak and are ignored, otherwise the DC peak would dominate the y axis scaling
+	return PhaseExtractionCore::spectrumRange(spectrum.constData(), spectrum.size(), firstBin, min, max);
+}
+
+qreal PhaseExtractionEngineBase::getRms(const QVector<qreal>& signal) {
+	return PhaseExtractionCore::rms(signal.constData(), signal.size());
+}
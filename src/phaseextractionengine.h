@@ -0,0 +1,348 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#ifndef PHASEEXTRACTIONENGINE_H
+#define PHASEEXTRACTIONENGINE_H
+
+#include <QVector>
+#include <QtMath>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <cstring>
+#include "fftwtraits.h"
+#include "fftwthreadpolicy.h"
+#include "resampling.h"
+#include "phaseextractioncore.h"
+#include "kerneldispatch.h"
+
+#define REAL 0
+#define IMAG 1
+#define SPECTRUM_POS_AFTER_DC 10
+
+enum CalculationPrecision {
+	DOUBLE_PRECISION,
+	SINGLE_PRECISION
+};
+
+//Calculation stages from averaging of the raw data up to the raw resampling curve.
+//PhaseExtractionEngine<T> owns buffers and fft plans for a specific scalar type and runs the kernels of PhaseExtractionCore on them, the hot kernels through KernelDispatch. Everything that leaves the engine is converted to qreal, the fit of the resampling curve is done in double by PhaseExtractionCalculator.
+class PhaseExtractionEngineBase
+{
+public:
+	PhaseExtractionEngineBase(FftwThreadPolicy* threadPolicy);
+	virtual ~PhaseExtractionEngineBase() {}
+
+	virtual CalculationPrecision getPrecision() = 0;
+	virtual void average(qint64 firstLine, qint64 numberOfLines, bool windowRaw, const QVector<qreal>* backgroundSignal, int lineStep = 1) = 0; //averages numberOfLines lines starting at firstLine, taking every lineStep-th line. Lines beyond the data are ignored
+	virtual void resampleAveraged(const QVector<qreal>* curve) = 0; //reloads the last averaged signal into the fft buffer, resampled with curve (nullptr: unchanged) and windowed like in average()
+	virtual void forwardFft() = 0;
+	virtual void selectBand(int startPos, int endPos, bool windowPeak) = 0;
+	virtual void inverseFft() = 0;
+	virtual void calculatePhase() = 0;
+	virtual void unwrapPhase() = 0;
+	virtual void calculateNonLinearPhase() = 0;
+	virtual void calculateResamplingCurve() = 0;
+
+	virtual void getAveragedRaw(QVector<qreal>* dest) = 0;
+	virtual void getSpectrum(QVector<qreal>* dest) = 0;
+	virtual void getSelectedSignal(QVector<qreal>* dest) = 0;
+	virtual void getAnalyticalSignal(QVector<qreal>* destReal, QVector<qreal>* destImag) = 0;
+	virtual void getUnwrappedPhase(QVector<qreal>* dest) = 0;
+	virtual void getNonLinearPhase(QVector<qreal>* dest) = 0;
+	virtual void getResamplingCurve(QVector<qreal>* dest) = 0;
+
+	void setData(unsigned char* data, int bytesPerSample, int samplesPerLine, qint64 lines);
+	void setFftParams(bool padToSmoothSize, int upsamplingFactor);
+	bool hasData() { return this->inputData != nullptr && this->samplesPerLine > 0; }
+	int getSamplesPerLine() { return this->samplesPerLine; }
+	int getFftSize() { return this->fftSize; }
+	int getUpsampledSize() { return this->upsampledSize; }
+	int getForwardFftThreads() { return this->forwardFftThreads; }
+	int getBackwardFftThreads() { return this->backwardFftThreads; }
+	qint64 getPlanningTime() { return this->planningNs; } //duration of the last updateFftPlans() call that created plans
+
+	static int nextSmoothSize(int size);
+	static QVector<qreal> getHanningWindow(int size);
+	static bool getSpectrumRange(const QVector<qreal>& spectrum, int firstBin, qreal* min, qreal* max);
+	static qreal getRms(const QVector<qreal>& signal);
+
+protected:
+	virtual void updateFftPlans() = 0;
+
+	FftwThreadPolicy* threadPolicy;
+	unsigned char* inputData;
+	int bytesPerSample;
+	int samplesPerLine;
+	qint64 lines;
+	bool padToSmoothSize;
+	int upsamplingFactor;
+	int fftSize;
+	int upsampledSize;
+	int phaseSize;
+	int forwardFftThreads;
+	int backwardFftThreads;
+	qint64 planningNs;
+};
+
+
+template <typename T>
+class PhaseExtractionEngine : public PhaseExtractionEngineBase
+{
+	typedef typename FftwTraits<T>::Complex Complex;
+	typedef typename FftwTraits<T>::Plan Plan;
+
+public:
+	PhaseExtractionEngine(FftwThreadPolicy* threadPolicy) : PhaseExtractionEngineBase(threadPolicy) {
+		this->rawSignal = nullptr;
+		this->selectedSignal = nullptr;
+		this->forwardPlan = nullptr;
+		this->backwardPlan = nullptr;
+		this->averagedWindowed = false;
+	}
+
+	~PhaseExtractionEngine() {
+		QMutexLocker plannerLocker(FftwThreadPolicy::getPlannerMutex());
+		if(this->forwardPlan != nullptr){
+			FftwTraits<T>::destroyPlan(this->forwardPlan);
+		}
+		if(this->backwardPlan != nullptr){
+			FftwTraits<T>::destroyPlan(this->backwardPlan);
+		}
+		FftwTraits<T>::free(this->rawSignal);
+		FftwTraits<T>::free(this->selectedSignal);
+	}
+
+	CalculationPrecision getPrecision() override {
+		return sizeof(T) == sizeof(float) ? SINGLE_PRECISION : DOUBLE_PRECISION;
+	}
+
+	void average(qint64 firstLine, qint64 numberOfLines, bool windowRaw, const QVector<qreal>* backgroundSignal, int lineStep = 1) override {
+		//lines are summed up in cache sized chunks with the kernels of the active instruction set, background is substracted if it matches the line length.
+		//The unwindowed average is kept for resampleAveraged
+		firstLine = qBound(static_cast<qint64>(0), firstLine, this->lines);
+		numberOfLines = qBound(static_cast<qint64>(0), numberOfLines, (this->lines - firstLine + lineStep - 1)/lineStep);
+		const qreal* background = (backgroundSignal != nullptr && backgroundSignal->size() == this->samplesPerLine) ? backgroundSignal->constData() : nullptr;
+		KernelDispatch::averageLines(this->inputData, this->bytesPerSample, this->samplesPerLine, static_cast<size_t>(firstLine), static_cast<size_t>(numberOfLines), lineStep, background, this->lineSum.data(), this->averagedSignal.data());
+		this->averagedWindowed = windowRaw;
+		this->loadRawSignal(this->averagedSignal.constData());
+	}
+
+	void resampleAveraged(const QVector<qreal>* curve) override {
+		if(curve != nullptr && curve->size() == this->samplesPerLine){
+			for(int j = 0; j < this->samplesPerLine; j++){
+				this->lineBuffer[j] = Resampling::interpolate(this->averagedSignal.constData(), this->samplesPerLine, static_cast<T>(curve->at(j)), CUBIC_INTERPOLATION);
+			}
+			this->loadRawSignal(this->lineBuffer.constData());
+		}else{
+			this->loadRawSignal(this->averagedSignal.constData());
+		}
+	}
+
+	void forwardFft() override {
+		FftwTraits<T>::execute(this->forwardPlan);
+	}
+
+	void selectBand(int startPos, int endPos, bool windowPeak) override {
+		//windowing (copy selected peak to selectedSignal array and set everything else, inlcuding imaginary part, to zero)
+		//selectedSignal has upsampledSize elements. Bins above fftSize stay zero, so the ifft interpolates the analytical signal by upsamplingFactor
+		QVector<qreal> window = windowPeak ? getHanningWindow((endPos-startPos)+1) : QVector<qreal>();
+		PhaseExtractionCore::selectBand(this->rawSignal, this->fftSize, startPos, endPos, windowPeak ? window.constData() : nullptr, this->selectedSignal, this->upsampledSize);
+	}
+
+	void inverseFft() override {
+		FftwTraits<T>::execute(this->backwardPlan); //info: no need to normalize the signal after ifft because we are not interested in the amplitudes
+	}
+
+	void calculatePhase() override {
+		//only the first phaseSize samples of the analytical signal correspond to the original line, the rest is zero padding
+		KernelDispatch::getKernels<T>().calculatePhase(this->selectedSignal, this->phaseSize, this->phase.data());
+	}
+
+	void unwrapPhase() override {
+		KernelDispatch::getKernels<T>().unwrapPhase(this->phase.data(), this->phaseSize);
+	}
+
+	void calculateNonLinearPhase() override {
+		PhaseExtractionCore::calculateNonLinearPhase(this->phase.constData(), this->phaseSize, this->connectionLine.data(), this->nonLinearPhase.data());
+	}
+
+	void calculateResamplingCurve() override {
+		//the curve is calculated on the upsampled grid and mapped back to the original sample grid. Every upsamplingFactor-th sample of the upsampled grid coincides with an original sample
+		PhaseExtractionCore::calculateResamplingCurve(this->phase.constData(), this->connectionLine.constData(), this->phaseSize, this->upsamplingFactor, this->upsampledCurve.data(), this->resamplingCurve.data(), this->samplesPerLine);
+	}
+
+	void getAveragedRaw(QVector<qreal>* dest) override {
+		dest->resize(this->samplesPerLine);
+		for(int j = 0; j < this->samplesPerLine; j++){
+			(*dest)[j] = this->rawSignal[j][REAL];
+		}
+	}
+
+	void getSpectrum(QVector<qreal>* dest) override {
+		dest->resize(this->fftSize/2);
+		for(int j = 0; j < this->fftSize/2; j++){
+			(*dest)[j] = this->rawSignal[j][REAL];
+		}
+	}
+
+	void getSelectedSignal(QVector<qreal>* dest) override {
+		dest->resize(this->fftSize/2);
+		for(int j = 0; j < this->fftSize/2; j++){
+			(*dest)[j] = this->selectedSignal[j][REAL];
+		}
+	}
+
+	void getAnalyticalSignal(QVector<qreal>* destReal, QVector<qreal>* destImag) override {
+		destReal->resize(this->phaseSize);
+		destImag->resize(this->phaseSize);
+		for(int j = 0; j < this->phaseSize; j++){
+			(*destReal)[j] = this->selectedSignal[j][REAL];
+			(*destImag)[j] = this->selectedSignal[j][IMAG];
+		}
+	}
+
+	void getUnwrappedPhase(QVector<qreal>* dest) override {
+		copyConverted(this->phase, dest);
+	}
+
+	void getNonLinearPhase(QVector<qreal>* dest) override {
+		copyConverted(this->nonLinearPhase, dest);
+	}
+
+	void getResamplingCurve(QVector<qreal>* dest) override {
+		copyConverted(this->resamplingCurve, dest);
+	}
+
+protected:
+	void updateFftPlans() override {
+		int newFftSize = this->padToSmoothSize ? nextSmoothSize(this->samplesPerLine) : this->samplesPerLine;
+		int newUpsampledSize = newFftSize * this->upsamplingFactor;
+		int newForwardFftThreads = this->threadPolicy->threadsFor(newFftSize);
+		int newBackwardFftThreads = this->threadPolicy->threadsFor(newUpsampledSize);
+		this->phaseSize = (this->samplesPerLine - 1) * this->upsamplingFactor + 1;
+		QMutexLocker plannerLocker(FftwThreadPolicy::getPlannerMutex());
+
+		//buffers are only reallocated if their size changed, so the averaged spectrum in rawSignal is kept if only the upsampling factor or thread count changed
+		if(newFftSize != this->fftSize || this->rawSignal == nullptr){
+			this->destroyPlan(&this->forwardPlan);
+			FftwTraits<T>::free(this->rawSignal);
+			this->fftSize = newFftSize;
+			this->rawSignal = FftwTraits<T>::allocComplex(this->fftSize);
+			memset(this->rawSignal, 0, this->fftSize * sizeof(Complex));
+		}
+		if(newUpsampledSize != this->upsampledSize || this->selectedSignal == nullptr){
+			this->destroyPlan(&this->backwardPlan);
+			FftwTraits<T>::free(this->selectedSignal);
+			this->upsampledSize = newUpsampledSize;
+			this->selectedSignal = FftwTraits<T>::allocComplex(this->upsampledSize);
+			memset(this->selectedSignal, 0, this->upsampledSize * sizeof(Complex));
+		}
+
+		//plans are created once per buffer size and thread count and reused for every averaging and analysis run. FFTW_ESTIMATE does not touch the buffers during planning
+		QElapsedTimer planningTimer;
+		planningTimer.start();
+		bool planned = this->forwardPlan == nullptr || this->backwardPlan == nullptr || newForwardFftThreads != this->forwardFftThreads || newBackwardFftThreads != this->backwardFftThreads;
+		if(this->forwardPlan == nullptr || newForwardFftThreads != this->forwardFftThreads){
+			this->destroyPlan(&this->forwardPlan);
+			this->threadPolicy->applyTo(newForwardFftThreads);
+			this->forwardPlan = FftwTraits<T>::planDft1d(this->fftSize, this->rawSignal, this->rawSignal, FFTW_FORWARD);
+			this->forwardFftThreads = newForwardFftThreads;
+		}
+		if(this->backwardPlan == nullptr || newBackwardFftThreads != this->backwardFftThreads){
+			this->destroyPlan(&this->backwardPlan);
+			this->threadPolicy->applyTo(newBackwardFftThreads);
+			this->backwardPlan = FftwTraits<T>::planDft1d(this->upsampledSize, this->selectedSignal, this->selectedSignal, FFTW_BACKWARD);
+			this->backwardFftThreads = newBackwardFftThreads;
+		}
+		this->threadPolicy->applyTo(1);
+		plannerLocker.unlock();
+		if(planned){
+			this->planningNs = planningTimer.nsecsElapsed();
+		}
+
+		this->phase.resize(this->phaseSize);
+		this->connectionLine.resize(this->phaseSize);
+		this->nonLinearPhase.resize(this->phaseSize);
+		this->upsampledCurve.resize(this->phaseSize);
+		this->resamplingCurve.resize(this->samplesPerLine);
+		this->averagedSignal.resize(this->samplesPerLine);
+		this->lineBuffer.resize(this->samplesPerLine);
+		this->lineSum.resize(this->samplesPerLine);
+		if(this->rawWindow.size() != this->samplesPerLine){
+			this->rawWindow.resize(this->samplesPerLine);
+			PhaseExtractionCore::hanningWindow(this->rawWindow.data(), this->samplesPerLine);
+		}
+	}
+
+private:
+	void loadRawSignal(const T* line) {
+		//line is windowed in lineBuffer if the averaged signal was windowed and written to the real part of rawSignal.
+		//Samples beyond samplesPerLine stay zero and act as zero padding if fftSize > samplesPerLine
+		if(line != this->lineBuffer.constData()){
+			memcpy(this->lineBuffer.data(), line, this->samplesPerLine * sizeof(T));
+		}
+		if(this->averagedWindowed){
+			KernelDispatch::getKernels<T>().applyWindow(this->lineBuffer.data(), this->samplesPerLine, this->rawWindow.constData());
+		}
+		memset(this->rawSignal, 0, this->fftSize * sizeof(Complex));
+		for(int j = 0; j < this->samplesPerLine; j++){
+			this->rawSignal[j][REAL] = this->lineBuffer.at(j);
+		}
+	}
+
+	void destroyPlan(Plan* plan) {
+		if(*plan != nullptr){
+			FftwTraits<T>::destroyPlan(*plan);
+			*plan = nullptr;
+		}
+	}
+
+	static void copyConverted(const QVector<T>& src, QVector<qreal>* dest) {
+		dest->resize(src.size());
+		for(int i = 0; i < src.size(); i++){
+			(*dest)[i] = static_cast<qreal>(src.at(i));
+		}
+	}
+
+	Complex* rawSignal;
+	Complex* selectedSignal;
+	Plan forwardPlan;
+	Plan backwardPlan;
+	QVector<T> phase;
+	QVector<T> connectionLine;
+	QVector<T> nonLinearPhase;
+	QVector<T> upsampledCurve;
+	QVector<T> resamplingCurve;
+	QVector<T> averagedSignal;
+	QVector<T> lineBuffer; //windowed or resampled line before it is copied into rawSignal
+	QVector<T> rawWindow;
+	QVector<double> lineSum; //scratch buffer of the chunked averaging
+	bool averagedWindowed;
+};
+
+#endif // PHASEEXTRACTIONENGINE_H
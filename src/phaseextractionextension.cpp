@@ -26,10 +26,13 @@
 **/
 
 #include "phaseextractionextension.h"
+#include <QElapsedTimer>
 
 
 PhaseExtractionExtension::PhaseExtractionExtension() : Extension() {
 	qRegisterMetaType<QVector<qreal> >("QVector<qreal>");
+	qRegisterMetaType<AnalysisResultPtr>("AnalysisResultPtr");
+	qRegisterMetaType<DriftSample>("DriftSample");
 	//init extension
 	this->setType(EXTENSION);
 	this->displayStyle = SEPARATE_WINDOW;
@@ -40,24 +43,47 @@ PhaseExtractionExtension::PhaseExtractionExtension() : Extension() {
 	this->form = new PhaseExtractionExtensionForm();
 	this->widgetDisplayed = false;
 	connect(this, &PhaseExtractionExtension::fetchingStatus, this->form, &PhaseExtractionExtensionForm::setFetchingStatusMessage);
+	connect(this, &PhaseExtractionExtension::acquisitionStatus, this->form, &PhaseExtractionExtensionForm::setAcquisitionStatusMessage);
+	connect(&this->acquisitionStatusTimer, &QTimer::timeout, this, &PhaseExtractionExtension::updateAcquisitionStatus);
+	this->acquisitionStatusTimer.setInterval(ACQUISITION_STATUS_INTERVAL_MS);
 	connect(this, &PhaseExtractionExtension::fetchingDone, this->form, &PhaseExtractionExtensionForm::enableAveragingGroupBox);
 	connect(this->form, &PhaseExtractionExtensionForm::fetchingEnabled, this,&PhaseExtractionExtension::enableFetching);
 	connect(this->form, &PhaseExtractionExtensionForm::fetchingBackgroundEnabled, this,&PhaseExtractionExtension::enableFetchingBackground);
 	connect(this->form, &PhaseExtractionExtensionForm::buffersToFetchChanged, this, &PhaseExtractionExtension::setBuffersToFetch);
 	connect(this->form, &PhaseExtractionExtensionForm::transferCoeffs, this, &PhaseExtractionExtension::transferCoeffsToOCTproZ);
+	connect(this->form, &PhaseExtractionExtensionForm::sessionSaveRequested, this, &PhaseExtractionExtension::saveSession);
+	connect(this->form, &PhaseExtractionExtensionForm::sessionOpenRequested, this, &PhaseExtractionExtension::openSession);
 
 	connect(this->form, &PhaseExtractionExtensionForm::paramsChanged, this, &PhaseExtractionExtension::setParams);
 
 	//init fetched buffers vector
 	this->fetchedRawData = nullptr;
-
-	this->lostBuffers = 0;
+	this->fetchedDataSize = 0;
+	this->fetchedBitDepth = 0;
+	this->fetchedLinesPerBuffer = 0;
+	this->session = nullptr;
+
+	this->lostBuffers.storeRelease(0);
+	this->lostBuffersDetectable.storeRelease(0);
+	this->lostBuffersAtFetchStart = 0;
+	this->fetchedLostBuffers = 0;
+	this->bufferNrResetRequested.storeRelease(0);
+	this->lastBufferNr = 0;
+	this->lastBufferNrValid = false;
 	this->buffersToFetch = 1;
 	this->bytesPerBuffer = 0;
+	this->fetchedBytesPerSample = 0;
+	this->fetchedSamplesPerLine = 0;
 	this->fetchedBuffers = 0;
 	this->isFetching = false;
 	this->active = false;
-	this->buffersChanged = false;
+	this->fetchBufferCount = 0;
+	this->fetchBufferReady.storeRelease(0);
+	this->fetchBufferRequested.storeRelease(0);
+	this->requestedBytesPerBuffer = 0;
+	this->requestedBytesPerSample = 0;
+	this->requestedSamplesPerLine = 0;
+	this->requestedLinesPerBuffer = 0;
 	this->fetchingEnabled = false;
 	this->fetchingBackgroundEnabled = false;
 	this->startWithSpecificBufferId = false;
@@ -67,33 +93,65 @@ PhaseExtractionExtension::PhaseExtractionExtension() : Extension() {
 	//init PhaseExtractionCalculator and thread
 	this->calculator = new PhaseExtractionCalculator();
 	this->calculator->moveToThread(&extractionCalculatorThread);
+	extractionCalculatorThread.setObjectName("PhaseExtractionCalculator"); //thread names are shown in exported traces
 	connect(this->calculator, &PhaseExtractionCalculator::error, this, &PhaseExtractionExtension::error);
 	connect(this->calculator, &PhaseExtractionCalculator::info, this, &PhaseExtractionExtension::info);
 	connect(this->form, &PhaseExtractionExtensionForm::error, this, &PhaseExtractionExtension::error);
 	connect(this->form, &PhaseExtractionExtensionForm::info, this, &PhaseExtractionExtension::info);
-	connect(this->form, &PhaseExtractionExtensionForm::startAveraging, this->calculator, &PhaseExtractionCalculator::averageAndFFT);
-	connect(this->form, &PhaseExtractionExtensionForm::startAnalyzing, this->calculator, &PhaseExtractionCalculator::analyze);
-	connect(this->form, &PhaseExtractionExtensionForm::startFit, this->calculator, &PhaseExtractionCalculator::reFitResamplingCurve);
+	//averaging, analysis and fit requests go through the job scheduler, so only the latest request is calculated if the user changes parameters faster than the calculator can follow
+	this->jobScheduler = new CalculatorJobScheduler(this);
+	this->calculator->setScheduler(this->jobScheduler);
+	connect(this->form, &PhaseExtractionExtensionForm::startAveraging, this->jobScheduler, &CalculatorJobScheduler::requestAveraging);
+	connect(this->form, &PhaseExtractionExtensionForm::startAnalyzing, this->jobScheduler, &CalculatorJobScheduler::requestAnalysis);
+	connect(this->form, &PhaseExtractionExtensionForm::startFit, this->jobScheduler, &CalculatorJobScheduler::requestFit);
+	connect(this, &PhaseExtractionExtension::fetchingDone, this->jobScheduler, &CalculatorJobScheduler::cancelAll, Qt::DirectConnection);
 	connect(this->form, &PhaseExtractionExtensionForm::fitParamsChanged, this->calculator, &PhaseExtractionCalculator::setFitParams);
+	connect(this->form, &PhaseExtractionExtensionForm::refinementParamsChanged, this->calculator, &PhaseExtractionCalculator::setRefinementParams);
+	connect(this->form, &PhaseExtractionExtensionForm::fftParamsChanged, this->calculator, &PhaseExtractionCalculator::setFftParams);
+	connect(this->form, &PhaseExtractionExtensionForm::precisionChanged, this->calculator, &PhaseExtractionCalculator::setPrecision);
+	connect(this->form, &PhaseExtractionExtensionForm::startPrecisionComparison, this->calculator, &PhaseExtractionCalculator::comparePrecisions);
+	connect(this->form, &PhaseExtractionExtensionForm::startVerification, this->calculator, &PhaseExtractionCalculator::verifyCalibration);
+	connect(this->form, &PhaseExtractionExtensionForm::resamplingLutRequested, this->calculator, &PhaseExtractionCalculator::saveResamplingLut);
+	this->form->setSinglePrecisionAvailable(PhaseExtractionCalculator::isPrecisionAvailable(SINGLE_PRECISION));
 	connect(this->calculator, &PhaseExtractionCalculator::info, this->form, &PhaseExtractionExtensionForm::setFetchingStatusMessage);
-	connect(this->calculator, &PhaseExtractionCalculator::fftDataAveraged, this->form, &PhaseExtractionExtensionForm::plotAveragedData);
-	connect(this->calculator, &PhaseExtractionCalculator::phaseCalculated, this->form, &PhaseExtractionExtensionForm::plotPhase);
-	connect(this->calculator, &PhaseExtractionCalculator::analyticalSignalCalculated, this->form, &PhaseExtractionExtensionForm::plotAnalyticalSignal);
-	connect(this->calculator, &PhaseExtractionCalculator::unwrappedPhaseCalculated, this->form, &PhaseExtractionExtensionForm::plotUnwrappedPhase);
-	connect(this->calculator, &PhaseExtractionCalculator::nonLinearPhaseCalculated, this->form, &PhaseExtractionExtensionForm::plotNonLinearPhase);
-	connect(this->calculator, &PhaseExtractionCalculator::signalSelected, this->form, &PhaseExtractionExtensionForm::plotSelectedSignal);
-	connect(this->calculator, &PhaseExtractionCalculator::resamplingCurveCalculated, this->form, &PhaseExtractionExtensionForm::plotResamplingCurve);
-	connect(this->calculator, &PhaseExtractionCalculator::rawAveraged, this->form, &PhaseExtractionExtensionForm::plotRaw);
-	connect(this->calculator, &PhaseExtractionCalculator::resamplingCurveFitted, this->form, &PhaseExtractionExtensionForm::plotFittedResamplingCurve);
-	connect(this->calculator, &PhaseExtractionCalculator::fftDataRangeFound, this->form, &PhaseExtractionExtensionForm::scaleYAxsisOfAscanPlot);
-	connect(this->calculator, &PhaseExtractionCalculator::coeffsCalculated, this, &PhaseExtractionExtension::setCoeffs);
+	connect(this->calculator, &PhaseExtractionCalculator::resultReady, this->form, &PhaseExtractionExtensionForm::showResult);
+	connect(this->calculator, &PhaseExtractionCalculator::resultReady, this, &PhaseExtractionExtension::takeCoeffsFromResult);
+	connect(this->calculator, &PhaseExtractionCalculator::timingsMeasured, this->form, &PhaseExtractionExtensionForm::showTimings);
+	connect(this->form, &PhaseExtractionExtensionForm::timingEnabled, this->calculator, &PhaseExtractionCalculator::setTimingEnabled);
+	connect(this, &PhaseExtractionExtension::timingsMeasured, this->form, &PhaseExtractionExtensionForm::showTimings);
 	connect(this, &PhaseExtractionExtension::fetchingDone, this->calculator, &PhaseExtractionCalculator::setData);
 	connect(this, &PhaseExtractionExtension::fetchingBackgroundDone, this->calculator, &PhaseExtractionCalculator::getBackgroundSignal);
 	connect(&extractionCalculatorThread, &QThread::finished, this->calculator, &PhaseExtractionCalculator::deleteLater);
 	extractionCalculatorThread.start();
+
+	//init live spectrum preview and thread
+	this->previewWorker = new SpectrumPreviewWorker();
+	this->previewWorker->moveToThread(&previewThread);
+	previewThread.setObjectName("SpectrumPreview");
+	connect(this->form, &PhaseExtractionExtensionForm::paramsChanged, this->previewWorker, &SpectrumPreviewWorker::setParams);
+	connect(this->form, &PhaseExtractionExtensionForm::fftParamsChanged, this->previewWorker, &SpectrumPreviewWorker::setFftParams);
+	connect(this->previewWorker, &SpectrumPreviewWorker::spectrumCalculated, this->form, &PhaseExtractionExtensionForm::plotPreviewSpectrum);
+	connect(&previewThread, &QThread::finished, this->previewWorker, &SpectrumPreviewWorker::deleteLater);
+	previewThread.start(QThread::LowPriority);
+
+	//init drift monitor and thread
+	this->recalibrationMonitor = new RecalibrationMonitor();
+	this->recalibrationMonitor->moveToThread(&monitorThread);
+	monitorThread.setObjectName("RecalibrationMonitor");
+	connect(this->form, &PhaseExtractionExtensionForm::paramsChanged, this->recalibrationMonitor, &RecalibrationMonitor::setParams);
+	connect(this->form, &PhaseExtractionExtensionForm::fftParamsChanged, this->recalibrationMonitor, &RecalibrationMonitor::setFftParams);
+	connect(this->recalibrationMonitor, &RecalibrationMonitor::driftMeasured, this->form, &PhaseExtractionExtensionForm::showDrift);
+	connect(this->recalibrationMonitor, &RecalibrationMonitor::error, this, &PhaseExtractionExtension::error);
+	connect(this->recalibrationMonitor, &RecalibrationMonitor::info, this, &PhaseExtractionExtension::info);
+	connect(&monitorThread, &QThread::finished, this->recalibrationMonitor, &RecalibrationMonitor::deleteLater);
+	monitorThread.start(QThread::LowestPriority);
 }
 
 PhaseExtractionExtension::~PhaseExtractionExtension() {
+	monitorThread.quit();
+	monitorThread.wait();
+	previewThread.quit();
+	previewThread.wait();
 	extractionCalculatorThread.quit();
 	extractionCalculatorThread.wait();
 
@@ -112,26 +170,107 @@ QWidget* PhaseExtractionExtension::getWidget() {
 void PhaseExtractionExtension::activateExtension() {
 	//this method is called by OCTproZ as soon as user activates the extension. If the extension controls hardware components, they can be prepared, activated, initialized or started here.
 	this->active = true;
+
+	//drop and latency statistics are collected from activation on
+	this->lostBuffers.storeRelease(0);
+	this->bufferNrResetRequested.storeRelease(1);
+	this->callbackLatency.reset();
+	this->acquisitionStatusTimer.start();
 }
 
 void PhaseExtractionExtension::deactivateExtension() {
 	//this method is called by OCTproZ as soon as user deactivates the extension. If the extension controls hardware components, they can be deactivated, resetted or stopped here.
 	this->active = false;
+	this->acquisitionStatusTimer.stop();
+	this->updateAcquisitionStatus();
 }
 
 void PhaseExtractionExtension::settingsLoaded(QVariantMap settings) {
 	//this method is called by OCTproZ and provides a QVariantMap with stored settings/parameters.
 	this->form->setSettings(settings); //update gui with stored settings
+	this->form->updateParams(); //setSettings only emits paramsChanged for values that differ from the gui defaults
 }
 
 void PhaseExtractionExtension::freeBuffer() {
-	free(this->fetchedRawData);
+	if(this->session != nullptr){
+		delete this->session;
+		this->session = nullptr;
+	}else{
+		free(this->fetchedRawData);
+	}
 	this->fetchedRawData = nullptr;
+	this->fetchedDataSize = 0;
 }
 
-void PhaseExtractionExtension::resizeBuffer(int numberOfBuffers, size_t bytesPerBuffer) {
-	this->freeBuffer();
-	this->fetchedRawData = static_cast<unsigned char*>(malloc(bytesPerBuffer*numberOfBuffers));
+void PhaseExtractionExtension::releaseBufferUsers() {
+	//blocks until neither the calculator nor the preview worker access the fetched buffer anymore
+	QMetaObject::invokeMethod(this->calculator, "releaseData", Qt::BlockingQueuedConnection);
+	this->previewWorker->releaseBuffers();
+}
+
+void PhaseExtractionExtension::discardBuffer() {
+	//the calculator may still read the old buffer. Instead of waiting for its running job, the buffer is freed on the calculator thread after that job
+	this->previewWorker->releaseBuffers();
+	if(this->fetchedRawData != nullptr){
+		PhaseExtractionCalculator* calculator = this->calculator;
+		SessionFile* session = this->session;
+		unsigned char* data = session == nullptr ? this->fetchedRawData : nullptr;
+		QMetaObject::invokeMethod(calculator, [calculator, session, data]() {
+			calculator->releaseData();
+			delete session;
+			free(data);
+		}, Qt::QueuedConnection);
+	}
+	this->session = nullptr;
+	this->fetchedRawData = nullptr;
+	this->fetchedDataSize = 0;
+}
+
+void PhaseExtractionExtension::requestFetchBuffer(size_t bytesPerBuffer, size_t bytesPerSample, int samplesPerLine, int linesPerBuffer) {
+	//called from rawDataReceived. The callback does not touch the fetch buffer until allocateFetchBuffer() has run on the gui thread, so the acquisition never waits for an allocation or for the calculator
+	this->fetchBufferReady.storeRelease(0);
+	if(this->fetchBufferRequested.loadAcquire() != 0){
+		return;
+	}
+	this->requestedBytesPerBuffer = bytesPerBuffer;
+	this->requestedBytesPerSample = bytesPerSample;
+	this->requestedSamplesPerLine = samplesPerLine;
+	this->requestedLinesPerBuffer = linesPerBuffer;
+	this->fetchBufferRequested.storeRelease(1);
+	QMetaObject::invokeMethod(this, "allocateFetchBuffer", Qt::QueuedConnection);
+}
+
+void PhaseExtractionExtension::allocateFetchBuffer() {
+	if(this->fetchBufferRequested.loadAcquire() == 0){
+		return;
+	}
+	//a request that arrives after fetching was cancelled must not replace an opened session
+	if(!this->fetchingEnabled){
+		this->fetchBufferRequested.storeRelease(0);
+		return;
+	}
+	this->discardBuffer();
+	size_t size = this->requestedBytesPerBuffer*static_cast<size_t>(this->buffersToFetch);
+	this->fetchedRawData = static_cast<unsigned char*>(malloc(size));
+	if(this->fetchedRawData == nullptr){
+		this->fetchingEnabled = false;
+		this->fetchingBackgroundEnabled = false;
+		this->bytesPerBuffer = 0;
+		this->fetchBufferRequested.storeRelease(0);
+		emit error(tr("PhaseExtractionExtension: could not allocate ") + QString::number(size/(1024.0*1024.0), 'f', 0) + tr(" MB for ") + QString::number(this->buffersToFetch) + tr(" buffers. Please fetch fewer buffers."));
+		emit this->fetchingStatus(tr("Not enough memory"));
+		return;
+	}
+	this->fetchBufferCount = this->buffersToFetch;
+	this->fetchedBufferIds.fill(0, this->fetchBufferCount);
+	this->bytesPerBuffer = this->requestedBytesPerBuffer;
+	this->fetchedBytesPerSample = this->requestedBytesPerSample;
+	this->fetchedSamplesPerLine = this->requestedSamplesPerLine;
+	this->fetchedBuffers = 0;
+	this->startBufferIdFound = false;
+	this->previewWorker->setFormat(static_cast<int>(this->requestedBytesPerSample), this->requestedSamplesPerLine, this->requestedLinesPerBuffer);
+	this->fetchBufferRequested.storeRelease(0);
+	this->fetchBufferReady.storeRelease(1);
 }
 
 void PhaseExtractionExtension::setParams(PhaseExtractionExtensionParameters params) {
@@ -150,7 +289,7 @@ void PhaseExtractionExtension::storeParameters() {
 
 void PhaseExtractionExtension::setBuffersToFetch(int buffersToFetch) {
 	this->buffersToFetch = buffersToFetch;
-	this->buffersChanged = true;
+	this->fetchBufferReady.storeRelease(0); //the next fetch requests a buffer with the new size
 }
 
 void PhaseExtractionExtension::setStartBufferId(int startBufferId) {
@@ -181,22 +320,141 @@ void PhaseExtractionExtension::setCoeffs(double k0, double k1, double k2, double
 	this->form->setCoeffs(this->k0, this->k1, this->k2, this->k3);
 }
 
+void PhaseExtractionExtension::takeCoeffsFromResult(AnalysisResultPtr result) {
+	this->currentResult = result;
+	if(result->isUpdated(STAGE_FIT) && result->fitValid){
+		this->setCoeffs(result->k0, result->k1, result->k2, result->k3);
+	}
+}
+
 void PhaseExtractionExtension::transferCoeffsToOCTproZ() {
 	emit setKLinCoeffsRequest(&this->k0, &this->k1, &this->k2, &this->k3);
 }
 
+void PhaseExtractionExtension::updateAcquisitionStatus() {
+	emit acquisitionStatus(tr("Callback p50: ") + QString::number(this->callbackLatency.getPercentile(50)/1000.0, 'f', 1) + tr(" us, p99: ")
+						   + QString::number(this->callbackLatency.getPercentile(99)/1000.0, 'f', 1) + tr(" us, max: ") + QString::number(this->callbackLatency.getMax()/1000.0, 'f', 1)
+						   + tr(" us - Lost buffers: ") + (this->lostBuffersDetectable.loadAcquire() != 0 ? QString::number(this->lostBuffers.loadAcquire()) : tr("n/a (one buffer per volume)")));
+}
+
+void PhaseExtractionExtension::saveSession(QString fileName, bool compress) {
+	if(this->fetchingEnabled || this->fetchedRawData == nullptr || this->fetchedDataSize == 0){
+		emit error(tr("No fetched raw data available. Fetch buffers or open a session before saving it."));
+		return;
+	}
+	SessionInfo sessionInfo;
+	sessionInfo.bitDepth = this->fetchedBitDepth;
+	sessionInfo.bytesPerSample = static_cast<int>(this->fetchedBytesPerSample);
+	sessionInfo.samplesPerLine = this->fetchedSamplesPerLine;
+	sessionInfo.linesPerBuffer = this->fetchedLinesPerBuffer;
+	sessionInfo.numberOfBuffers = static_cast<int>(this->fetchedDataSize/this->bytesPerBuffer);
+	sessionInfo.lostBuffers = this->fetchedLostBuffers;
+	sessionInfo.callbackCount = this->callbackLatency.getCount();
+	sessionInfo.callbackP50Ns = this->callbackLatency.getPercentile(50);
+	sessionInfo.callbackP99Ns = this->callbackLatency.getPercentile(99);
+	sessionInfo.callbackMaxNs = this->callbackLatency.getMax();
+	sessionInfo.bufferIds = this->fetchedBufferIds.mid(0, sessionInfo.numberOfBuffers);
+	this->form->getSettings(&sessionInfo.settings);
+
+	QElapsedTimer timer;
+	timer.start();
+	QString errorMessage;
+	if(!SessionFile::save(fileName, this->fetchedRawData, this->fetchedDataSize, sessionInfo, this->currentResult.data(), compress, &errorMessage)){
+		emit error(errorMessage);
+		return;
+	}
+	emit info(tr("Session saved to: ") + fileName + tr(" (") + QString::number(timer.elapsed()) + tr(" ms)"));
+}
+
+void PhaseExtractionExtension::openSession(QString fileName) {
+	if(this->fetchingEnabled){
+		emit error(tr("Cancel fetching before opening a session."));
+		return;
+	}
+	QElapsedTimer timer;
+	timer.start();
+	SessionFile* openedSession = new SessionFile();
+	QString errorMessage;
+	if(!openedSession->open(fileName, &errorMessage)){
+		delete openedSession;
+		emit error(errorMessage);
+		return;
+	}
+	const SessionInfo& sessionInfo = openedSession->getInfo();
+	size_t bytesPerSample = static_cast<size_t>(sessionInfo.bytesPerSample);
+	if(sessionInfo.numberOfBuffers <= 0 || sessionInfo.samplesPerLine <= 0 || bytesPerSample == 0 || openedSession->getRawSize() % (static_cast<size_t>(sessionInfo.samplesPerLine)*bytesPerSample) != 0){
+		delete openedSession;
+		emit error(tr("Session does not contain valid raw data: ") + fileName);
+		return;
+	}
+
+	//nothing may access the previous buffer anymore before it is replaced by the session payload. Cancelling first lets a running calculator job stop at its next stage
+	this->fetchBufferReady.storeRelease(0); //next fetch allocates its own buffer instead of writing into the session
+	this->jobScheduler->cancelAll();
+	this->releaseBufferUsers();
+	this->freeBuffer();
+	this->session = openedSession;
+	this->fetchedRawData = openedSession->getRawData();
+	this->fetchedDataSize = openedSession->getRawSize();
+	this->fetchedBitDepth = sessionInfo.bitDepth;
+	this->fetchedBytesPerSample = bytesPerSample;
+	this->fetchedSamplesPerLine = sessionInfo.samplesPerLine;
+	this->fetchedLinesPerBuffer = sessionInfo.linesPerBuffer;
+	this->fetchedBufferIds = sessionInfo.bufferIds;
+	this->bytesPerBuffer = this->fetchedDataSize/static_cast<size_t>(sessionInfo.numberOfBuffers);
+	this->fetchedLostBuffers = sessionInfo.lostBuffers;
+	this->currentResult = openedSession->getResult();
+
+	if(!sessionInfo.settings.isEmpty()){
+		this->form->setSettings(sessionInfo.settings);
+	}
+	emit fetchingDone(this->fetchedRawData, this->fetchedDataSize, this->fetchedBytesPerSample, this->fetchedSamplesPerLine);
+	if(!this->currentResult.isNull()){
+		this->form->showResult(this->currentResult);
+	}
+	emit info(tr("Session opened: ") + fileName + tr(" (") + QString::number(sessionInfo.numberOfBuffers) + tr(" buffers, ") + QString::number(timer.elapsed()) + tr(" ms") + (openedSession->isMapped() ? tr(", memory mapped)") : tr(")")));
+	if(sessionInfo.callbackCount > 0){
+		emit info(tr("Session acquisition: ") + (sessionInfo.lostBuffers >= 0 ? QString::number(sessionInfo.lostBuffers) : tr("unknown number of")) + tr(" lost buffers during fetch, callback p50: ") + QString::number(sessionInfo.callbackP50Ns/1000.0, 'f', 1)
+				  + tr(" us, p99: ") + QString::number(sessionInfo.callbackP99Ns/1000.0, 'f', 1) + tr(" us, max: ") + QString::number(sessionInfo.callbackMaxNs/1000.0, 'f', 1) + tr(" us"));
+	}
+}
+
 void PhaseExtractionExtension::rawDataReceived(void* buffer, unsigned int bitDepth, unsigned int samplesPerLine, unsigned int linesPerFrame, unsigned int framesPerBuffer, unsigned int buffersPerVolume, unsigned int currentBufferNr) {
+	TraceScope trace("rawDataReceived");
 	if(this->active){
+		LatencyScope latency(&this->callbackLatency);
+
+		//buffer ids count up to buffersPerVolume-1 and start again at 0. Every skipped id is a buffer that never reached the extension
+		if(this->bufferNrResetRequested.fetchAndStoreAcquire(0) != 0){
+			this->lastBufferNrValid = false;
+		}
+		this->lostBuffersDetectable.storeRelease(buffersPerVolume > 1 ? 1 : 0);
+		if(this->lastBufferNrValid && buffersPerVolume > 1){
+			unsigned int expectedBufferNr = (this->lastBufferNr + 1) % buffersPerVolume;
+			unsigned int gap = (currentBufferNr + buffersPerVolume - expectedBufferNr) % buffersPerVolume;
+			if(gap > 0){
+				this->lostBuffers.fetchAndAddOrdered(static_cast<int>(gap));
+			}
+		}
+		this->lastBufferNr = currentBufferNr;
+		this->lastBufferNrValid = true;
+
+		//drift monitor copies a decimated subset of this buffer only if it requested one
+		if(this->recalibrationMonitor->isBufferRequested()){
+			int bytesPerSample = static_cast<int>(ceil(static_cast<double>(bitDepth) / 8.0));
+			this->recalibrationMonitor->captureBuffer(buffer, bytesPerSample, static_cast<int>(samplesPerLine), static_cast<int>(linesPerFrame*framesPerBuffer));
+		}
+
 		if(!this->isFetching && this->rawGrabbingAllowed && this->fetchingEnabled){
 			this->isFetching = true;
 
-			//resize buffers vector if necessary
+			//the fetch buffer is allocated on the gui thread. If there is none that fits the incoming buffers, this buffer is skipped and a new one is requested. Sizes are calculated in size_t, a capture of many buffers can exceed 4 GB
 			size_t bytesPerSample = static_cast<size_t>(ceil(static_cast<double>(bitDepth) / 8.0));
-			size_t bufferSizeInBytes = samplesPerLine * linesPerFrame * framesPerBuffer * bytesPerSample;
-			if(this->buffersChanged || this->bytesPerBuffer != bufferSizeInBytes) {
-				this->resizeBuffer(this->buffersToFetch, bufferSizeInBytes);
-				this->bytesPerBuffer = bufferSizeInBytes;
-				this->buffersChanged = false;
+			size_t bufferSizeInBytes = static_cast<size_t>(samplesPerLine) * linesPerFrame * framesPerBuffer * bytesPerSample;
+			if(this->fetchBufferReady.loadAcquire() == 0 || this->bytesPerBuffer != bufferSizeInBytes || this->fetchedBytesPerSample != bytesPerSample || this->fetchedSamplesPerLine != static_cast<int>(samplesPerLine)) {
+				this->requestFetchBuffer(bufferSizeInBytes, bytesPerSample, static_cast<int>(samplesPerLine), static_cast<int>(linesPerFrame*framesPerBuffer));
+				this->isFetching = false;
+				return;
 			}
 
 			//check if buffer copy should start with first buffer of volume
@@ -211,23 +469,47 @@ void PhaseExtractionExtension::rawDataReceived(void* buffer, unsigned int bitDep
 				}
 			}
 
-			//copy buffer
-			memcpy(this->fetchedRawData+(this->fetchedBuffers*bufferSizeInBytes), buffer, bufferSizeInBytes);
+			//copy buffer, the copy time of all buffers of one fetch is summed up if timing is enabled
+			if(this->fetchedBuffers == 0){
+				this->fetchTimings = StageTimings();
+				this->lostBuffersAtFetchStart = this->lostBuffers.loadAcquire();
+			}
+			unsigned char* fetchedBuffer = this->fetchedRawData + this->fetchedBuffers*bufferSizeInBytes;
+			{
+				StageTimer timer(this->params.showTimings ? &this->fetchTimings : nullptr, TIMING_COPY);
+				memcpy(fetchedBuffer, buffer, bufferSizeInBytes);
+			}
+			this->fetchedBufferIds[static_cast<int>(this->fetchedBuffers)] = currentBufferNr;
 			this->fetchedBuffers++;
 
+			//hand over copied buffer to live preview, this is a single atomic store
+			if(this->params.livePreview && (this->fetchedBuffers-1) % static_cast<size_t>(qMax(1, this->params.previewInterval)) == 0){
+				this->previewWorker->offerBuffer(fetchedBuffer);
+			}
+
 			//update fetching status message
-			emit this->fetchingStatus(tr("Fetched ") + QString::number(this->fetchedBuffers) + "/" + QString::number(this->buffersToFetch) + tr(" - Last fetched ID: ") + QString::number(currentBufferNr));
+			emit this->fetchingStatus(tr("Fetched ") + QString::number(this->fetchedBuffers) + "/" + QString::number(this->fetchBufferCount) + tr(" - Last fetched ID: ") + QString::number(currentBufferNr));
 
 			//check if enough buffers were fetched
-			if(this->fetchedBuffers >= this->buffersToFetch){
+			if(this->fetchedBuffers >= static_cast<size_t>(this->fetchBufferCount)){
 				this->fetchingEnabled = false;
 				this->startBufferIdFound = false;
 				this->fetchedBuffers = 0;
 				if(this->fetchingBackgroundEnabled){
-					emit fetchingBackgroundDone(this->fetchedRawData, bufferSizeInBytes*this->buffersToFetch, bytesPerSample, samplesPerLine);
+					this->fetchedDataSize = 0; //background data is not a capture that can be saved as session
+					emit fetchingBackgroundDone(this->fetchedRawData, bufferSizeInBytes*static_cast<size_t>(this->fetchBufferCount), bytesPerSample, samplesPerLine);
 					this->fetchingBackgroundEnabled = false;
 				} else {
-					emit fetchingDone(this->fetchedRawData, bufferSizeInBytes*this->buffersToFetch, bytesPerSample, samplesPerLine);
+					this->fetchedDataSize = bufferSizeInBytes*static_cast<size_t>(this->fetchBufferCount);
+					this->fetchedLostBuffers = this->lostBuffersDetectable.loadAcquire() != 0 ? this->lostBuffers.loadAcquire() - this->lostBuffersAtFetchStart : -1;
+					this->fetchedBitDepth = bitDepth;
+					this->fetchedLinesPerBuffer = static_cast<int>(linesPerFrame*framesPerBuffer);
+					emit fetchingDone(this->fetchedRawData, this->fetchedDataSize, bytesPerSample, samplesPerLine);
+				}
+				if(this->fetchTimings.isMeasured(TIMING_COPY)){
+					emit timingsMeasured(this->fetchTimings);
+					emit info(tr("Timings: copy of ") + QString::number(this->fetchBufferCount) + tr(" buffers ") + QString::number(this->fetchTimings.durationNs[TIMING_COPY]/1000000.0, 'f', 3)
+							  + tr(" ms (") + QString::number(this->fetchTimings.durationNs[TIMING_COPY]/1000000.0/this->fetchBufferCount, 'f', 3) + tr(" ms per buffer)"));
 				}
 			}
 			this->isFetching = false;
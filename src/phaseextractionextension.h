@@ -31,9 +31,17 @@
 
 #include <QCoreApplication>
 #include <QThread>
+#include <QTimer>
 #include "octproz_devkit.h"
 #include "phaseextractioncalculator.h"
+#include "calculatorjobscheduler.h"
+#include "spectrumpreviewworker.h"
+#include "recalibrationmonitor.h"
 #include "phaseextractionextensionform.h"
+#include "sessionfile.h"
+#include "latencyhistogram.h"
+
+#define ACQUISITION_STATUS_INTERVAL_MS 1000
 
 class PhaseExtractionExtension : public Extension
 {
@@ -62,22 +70,52 @@ private:
 	bool fetchingBackgroundEnabled;
 	bool startWithSpecificBufferId;
 	bool startBufferIdFound;
-	int lostBuffers;
+	QAtomicInt lostBuffers; //buffer id gaps since activation
+	QAtomicInt lostBuffersDetectable; //0 while the host sends only one buffer per volume, every buffer id is 0 then and gaps can not be detected
+	int lostBuffersAtFetchStart;
+	int fetchedLostBuffers; //-1 if lost buffers could not be detected
+	QAtomicInt bufferNrResetRequested; //set on activation, lastBufferNr and lastBufferNrValid are only accessed by the acquisition thread
+	unsigned int lastBufferNr;
+	bool lastBufferNrValid;
+	LatencyHistogram callbackLatency; //time spent in rawDataReceived
+	QTimer acquisitionStatusTimer;
 	int buffersToFetch;
-	int fetchedBuffers;
+	size_t fetchedBuffers;
 	size_t bytesPerBuffer;
-	bool buffersChanged;
+	size_t fetchedBytesPerSample;
+	int fetchedSamplesPerLine;
+	int fetchBufferCount; //number of buffers the fetch buffer was allocated for
+	QAtomicInt fetchBufferReady; //fetch buffer fits the incoming buffers and may be written by rawDataReceived
+	QAtomicInt fetchBufferRequested; //rawDataReceived requested a new fetch buffer, allocateFetchBuffer() is pending
+	size_t requestedBytesPerBuffer;
+	size_t requestedBytesPerSample;
+	int requestedSamplesPerLine;
+	int requestedLinesPerBuffer;
 	int startBufferId;
 	unsigned char* fetchedRawData;
+	size_t fetchedDataSize;
+	unsigned int fetchedBitDepth;
+	int fetchedLinesPerBuffer;
+	QVector<unsigned int> fetchedBufferIds;
+	SessionFile* session; //owns fetchedRawData while a session is opened
+	AnalysisResultPtr currentResult;
+	StageTimings fetchTimings;
 	double k0;
 	double k1;
 	double k2;
 	double k3;
 
 	void freeBuffer();
-	void resizeBuffer(int numberOfBuffers, size_t bytesPerBuffer);
+	void releaseBufferUsers();
+	void discardBuffer();
+	void requestFetchBuffer(size_t bytesPerBuffer, size_t bytesPerSample, int samplesPerLine, int linesPerBuffer);
 
 	PhaseExtractionCalculator* calculator;
+	CalculatorJobScheduler* jobScheduler;
+	SpectrumPreviewWorker* previewWorker;
+	QThread previewThread;
+	RecalibrationMonitor* recalibrationMonitor;
+	QThread monitorThread;
 
 
 public slots:
@@ -88,15 +126,23 @@ public slots:
 	void enableFetching(bool enable);
 	void enableFetchingBackground(bool enable);
 	void setCoeffs(double k0, double k1, double k2, double k3);
+	void takeCoeffsFromResult(AnalysisResultPtr result);
 	void transferCoeffsToOCTproZ();
+	void saveSession(QString fileName, bool compress);
+	void updateAcquisitionStatus();
+	void openSession(QString fileName);
+
+	void allocateFetchBuffer();
 
 	virtual void rawDataReceived(void* buffer, unsigned int bitDepth, unsigned int samplesPerLine, unsigned int linesPerFrame, unsigned int framesPerBuffer, unsigned int buffersPerVolume, unsigned int currentBufferNr) override;
 	virtual void processedDataReceived(void* buffer, unsigned int bitDepth, unsigned int samplesPerLine, unsigned int linesPerFrame, unsigned int framesPerBuffer, unsigned int buffersPerVolume, unsigned int currentBufferNr) override;
 
 signals:
 	void fetchingStatus(QString statusMessage);
+	void acquisitionStatus(QString statusMessage);
 	void fetchingDone(unsigned char* data, size_t size, size_t bytesPerSample, int samplesPerLine);
 	void fetchingBackgroundDone(unsigned char* data, size_t size, size_t bytesPerSample, int samplesPerLine);
+	void timingsMeasured(StageTimings timings);
 };
 
 #endif // PHASEEXTRACTIONEXTENSION_H
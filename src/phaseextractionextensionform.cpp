@@ -27,12 +27,16 @@
 
 #include "phaseextractionextensionform.h"
 #include "ui_phaseextractionextensionform.h"
+#include "npyarchive.h"
+#include <QFile>
+#include <QTextStream>
 
 PhaseExtractionExtensionForm::PhaseExtractionExtensionForm(QWidget *parent) :
 	QWidget(parent),
 	ui(new Ui::PhaseExtractionExtensionForm)
 {
 	qRegisterMetaType<PhaseExtractionExtensionParameters >("PhaseExtractionExtensionParameters");
+	qRegisterMetaType<StageTimings>("StageTimings");
 	this->ui->setupUi(this);
 	this->findGuiElements();
 	this->connectGuiElementsToUpdateParams();
@@ -45,7 +49,14 @@ PhaseExtractionExtensionForm::PhaseExtractionExtensionForm(QWidget *parent) :
 	connect(this->ui->pushButton_analyze, &QPushButton::clicked, this, &PhaseExtractionExtensionForm::analyze);
 	connect(this->ui->pushButton_transferCoeffs, &QPushButton::clicked, this, &PhaseExtractionExtensionForm::transferCoeffs);
 	connect(this->ui->pushButton_saveRawResamplingCurve, &QPushButton::clicked, this, &PhaseExtractionExtensionForm::saveResamplingCurve);
+	connect(this->ui->pushButton_saveResamplingLut, &QPushButton::clicked, this, &PhaseExtractionExtensionForm::saveResamplingLut);
+	connect(this->ui->pushButton_saveAllStages, &QPushButton::clicked, this, &PhaseExtractionExtensionForm::saveAllStages);
+	connect(this->ui->pushButton_saveSession, &QPushButton::clicked, this, &PhaseExtractionExtensionForm::saveSession);
+	connect(this->ui->pushButton_openSession, &QPushButton::clicked, this, &PhaseExtractionExtensionForm::openSession);
 	connect(this->ui->pushButton_fit, &QPushButton::clicked, this, &PhaseExtractionExtensionForm::fit);
+	connect(this->ui->pushButton_comparePrecisions, &QPushButton::clicked, this, &PhaseExtractionExtensionForm::comparePrecisions);
+	connect(this->ui->pushButton_verify, &QPushButton::clicked, this, &PhaseExtractionExtensionForm::verify);
+	connect(this->ui->comboBox_precision, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this, &PhaseExtractionExtensionForm::precisionChanged);
 
 
 	//init group boxes
@@ -79,6 +90,28 @@ PhaseExtractionExtensionForm::PhaseExtractionExtensionForm(QWidget *parent) :
 		emit fitParamsChanged(this->ui->spinBox_ignoreStart->value(), this->ui->spinBox_ignoreEnd->value());
 	});
 
+	//iterative refinement
+	connect(this->ui->spinBox_refinementIterations, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), this, [this]() {
+		emit refinementParamsChanged(this->ui->spinBox_refinementIterations->value(), this->ui->doubleSpinBox_refinementTolerance->value());
+	});
+	connect(this->ui->doubleSpinBox_refinementTolerance, static_cast<void (QDoubleSpinBox::*)(double)>(&QDoubleSpinBox::valueChanged), this, [this]() {
+		emit refinementParamsChanged(this->ui->spinBox_refinementIterations->value(), this->ui->doubleSpinBox_refinementTolerance->value());
+	});
+
+	//fft length, upsampling and threading
+	connect(this->ui->checkBox_padFft, &QCheckBox::stateChanged, this, &PhaseExtractionExtensionForm::emitFftParams);
+	connect(this->ui->spinBox_upsampling, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), this, &PhaseExtractionExtensionForm::emitFftParams);
+	connect(this->ui->checkBox_multithreadedFft, &QCheckBox::stateChanged, this, &PhaseExtractionExtensionForm::emitFftParams);
+
+	//optional stage timings, every plot reports its replot duration
+	connect(this->ui->checkBox_showTimings, &QCheckBox::toggled, this, &PhaseExtractionExtensionForm::enableTimings);
+	connect(this->ui->checkBox_trace, &QCheckBox::toggled, this, &PhaseExtractionExtensionForm::enableTrace);
+	connect(this->ui->pushButton_saveTrace, &QPushButton::clicked, this, &PhaseExtractionExtensionForm::saveTrace);
+	foreach(MiniCurvePlot* plot, this->findChildren<MiniCurvePlot*>()){
+		connect(plot, &MiniCurvePlot::replotTimed, this, &PhaseExtractionExtensionForm::showReplotTiming);
+	}
+	this->ui->label_timings->setVisible(false);
+
 	//default values
 	this->ui->radioButton_select->setChecked(true);
 }
@@ -99,6 +132,23 @@ void PhaseExtractionExtensionForm::setSettings(QVariantMap settings) {
 	this->ui->spinBox_endAscanPeak->setValue(settings.value(PEAK_END).toInt());
 	this->ui->spinBox_ignoreStart->setValue(settings.value(IGNORE_START).toInt());
 	this->ui->spinBox_ignoreEnd->setValue(settings.value(IGNORE_END).toInt());
+	this->ui->checkBox_padFft->setChecked(settings.value(PAD_FFT).toBool());
+	this->ui->spinBox_upsampling->setValue(settings.value(UPSAMPLING_FACTOR, 1).toInt());
+	this->ui->checkBox_multithreadedFft->setChecked(settings.value(MULTITHREADED_FFT).toBool());
+	if(this->ui->comboBox_precision->isEnabled()){
+		this->ui->comboBox_precision->setCurrentIndex(settings.value(CALCULATION_PRECISION).toInt());
+	}
+	this->ui->checkBox_livePreview->setChecked(settings.value(LIVE_PREVIEW).toBool());
+	this->ui->spinBox_previewInterval->setValue(settings.value(PREVIEW_INTERVAL, 1).toInt());
+	this->ui->checkBox_windowSelectedPeak->setChecked(settings.value(WINDOW_PEAK, this->ui->checkBox_windowSelectedPeak->isChecked()).toBool());
+	this->ui->spinBox_driftInterval->setValue(settings.value(DRIFT_INTERVAL, 30).toInt());
+	this->ui->doubleSpinBox_driftThreshold->setValue(settings.value(DRIFT_THRESHOLD, 0.5).toDouble());
+	this->ui->comboBox_interpolation->setCurrentIndex(settings.value(VERIFICATION_INTERPOLATION).toInt());
+	this->ui->spinBox_refinementIterations->setValue(settings.value(REFINEMENT_ITERATIONS).toInt());
+	this->ui->doubleSpinBox_refinementTolerance->setValue(settings.value(REFINEMENT_TOLERANCE, 0.001).toDouble());
+	this->ui->checkBox_lutHalfPrecision->setChecked(settings.value(LUT_HALF_PRECISION).toBool());
+	this->ui->checkBox_compressSession->setChecked(settings.value(COMPRESS_SESSION).toBool());
+	this->ui->checkBox_showTimings->setChecked(settings.value(SHOW_TIMINGS).toBool());
 }
 
 void PhaseExtractionExtensionForm::getSettings(QVariantMap* settings) {
@@ -112,6 +162,30 @@ void PhaseExtractionExtensionForm::getSettings(QVariantMap* settings) {
 	settings->insert(PEAK_END, this->parameters.endPos);
 	settings->insert(IGNORE_START, this->parameters.ignoreStart);
 	settings->insert(IGNORE_END, this->parameters.ignoreEnd);
+	settings->insert(PAD_FFT, this->parameters.padToSmoothSize);
+	settings->insert(UPSAMPLING_FACTOR, this->parameters.upsamplingFactor);
+	settings->insert(MULTITHREADED_FFT, this->parameters.multithreadedFft);
+	settings->insert(CALCULATION_PRECISION, this->parameters.precision);
+	settings->insert(LIVE_PREVIEW, this->parameters.livePreview);
+	settings->insert(PREVIEW_INTERVAL, this->parameters.previewInterval);
+	settings->insert(WINDOW_PEAK, this->parameters.windowPeak);
+	settings->insert(DRIFT_INTERVAL, this->parameters.driftInterval);
+	settings->insert(DRIFT_THRESHOLD, this->parameters.driftThreshold);
+	settings->insert(VERIFICATION_INTERPOLATION, this->parameters.verificationInterpolation);
+	settings->insert(REFINEMENT_ITERATIONS, this->parameters.refinementIterations);
+	settings->insert(REFINEMENT_TOLERANCE, this->parameters.refinementTolerance);
+	settings->insert(LUT_HALF_PRECISION, this->parameters.lutHalfPrecision);
+	settings->insert(COMPRESS_SESSION, this->parameters.compressSession);
+	settings->insert(SHOW_TIMINGS, this->parameters.showTimings);
+}
+
+void PhaseExtractionExtensionForm::setSinglePrecisionAvailable(bool available) {
+	//combo box entries are in the same order as CalculationPrecision
+	if(!available){
+		this->ui->comboBox_precision->setCurrentIndex(0);
+	}
+	this->ui->comboBox_precision->setEnabled(available);
+	this->ui->pushButton_comparePrecisions->setEnabled(available);
 }
 
 void PhaseExtractionExtensionForm::updateParams() {
@@ -125,6 +199,22 @@ void PhaseExtractionExtensionForm::updateParams() {
 	this->parameters.endPos = this->ui->spinBox_endAscanPeak->value();
 	this->parameters.ignoreStart = this->ui->spinBox_ignoreStart->value();
 	this->parameters.ignoreEnd = this->ui->spinBox_ignoreEnd->value();
+	this->parameters.padToSmoothSize = this->ui->checkBox_padFft->isChecked();
+	this->parameters.upsamplingFactor = this->ui->spinBox_upsampling->value();
+	this->parameters.multithreadedFft = this->ui->checkBox_multithreadedFft->isChecked();
+	this->parameters.precision = this->ui->comboBox_precision->currentIndex();
+	this->parameters.livePreview = this->ui->checkBox_livePreview->isChecked();
+	this->parameters.previewInterval = this->ui->spinBox_previewInterval->value();
+	this->parameters.windowPeak = this->ui->checkBox_windowSelectedPeak->isChecked();
+	this->parameters.driftMonitor = this->ui->checkBox_driftMonitor->isChecked();
+	this->parameters.driftInterval = this->ui->spinBox_driftInterval->value();
+	this->parameters.driftThreshold = this->ui->doubleSpinBox_driftThreshold->value();
+	this->parameters.verificationInterpolation = this->ui->comboBox_interpolation->currentIndex();
+	this->parameters.refinementIterations = this->ui->spinBox_refinementIterations->value();
+	this->parameters.refinementTolerance = this->ui->doubleSpinBox_refinementTolerance->value();
+	this->parameters.lutHalfPrecision = this->ui->checkBox_lutHalfPrecision->isChecked();
+	this->parameters.compressSession = this->ui->checkBox_compressSession->isChecked();
+	this->parameters.showTimings = this->ui->checkBox_showTimings->isChecked();
 	emit paramsChanged(this->parameters);
 }
 
@@ -132,6 +222,10 @@ void PhaseExtractionExtensionForm::setFetchingStatusMessage(QString message) {
 	this->ui->label_status->setText(message);
 }
 
+void PhaseExtractionExtensionForm::setAcquisitionStatusMessage(QString message) {
+	this->ui->label_acquisitionStatus->setText(message);
+}
+
 void PhaseExtractionExtensionForm::startFetching() {
 	this->clearPlots();
 	this->setFetchingStatusMessage(tr("Fetching started."));
@@ -151,12 +245,8 @@ void PhaseExtractionExtensionForm::cancelFetching() {
 
 void PhaseExtractionExtensionForm::average() {
 	this->clearPlots();
-	int firstLine = qAbs(qMin(this->ui->spinBox_startAscanAveraging->value(), this->ui->spinBox_endAscanAveraging->value()));
-	int lastLine = qAbs(qMax(this->ui->spinBox_startAscanAveraging->value(), this->ui->spinBox_endAscanAveraging->value()));
-	if(this->ui->radioButton_all->isChecked()){
-		firstLine = -1;
-		lastLine = -1;
-	}
+	int firstLine, lastLine;
+	this->getSelectedLines(&firstLine, &lastLine);
 	bool windowRaw = this->ui->checkBox_windowRaw->isChecked();
 	//bool useBackground = this->ui->checkBox_background->isChecked(); //todo: carefully check if using background signal is really not necessary and then clean up the code
 	bool useBackground = false;
@@ -164,8 +254,8 @@ void PhaseExtractionExtensionForm::average() {
 }
 
 void PhaseExtractionExtensionForm::analyze() {
-	int startPos = qAbs(qMin(this->ui->spinBox_startAscanPeak->value(), this->ui->spinBox_endAscanPeak->value()));
-	int endPos = qAbs(qMax(this->ui->spinBox_startAscanPeak->value(), this->ui->spinBox_endAscanPeak->value()));
+	int startPos, endPos;
+	this->getSelectedPeak(&startPos, &endPos);
 	bool windowPeak = this->ui->checkBox_windowSelectedPeak->isChecked();
 	emit startAnalyzing(startPos, endPos, windowPeak);
 }
@@ -176,47 +266,123 @@ void PhaseExtractionExtensionForm::fit() {
 	emit startFit(ignoreStart, ignoreEnd);
 }
 
-void PhaseExtractionExtensionForm::plotAveragedData(QVector<qreal> data) {
-	this->ui->groupBox_3->setEnabled(true);
-	this->ui->groupBox_5->setEnabled(true);
-	this->ui->widget_PeakSelectPlot->plotCurves(data.data(), nullptr, data.size());
+void PhaseExtractionExtensionForm::comparePrecisions() {
+	int firstLine, lastLine, startPos, endPos;
+	this->getSelectedLines(&firstLine, &lastLine);
+	this->getSelectedPeak(&startPos, &endPos);
+	emit startPrecisionComparison(firstLine, lastLine, this->ui->checkBox_windowRaw->isChecked(), startPos, endPos, this->ui->checkBox_windowSelectedPeak->isChecked());
 }
 
-void PhaseExtractionExtensionForm::scaleYAxsisOfAscanPlot(qreal min, qreal max) {
-	this->ui->widget_PeakSelectPlot->scaleYAxis(min, max);
+void PhaseExtractionExtensionForm::verify() {
+	int firstLine, lastLine, startPos, endPos;
+	this->getSelectedLines(&firstLine, &lastLine);
+	this->getSelectedPeak(&startPos, &endPos);
+	this->ui->label_verification->setText(tr("Verifying..."));
+	emit startVerification(firstLine, lastLine, startPos, endPos, this->ui->comboBox_interpolation->currentIndex());
 }
 
-void PhaseExtractionExtensionForm::plotSelectedSignal(QVector<qreal> data) {
-	this->ui->widget_selectedSignalPlot->plotCurves(data.data(), nullptr, data.size());
+void PhaseExtractionExtensionForm::showResult(AnalysisResultPtr result) {
+	TraceScope trace("showResult");
+	Tracer::flowEnd("resultReady", result->runId);
+	//only plots of stages that were updated by this calculator run are redrawn. The snapshot is kept for export
+	this->currentResult = result;
+	if(result->isUpdated(STAGE_AVERAGE)){
+		this->ui->widget_rawSignalPlot->plotCurves<qreal>(result->averagedRaw.constData(), nullptr, result->averagedRaw.size());
+	}
+	if(result->isUpdated(STAGE_FFT)){
+		this->ui->groupBox_3->setEnabled(true);
+		this->ui->groupBox_5->setEnabled(true);
+		this->ui->widget_PeakSelectPlot->plotCurves<qreal>(result->spectrum.constData(), nullptr, result->spectrum.size());
+		if(result->spectrum.size() > 10){
+			this->ui->widget_PeakSelectPlot->scaleYAxis(result->spectrumMinAfterDC, result->spectrumMaxAfterDC);
+		}
+	}
+	if(result->isUpdated(STAGE_BAND)){
+		this->ui->widget_selectedSignalPlot->plotCurves<qreal>(result->selectedSignal.constData(), nullptr, result->selectedSignal.size());
+		this->ui->widget_analyticalSignalPlot->plotCurves(result->analyticalSignalReal.constData(), result->analyticalSignalImag.constData(), result->analyticalSignalReal.size());
+	}
+	if(result->isUpdated(STAGE_PHASE)){
+		this->ui->widget_unwrappedPhasePlot->plotCurves<qreal>(result->nonLinearPhase.constData(), nullptr, result->nonLinearPhase.size());
+	}
+	if(result->isUpdated(STAGE_CURVE)){
+		this->ui->groupBox_4->setEnabled(true);
+		this->ui->widget_resultPlot->plotCurves<qreal>(result->resamplingCurve.constData(), nullptr, result->resamplingCurve.size());
+	}
+	if(result->isUpdated(STAGE_FIT) && result->fitValid){
+		this->ui->widget_resultPlot->plotCurves<float>(nullptr, result->fittedResamplingCurve.constData(), result->fittedResamplingCurve.size());
+	}
+	if(result->isUpdated(STAGE_FIT) && !result->verification.valid){
+		this->ui->label_verification->clear();
+	}
+	if(result->isUpdated(STAGE_VERIFICATION) && result->verification.valid){
+		const VerificationResult& verification = result->verification;
+		this->ui->label_verification->setText((verification.accepted ? tr("Accepted. ") : tr("Rejected. "))
+				+ tr("FWHM: ") + QString::number(verification.beforeLinearization.fwhm, 'f', 2) + tr(" uncorrected, ")
+				+ QString::number(verification.rawCurve.fwhm, 'f', 2) + tr(" raw, ")
+				+ QString::number(verification.fittedCurve.fwhm, 'f', 2) + tr(" fitted. Side lobes: ")
+				+ QString::number(verification.fittedCurve.sideLobeLevel, 'f', 1) + tr(" dB"));
+	}
 }
 
-void PhaseExtractionExtensionForm::plotAnalyticalSignal(QVector<qreal> dataReal, QVector<qreal> dataImag) {
-	this->ui->widget_analyticalSignalPlot->plotCurves(dataReal.data(), dataImag.data(), dataReal.size());
+void PhaseExtractionExtensionForm::plotPreviewSpectrum(QVector<qreal> spectrum, qreal min, qreal max) {
+	TraceScope trace("plotPreviewSpectrum");
+	//preview is shown in the peak selection plot while buffers are fetched, the plot itself limits the refresh rate
+	this->ui->widget_PeakSelectPlot->plotCurves<qreal>(spectrum.constData(), nullptr, spectrum.size());
+	if(spectrum.size() > 10){
+		this->ui->widget_PeakSelectPlot->scaleYAxis(min, max);
+	}
 }
 
-void PhaseExtractionExtensionForm::plotUnwrappedPhase(QVector<qreal> data) {
-	this->ui->widget_unwrappedPhasePlot->plotCurves(data.data(), nullptr, data.size());
+void PhaseExtractionExtensionForm::showDrift(DriftSample sample) {
+	this->ui->label_driftStatus->setText(tr("Drift: ") + QString::number(sample.drift, 'f', 3) + tr(" samples, nonlinear phase rms: ") + QString::number(sample.nonLinearPhaseRms, 'f', 3) + tr(" rad"));
 }
 
-void PhaseExtractionExtensionForm::plotNonLinearPhase(QVector<qreal> data) {
-	this->ui->widget_unwrappedPhasePlot->plotCurves(data.data(), nullptr, data.size());
+void PhaseExtractionExtensionForm::showTimings(StageTimings timings) {
+	//records of the calculator and of the buffer copy only contain their own stages, they are merged into one panel
+	this->displayedTimings.merge(timings);
+	this->ui->label_timings->setText(this->displayedTimings.toString());
 }
 
-void PhaseExtractionExtensionForm::plotPhase(QVector<qreal> phase) {
-	this->ui->widget_resultPlot->plotCurves(phase.data(), nullptr, phase.size());
+void PhaseExtractionExtensionForm::showReplotTiming(qint64 ns) {
+	StageTimings timings;
+	timings.add(TIMING_REPLOT, ns);
+	this->showTimings(timings);
 }
 
-void PhaseExtractionExtensionForm::plotFittedResamplingCurve(float* data, int size) {
-	this->ui->widget_resultPlot->plotCurves(nullptr, data, size);
+void PhaseExtractionExtensionForm::enableTimings(bool enable) {
+	this->displayedTimings = StageTimings();
+	this->ui->label_timings->clear();
+	this->ui->label_timings->setVisible(enable);
+	foreach(MiniCurvePlot* plot, this->findChildren<MiniCurvePlot*>()){
+		plot->setTimingEnabled(enable);
+	}
+	emit timingEnabled(enable);
 }
 
-void PhaseExtractionExtensionForm::plotResamplingCurve(QVector<qreal> data) {
-	this->ui->groupBox_4->setEnabled(true);
-	this->ui->widget_resultPlot->plotCurves(data.data(), nullptr, data.size());
+void PhaseExtractionExtensionForm::enableTrace(bool enable) {
+	//enabling starts a new trace, events recorded so far are discarded
+	Tracer::setEnabled(enable);
 }
 
-void PhaseExtractionExtensionForm::plotRaw(QVector<qreal> data) {
-	this->ui->widget_rawSignalPlot->plotCurves(data.data(), nullptr, data.size());
+void PhaseExtractionExtensionForm::saveTrace() {
+	QString fileName = "";
+
+#if defined(Q_OS_WIN)
+	QString filters("Chrome trace (*.json)");
+	QString defaultFilter("Chrome trace (*.json)");
+	fileName = QFileDialog::getSaveFileName(this, tr("Save Trace"), QDir::currentPath(), filters, &defaultFilter);
+#elif defined(Q_OS_LINUX)
+	//same workaround as in saveResamplingCurve
+	fileName = QStandardPaths::writableLocation(QStandardPaths::DesktopLocation) + "/" + "phaseextraction_trace.json";
+#endif
+
+	int numberOfEvents = 0;
+	if(!fileName.isEmpty() && Tracer::save(fileName, &numberOfEvents)){
+		emit info(tr("Trace with ") + QString::number(numberOfEvents) + tr(" events saved to: ") + fileName
+				  + (Tracer::getDroppedEvents() > 0 ? tr(" (") + QString::number(Tracer::getDroppedEvents()) + tr(" events of threads without trace buffer dropped)") : QString()));
+	}else{
+		emit error(tr("Could not save trace to: ") + fileName + tr(". Enable tracing first."));
+	}
 }
 
 void PhaseExtractionExtensionForm::setCoeffs(double k0, double k1, double k2, double k3) {
@@ -238,7 +404,21 @@ void PhaseExtractionExtensionForm::saveResamplingCurve() {
 	fileName = QStandardPaths::writableLocation(QStandardPaths::DesktopLocation) + "/" + "resamplingcurve.csv";
 #endif
 
-	bool saved = this->ui->widget_resultPlot->saveCurveDataToFile(fileName);
+	//export the raw resampling curve of the latest published result
+	bool saved = false;
+	if(!this->currentResult.isNull() && !this->currentResult->resamplingCurve.isEmpty()){
+		QFile file(fileName);
+		if(file.open(QFile::WriteOnly|QFile::Truncate)){
+			QTextStream stream(&file);
+			const QVector<qreal>& curve = this->currentResult->resamplingCurve;
+			stream << "Sample Number" << ";" << "Sample Value" << "\n";
+			for(int i = 0; i < curve.size(); i++){
+				stream << QString::number(i) << ";" << QString::number(curve.at(i)) << "\n";
+			}
+			file.close();
+			saved = true;
+		}
+	}
 	if(saved){
 		emit info(tr("File saved to: ") + fileName);
 	}else{
@@ -246,6 +426,85 @@ void PhaseExtractionExtensionForm::saveResamplingCurve() {
 	}
 }
 
+void PhaseExtractionExtensionForm::saveAllStages() {
+	QString fileName = "";
+
+#if defined(Q_OS_WIN)
+	QString filters("NumPy archive (*.npz)");
+	QString defaultFilter("NumPy archive (*.npz)");
+	fileName = QFileDialog::getSaveFileName(this, tr("Save All Stages"), QDir::currentPath(), filters, &defaultFilter);
+#elif defined(Q_OS_LINUX)
+	//same workaround as in saveResamplingCurve
+	fileName = QStandardPaths::writableLocation(QStandardPaths::DesktopLocation) + "/" + "phaseextraction.npz";
+#endif
+
+	//all stages of the latest published result are written at once, the snapshot does not change while it is written
+	bool saved = false;
+	if(!this->currentResult.isNull() && !fileName.isEmpty()){
+		NpyArchive archive;
+		archive.addAnalysisResult(*this->currentResult);
+		saved = archive.save(fileName);
+	}
+	if(saved){
+		emit info(tr("File saved to: ") + fileName);
+	}else{
+		emit error(tr("Could not save file to: ") + fileName);
+	}
+}
+
+void PhaseExtractionExtensionForm::saveResamplingLut() {
+	QString fileName = "";
+
+#if defined(Q_OS_WIN)
+	QString filters("Resampling LUT (*.bin)");
+	QString defaultFilter("Resampling LUT (*.bin)");
+	fileName = QFileDialog::getSaveFileName(this, tr("Save Resampling LUT"), QDir::currentPath(), filters, &defaultFilter);
+#elif defined(Q_OS_LINUX)
+	//same workaround as in saveResamplingCurve
+	fileName = QStandardPaths::writableLocation(QStandardPaths::DesktopLocation) + "/" + "resamplinglut.bin";
+#endif
+
+	if(fileName.isEmpty()){
+		return;
+	}
+	//the LUT is generated by the calculator from the fitted curve, which also runs the benchmark on the fetched buffers
+	emit resamplingLutRequested(fileName, this->ui->comboBox_interpolation->currentIndex(), this->ui->checkBox_lutHalfPrecision->isChecked());
+}
+
+void PhaseExtractionExtensionForm::saveSession() {
+	QString fileName = "";
+
+#if defined(Q_OS_WIN)
+	QString filters("Session (*.session)");
+	QString defaultFilter("Session (*.session)");
+	fileName = QFileDialog::getSaveFileName(this, tr("Save Session"), QDir::currentPath(), filters, &defaultFilter);
+#elif defined(Q_OS_LINUX)
+	//same workaround as in saveResamplingCurve
+	fileName = QStandardPaths::writableLocation(QStandardPaths::DesktopLocation) + "/" + "phaseextraction.session";
+#endif
+
+	if(!fileName.isEmpty()){
+		emit sessionSaveRequested(fileName, this->ui->checkBox_compressSession->isChecked());
+	}
+}
+
+void PhaseExtractionExtensionForm::openSession() {
+	QString fileName = "";
+
+#if defined(Q_OS_WIN)
+	QString filters("Session (*.session)");
+	QString defaultFilter("Session (*.session)");
+	fileName = QFileDialog::getOpenFileName(this, tr("Open Session"), QDir::currentPath(), filters, &defaultFilter);
+#elif defined(Q_OS_LINUX)
+	//same workaround as in saveResamplingCurve, the session saved last is opened
+	fileName = QStandardPaths::writableLocation(QStandardPaths::DesktopLocation) + "/" + "phaseextraction.session";
+#endif
+
+	if(!fileName.isEmpty()){
+		emit sessionOpenRequested(fileName);
+	}
+}
+
 void PhaseExtractionExtensionForm::enableAveragingGroupBox() {
 	this->ui->groupBox_2->setEnabled(true);
 }
@@ -277,6 +536,21 @@ void PhaseExtractionExtensionForm::connectGuiElementsToUpdateParams() {
 	}
 }
 
+void PhaseExtractionExtensionForm::getSelectedLines(int* firstLine, int* lastLine) {
+	//-1 for both lines selects all lines of the fetched buffers
+	*firstLine = qAbs(qMin(this->ui->spinBox_startAscanAveraging->value(), this->ui->spinBox_endAscanAveraging->value()));
+	*lastLine = qAbs(qMax(this->ui->spinBox_startAscanAveraging->value(), this->ui->spinBox_endAscanAveraging->value()));
+	if(this->ui->radioButton_all->isChecked()){
+		*firstLine = -1;
+		*lastLine = -1;
+	}
+}
+
+void PhaseExtractionExtensionForm::getSelectedPeak(int* startPos, int* endPos) {
+	*startPos = qAbs(qMin(this->ui->spinBox_startAscanPeak->value(), this->ui->spinBox_endAscanPeak->value()));
+	*endPos = qAbs(qMax(this->ui->spinBox_startAscanPeak->value(), this->ui->spinBox_endAscanPeak->value()));
+}
+
 void PhaseExtractionExtensionForm::clearPlots() {
 	this->ui->widget_analyticalSignalPlot->clearPlot();
 	this->ui->widget_PeakSelectPlot->clearPlot();
@@ -285,3 +559,7 @@ void PhaseExtractionExtensionForm::clearPlots() {
 	this->ui->widget_selectedSignalPlot->clearPlot();
 	this->ui->widget_unwrappedPhasePlot->clearPlot();
 }
+
+void PhaseExtractionExtensionForm::emitFftParams() {
+	emit fftParamsChanged(this->ui->checkBox_padFft->isChecked(), this->ui->spinBox_upsampling->value(), this->ui->checkBox_multithreadedFft->isChecked());
+}
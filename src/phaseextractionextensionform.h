@@ -28,16 +28,6 @@
 #ifndef PHASEEXTRACTIONEXTENSIONFORM_H
 #define PHASEEXTRACTIONEXTENSIONFORM_H
 
-#define START_WITH_FIRST_BUFFER "start_with_first_buffer"
-#define BUFFERS_TO_FETCH "buffer_to_fetch"
-#define SELECT_ALL_ASCANS "select_all_ascans"
-#define WINDOW_RAW "window_raw_data"
-#define FIRST_ASCAN "first_ascan"
-#define LAST_ASCAN "last_ascan"
-#define PEAK_START "peak_start"
-#define PEAK_END "peak_end"
-#define IGNORE_START "ignore_start"
-#define IGNORE_END "ignore_end"
 
 #include <QWidget>
 #include <QCheckBox>
@@ -45,6 +35,9 @@
 #include <QSpinBox>
 #include <QComboBox>
 #include <QRadioButton>
+#include "analysisresult.h"
+#include "stagetimings.h"
+#include "extensionparameters.h"
 
 
 
@@ -52,18 +45,6 @@ namespace Ui {
 class PhaseExtractionExtensionForm;
 }
 
-struct PhaseExtractionExtensionParameters {
-	bool startWithFirstBuffer;
-	int buffersToFetch;
-	bool useAllAscans;
-	bool windowRaw;
-	int firstLine;
-	int lastLine;
-	int startPos;
-	int endPos;
-	int ignoreStart;
-	int ignoreEnd;
-};
 
 class PhaseExtractionExtensionForm : public QWidget
 {
@@ -75,6 +56,7 @@ public:
 
 	void setSettings(QVariantMap settings);
 	void getSettings(QVariantMap* settings);
+	void setSinglePrecisionAvailable(bool available);
 
 	Ui::PhaseExtractionExtensionForm* ui;
 
@@ -82,24 +64,29 @@ public:
 public slots:
 	void updateParams();
 	void setFetchingStatusMessage(QString message);
+	void setAcquisitionStatusMessage(QString message);
 	void startFetching();
 	void startBackgroundFetching();
 	void cancelFetching();
 	void average();
 	void analyze();
 	void fit();
-	void plotAveragedData(QVector<qreal> data);
-	void scaleYAxsisOfAscanPlot(qreal min, qreal max);
-	void plotPhase(QVector<qreal> phase);
-	void plotSelectedSignal(QVector<qreal> data);
-	void plotAnalyticalSignal(QVector<qreal> dataReal, QVector<qreal> dataImag);
-	void plotUnwrappedPhase(QVector<qreal> data);
-	void plotResamplingCurve(QVector<qreal> data);
-	void plotNonLinearPhase(QVector<qreal> data);
-	void plotFittedResamplingCurve(float* data, int size);
-	void plotRaw(QVector<qreal> data);
+	void comparePrecisions();
+	void verify();
+	void showResult(AnalysisResultPtr result);
+	void plotPreviewSpectrum(QVector<qreal> spectrum, qreal min, qreal max);
+	void showDrift(DriftSample sample);
+	void showTimings(StageTimings timings);
+	void showReplotTiming(qint64 ns);
+	void enableTimings(bool enable);
+	void enableTrace(bool enable);
+	void saveTrace();
 	void setCoeffs(double k0, double k1, double k2, double k3);
 	void saveResamplingCurve();
+	void saveResamplingLut();
+	void saveAllStages();
+	void saveSession();
+	void openSession();
 	void enableAveragingGroupBox();
 
 
@@ -107,8 +94,13 @@ private:
 	void findGuiElements();
 	void connectGuiElementsToUpdateParams();
 	void clearPlots();
+	void getSelectedLines(int* firstLine, int* lastLine);
+	void getSelectedPeak(int* startPos, int* endPos);
+	void emitFftParams();
 
 	PhaseExtractionExtensionParameters parameters;
+	AnalysisResultPtr currentResult;
+	StageTimings displayedTimings;
 	QList<QCheckBox*> checkBoxes;
 	QList<QDoubleSpinBox*> doubleSpinBoxes;
 	QList<QSpinBox*> spinBoxes;
@@ -124,7 +116,16 @@ signals:
 	void startAnalyzing(int startPos, int endPos, bool windowPeak);
 	void startFit(int startIgnore, int endIgnore);
 	void fitParamsChanged(int startIgnore, int endIgnore);
+	void refinementParamsChanged(int maxIterations, double tolerance);
+	void fftParamsChanged(bool padToSmoothSize, int upsamplingFactor, bool multithreadedFft);
+	void precisionChanged(int precision);
+	void startPrecisionComparison(int firstLine, int lastLine, bool windowRaw, int startPos, int endPos, bool windowPeak);
+	void startVerification(int firstLine, int lastLine, int startPos, int endPos, int interpolationMethod);
 	void transferCoeffs();
+	void resamplingLutRequested(QString fileName, int interpolationMethod, bool halfPrecision);
+	void sessionSaveRequested(QString fileName, bool compress);
+	void sessionOpenRequested(QString fileName);
+	void timingEnabled(bool enabled);
 	void error(QString);
 	void info(QString);
 
@@ -0,0 +1,70 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#include "pipelinestagecache.h"
+
+
+PipelineStageCache::PipelineStageCache() {
+	this->invalidateAll();
+}
+
+bool PipelineStageCache::isValid(PipelineStage stage, quint64 key) {
+	return this->valid[stage] && this->keys[stage] == key;
+}
+
+void PipelineStageCache::store(PipelineStage stage, quint64 key) {
+	this->keys[stage] = key;
+	this->valid[stage] = true;
+	if(stage+1 < NUMBER_OF_STAGES){
+		this->invalidate(static_cast<PipelineStage>(stage+1));
+	}
+}
+
+void PipelineStageCache::invalidate(PipelineStage stage) {
+	//stages form a chain (average -> fft -> band -> phase -> curve -> fit -> verification), so everything after the given stage is invalidated as well
+	for(int i = stage; i < NUMBER_OF_STAGES; i++){
+		this->valid[i] = false;
+		this->keys[i] = 0;
+	}
+}
+
+void PipelineStageCache::invalidateAll() {
+	this->invalidate(STAGE_AVERAGE);
+}
+
+quint64 PipelineStageCache::getUpstreamKey(PipelineStage stage) {
+	return stage == STAGE_AVERAGE ? 0 : this->keys[stage-1];
+}
+
+quint64 PipelineStageCache::combine(quint64 seed, quint64 value) {
+	//64 bit variant of boost::hash_combine with an additional finalizer step from splitmix64
+	value ^= value >> 30;
+	value *= Q_UINT64_C(0xbf58476d1ce4e5b9);
+	value ^= value >> 27;
+	return seed ^ (value + Q_UINT64_C(0x9e3779b97f4a7c15) + (seed << 6) + (seed >> 2));
+}
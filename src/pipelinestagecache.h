@@ -0,0 +1,76 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#ifndef PIPELINESTAGECACHE_H
+#define PIPELINESTAGECACHE_H
+
+#include <QtGlobal>
+
+enum PipelineStage {
+	STAGE_AVERAGE,
+	STAGE_FFT,
+	STAGE_BAND,
+	STAGE_PHASE,
+	STAGE_CURVE,
+	STAGE_FIT,
+	STAGE_VERIFICATION,
+	NUMBER_OF_STAGES
+};
+
+//Keeps track of which calculation stage results are still valid.
+//The key of a stage is a hash of the key of its upstream stage and its own parameters, so a change anywhere upstream makes all downstream stages dirty.
+//Every stage holds exactly one result (the buffers of PhaseExtractionEngine and PhaseExtractionCalculator), therefore storing a new result of a stage invalidates all downstream stages.
+class PipelineStageCache
+{
+public:
+	PipelineStageCache();
+
+	template <typename... Args>
+	quint64 keyFor(PipelineStage stage, Args... parameters) {
+		quint64 key = this->getUpstreamKey(stage);
+		const quint64 values[] = {static_cast<quint64>(stage), static_cast<quint64>(parameters)...};
+		for(quint64 value : values){
+			key = combine(key, value);
+		}
+		return key;
+	}
+
+	bool isValid(PipelineStage stage, quint64 key);
+	void store(PipelineStage stage, quint64 key);
+	void invalidate(PipelineStage stage);
+	void invalidateAll();
+
+private:
+	quint64 getUpstreamKey(PipelineStage stage);
+	static quint64 combine(quint64 seed, quint64 value);
+
+	quint64 keys[NUMBER_OF_STAGES];
+	bool valid[NUMBER_OF_STAGES];
+};
+
+#endif // PIPELINESTAGECACHE_H
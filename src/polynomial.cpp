@@ -26,6 +26,7 @@
 **/
 
 #include "polynomial.h"
+#include "kerneldispatch.h"
 
 Polynomial::Polynomial(float* coeffs, unsigned int order, unsigned int size){
 	this->polynomialChanged = false;
@@ -138,8 +139,6 @@ void Polynomial::clamp(float* inputData, unsigned int inputLength, float min, fl
 
 void Polynomial::updateData() {
 	if (this->data != nullptr && this->coeffs != nullptr) {
-		for (unsigned int i = 0; i < this->size; i++) {
-			this->data[i] = this->getValueAt(i);
-		}
+		KernelDispatch::getKernels<float>().evaluatePolynomial(this->coeffs, static_cast<int>(this->order), this->data, static_cast<int>(this->size));
 	}
 }
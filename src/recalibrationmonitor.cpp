@@ -0,0 +1,240 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#include "recalibrationmonitor.h"
+#include "phaseextractioncalculator.h"
+#include <cstring>
+#include <climits>
+
+
+RecalibrationMonitor::RecalibrationMonitor(QObject *parent) : QObject(parent)
+{
+	this->bufferRequested.storeRelease(0);
+	this->stagedBytesPerSample = 0;
+	this->stagedSamplesPerLine = 0;
+	this->stagedLines = 0;
+	this->engine = new PhaseExtractionEngine<double>(&this->fftThreadPolicy);
+	this->params = PhaseExtractionExtensionParameters();
+	this->enabled = false;
+	this->lastProcessingTimeNs = 0;
+	this->thresholdExceeded = false;
+	this->hasReference = false;
+	this->history.resize(MONITOR_HISTORY_SIZE);
+	this->historyHead = 0;
+	this->historySize = 0;
+
+	//the timer is a child of the monitor, so it is moved to the monitor thread together with it
+	this->intervalTimer = new QTimer(this);
+	this->intervalTimer->setSingleShot(true);
+	connect(this->intervalTimer, &QTimer::timeout, this, &RecalibrationMonitor::requestBuffer);
+}
+
+RecalibrationMonitor::~RecalibrationMonitor()
+{
+	delete this->engine;
+}
+
+void RecalibrationMonitor::captureBuffer(void* buffer, int bytesPerSample, int samplesPerLine, int linesPerBuffer) {
+	//only the first callback after a request copies data, all others return after one atomic operation
+	if(this->bufferRequested.fetchAndStoreAcquire(0) == 0 || samplesPerLine <= 0 || linesPerBuffer <= 0){
+		return;
+	}
+	QMutexLocker locker(&this->stagingMutex);
+	int lineStep = qMax(1, linesPerBuffer/MONITOR_MAX_LINES);
+	int lines = linesPerBuffer/lineStep;
+	size_t bytesPerLine = static_cast<size_t>(samplesPerLine)*bytesPerSample;
+	this->stagingBuffer.resize(static_cast<int>(bytesPerLine*lines));
+	const unsigned char* src = static_cast<const unsigned char*>(buffer);
+	for(int i = 0; i < lines; i++){
+		memcpy(this->stagingBuffer.data()+i*bytesPerLine, src+static_cast<size_t>(i)*lineStep*bytesPerLine, bytesPerLine);
+	}
+	this->stagedBytesPerSample = bytesPerSample;
+	this->stagedSamplesPerLine = samplesPerLine;
+	this->stagedLines = lines;
+	locker.unlock();
+	QMetaObject::invokeMethod(this, "processCapturedBuffer", Qt::QueuedConnection);
+}
+
+QVector<DriftSample> RecalibrationMonitor::getHistory() {
+	QMutexLocker locker(&this->historyMutex);
+	QVector<DriftSample> orderedHistory;
+	orderedHistory.reserve(this->historySize);
+	int oldest = (this->historyHead - this->historySize + MONITOR_HISTORY_SIZE) % MONITOR_HISTORY_SIZE;
+	for(int i = 0; i < this->historySize; i++){
+		orderedHistory.append(this->history.at((oldest + i) % MONITOR_HISTORY_SIZE));
+	}
+	return orderedHistory;
+}
+
+QString RecalibrationMonitor::summarizeHistory() {
+	QVector<DriftSample> history = this->getHistory();
+	if(history.isEmpty()){
+		return tr("No drift measurements were taken.");
+	}
+	double maxDrift = 0;
+	for(int i = 0; i < history.size(); i++){
+		maxDrift = qMax(maxDrift, history.at(i).drift);
+	}
+	const DriftSample& first = history.first();
+	const DriftSample& last = history.last();
+	return QString::number(history.size()) + tr(" measurements over ") + QString::number((last.timestamp-first.timestamp)/1000.0, 'f', 1) + tr(" s, max drift: ")
+			+ QString::number(maxDrift, 'f', 3) + tr(" samples, last drift: ") + QString::number(last.drift, 'f', 3) + tr(" samples, last coefficients: k0 = ")
+			+ QString::number(last.k0) + tr(", k1 = ") + QString::number(last.k1) + tr(", k2 = ") + QString::number(last.k2) + tr(", k3 = ") + QString::number(last.k3);
+}
+
+void RecalibrationMonitor::setParams(PhaseExtractionExtensionParameters params) {
+	//a new reference is needed if anything changed that influences the resulting resampling curve
+	if(params.startPos != this->params.startPos || params.endPos != this->params.endPos || params.windowRaw != this->params.windowRaw
+			|| params.windowPeak != this->params.windowPeak || params.ignoreStart != this->params.ignoreStart || params.ignoreEnd != this->params.ignoreEnd){
+		this->resetReference();
+	}
+	bool wasEnabled = this->enabled;
+	this->params = params;
+	this->enabled = params.driftMonitor;
+
+	if(this->enabled && !wasEnabled){
+		this->resetReference();
+		this->historyMutex.lock();
+		this->historySize = 0;
+		this->historyHead = 0;
+		this->historyMutex.unlock();
+		this->monitoringTime.start();
+		emit info(tr("Drift monitoring started. The next measurement is used as reference."));
+		this->requestBuffer();
+	}else if(!this->enabled && wasEnabled){
+		this->intervalTimer->stop();
+		this->bufferRequested.storeRelease(0);
+		emit info(tr("Drift monitoring stopped. ") + this->summarizeHistory());
+	}
+}
+
+void RecalibrationMonitor::setFftParams(bool padToSmoothSize, int upsamplingFactor, bool multithreadedFft) {
+	//monitoring is always single threaded to keep its cpu load low
+	Q_UNUSED(multithreadedFft)
+	this->engine->setFftParams(padToSmoothSize, qMax(1, upsamplingFactor));
+	this->resetReference();
+}
+
+void RecalibrationMonitor::requestBuffer() {
+	if(this->enabled){
+		this->bufferRequested.storeRelease(1);
+	}
+}
+
+void RecalibrationMonitor::resetReference() {
+	this->hasReference = false;
+	this->thresholdExceeded = false;
+}
+
+void RecalibrationMonitor::scheduleNextMeasurement() {
+	//processing time of the last measurement determines the minimum interval that keeps the cpu load within budget
+	qint64 minIntervalMs = static_cast<qint64>(this->lastProcessingTimeNs / (MONITOR_CPU_BUDGET * 1000000.0));
+	qint64 intervalMs = qMax(static_cast<qint64>(this->params.driftInterval)*1000, minIntervalMs);
+	this->intervalTimer->start(static_cast<int>(qMin(intervalMs, static_cast<qint64>(INT_MAX))));
+}
+
+void RecalibrationMonitor::processCapturedBuffer() {
+	if(!this->enabled){
+		return;
+	}
+	QElapsedTimer timer;
+	timer.start();
+
+	//same calculation steps as PhaseExtractionCalculator, but on the decimated staging buffer
+	QMutexLocker locker(&this->stagingMutex);
+	this->engine->setData(this->stagingBuffer.data(), this->stagedBytesPerSample, this->stagedSamplesPerLine, this->stagedLines);
+	this->engine->average(0, this->stagedLines, this->params.windowRaw, nullptr);
+	locker.unlock();
+	int startPos = qAbs(qMin(this->params.startPos, this->params.endPos));
+	int endPos = qAbs(qMax(this->params.startPos, this->params.endPos));
+	this->engine->forwardFft();
+	this->engine->selectBand(startPos, endPos, this->params.windowPeak);
+	this->engine->inverseFft();
+	this->engine->calculatePhase();
+	this->engine->unwrapPhase();
+	this->engine->calculateNonLinearPhase();
+	this->engine->calculateResamplingCurve();
+	this->engine->getNonLinearPhase(&this->nonLinearPhase);
+	this->engine->getResamplingCurve(&this->curve);
+
+	int size = this->curve.size();
+	if(!PhaseExtractionCalculator::fitPolynomial(this->curve, qBound(0, this->params.ignoreStart, size), qBound(0, this->params.ignoreEnd, size), 3, &this->coeffs)){
+		emit error(tr("PhaseExtractionExtension: drift monitoring failed, no samples available for fit."));
+		this->lastProcessingTimeNs = timer.nsecsElapsed();
+		this->scheduleNextMeasurement();
+		return;
+	}
+
+	if(!this->hasReference){
+		this->referenceCoeffs = this->coeffs;
+		this->hasReference = true;
+	}
+	double drift = 0;
+	for(int i = 0; i < size; i++){
+		drift = qMax(drift, qAbs(evaluatePolynomial(this->coeffs, i) - evaluatePolynomial(this->referenceCoeffs, i)));
+	}
+
+	//coefficients with OCTproZ scaling factors
+	double scale = size-1;
+	DriftSample sample;
+	sample.timestamp = this->monitoringTime.elapsed();
+	sample.k0 = this->coeffs.at(0);
+	sample.k1 = this->coeffs.at(1)*scale;
+	sample.k2 = this->coeffs.at(2)*scale*scale;
+	sample.k3 = this->coeffs.at(3)*scale*scale*scale;
+	sample.nonLinearPhaseRms = PhaseExtractionEngineBase::getRms(this->nonLinearPhase);
+	sample.drift = drift;
+	this->addToHistory(sample);
+	emit driftMeasured(sample);
+
+	if(drift > this->params.driftThreshold && !this->thresholdExceeded){
+		this->thresholdExceeded = true;
+		emit error(tr("PhaseExtractionExtension: k-linearization drifted by ") + QString::number(drift, 'f', 3) + tr(" samples. Recalibration is recommended."));
+	}else if(drift <= this->params.driftThreshold && this->thresholdExceeded){
+		this->thresholdExceeded = false;
+		emit info(tr("K-linearization drift is back within threshold (") + QString::number(drift, 'f', 3) + tr(" samples)."));
+	}
+
+	this->lastProcessingTimeNs = timer.nsecsElapsed();
+	this->scheduleNextMeasurement();
+}
+
+void RecalibrationMonitor::addToHistory(const DriftSample& sample) {
+	QMutexLocker locker(&this->historyMutex);
+	this->history[this->historyHead] = sample;
+	this->historyHead = (this->historyHead + 1) % MONITOR_HISTORY_SIZE;
+	this->historySize = qMin(this->historySize + 1, MONITOR_HISTORY_SIZE);
+}
+
+double RecalibrationMonitor::evaluatePolynomial(const QVector<qreal>& coeffs, double x) {
+	double value = 0;
+	for(int i = coeffs.size()-1; i >= 0; i--){
+		value = value*x + coeffs.at(i);
+	}
+	return value;
+}
@@ -0,0 +1,104 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#ifndef RECALIBRATIONMONITOR_H
+#define RECALIBRATIONMONITOR_H
+
+#include <QObject>
+#include <QVector>
+#include <QTimer>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include "phaseextractionengine.h"
+#include "analysisresult.h"
+#include "extensionparameters.h"
+
+#define MONITOR_MAX_LINES 256
+#define MONITOR_HISTORY_SIZE 1024
+#define MONITOR_CPU_BUDGET 0.05 //fraction of one core
+
+//Repeats averaging, analysis and fit on a decimated subset of live buffers while OCTproZ is acquiring, to track drift of the k-linearization (e.g. while the laser warms up).
+//At every interval the monitor requests one buffer. rawDataReceived copies at most MONITOR_MAX_LINES evenly spaced lines of the next buffer into a staging buffer, which is the only work added to the callback.
+//The first measurement after enabling the monitor is the reference. The interval is stretched if necessary, so processing never takes more than MONITOR_CPU_BUDGET of one core.
+class RecalibrationMonitor : public QObject
+{
+	Q_OBJECT
+public:
+	explicit RecalibrationMonitor(QObject *parent = nullptr);
+	~RecalibrationMonitor();
+
+	bool isBufferRequested() { return this->bufferRequested.loadAcquire() != 0; }
+	void captureBuffer(void* buffer, int bytesPerSample, int samplesPerLine, int linesPerBuffer); //called from rawDataReceived if isBufferRequested() is true
+	QVector<DriftSample> getHistory(); //oldest sample first, thread safe
+	QString summarizeHistory(); //number of measurements, max drift and last coefficients of the history, reported when monitoring stops
+
+private:
+	void resetReference();
+	void scheduleNextMeasurement();
+	void addToHistory(const DriftSample& sample);
+	static double evaluatePolynomial(const QVector<qreal>& coeffs, double x);
+
+	QAtomicInt bufferRequested;
+	QMutex stagingMutex;
+	QVector<unsigned char> stagingBuffer;
+	int stagedBytesPerSample;
+	int stagedSamplesPerLine;
+	int stagedLines;
+
+	QTimer* intervalTimer;
+	QElapsedTimer monitoringTime;
+	FftwThreadPolicy fftThreadPolicy;
+	PhaseExtractionEngineBase* engine;
+	PhaseExtractionExtensionParameters params;
+	bool enabled;
+	qint64 lastProcessingTimeNs;
+	bool thresholdExceeded;
+	bool hasReference;
+	QVector<qreal> referenceCoeffs;
+	QVector<qreal> curve;
+	QVector<qreal> nonLinearPhase;
+	QVector<qreal> coeffs;
+	QMutex historyMutex;
+	QVector<DriftSample> history;
+	int historyHead;
+	int historySize;
+
+public slots:
+	void setParams(PhaseExtractionExtensionParameters params);
+	void setFftParams(bool padToSmoothSize, int upsamplingFactor, bool multithreadedFft);
+	void requestBuffer();
+	void processCapturedBuffer();
+
+signals:
+	void driftMeasured(DriftSample sample);
+	void error(QString);
+	void info(QString);
+};
+
+#endif // RECALIBRATIONMONITOR_H
@@ -0,0 +1,104 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#ifndef RESAMPLING_H
+#define RESAMPLING_H
+
+#include <cmath>
+
+#define SINC_INTERPOLATION_LOBES 4
+
+enum InterpolationMethod {
+	LINEAR_INTERPOLATION,
+	CUBIC_INTERPOLATION,
+	SINC_INTERPOLATION
+};
+
+//Interpolation of a sampled line at fractional positions, as done by OCTproZ during k-linearization.
+//Positions outside the line are clamped to the first or last sample.
+namespace Resampling {
+
+template <typename T>
+inline T sampleAt(const T* line, int size, int index) {
+	return line[index < 0 ? 0 : (index >= size ? size-1 : index)];
+}
+
+template <typename T>
+inline T lanczosKernel(T x) {
+	//windowed sinc with a Lanczos window of SINC_INTERPOLATION_LOBES lobes
+	if(x == 0){
+		return 1;
+	}
+	if(x <= -SINC_INTERPOLATION_LOBES || x >= SINC_INTERPOLATION_LOBES){
+		return 0;
+	}
+	const T pi = static_cast<T>(M_PI);
+	T piX = pi*x;
+	return (SINC_INTERPOLATION_LOBES*std::sin(piX)*std::sin(piX/SINC_INTERPOLATION_LOBES)) / (piX*piX);
+}
+
+template <typename T>
+inline T interpolate(const T* line, int size, T position, InterpolationMethod method) {
+	int index = static_cast<int>(std::floor(position));
+	T fraction = position - index;
+	switch(method){
+		case CUBIC_INTERPOLATION: {
+			//Catmull-Rom spline through the four neighbouring samples
+			T p0 = sampleAt(line, size, index-1);
+			T p1 = sampleAt(line, size, index);
+			T p2 = sampleAt(line, size, index+1);
+			T p3 = sampleAt(line, size, index+2);
+			return p1 + static_cast<T>(0.5)*fraction*(p2 - p0 + fraction*(2*p0 - 5*p1 + 4*p2 - p3 + fraction*(3*(p1 - p2) + p3 - p0)));
+		}
+		case SINC_INTERPOLATION: {
+			T sum = 0;
+			T weightSum = 0;
+			for(int i = index-SINC_INTERPOLATION_LOBES+1; i <= index+SINC_INTERPOLATION_LOBES; i++){
+				T weight = lanczosKernel(position - i);
+				sum += weight*sampleAt(line, size, i);
+				weightSum += weight;
+			}
+			return weightSum != 0 ? sum/weightSum : sampleAt(line, size, index);
+		}
+		case LINEAR_INTERPOLATION:
+		default:
+			return sampleAt(line, size, index) + fraction*(sampleAt(line, size, index+1) - sampleAt(line, size, index));
+	}
+}
+
+//out[i] = line interpolated at curve[i]
+template <typename T>
+inline void resampleLine(const T* line, int size, const T* curve, InterpolationMethod method, T* out) {
+	for(int i = 0; i < size; i++){
+		out[i] = interpolate(line, size, curve[i], method);
+	}
+}
+
+}
+
+#endif // RESAMPLING_H
@@ -0,0 +1,323 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#include "resamplinglut.h"
+#include <QFile>
+#include <QtEndian>
+#include <QElapsedTimer>
+#include <cstring>
+#include <cstddef>
+
+
+ResamplingLut::ResamplingLut() {
+	this->samplesPerLine = 0;
+	this->taps = 0;
+	this->interpolation = LINEAR_INTERPOLATION;
+}
+
+void ResamplingLut::generate(const float* curve, int size, InterpolationMethod method) {
+	int taps = tapsFor(method);
+	if(curve == nullptr || size < taps){
+		this->samplesPerLine = 0;
+		this->indices.clear();
+		this->weights.clear();
+		return;
+	}
+	this->samplesPerLine = size;
+	this->taps = taps;
+	this->interpolation = method;
+	this->indices.resize(size);
+	this->weights.fill(0, size*taps);
+
+	float tapWeights[4];
+	for(int i = 0; i < size; i++){
+		float position = curve[i];
+		int index = static_cast<int>(floorf(position));
+		int first = index - (taps/2 - 1);
+
+		//the taps window is moved inside the line. Weights of taps outside the line are added to the border sample like Resampling::sampleAt does
+		int base = qBound(0, first, size-taps);
+		this->tapWeights(position - index, tapWeights);
+		float* weight = this->weights.data() + static_cast<size_t>(i)*taps;
+		for(int t = 0; t < taps; t++){
+			int sample = qBound(0, first+t, size-1);
+			weight[sample-base] += tapWeights[t];
+		}
+		this->indices[i] = base;
+	}
+}
+
+void ResamplingLut::tapWeights(float fraction, float* weights) const {
+	switch(this->interpolation){
+		case CUBIC_INTERPOLATION: {
+			//Catmull-Rom, same spline as Resampling::interpolate
+			float f2 = fraction*fraction;
+			float f3 = f2*fraction;
+			weights[0] = 0.5f*(-f3 + 2.0f*f2 - fraction);
+			weights[1] = 0.5f*(3.0f*f3 - 5.0f*f2 + 2.0f);
+			weights[2] = 0.5f*(-3.0f*f3 + 4.0f*f2 + fraction);
+			weights[3] = 0.5f*(f3 - f2);
+			break;
+		}
+		case SINC_INTERPOLATION: {
+			//Lanczos with RESAMPLINGLUT_LANCZOS_LOBES lobes, normalized so a constant signal stays constant
+			float sum = 0;
+			for(int t = 0; t < 4; t++){
+				float x = fraction + 1.0f - t;
+				float weight = 1.0f;
+				if(x != 0){
+					float piX = static_cast<float>(M_PI)*x;
+					weight = (x > -RESAMPLINGLUT_LANCZOS_LOBES && x < RESAMPLINGLUT_LANCZOS_LOBES) ? RESAMPLINGLUT_LANCZOS_LOBES*sinf(piX)*sinf(piX/RESAMPLINGLUT_LANCZOS_LOBES)/(piX*piX) : 0.0f;
+				}
+				weights[t] = weight;
+				sum += weight;
+			}
+			for(int t = 0; t < 4; t++){
+				weights[t] /= sum;
+			}
+			break;
+		}
+		case LINEAR_INTERPOLATION:
+		default:
+			weights[0] = 1.0f - fraction;
+			weights[1] = fraction;
+			break;
+	}
+}
+
+bool ResamplingLut::save(const QString& fileName, LutWeightType weightType) const {
+	if(this->isEmpty()){
+		return false;
+	}
+	size_t weightSize = weightType == LUT_FLOAT16 ? sizeof(quint16) : sizeof(float);
+	quint64 indexOffset = RESAMPLINGLUT_ALIGNMENT;
+	quint64 weightOffset = indexOffset + ((this->samplesPerLine*sizeof(qint32) + RESAMPLINGLUT_ALIGNMENT-1)/RESAMPLINGLUT_ALIGNMENT)*RESAMPLINGLUT_ALIGNMENT;
+	quint64 fileSize = weightOffset + static_cast<quint64>(this->weights.size())*weightSize;
+
+	//the file is assembled in memory and written at once, unused bytes between header and arrays stay zero
+	QByteArray buffer(static_cast<int>(fileSize), 0);
+	char* dest = buffer.data();
+	qToLittleEndian<quint32>(RESAMPLINGLUT_MAGIC, dest + offsetof(ResamplingLutHeader, magic));
+	qToLittleEndian<quint32>(RESAMPLINGLUT_VERSION, dest + offsetof(ResamplingLutHeader, version));
+	qToLittleEndian<quint32>(this->samplesPerLine, dest + offsetof(ResamplingLutHeader, samplesPerLine));
+	qToLittleEndian<quint32>(this->taps, dest + offsetof(ResamplingLutHeader, taps));
+	qToLittleEndian<quint32>(this->interpolation, dest + offsetof(ResamplingLutHeader, interpolation));
+	qToLittleEndian<quint32>(weightType, dest + offsetof(ResamplingLutHeader, weightType));
+	qToLittleEndian<quint64>(indexOffset, dest + offsetof(ResamplingLutHeader, indexOffset));
+	qToLittleEndian<quint64>(weightOffset, dest + offsetof(ResamplingLutHeader, weightOffset));
+	qToLittleEndian<quint64>(fileSize, dest + offsetof(ResamplingLutHeader, fileSize));
+	for(int i = 0; i < this->samplesPerLine; i++){
+		qToLittleEndian<qint32>(this->indices.at(i), dest + indexOffset + i*sizeof(qint32));
+	}
+	for(int i = 0; i < this->weights.size(); i++){
+		if(weightType == LUT_FLOAT16){
+			qToLittleEndian<quint16>(floatToHalf(this->weights.at(i)), dest + weightOffset + i*sizeof(quint16));
+		}else{
+			quint32 bits;
+			memcpy(&bits, &this->weights.at(i), sizeof(bits));
+			qToLittleEndian<quint32>(bits, dest + weightOffset + i*sizeof(quint32));
+		}
+	}
+
+	QFile file(fileName);
+	if(!file.open(QFile::WriteOnly|QFile::Truncate)){
+		return false;
+	}
+	bool written = file.write(buffer) == buffer.size();
+	file.close();
+	return written;
+}
+
+bool ResamplingLut::load(const QString& fileName) {
+	QFile file(fileName);
+	if(!file.open(QFile::ReadOnly) || file.size() < static_cast<qint64>(sizeof(ResamplingLutHeader))){
+		return false;
+	}
+	const uchar* src = file.map(0, file.size());
+	if(src == nullptr){
+		return false;
+	}
+
+	//header is checked against the file size before any array is read
+	quint32 magic = qFromLittleEndian<quint32>(src + offsetof(ResamplingLutHeader, magic));
+	quint32 version = qFromLittleEndian<quint32>(src + offsetof(ResamplingLutHeader, version));
+	quint32 samplesPerLine = qFromLittleEndian<quint32>(src + offsetof(ResamplingLutHeader, samplesPerLine));
+	quint32 taps = qFromLittleEndian<quint32>(src + offsetof(ResamplingLutHeader, taps));
+	quint32 interpolation = qFromLittleEndian<quint32>(src + offsetof(ResamplingLutHeader, interpolation));
+	quint32 weightType = qFromLittleEndian<quint32>(src + offsetof(ResamplingLutHeader, weightType));
+	quint64 indexOffset = qFromLittleEndian<quint64>(src + offsetof(ResamplingLutHeader, indexOffset));
+	quint64 weightOffset = qFromLittleEndian<quint64>(src + offsetof(ResamplingLutHeader, weightOffset));
+	size_t weightSize = weightType == LUT_FLOAT16 ? sizeof(quint16) : sizeof(float);
+	quint64 fileSize = static_cast<quint64>(file.size());
+
+	//offsets are compared with the file size before the array sizes are subtracted, so a corrupted offset can not wrap around. The array sizes can not overflow, samplesPerLine and taps are 32 bit
+	bool valid = magic == RESAMPLINGLUT_MAGIC && version == RESAMPLINGLUT_VERSION && interpolation <= SINC_INTERPOLATION && weightType <= LUT_FLOAT16
+			&& taps == static_cast<quint32>(tapsFor(static_cast<InterpolationMethod>(interpolation))) && samplesPerLine >= taps
+			&& indexOffset <= fileSize && static_cast<quint64>(samplesPerLine)*sizeof(qint32) <= fileSize - indexOffset
+			&& weightOffset <= fileSize && static_cast<quint64>(samplesPerLine)*taps*weightSize <= fileSize - weightOffset;
+	if(valid){
+		this->samplesPerLine = samplesPerLine;
+		this->taps = taps;
+		this->interpolation = static_cast<InterpolationMethod>(interpolation);
+		this->indices.resize(samplesPerLine);
+		this->weights.resize(samplesPerLine*taps);
+		for(quint32 i = 0; i < samplesPerLine; i++){
+			this->indices[i] = qBound(0, qFromLittleEndian<qint32>(src + indexOffset + i*sizeof(qint32)), static_cast<int>(samplesPerLine-taps));
+		}
+		for(int i = 0; i < this->weights.size(); i++){
+			if(weightType == LUT_FLOAT16){
+				this->weights[i] = halfToFloat(qFromLittleEndian<quint16>(src + weightOffset + i*sizeof(quint16)));
+			}else{
+				quint32 bits = qFromLittleEndian<quint32>(src + weightOffset + i*sizeof(quint32));
+				memcpy(&this->weights[i], &bits, sizeof(bits));
+			}
+		}
+	}
+	file.unmap(const_cast<uchar*>(src));
+	file.close();
+	return valid;
+}
+
+ResamplingLutBenchmark ResamplingLut::benchmark(const ResamplingLut& lut, Polynomial* polynomial, const unsigned char* data, int bytesPerSample, int numberOfLines) {
+	//uchar
+	if(bytesPerSample <= 1){
+		return runBenchmark(lut, polynomial, reinterpret_cast<const quint8*>(data), numberOfLines);
+	}
+	//ushort
+	else if(bytesPerSample <= 2){
+		return runBenchmark(lut, polynomial, reinterpret_cast<const quint16*>(data), numberOfLines);
+	}
+	//uint
+	return runBenchmark(lut, polynomial, reinterpret_cast<const quint32*>(data), numberOfLines);
+}
+
+template <typename S>
+ResamplingLutBenchmark ResamplingLut::runBenchmark(const ResamplingLut& lut, Polynomial* polynomial, const S* data, int numberOfLines) {
+	ResamplingLutBenchmark result;
+	int size = lut.getSamplesPerLine();
+	if(size <= 1 || numberOfLines <= 0 || polynomial == nullptr){
+		return result;
+	}
+	QVector<float> lutOutput(size);
+	QVector<float> polynomialOutput(size);
+	QElapsedTimer timer;
+
+	//reference path: resampling position is evaluated for every sample and the line is interpolated linearly, as done without a LUT
+	timer.start();
+	for(int n = 0; n < numberOfLines; n++){
+		const S* line = data + static_cast<size_t>(n)*size;
+		for(int i = 0; i < size; i++){
+			float position = qBound(0.0f, polynomial->getValueAt(static_cast<float>(i)), static_cast<float>(size-1));
+			int index = qMin(static_cast<int>(position), size-2);
+			float fraction = position - index;
+			polynomialOutput[i] = static_cast<float>(line[index]) + fraction*(static_cast<float>(line[index+1]) - static_cast<float>(line[index]));
+		}
+	}
+	qint64 polynomialNs = timer.nsecsElapsed();
+
+	timer.start();
+	for(int n = 0; n < numberOfLines; n++){
+		lut.apply(data + static_cast<size_t>(n)*size, lutOutput.data());
+	}
+	qint64 lutNs = timer.nsecsElapsed();
+
+	//outputs of the last line are compared, the compiler can not drop either loop because both outputs are used
+	for(int i = 0; i < size; i++){
+		result.maxDeviation = qMax(result.maxDeviation, static_cast<double>(qAbs(lutOutput.at(i) - polynomialOutput.at(i))));
+	}
+	result.lines = numberOfLines;
+	result.lutNsPerLine = static_cast<double>(lutNs)/numberOfLines;
+	result.polynomialNsPerLine = static_cast<double>(polynomialNs)/numberOfLines;
+	return result;
+}
+
+int ResamplingLut::tapsFor(InterpolationMethod method) {
+	return method == LINEAR_INTERPOLATION ? 2 : 4;
+}
+
+quint16 ResamplingLut::floatToHalf(float value) {
+	//IEEE 754 binary16 with round to nearest even. Values beyond the half range become infinity, tiny values become subnormal or zero
+	quint32 bits;
+	memcpy(&bits, &value, sizeof(bits));
+	quint16 sign = static_cast<quint16>((bits >> 16) & 0x8000);
+	qint32 exponent = static_cast<qint32>((bits >> 23) & 0xff) - 127 + 15;
+	quint32 mantissa = bits & 0x7fffff;
+	if(((bits >> 23) & 0xff) == 0xff){
+		return sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0); //inf or nan
+	}
+	if(exponent >= 31){
+		return sign | 0x7c00;
+	}
+	if(exponent <= 0){
+		if(exponent < -10){
+			return sign;
+		}
+		mantissa |= 0x800000;
+		int shift = 14 - exponent;
+		quint32 halfMantissa = mantissa >> shift;
+		quint32 remainder = mantissa & ((1u << shift) - 1);
+		quint32 halfway = 1u << (shift - 1);
+		if(remainder > halfway || (remainder == halfway && (halfMantissa & 1))){
+			halfMantissa++;
+		}
+		return sign | static_cast<quint16>(halfMantissa);
+	}
+	quint32 half = (static_cast<quint32>(exponent) << 10) | (mantissa >> 13);
+	quint32 remainder = mantissa & 0x1fff;
+	if(remainder > 0x1000 || (remainder == 0x1000 && (half & 1))){
+		half++; //carry into the exponent is the correct rounding up to the next power of two
+	}
+	return sign | static_cast<quint16>(half);
+}
+
+float ResamplingLut::halfToFloat(quint16 value) {
+	quint32 sign = static_cast<quint32>(value & 0x8000) << 16;
+	quint32 exponent = (value >> 10) & 0x1f;
+	quint32 mantissa = value & 0x3ff;
+	quint32 bits;
+	if(exponent == 0){
+		if(mantissa == 0){
+			bits = sign;
+		}else{
+			//subnormal half, normalized for float
+			exponent = 127 - 15 + 1;
+			while((mantissa & 0x400) == 0){
+				mantissa <<= 1;
+				exponent--;
+			}
+			bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+		}
+	}else if(exponent == 31){
+		bits = sign | 0x7f800000 | (mantissa << 13);
+	}else{
+		bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+	}
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
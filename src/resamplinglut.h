@@ -0,0 +1,120 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#ifndef RESAMPLINGLUT_H
+#define RESAMPLINGLUT_H
+
+#include <QVector>
+#include <QString>
+#include "resampling.h"
+#include "polynomial.h"
+
+#define RESAMPLINGLUT_MAGIC 0x54554C50 //"PLUT" little endian
+#define RESAMPLINGLUT_VERSION 1
+#define RESAMPLINGLUT_ALIGNMENT 64 //index and weight arrays start at cache line boundaries
+#define RESAMPLINGLUT_LANCZOS_LOBES 2 //4 taps
+
+enum LutWeightType {
+	LUT_FLOAT32,
+	LUT_FLOAT16
+};
+
+//Header of the binary LUT file. All values are little endian.
+//The file is header, int32 base index per output sample at indexOffset and taps weights per output sample at weightOffset (float32 or IEEE 754 half).
+//Output sample i = sum over t < taps of weight[i*taps + t] * input[index[i] + t]. index[i] + taps never exceeds samplesPerLine, border clamping is folded into the weights.
+//For linear interpolation (taps = 2) weight[i*2] is 1 - fraction and weight[i*2 + 1] the fraction.
+struct ResamplingLutHeader {
+	quint32 magic;
+	quint32 version;
+	quint32 samplesPerLine;
+	quint32 taps;
+	quint32 interpolation; //InterpolationMethod
+	quint32 weightType; //LutWeightType
+	quint64 indexOffset; //bytes from start of file
+	quint64 weightOffset;
+	quint64 fileSize;
+};
+
+//Timing of ResamplingLut::apply against evaluating the resampling polynomial for every sample and interpolating linearly
+struct ResamplingLutBenchmark {
+	ResamplingLutBenchmark() : lines(0), lutNsPerLine(0), polynomialNsPerLine(0), maxDeviation(0) {}
+
+	int lines;
+	double lutNsPerLine;
+	double polynomialNsPerLine;
+	double maxDeviation; //max difference between both outputs. For a linear LUT only float rounding and weight precision contribute
+};
+
+//Precomputed resampling of one line: base index and interpolation weights per output sample, so the resampling curve does not have to be evaluated per sample.
+class ResamplingLut
+{
+public:
+	ResamplingLut();
+
+	void generate(const float* curve, int size, InterpolationMethod method);
+	bool save(const QString& fileName, LutWeightType weightType) const;
+	bool load(const QString& fileName);
+	bool isEmpty() const { return this->samplesPerLine == 0; }
+	int getSamplesPerLine() const { return this->samplesPerLine; }
+	int getTaps() const { return this->taps; }
+	InterpolationMethod getInterpolation() const { return this->interpolation; }
+
+	//reference resampler, out has to hold getSamplesPerLine() samples
+	template <typename S>
+	void apply(const S* line, float* out) const {
+		const qint32* index = this->indices.constData();
+		const float* weight = this->weights.constData();
+		for(int i = 0; i < this->samplesPerLine; i++){
+			const S* src = line + index[i];
+			float sum = 0;
+			for(int t = 0; t < this->taps; t++){
+				sum += weight[t]*static_cast<float>(src[t]);
+			}
+			out[i] = sum;
+			weight += this->taps;
+		}
+	}
+
+	static ResamplingLutBenchmark benchmark(const ResamplingLut& lut, Polynomial* polynomial, const unsigned char* data, int bytesPerSample, int numberOfLines);
+	static int tapsFor(InterpolationMethod method);
+	static quint16 floatToHalf(float value);
+	static float halfToFloat(quint16 value);
+
+private:
+	void tapWeights(float fraction, float* weights) const;
+	template <typename S>
+	static ResamplingLutBenchmark runBenchmark(const ResamplingLut& lut, Polynomial* polynomial, const S* data, int numberOfLines);
+
+	int samplesPerLine;
+	int taps;
+	InterpolationMethod interpolation;
+	QVector<qint32> indices;
+	QVector<float> weights;
+};
+
+#endif // RESAMPLINGLUT_H
@@ -0,0 +1,311 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#include "sessionfile.h"
+#include "npyarchive.h"
+#include "phaseextractionengine.h"
+#include <QtEndian>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtConcurrent>
+#include <QThread>
+#include <cstddef>
+#include <cstdlib>
+#include <climits>
+
+#define SESSIONFILE_WRITE_BLOCK_SIZE (64*1024*1024)
+
+
+struct SessionChunk {
+	const unsigned char* source;
+	unsigned char* destination;
+	qint64 sourceSize;
+	qint64 destinationSize;
+	QByteArray compressed;
+	bool valid;
+};
+
+namespace {
+	quint64 alignOffset(quint64 offset, quint64 alignment) {
+		return ((offset + alignment - 1)/alignment)*alignment;
+	}
+
+	template <typename T>
+	void writeField(QByteArray* header, size_t offset, T value) {
+		qToLittleEndian<T>(value, header->data() + offset);
+	}
+
+	template <typename T>
+	T readField(const QByteArray& header, size_t offset) {
+		return qFromLittleEndian<T>(header.constData() + offset);
+	}
+}
+
+
+SessionFile::SessionFile() {
+	this->mappedData = nullptr;
+	this->rawData = nullptr;
+	this->rawSize = 0;
+}
+
+SessionFile::~SessionFile() {
+	this->close();
+}
+
+bool SessionFile::save(const QString& fileName, const unsigned char* rawData, size_t rawSize, const SessionInfo& info, const AnalysisResult* result, bool compress, QString* errorMessage) {
+	QFile file(fileName);
+	if(rawData == nullptr || rawSize == 0 || !file.open(QFile::WriteOnly|QFile::Truncate)){
+		*errorMessage = QObject::tr("Could not save session to: ") + fileName;
+		return false;
+	}
+
+	//small sections are assembled in memory, their sizes determine where the raw payload starts
+	QByteArray bufferIds(info.bufferIds.size()*static_cast<int>(sizeof(quint32)), 0);
+	for(int i = 0; i < info.bufferIds.size(); i++){
+		qToLittleEndian<quint32>(info.bufferIds.at(i), bufferIds.data() + i*sizeof(quint32));
+	}
+	QByteArray settings = QJsonDocument(QJsonObject::fromVariantMap(info.settings)).toJson(QJsonDocument::Compact);
+	QByteArray results;
+	if(result != nullptr){
+		NpyArchive archive;
+		archive.addAnalysisResult(*result);
+		results = archive.toByteArray();
+	}
+	quint64 chunkCount = compress ? (rawSize + SESSIONFILE_CHUNK_SIZE - 1)/SESSIONFILE_CHUNK_SIZE : 0;
+	quint64 bufferIdsOffset = SESSIONFILE_HEADER_SIZE;
+	quint64 settingsOffset = bufferIdsOffset + bufferIds.size();
+	quint64 resultsOffset = settingsOffset + settings.size();
+	quint64 chunkTableOffset = resultsOffset + results.size();
+	quint64 rawOffset = alignOffset(chunkTableOffset + chunkCount*2*sizeof(quint64), SESSIONFILE_PAYLOAD_ALIGNMENT);
+
+	QByteArray sections(static_cast<int>(rawOffset), 0);
+	memcpy(sections.data() + bufferIdsOffset, bufferIds.constData(), bufferIds.size());
+	memcpy(sections.data() + settingsOffset, settings.constData(), settings.size());
+	memcpy(sections.data() + resultsOffset, results.constData(), results.size());
+	bool written = file.write(sections) == sections.size();
+
+	//raw payload, either as is or as zlib chunks. Chunks are compressed in batches of one chunk per thread, so memory usage does not grow with the capture size
+	quint64 rawStoredSize = 0;
+	QByteArray chunkTable(static_cast<int>(chunkCount*2*sizeof(quint64)), 0);
+	if(!compress){
+		for(size_t offset = 0; written && offset < rawSize; offset += SESSIONFILE_WRITE_BLOCK_SIZE){
+			qint64 blockSize = static_cast<qint64>(qMin(static_cast<size_t>(SESSIONFILE_WRITE_BLOCK_SIZE), rawSize - offset));
+			written = file.write(reinterpret_cast<const char*>(rawData + offset), blockSize) == blockSize;
+		}
+		rawStoredSize = rawSize;
+	}else{
+		int batchSize = qMax(1, QThread::idealThreadCount());
+		for(quint64 firstChunk = 0; written && firstChunk < chunkCount; firstChunk += batchSize){
+			QVector<SessionChunk> batch(static_cast<int>(qMin(static_cast<quint64>(batchSize), chunkCount - firstChunk)));
+			for(int i = 0; i < batch.size(); i++){
+				size_t offset = static_cast<size_t>(firstChunk + i)*SESSIONFILE_CHUNK_SIZE;
+				batch[i].source = rawData + offset;
+				batch[i].sourceSize = static_cast<qint64>(qMin(static_cast<size_t>(SESSIONFILE_CHUNK_SIZE), rawSize - offset));
+			}
+			QtConcurrent::blockingMap(batch, [](SessionChunk& chunk) {
+				chunk.compressed = qCompress(chunk.source, static_cast<int>(chunk.sourceSize), SESSIONFILE_COMPRESSION_LEVEL);
+			});
+			for(int i = 0; written && i < batch.size(); i++){
+				char* entry = chunkTable.data() + (firstChunk + i)*2*sizeof(quint64);
+				qToLittleEndian<quint64>(rawStoredSize, entry);
+				qToLittleEndian<quint64>(static_cast<quint64>(batch.at(i).compressed.size()), entry + sizeof(quint64));
+				written = file.write(batch.at(i).compressed) == batch.at(i).compressed.size();
+				rawStoredSize += batch.at(i).compressed.size();
+			}
+		}
+	}
+
+	//header and chunk table are written last, an interrupted save leaves a file without valid magic
+	QByteArray header(SESSIONFILE_HEADER_SIZE, 0);
+	writeField<quint32>(&header, offsetof(SessionFileHeader, magic), SESSIONFILE_MAGIC);
+	writeField<quint32>(&header, offsetof(SessionFileHeader, version), SESSIONFILE_VERSION);
+	writeField<quint32>(&header, offsetof(SessionFileHeader, bitDepth), info.bitDepth);
+	writeField<quint32>(&header, offsetof(SessionFileHeader, bytesPerSample), info.bytesPerSample);
+	writeField<quint32>(&header, offsetof(SessionFileHeader, samplesPerLine), info.samplesPerLine);
+	writeField<quint32>(&header, offsetof(SessionFileHeader, linesPerBuffer), info.linesPerBuffer);
+	writeField<quint32>(&header, offsetof(SessionFileHeader, numberOfBuffers), info.numberOfBuffers);
+	writeField<quint32>(&header, offsetof(SessionFileHeader, lostBuffers), info.lostBuffers);
+	writeField<quint32>(&header, offsetof(SessionFileHeader, compressed), compress ? 1 : 0);
+	writeField<quint64>(&header, offsetof(SessionFileHeader, bufferIdsOffset), bufferIdsOffset);
+	writeField<quint64>(&header, offsetof(SessionFileHeader, settingsOffset), settingsOffset);
+	writeField<quint64>(&header, offsetof(SessionFileHeader, settingsSize), settings.size());
+	writeField<quint64>(&header, offsetof(SessionFileHeader, resultsOffset), resultsOffset);
+	writeField<quint64>(&header, offsetof(SessionFileHeader, resultsSize), results.size());
+	writeField<quint64>(&header, offsetof(SessionFileHeader, chunkTableOffset), chunkTableOffset);
+	writeField<quint64>(&header, offsetof(SessionFileHeader, chunkCount), chunkCount);
+	writeField<quint64>(&header, offsetof(SessionFileHeader, chunkSize), SESSIONFILE_CHUNK_SIZE);
+	writeField<quint64>(&header, offsetof(SessionFileHeader, rawOffset), rawOffset);
+	writeField<quint64>(&header, offsetof(SessionFileHeader, rawSize), rawSize);
+	writeField<quint64>(&header, offsetof(SessionFileHeader, rawStoredSize), rawStoredSize);
+	writeField<quint64>(&header, offsetof(SessionFileHeader, fileSize), rawOffset + rawStoredSize);
+	writeField<quint64>(&header, offsetof(SessionFileHeader, callbackCount), info.callbackCount);
+	writeField<quint64>(&header, offsetof(SessionFileHeader, callbackP50Ns), static_cast<quint64>(info.callbackP50Ns));
+	writeField<quint64>(&header, offsetof(SessionFileHeader, callbackP99Ns), static_cast<quint64>(info.callbackP99Ns));
+	writeField<quint64>(&header, offsetof(SessionFileHeader, callbackMaxNs), static_cast<quint64>(info.callbackMaxNs));
+	written = written && file.seek(chunkTableOffset) && file.write(chunkTable) == chunkTable.size();
+	written = written && file.seek(0) && file.write(header) == header.size();
+	file.close();
+	if(!written){
+		*errorMessage = QObject::tr("Could not save session to: ") + fileName;
+	}
+	return written;
+}
+
+bool SessionFile::open(const QString& fileName, QString* errorMessage) {
+	this->close();
+	this->file.setFileName(fileName);
+	*errorMessage = QObject::tr("Could not open session: ") + fileName;
+	if(!this->file.open(QFile::ReadOnly)){
+		return false;
+	}
+	QByteArray header = this->file.read(SESSIONFILE_HEADER_SIZE);
+	if(header.size() != SESSIONFILE_HEADER_SIZE || readField<quint32>(header, offsetof(SessionFileHeader, magic)) != SESSIONFILE_MAGIC
+			|| readField<quint32>(header, offsetof(SessionFileHeader, version)) != SESSIONFILE_VERSION
+			|| readField<quint64>(header, offsetof(SessionFileHeader, fileSize)) > static_cast<quint64>(this->file.size())){
+		*errorMessage = QObject::tr("Not a valid session file: ") + fileName;
+		this->close();
+		return false;
+	}
+
+	//metadata
+	this->info.bitDepth = readField<quint32>(header, offsetof(SessionFileHeader, bitDepth));
+	this->info.bytesPerSample = static_cast<int>(readField<quint32>(header, offsetof(SessionFileHeader, bytesPerSample)));
+	this->info.samplesPerLine = static_cast<int>(readField<quint32>(header, offsetof(SessionFileHeader, samplesPerLine)));
+	this->info.linesPerBuffer = static_cast<int>(readField<quint32>(header, offsetof(SessionFileHeader, linesPerBuffer)));
+	this->info.numberOfBuffers = static_cast<int>(readField<quint32>(header, offsetof(SessionFileHeader, numberOfBuffers)));
+	this->info.lostBuffers = static_cast<int>(readField<quint32>(header, offsetof(SessionFileHeader, lostBuffers)));
+	this->info.callbackCount = readField<quint64>(header, offsetof(SessionFileHeader, callbackCount));
+	this->info.callbackP50Ns = static_cast<qint64>(readField<quint64>(header, offsetof(SessionFileHeader, callbackP50Ns)));
+	this->info.callbackP99Ns = static_cast<qint64>(readField<quint64>(header, offsetof(SessionFileHeader, callbackP99Ns)));
+	this->info.callbackMaxNs = static_cast<qint64>(readField<quint64>(header, offsetof(SessionFileHeader, callbackMaxNs)));
+	bool compressed = readField<quint32>(header, offsetof(SessionFileHeader, compressed)) != 0;
+	quint64 rawOffset = readField<quint64>(header, offsetof(SessionFileHeader, rawOffset));
+	quint64 rawSize = readField<quint64>(header, offsetof(SessionFileHeader, rawSize));
+	quint64 rawStoredSize = readField<quint64>(header, offsetof(SessionFileHeader, rawStoredSize));
+
+	this->file.seek(readField<quint64>(header, offsetof(SessionFileHeader, bufferIdsOffset)));
+	QByteArray bufferIds = this->file.read(this->info.numberOfBuffers*sizeof(quint32));
+	this->info.bufferIds.resize(bufferIds.size()/static_cast<int>(sizeof(quint32)));
+	for(int i = 0; i < this->info.bufferIds.size(); i++){
+		this->info.bufferIds[i] = qFromLittleEndian<quint32>(bufferIds.constData() + i*sizeof(quint32));
+	}
+	this->file.seek(readField<quint64>(header, offsetof(SessionFileHeader, settingsOffset)));
+	this->info.settings = QJsonDocument::fromJson(this->file.read(readField<quint64>(header, offsetof(SessionFileHeader, settingsSize)))).object().toVariantMap();
+
+	//stored stage results are shown right away, without averaging the capture again
+	quint64 resultsSize = readField<quint64>(header, offsetof(SessionFileHeader, resultsSize));
+	if(resultsSize > 0){
+		this->file.seek(readField<quint64>(header, offsetof(SessionFileHeader, resultsOffset)));
+		NpyArchive archive;
+		if(archive.fromByteArray(this->file.read(resultsSize))){
+			AnalysisResult* storedResult = new AnalysisResult();
+			archive.getAnalysisResult(storedResult);
+			PhaseExtractionEngineBase::getSpectrumRange(storedResult->spectrum, SPECTRUM_POS_AFTER_DC, &storedResult->spectrumMinAfterDC, &storedResult->spectrumMaxAfterDC);
+			this->result = AnalysisResultPtr(storedResult);
+		}
+	}
+
+	//raw payload
+	if(!compressed){
+		this->mappedData = this->file.map(rawOffset, rawSize);
+		if(this->mappedData == nullptr){
+			this->close();
+			return false;
+		}
+		this->rawData = this->mappedData;
+		this->rawSize = rawSize;
+	}else{
+		quint64 chunkCount = readField<quint64>(header, offsetof(SessionFileHeader, chunkCount));
+		quint64 chunkSize = readField<quint64>(header, offsetof(SessionFileHeader, chunkSize));
+		//every chunk except the last one decompresses to chunkSize bytes, so the chunk table has to cover the raw payload exactly. The table is read into one QByteArray
+		if(chunkSize == 0 || chunkCount != rawSize/chunkSize + (rawSize % chunkSize != 0 ? 1 : 0) || chunkCount > static_cast<quint64>(INT_MAX)/(2*sizeof(quint64))){
+			*errorMessage = QObject::tr("Session file is corrupted: ") + fileName;
+			this->close();
+			return false;
+		}
+		this->file.seek(readField<quint64>(header, offsetof(SessionFileHeader, chunkTableOffset)));
+		QByteArray chunkTable = this->file.read(chunkCount*2*sizeof(quint64));
+		uchar* storedData = this->file.map(rawOffset, rawStoredSize);
+		this->rawData = static_cast<unsigned char*>(malloc(rawSize));
+		if(static_cast<quint64>(chunkTable.size()) != chunkCount*2*sizeof(quint64) || storedData == nullptr || this->rawData == nullptr){
+			if(storedData != nullptr){
+				this->file.unmap(storedData);
+			}
+			this->close();
+			return false;
+		}
+		QVector<SessionChunk> chunks(static_cast<int>(chunkCount));
+		bool valid = true;
+		for(int i = 0; i < chunks.size(); i++){
+			quint64 offset = qFromLittleEndian<quint64>(chunkTable.constData() + i*2*sizeof(quint64));
+			quint64 size = qFromLittleEndian<quint64>(chunkTable.constData() + (i*2+1)*sizeof(quint64));
+			valid = valid && offset <= rawStoredSize && size <= rawStoredSize - offset;
+			chunks[i].source = storedData + offset;
+			chunks[i].sourceSize = static_cast<qint64>(size);
+			chunks[i].destination = this->rawData + i*chunkSize;
+			chunks[i].destinationSize = static_cast<qint64>(qMin(chunkSize, rawSize - i*chunkSize));
+		}
+		if(valid){
+			QtConcurrent::blockingMap(chunks, [](SessionChunk& chunk) {
+				QByteArray data = qUncompress(chunk.source, static_cast<int>(chunk.sourceSize));
+				chunk.valid = data.size() == chunk.destinationSize;
+				if(chunk.valid){
+					memcpy(chunk.destination, data.constData(), data.size());
+				}
+			});
+			for(int i = 0; i < chunks.size(); i++){
+				valid = valid && chunks.at(i).valid;
+			}
+		}
+		this->file.unmap(storedData);
+		if(!valid){
+			*errorMessage = QObject::tr("Session file is corrupted: ") + fileName;
+			this->close();
+			return false;
+		}
+		this->rawSize = rawSize;
+	}
+	errorMessage->clear();
+	return true;
+}
+
+void SessionFile::close() {
+	if(this->mappedData != nullptr){
+		this->file.unmap(this->mappedData);
+	}else{
+		free(this->rawData);
+	}
+	this->mappedData = nullptr;
+	this->rawData = nullptr;
+	this->rawSize = 0;
+	this->result.reset();
+	this->info = SessionInfo();
+	if(this->file.isOpen()){
+		this->file.close();
+	}
+}
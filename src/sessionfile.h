@@ -0,0 +1,121 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#ifndef SESSIONFILE_H
+#define SESSIONFILE_H
+
+#include <QVector>
+#include <QString>
+#include <QVariantMap>
+#include <QFile>
+#include "analysisresult.h"
+
+#define SESSIONFILE_MAGIC 0x53534550 //"PESS" little endian
+#define SESSIONFILE_VERSION 1
+#define SESSIONFILE_HEADER_SIZE 256
+#define SESSIONFILE_PAYLOAD_ALIGNMENT 4096 //raw payload starts at a page boundary so it can be memory mapped and used in place
+#define SESSIONFILE_CHUNK_SIZE (16*1024*1024) //compressed payloads are split into chunks that are (de)compressed in parallel
+#define SESSIONFILE_COMPRESSION_LEVEL 1
+
+//Header of the session file, all offsets are bytes from the start of the file
+struct SessionFileHeader {
+	quint32 magic;
+	quint32 version;
+	quint32 bitDepth;
+	quint32 bytesPerSample;
+	quint32 samplesPerLine;
+	quint32 linesPerBuffer;
+	quint32 numberOfBuffers;
+	quint32 lostBuffers; //0xffffffff if lost buffers could not be detected
+	quint32 compressed;
+	quint32 reserved;
+	quint64 bufferIdsOffset;
+	quint64 settingsOffset;
+	quint64 settingsSize;
+	quint64 resultsOffset;
+	quint64 resultsSize;
+	quint64 chunkTableOffset; //per chunk: uint64 offset relative to rawOffset, uint64 stored size
+	quint64 chunkCount;
+	quint64 chunkSize; //uncompressed size of every chunk except the last one
+	quint64 rawOffset;
+	quint64 rawSize; //uncompressed
+	quint64 rawStoredSize;
+	quint64 fileSize;
+	quint64 callbackCount; //acquisition statistics of rawDataReceived since activation of the extension
+	quint64 callbackP50Ns;
+	quint64 callbackP99Ns;
+	quint64 callbackMaxNs;
+};
+
+//Acquisition metadata of a session
+struct SessionInfo {
+	SessionInfo() : bitDepth(0), bytesPerSample(0), samplesPerLine(0), linesPerBuffer(0), numberOfBuffers(0), lostBuffers(0), callbackCount(0), callbackP50Ns(0), callbackP99Ns(0), callbackMaxNs(0) {}
+
+	unsigned int bitDepth;
+	int bytesPerSample;
+	int samplesPerLine;
+	int linesPerBuffer;
+	int numberOfBuffers;
+	int lostBuffers; //buffer id gaps while the session was fetched, -1 if the host sent only one buffer per volume and gaps could not be detected
+	quint64 callbackCount;
+	qint64 callbackP50Ns;
+	qint64 callbackP99Ns;
+	qint64 callbackMaxNs;
+	QVector<unsigned int> bufferIds;
+	QVariantMap settings; //PhaseExtractionExtensionParameters as stored by PhaseExtractionExtensionForm::getSettings
+};
+
+//Session file with raw capture, acquisition metadata, parameters and calculated stage results.
+//Layout (little endian): 256 byte header, buffer ids (uint32), settings (json), stage results (npz, see NpyArchive), chunk table (compressed sessions only) and the raw payload at the next 4096 byte boundary.
+//Uncompressed payloads are memory mapped when the session is opened, so opening does not depend on the capture size. Compressed payloads are stored as zlib chunks and decompressed in parallel into memory.
+class SessionFile
+{
+public:
+	SessionFile();
+	~SessionFile();
+
+	static bool save(const QString& fileName, const unsigned char* rawData, size_t rawSize, const SessionInfo& info, const AnalysisResult* result, bool compress, QString* errorMessage);
+	bool open(const QString& fileName, QString* errorMessage);
+	void close();
+
+	unsigned char* getRawData() { return this->rawData; } //valid until close() or destruction
+	size_t getRawSize() const { return this->rawSize; }
+	bool isMapped() const { return this->mappedData != nullptr; }
+	const SessionInfo& getInfo() const { return this->info; }
+	AnalysisResultPtr getResult() const { return this->result; }
+
+private:
+	QFile file;
+	uchar* mappedData;
+	unsigned char* rawData;
+	size_t rawSize;
+	SessionInfo info;
+	AnalysisResultPtr result;
+};
+
+#endif // SESSIONFILE_H
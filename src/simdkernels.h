@@ -0,0 +1,202 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#ifndef SIMDKERNELS_H
+#define SIMDKERNELS_H
+
+//Vectorized versions of the KernelTable kernels, written once for a vector type V that wraps the intrinsics of one instruction set and scalar type.
+//Only included by the instruction set translation units after their target pragma. Everything is in an anonymous namespace and no library functions
+//are called, so no code that needs a newer instruction set can end up in functions shared with other translation units. Tails are processed
+//as one vector on a zero padded copy, so they give the same results as the other lanes.
+namespace {
+
+template <typename T>
+inline void copyValues(T* dest, const T* src, int size) {
+	for(int i = 0; i < size; i++){
+		dest[i] = src[i];
+	}
+}
+
+template <typename V>
+struct SimdKernels {
+	typedef typename V::Scalar T;
+	typedef typename V::Vector Vector;
+	typedef typename V::Mask Mask;
+
+	static void decodeLine(const uint16_t* src, int size, T* dest) {
+		int i = 0;
+		for(; i + V::width <= size; i += V::width){
+			V::store(dest + i, V::loadU16(src + i));
+		}
+		if(i < size){
+			uint16_t tail[V::width] = {};
+			T result[V::width];
+			copyValues(tail, src + i, size - i);
+			V::store(result, V::loadU16(tail));
+			copyValues(dest + i, result, size - i);
+		}
+	}
+
+	static void accumulateLines(const uint16_t* src, int samplesPerLine, size_t firstLine, int numberOfLines, int lineStep, int size, T* dest) {
+		//lines are added in the same order as by the scalar reference, so the sums are identical
+		int vectorEnd = size - size % V::width;
+		for(int n = 0; n < numberOfLines; n++){
+			const uint16_t* lineStart = src + (firstLine + static_cast<size_t>(n)*lineStep)*samplesPerLine;
+			for(int i = 0; i < vectorEnd; i += V::width){
+				V::store(dest + i, V::add(V::load(dest + i), V::loadU16(lineStart + i)));
+			}
+			for(int i = vectorEnd; i < size; i++){
+				dest[i] += static_cast<T>(lineStart[i]);
+			}
+		}
+	}
+
+	static void applyWindow(T* signal, int size, const T* window) {
+		int i = 0;
+		for(; i + V::width <= size; i += V::width){
+			V::store(signal + i, V::mul(V::load(signal + i), V::load(window + i)));
+		}
+		for(; i < size; i++){
+			signal[i] *= window[i];
+		}
+	}
+
+	static Vector atan2(Vector y, Vector x) {
+		//the smaller of |x| and |y| divided by the larger one is in [0, 1]. Values above tan(pi/8) are reduced with atan(a) = pi/4 + atan((a-1)/(a+1)),
+		//the remaining range is covered by the minimax polynomial of the cephes atanf. The octant is restored from the signs and the order of |x| and |y|
+		const Vector zero = V::zero();
+		const Vector one = V::set1(1);
+		Vector absX = V::abs(x);
+		Vector absY = V::abs(y);
+		Vector larger = V::max(absX, absY);
+		Vector smaller = V::min(absX, absY);
+		Vector a = V::div(smaller, V::select(V::cmpeq(larger, zero), one, larger));
+		Mask reduce = V::cmpgt(a, V::set1(static_cast<T>(0.414213562373095)));
+		a = V::select(reduce, V::div(V::sub(a, one), V::add(a, one)), a);
+		Vector z = V::mul(a, a);
+		Vector polynomial = V::fmadd(V::set1(static_cast<T>(8.05374449538e-2)), z, V::set1(static_cast<T>(-1.38776856032e-1)));
+		polynomial = V::fmadd(polynomial, z, V::set1(static_cast<T>(1.99777106478e-1)));
+		polynomial = V::fmadd(polynomial, z, V::set1(static_cast<T>(-3.33329491539e-1)));
+		Vector result = V::fmadd(V::mul(polynomial, z), a, a);
+		result = V::add(result, V::select(reduce, V::set1(static_cast<T>(0.785398163397448)), zero));
+		result = V::select(V::cmpgt(absY, absX), V::sub(V::set1(static_cast<T>(1.570796326794897)), result), result);
+		result = V::select(V::cmplt(x, zero), V::sub(V::set1(static_cast<T>(3.141592653589793)), result), result);
+		return V::select(V::cmplt(y, zero), V::sub(zero, result), result);
+	}
+
+	static void calculatePhase(const T (*signal)[2], int size, T* phase) {
+		Vector real;
+		Vector imag;
+		int i = 0;
+		for(; i + V::width <= size; i += V::width){
+			V::deinterleave(&signal[i][0], &real, &imag);
+			V::store(phase + i, atan2(imag, real));
+		}
+		if(i < size){
+			T tail[2*V::width] = {};
+			T result[V::width];
+			copyValues(tail, &signal[i][0], 2*(size - i));
+			V::deinterleave(tail, &real, &imag);
+			V::store(result, atan2(imag, real));
+			copyValues(phase + i, result, size - i);
+		}
+	}
+
+	static void unwrapPhase(T* phase, int size) {
+		//jumps of the wrapped phase are counted as whole cycles (-1, 0 or 1 per sample) and summed up within the vector, the count of the previous vectors is carried along.
+		//Cycle counts are small integers and exact in floating point, so the result is the same as with the sequential scalar reference
+		if(size < 2){
+			return;
+		}
+		const Vector pi = V::set1(static_cast<T>(3.141592653589793));
+		const Vector minusPi = V::set1(static_cast<T>(-3.141592653589793));
+		const Vector twoPi = V::set1(static_cast<T>(6.283185307179586));
+		T previous = phase[0];
+		T carry = 0;
+		int i = 1;
+		for(; i + V::width <= size; i += V::width){
+			Vector current = V::load(phase + i);
+			Vector diff = V::sub(current, V::shiftIn(current, previous));
+			Vector cycles = V::sub(V::maskedOne(V::cmplt(diff, minusPi)), V::maskedOne(V::cmpgt(diff, pi)));
+			cycles = V::add(V::prefixSum(cycles), V::set1(carry));
+			previous = V::lastLane(current);
+			carry = V::lastLane(cycles);
+			V::store(phase + i, V::add(current, V::mul(cycles, twoPi)));
+		}
+		const T scalarPi = static_cast<T>(3.141592653589793);
+		const T scalarTwoPi = static_cast<T>(6.283185307179586);
+		for(; i < size; i++){
+			T current = phase[i];
+			T diff = current - previous;
+			if(diff > scalarPi){
+				carry -= 1;
+			}
+			if(diff < -scalarPi){
+				carry += 1;
+			}
+			previous = current;
+			phase[i] = current + carry*scalarTwoPi;
+		}
+	}
+
+	static void evaluatePolynomial(const T* coeffs, int order, T* dest, int size) {
+		//Horner's method for W consecutive positions at once
+		Vector x = V::iota();
+		const Vector step = V::set1(static_cast<T>(V::width));
+		int i = 0;
+		for(; i < size; i += V::width){
+			Vector value = V::zero();
+			for(int j = order; j >= 0; j--){
+				value = V::fmadd(value, x, V::set1(coeffs[j]));
+			}
+			if(i + V::width <= size){
+				V::store(dest + i, value);
+			}else{
+				T result[V::width];
+				V::store(result, value);
+				copyValues(dest + i, result, size - i);
+			}
+			x = V::add(x, step);
+		}
+	}
+
+	static void fill(KernelTable<T>* kernels, bool phase) {
+		kernels->decodeLine = &decodeLine;
+		kernels->accumulateLines = &accumulateLines;
+		kernels->applyWindow = &applyWindow;
+		if(phase){
+			kernels->calculatePhase = &calculatePhase;
+		}
+		kernels->unwrapPhase = &unwrapPhase;
+		kernels->evaluatePolynomial = &evaluatePolynomial;
+	}
+};
+
+}
+
+#endif // SIMDKERNELS_H
@@ -0,0 +1,164 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#include "kerneldispatch.h"
+
+#ifdef KERNELDISPATCH_X86
+#include <immintrin.h>
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2,fma"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#endif
+
+#include "simdkernels.h"
+
+namespace {
+
+struct Avx2Float {
+	typedef float Scalar;
+	typedef __m256 Vector;
+	typedef __m256 Mask;
+	static const int width = 8;
+
+	static Vector load(const float* src) { return _mm256_loadu_ps(src); }
+	static void store(float* dest, Vector v) { _mm256_storeu_ps(dest, v); }
+	static Vector set1(float value) { return _mm256_set1_ps(value); }
+	static Vector zero() { return _mm256_setzero_ps(); }
+	static Vector iota() { return _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7); }
+	static Vector add(Vector a, Vector b) { return _mm256_add_ps(a, b); }
+	static Vector sub(Vector a, Vector b) { return _mm256_sub_ps(a, b); }
+	static Vector mul(Vector a, Vector b) { return _mm256_mul_ps(a, b); }
+	static Vector div(Vector a, Vector b) { return _mm256_div_ps(a, b); }
+	static Vector fmadd(Vector a, Vector b, Vector c) { return _mm256_fmadd_ps(a, b, c); }
+	static Vector min(Vector a, Vector b) { return _mm256_min_ps(a, b); }
+	static Vector max(Vector a, Vector b) { return _mm256_max_ps(a, b); }
+	static Vector abs(Vector a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+	static Mask cmplt(Vector a, Vector b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	static Mask cmpgt(Vector a, Vector b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+	static Mask cmpeq(Vector a, Vector b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+	static Vector select(Mask m, Vector a, Vector b) { return _mm256_blendv_ps(b, a, m); }
+	static Vector maskedOne(Mask m) { return _mm256_and_ps(m, _mm256_set1_ps(1.0f)); }
+	static Vector loadU16(const uint16_t* src) {
+		return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src))));
+	}
+	static Vector shiftIn(Vector v, float first) { //(first, v0, ..., v6)
+		return _mm256_blend_ps(_mm256_permutevar8x32_ps(v, _mm256_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6)), _mm256_set1_ps(first), 1);
+	}
+	static Vector prefixSum(Vector v) {
+		//within both 128 bit lanes, then the sum of the lower lane is added to the upper lane
+		v = _mm256_add_ps(v, _mm256_castsi256_ps(_mm256_slli_si256(_mm256_castps_si256(v), 4)));
+		v = _mm256_add_ps(v, _mm256_castsi256_ps(_mm256_slli_si256(_mm256_castps_si256(v), 8)));
+		Vector lowerSum = _mm256_permute_ps(v, _MM_SHUFFLE(3, 3, 3, 3));
+		return _mm256_add_ps(v, _mm256_permute2f128_ps(lowerSum, lowerSum, 0x08));
+	}
+	static float lastLane(Vector v) {
+		__m128 upper = _mm256_extractf128_ps(v, 1);
+		return _mm_cvtss_f32(_mm_shuffle_ps(upper, upper, _MM_SHUFFLE(3, 3, 3, 3)));
+	}
+	static void deinterleave(const float* src, Vector* real, Vector* imag) {
+		//in lane shuffles give the order 0 1 4 5 2 3 6 7, the 64 bit permutation restores 0 ... 7
+		Vector a = _mm256_loadu_ps(src);
+		Vector b = _mm256_loadu_ps(src + 8);
+		*real = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0)));
+		*imag = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0)));
+	}
+};
+
+struct Avx2Double {
+	typedef double Scalar;
+	typedef __m256d Vector;
+	typedef __m256d Mask;
+	static const int width = 4;
+
+	static Vector load(const double* src) { return _mm256_loadu_pd(src); }
+	static void store(double* dest, Vector v) { _mm256_storeu_pd(dest, v); }
+	static Vector set1(double value) { return _mm256_set1_pd(value); }
+	static Vector zero() { return _mm256_setzero_pd(); }
+	static Vector iota() { return _mm256_setr_pd(0, 1, 2, 3); }
+	static Vector add(Vector a, Vector b) { return _mm256_add_pd(a, b); }
+	static Vector sub(Vector a, Vector b) { return _mm256_sub_pd(a, b); }
+	static Vector mul(Vector a, Vector b) { return _mm256_mul_pd(a, b); }
+	static Vector div(Vector a, Vector b) { return _mm256_div_pd(a, b); }
+	static Vector fmadd(Vector a, Vector b, Vector c) { return _mm256_fmadd_pd(a, b, c); }
+	static Vector min(Vector a, Vector b) { return _mm256_min_pd(a, b); }
+	static Vector max(Vector a, Vector b) { return _mm256_max_pd(a, b); }
+	static Vector abs(Vector a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+	static Mask cmplt(Vector a, Vector b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+	static Mask cmpgt(Vector a, Vector b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+	static Mask cmpeq(Vector a, Vector b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+	static Vector select(Mask m, Vector a, Vector b) { return _mm256_blendv_pd(b, a, m); }
+	static Vector maskedOne(Mask m) { return _mm256_and_pd(m, _mm256_set1_pd(1.0)); }
+	static Vector loadU16(const uint16_t* src) {
+		return _mm256_cvtepi32_pd(_mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src))));
+	}
+	static Vector shiftIn(Vector v, double first) { //(first, v0, v1, v2)
+		return _mm256_blend_pd(_mm256_permute4x64_pd(v, _MM_SHUFFLE(2, 1, 0, 0)), _mm256_set1_pd(first), 1);
+	}
+	static Vector prefixSum(Vector v) {
+		v = _mm256_add_pd(v, _mm256_castsi256_pd(_mm256_slli_si256(_mm256_castpd_si256(v), 8)));
+		Vector lowerSum = _mm256_permute_pd(v, 0xF);
+		return _mm256_add_pd(v, _mm256_permute2f128_pd(lowerSum, lowerSum, 0x08));
+	}
+	static double lastLane(Vector v) {
+		__m128d upper = _mm256_extractf128_pd(v, 1);
+		return _mm_cvtsd_f64(_mm_unpackhi_pd(upper, upper));
+	}
+	static void deinterleave(const double* src, Vector* real, Vector* imag) {
+		Vector a = _mm256_loadu_pd(src);
+		Vector b = _mm256_loadu_pd(src + 4);
+		*real = _mm256_permute4x64_pd(_mm256_unpacklo_pd(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+		*imag = _mm256_permute4x64_pd(_mm256_unpackhi_pd(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+	}
+};
+
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+bool fillAvx2Kernels(KernelTable<float>* floatKernels, KernelTable<double>* doubleKernels) {
+	SimdKernels<Avx2Float>::fill(floatKernels, true);
+	SimdKernels<Avx2Double>::fill(doubleKernels, false);
+	return true;
+}
+
+#else
+
+bool fillAvx2Kernels(KernelTable<float>* floatKernels, KernelTable<double>* doubleKernels) {
+	(void)floatKernels;
+	(void)doubleKernels;
+	return false;
+}
+
+#endif
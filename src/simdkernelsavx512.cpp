@@ -0,0 +1,176 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#include "kerneldispatch.h"
+
+#ifdef KERNELDISPATCH_X86
+//gcc reports the _mm512_undefined_* placeholders inside of the AVX-512 intrinsics (e.g. _mm512_permutexvar_ps) as maybe uninitialized
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#include <immintrin.h>
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx512f,avx2,fma"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx2,fma")
+#endif
+
+#include "simdkernels.h"
+
+namespace {
+
+//only AVX-512F instructions are used, so every AVX-512 cpu can run these kernels
+struct Avx512Float {
+	typedef float Scalar;
+	typedef __m512 Vector;
+	typedef __mmask16 Mask;
+	static const int width = 16;
+
+	static Vector load(const float* src) { return _mm512_loadu_ps(src); }
+	static void store(float* dest, Vector v) { _mm512_storeu_ps(dest, v); }
+	static Vector set1(float value) { return _mm512_set1_ps(value); }
+	static Vector zero() { return _mm512_setzero_ps(); }
+	static Vector iota() { return _mm512_setr_ps(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15); }
+	static Vector add(Vector a, Vector b) { return _mm512_add_ps(a, b); }
+	static Vector sub(Vector a, Vector b) { return _mm512_sub_ps(a, b); }
+	static Vector mul(Vector a, Vector b) { return _mm512_mul_ps(a, b); }
+	static Vector div(Vector a, Vector b) { return _mm512_div_ps(a, b); }
+	static Vector fmadd(Vector a, Vector b, Vector c) { return _mm512_fmadd_ps(a, b, c); }
+	static Vector min(Vector a, Vector b) { return _mm512_min_ps(a, b); }
+	static Vector max(Vector a, Vector b) { return _mm512_max_ps(a, b); }
+	static Vector abs(Vector a) { return _mm512_abs_ps(a); }
+	static Mask cmplt(Vector a, Vector b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+	static Mask cmpgt(Vector a, Vector b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+	static Mask cmpeq(Vector a, Vector b) { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+	static Vector select(Mask m, Vector a, Vector b) { return _mm512_mask_blend_ps(m, b, a); }
+	static Vector maskedOne(Mask m) { return _mm512_maskz_mov_ps(m, _mm512_set1_ps(1.0f)); }
+	static Vector loadU16(const uint16_t* src) {
+		return _mm512_cvtepi32_ps(_mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src))));
+	}
+	static Vector shiftIn(Vector v, float first) { //(first, v0, ..., v14)
+		__m512i previousLane = _mm512_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14);
+		return _mm512_mask_blend_ps(1, _mm512_permutexvar_ps(previousLane, v), _mm512_set1_ps(first));
+	}
+	static Vector prefixSum(Vector v) {
+		//lane i adds lane i-shift, lanes below shift are zeroed by the mask
+		__m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+		v = _mm512_add_ps(v, _mm512_maskz_permutexvar_ps(0xFFFE, _mm512_sub_epi32(lanes, _mm512_set1_epi32(1)), v));
+		v = _mm512_add_ps(v, _mm512_maskz_permutexvar_ps(0xFFFC, _mm512_sub_epi32(lanes, _mm512_set1_epi32(2)), v));
+		v = _mm512_add_ps(v, _mm512_maskz_permutexvar_ps(0xFFF0, _mm512_sub_epi32(lanes, _mm512_set1_epi32(4)), v));
+		return _mm512_add_ps(v, _mm512_maskz_permutexvar_ps(0xFF00, _mm512_sub_epi32(lanes, _mm512_set1_epi32(8)), v));
+	}
+	static float lastLane(Vector v) {
+		__m128 upper = _mm512_extractf32x4_ps(v, 3);
+		return _mm_cvtss_f32(_mm_shuffle_ps(upper, upper, _MM_SHUFFLE(3, 3, 3, 3)));
+	}
+	static void deinterleave(const float* src, Vector* real, Vector* imag) {
+		Vector a = _mm512_loadu_ps(src);
+		Vector b = _mm512_loadu_ps(src + 16);
+		*real = _mm512_permutex2var_ps(a, _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30), b);
+		*imag = _mm512_permutex2var_ps(a, _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31), b);
+	}
+};
+
+struct Avx512Double {
+	typedef double Scalar;
+	typedef __m512d Vector;
+	typedef __mmask8 Mask;
+	static const int width = 8;
+
+	static Vector load(const double* src) { return _mm512_loadu_pd(src); }
+	static void store(double* dest, Vector v) { _mm512_storeu_pd(dest, v); }
+	static Vector set1(double value) { return _mm512_set1_pd(value); }
+	static Vector zero() { return _mm512_setzero_pd(); }
+	static Vector iota() { return _mm512_setr_pd(0, 1, 2, 3, 4, 5, 6, 7); }
+	static Vector add(Vector a, Vector b) { return _mm512_add_pd(a, b); }
+	static Vector sub(Vector a, Vector b) { return _mm512_sub_pd(a, b); }
+	static Vector mul(Vector a, Vector b) { return _mm512_mul_pd(a, b); }
+	static Vector div(Vector a, Vector b) { return _mm512_div_pd(a, b); }
+	static Vector fmadd(Vector a, Vector b, Vector c) { return _mm512_fmadd_pd(a, b, c); }
+	static Vector min(Vector a, Vector b) { return _mm512_min_pd(a, b); }
+	static Vector max(Vector a, Vector b) { return _mm512_max_pd(a, b); }
+	static Vector abs(Vector a) { return _mm512_abs_pd(a); }
+	static Mask cmplt(Vector a, Vector b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+	static Mask cmpgt(Vector a, Vector b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+	static Mask cmpeq(Vector a, Vector b) { return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ); }
+	static Vector select(Mask m, Vector a, Vector b) { return _mm512_mask_blend_pd(m, b, a); }
+	static Vector maskedOne(Mask m) { return _mm512_maskz_mov_pd(m, _mm512_set1_pd(1.0)); }
+	static Vector loadU16(const uint16_t* src) {
+		return _mm512_cvtepi32_pd(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src))));
+	}
+	static Vector shiftIn(Vector v, double first) { //(first, v0, ..., v6)
+		__m512i previousLane = _mm512_setr_epi64(0, 0, 1, 2, 3, 4, 5, 6);
+		return _mm512_mask_blend_pd(1, _mm512_permutexvar_pd(previousLane, v), _mm512_set1_pd(first));
+	}
+	static Vector prefixSum(Vector v) {
+		__m512i lanes = _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7);
+		v = _mm512_add_pd(v, _mm512_maskz_permutexvar_pd(0xFE, _mm512_sub_epi64(lanes, _mm512_set1_epi64(1)), v));
+		v = _mm512_add_pd(v, _mm512_maskz_permutexvar_pd(0xFC, _mm512_sub_epi64(lanes, _mm512_set1_epi64(2)), v));
+		return _mm512_add_pd(v, _mm512_maskz_permutexvar_pd(0xF0, _mm512_sub_epi64(lanes, _mm512_set1_epi64(4)), v));
+	}
+	static double lastLane(Vector v) {
+		__m128d upper = _mm256_extractf128_pd(_mm512_extractf64x4_pd(v, 1), 1);
+		return _mm_cvtsd_f64(_mm_unpackhi_pd(upper, upper));
+	}
+	static void deinterleave(const double* src, Vector* real, Vector* imag) {
+		Vector a = _mm512_loadu_pd(src);
+		Vector b = _mm512_loadu_pd(src + 8);
+		*real = _mm512_permutex2var_pd(a, _mm512_setr_epi64(0, 2, 4, 6, 8, 10, 12, 14), b);
+		*imag = _mm512_permutex2var_pd(a, _mm512_setr_epi64(1, 3, 5, 7, 9, 11, 13, 15), b);
+	}
+};
+
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+bool fillAvx512Kernels(KernelTable<float>* floatKernels, KernelTable<double>* doubleKernels) {
+	SimdKernels<Avx512Float>::fill(floatKernels, true);
+	SimdKernels<Avx512Double>::fill(doubleKernels, false);
+	return true;
+}
+
+#else
+
+bool fillAvx512Kernels(KernelTable<float>* floatKernels, KernelTable<double>* doubleKernels) {
+	(void)floatKernels;
+	(void)doubleKernels;
+	return false;
+}
+
+#endif
@@ -0,0 +1,152 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#include "kerneldispatch.h"
+
+#ifdef KERNELDISPATCH_X86
+#include <cstring>
+#include <emmintrin.h>
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("sse2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#endif
+
+#include "simdkernels.h"
+
+namespace {
+
+struct Sse2Float {
+	typedef float Scalar;
+	typedef __m128 Vector;
+	typedef __m128 Mask;
+	static const int width = 4;
+
+	static Vector load(const float* src) { return _mm_loadu_ps(src); }
+	static void store(float* dest, Vector v) { _mm_storeu_ps(dest, v); }
+	static Vector set1(float value) { return _mm_set1_ps(value); }
+	static Vector zero() { return _mm_setzero_ps(); }
+	static Vector iota() { return _mm_setr_ps(0, 1, 2, 3); }
+	static Vector add(Vector a, Vector b) { return _mm_add_ps(a, b); }
+	static Vector sub(Vector a, Vector b) { return _mm_sub_ps(a, b); }
+	static Vector mul(Vector a, Vector b) { return _mm_mul_ps(a, b); }
+	static Vector div(Vector a, Vector b) { return _mm_div_ps(a, b); }
+	static Vector fmadd(Vector a, Vector b, Vector c) { return _mm_add_ps(_mm_mul_ps(a, b), c); } //sse2 has no fused multiply add
+	static Vector min(Vector a, Vector b) { return _mm_min_ps(a, b); }
+	static Vector max(Vector a, Vector b) { return _mm_max_ps(a, b); }
+	static Vector abs(Vector a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+	static Mask cmplt(Vector a, Vector b) { return _mm_cmplt_ps(a, b); }
+	static Mask cmpgt(Vector a, Vector b) { return _mm_cmpgt_ps(a, b); }
+	static Mask cmpeq(Vector a, Vector b) { return _mm_cmpeq_ps(a, b); }
+	static Vector select(Mask m, Vector a, Vector b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+	static Vector maskedOne(Mask m) { return _mm_and_ps(m, _mm_set1_ps(1.0f)); }
+	static Vector loadU16(const uint16_t* src) {
+		return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src)), _mm_setzero_si128()));
+	}
+	static Vector shiftIn(Vector v, float first) { //(first, v0, v1, v2)
+		return _mm_move_ss(_mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4)), _mm_set_ss(first));
+	}
+	static Vector prefixSum(Vector v) {
+		v = _mm_add_ps(v, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4)));
+		return _mm_add_ps(v, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 8)));
+	}
+	static float lastLane(Vector v) { return _mm_cvtss_f32(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))); }
+	static void deinterleave(const float* src, Vector* real, Vector* imag) {
+		Vector a = _mm_loadu_ps(src);
+		Vector b = _mm_loadu_ps(src + 4);
+		*real = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+		*imag = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+	}
+};
+
+struct Sse2Double {
+	typedef double Scalar;
+	typedef __m128d Vector;
+	typedef __m128d Mask;
+	static const int width = 2;
+
+	static Vector load(const double* src) { return _mm_loadu_pd(src); }
+	static void store(double* dest, Vector v) { _mm_storeu_pd(dest, v); }
+	static Vector set1(double value) { return _mm_set1_pd(value); }
+	static Vector zero() { return _mm_setzero_pd(); }
+	static Vector iota() { return _mm_setr_pd(0, 1); }
+	static Vector add(Vector a, Vector b) { return _mm_add_pd(a, b); }
+	static Vector sub(Vector a, Vector b) { return _mm_sub_pd(a, b); }
+	static Vector mul(Vector a, Vector b) { return _mm_mul_pd(a, b); }
+	static Vector div(Vector a, Vector b) { return _mm_div_pd(a, b); }
+	static Vector fmadd(Vector a, Vector b, Vector c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+	static Vector min(Vector a, Vector b) { return _mm_min_pd(a, b); }
+	static Vector max(Vector a, Vector b) { return _mm_max_pd(a, b); }
+	static Vector abs(Vector a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+	static Mask cmplt(Vector a, Vector b) { return _mm_cmplt_pd(a, b); }
+	static Mask cmpgt(Vector a, Vector b) { return _mm_cmpgt_pd(a, b); }
+	static Mask cmpeq(Vector a, Vector b) { return _mm_cmpeq_pd(a, b); }
+	static Vector select(Mask m, Vector a, Vector b) { return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+	static Vector maskedOne(Mask m) { return _mm_and_pd(m, _mm_set1_pd(1.0)); }
+	static Vector loadU16(const uint16_t* src) {
+		int32_t samples;
+		memcpy(&samples, src, sizeof(samples));
+		return _mm_cvtepi32_pd(_mm_unpacklo_epi16(_mm_cvtsi32_si128(samples), _mm_setzero_si128()));
+	}
+	static Vector shiftIn(Vector v, double first) { return _mm_shuffle_pd(_mm_set_sd(first), v, 0); } //(first, v0)
+	static Vector prefixSum(Vector v) { return _mm_add_pd(v, _mm_castsi128_pd(_mm_slli_si128(_mm_castpd_si128(v), 8))); }
+	static double lastLane(Vector v) { return _mm_cvtsd_f64(_mm_unpackhi_pd(v, v)); }
+	static void deinterleave(const double* src, Vector* real, Vector* imag) {
+		Vector a = _mm_loadu_pd(src);
+		Vector b = _mm_loadu_pd(src + 2);
+		*real = _mm_unpacklo_pd(a, b);
+		*imag = _mm_unpackhi_pd(a, b);
+	}
+};
+
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+bool fillSse2Kernels(KernelTable<float>* floatKernels, KernelTable<double>* doubleKernels) {
+	//the polynomial atan2 is accurate to single precision, double precision keeps the scalar phase
+	SimdKernels<Sse2Float>::fill(floatKernels, true);
+	SimdKernels<Sse2Double>::fill(doubleKernels, false);
+	return true;
+}
+
+#else
+
+bool fillSse2Kernels(KernelTable<float>* floatKernels, KernelTable<double>* doubleKernels) {
+	(void)floatKernels;
+	(void)doubleKernels;
+	return false;
+}
+
+#endif
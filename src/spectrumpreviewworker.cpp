@@ -0,0 +1,102 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#include "spectrumpreviewworker.h"
+
+
+SpectrumPreviewWorker::SpectrumPreviewWorker(QObject *parent) : QObject(parent)
+{
+	this->pendingBuffer.storeRelease(nullptr);
+	this->bytesPerSample = 0;
+	this->samplesPerLine = 0;
+	this->linesPerBuffer = 0;
+	this->windowRaw = false;
+	this->engine = new PhaseExtractionEngine<double>(&this->fftThreadPolicy);
+
+	//the timer is a child of the worker, so it is moved to the worker thread together with it
+	this->refreshTimer = new QTimer(this);
+	this->refreshTimer->setInterval(PREVIEW_REFRESH_INTERVAL_MS);
+	connect(this->refreshTimer, &QTimer::timeout, this, &SpectrumPreviewWorker::processPendingBuffer);
+}
+
+SpectrumPreviewWorker::~SpectrumPreviewWorker()
+{
+	delete this->engine;
+}
+
+void SpectrumPreviewWorker::setFormat(int bytesPerSample, int samplesPerLine, int linesPerBuffer) {
+	QMutexLocker locker(&this->bufferMutex);
+	this->pendingBuffer.storeRelease(nullptr);
+	this->bytesPerSample = bytesPerSample;
+	this->samplesPerLine = samplesPerLine;
+	this->linesPerBuffer = linesPerBuffer;
+}
+
+void SpectrumPreviewWorker::releaseBuffers() {
+	//the buffer is taken and processed while bufferMutex is held, so after this no offered buffer is accessed anymore
+	QMutexLocker locker(&this->bufferMutex);
+	this->pendingBuffer.storeRelease(nullptr);
+}
+
+void SpectrumPreviewWorker::setParams(PhaseExtractionExtensionParameters params) {
+	this->windowRaw = params.windowRaw;
+	if(params.livePreview && !this->refreshTimer->isActive()){
+		this->refreshTimer->start();
+	}else if(!params.livePreview && this->refreshTimer->isActive()){
+		this->refreshTimer->stop();
+		this->pendingBuffer.storeRelease(nullptr);
+	}
+}
+
+void SpectrumPreviewWorker::setFftParams(bool padToSmoothSize, int upsamplingFactor, bool multithreadedFft) {
+	//preview uses the same fft length as the calculator so peak positions match. Preview is always single threaded to keep its cpu load low
+	Q_UNUSED(multithreadedFft)
+	this->engine->setFftParams(padToSmoothSize, qMax(1, upsamplingFactor));
+}
+
+void SpectrumPreviewWorker::processPendingBuffer() {
+	QMutexLocker locker(&this->bufferMutex);
+	unsigned char* buffer = this->pendingBuffer.fetchAndStoreAcquire(nullptr);
+	if(buffer == nullptr || this->samplesPerLine <= 0 || this->linesPerBuffer <= 0){
+		return;
+	}
+
+	//average an evenly spaced subset of lines. This is enough to judge the position of the calibration reflector
+	int lineStep = qMax(1, this->linesPerBuffer/PREVIEW_MAX_LINES);
+	int numberOfLines = this->linesPerBuffer/lineStep;
+	this->engine->setData(buffer, this->bytesPerSample, this->samplesPerLine, this->linesPerBuffer);
+	this->engine->average(0, numberOfLines, this->windowRaw, nullptr, lineStep);
+	locker.unlock();
+
+	this->engine->forwardFft();
+	this->engine->getSpectrum(&this->spectrum);
+	qreal min = 0;
+	qreal max = 0;
+	PhaseExtractionEngineBase::getSpectrumRange(this->spectrum, SPECTRUM_POS_AFTER_DC, &min, &max);
+	emit spectrumCalculated(this->spectrum, min, max);
+}
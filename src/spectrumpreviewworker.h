@@ -0,0 +1,77 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#ifndef SPECTRUMPREVIEWWORKER_H
+#define SPECTRUMPREVIEWWORKER_H
+
+#include <QObject>
+#include <QVector>
+#include <QTimer>
+#include <QMutex>
+#include <QAtomicPointer>
+#include "phaseextractionengine.h"
+#include "extensionparameters.h"
+
+#define PREVIEW_REFRESH_INTERVAL_MS 100
+#define PREVIEW_MAX_LINES 64
+
+//Calculates a spectrum preview of buffers while they are fetched.
+//rawDataReceived only publishes a pointer to the buffer that was just copied into the fetch buffer. The worker picks up the latest published buffer at a capped rate on its own thread, averages a decimated subset of its lines and calculates the spectrum with the same fft settings as PhaseExtractionCalculator. Buffers that are published faster than they can be previewed are simply skipped.
+class SpectrumPreviewWorker : public QObject
+{
+	Q_OBJECT
+public:
+	explicit SpectrumPreviewWorker(QObject *parent = nullptr);
+	~SpectrumPreviewWorker();
+
+	void offerBuffer(unsigned char* buffer) { this->pendingBuffer.storeRelease(buffer); } //lock free, called from rawDataReceived
+	void setFormat(int bytesPerSample, int samplesPerLine, int linesPerBuffer);
+	void releaseBuffers(); //blocks until the worker does not access any previously offered buffer anymore
+
+private:
+	QAtomicPointer<unsigned char> pendingBuffer;
+	QMutex bufferMutex;
+	QTimer* refreshTimer;
+	FftwThreadPolicy fftThreadPolicy;
+	PhaseExtractionEngineBase* engine;
+	QVector<qreal> spectrum;
+	int bytesPerSample;
+	int samplesPerLine;
+	int linesPerBuffer;
+	bool windowRaw;
+
+public slots:
+	void setParams(PhaseExtractionExtensionParameters params);
+	void setFftParams(bool padToSmoothSize, int upsamplingFactor, bool multithreadedFft);
+	void processPendingBuffer();
+
+signals:
+	void spectrumCalculated(QVector<qreal> spectrum, qreal min, qreal max);
+};
+
+#endif // SPECTRUMPREVIEWWORKER_H
@@ -0,0 +1,137 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+
+#ifndef STAGETIMINGS_H
+#define STAGETIMINGS_H
+
+#include <QString>
+#include <QMetaType>
+#include <QElapsedTimer>
+#include "tracer.h"
+
+enum TimingStage {
+	TIMING_COPY, //memcpy of the fetched buffers in rawDataReceived, sum over all buffers of one fetch
+	TIMING_AVERAGE,
+	TIMING_FFT_PLAN, //last (re)planning of the fft plans, plans are only rebuilt if size or thread count changed
+	TIMING_FFT,
+	TIMING_WINDOW,
+	TIMING_IFFT,
+	TIMING_PHASE,
+	TIMING_UNWRAP,
+	TIMING_CURVE,
+	TIMING_FIT,
+	TIMING_EMIT,
+	TIMING_REPLOT, //last MiniCurvePlot replot
+	NUMBER_OF_TIMING_STAGES
+};
+
+//Wall clock durations of the calculation stages of one run. Stages that were not executed (e.g. because their result was cached) are -1
+struct StageTimings
+{
+	StageTimings() : runId(0), forwardFftThreads(0), backwardFftThreads(0), fftSize(0), upsampledSize(0) {
+		for(int i = 0; i < NUMBER_OF_TIMING_STAGES; i++){
+			this->durationNs[i] = -1;
+		}
+	}
+
+	bool isMeasured(TimingStage stage) const {return this->durationNs[stage] >= 0;}
+	void add(TimingStage stage, qint64 ns) {this->durationNs[stage] = qMax(this->durationNs[stage], static_cast<qint64>(0)) + ns;}
+
+	void merge(const StageTimings& other) {
+		//measured stages of other overwrite the stages of this record, everything else is kept
+		for(int i = 0; i < NUMBER_OF_TIMING_STAGES; i++){
+			if(other.durationNs[i] >= 0){
+				this->durationNs[i] = other.durationNs[i];
+			}
+		}
+		if(other.fftSize > 0){
+			this->runId = other.runId;
+			this->forwardFftThreads = other.forwardFftThreads;
+			this->backwardFftThreads = other.backwardFftThreads;
+			this->fftSize = other.fftSize;
+			this->upsampledSize = other.upsampledSize;
+		}
+	}
+
+	static const char* getStageName(TimingStage stage) {
+		static const char* names[NUMBER_OF_TIMING_STAGES] = {"copy", "average", "fft plan", "fft", "window", "ifft", "phase", "unwrap", "curve", "fit", "emit", "replot"};
+		return names[stage];
+	}
+
+	QString toString(const QString& separator = ", ") const {
+		QString text;
+		for(int i = 0; i < NUMBER_OF_TIMING_STAGES; i++){
+			if(this->durationNs[i] >= 0){
+				if(!text.isEmpty()){
+					text += separator;
+				}
+				text += QString(getStageName(static_cast<TimingStage>(i))) + ": " + QString::number(this->durationNs[i]/1000000.0, 'f', 3) + " ms";
+			}
+		}
+		if(this->fftSize > 0){
+			text += separator + "fft threads: " + QString::number(this->forwardFftThreads) + " (" + QString::number(this->fftSize) + "), ifft threads: "
+					+ QString::number(this->backwardFftThreads) + " (" + QString::number(this->upsampledSize) + ")";
+		}
+		return text;
+	}
+
+	quint64 runId;
+	qint64 durationNs[NUMBER_OF_TIMING_STAGES];
+	int forwardFftThreads;
+	int backwardFftThreads;
+	int fftSize;
+	int upsampledSize;
+};
+
+Q_DECLARE_METATYPE(StageTimings)
+
+//Measures the lifetime of the timer with the monotonic clock of QElapsedTimer and adds it to a stage of timings.
+//If timings is nullptr nothing is measured, so disabled instrumentation costs one pointer check per stage. Independent of timings the stage is recorded as trace event if the Tracer is enabled
+class StageTimer
+{
+public:
+	StageTimer(StageTimings* timings, TimingStage stage) : timings(timings), stage(stage), trace(StageTimings::getStageName(stage)) {
+		if(this->timings != nullptr){
+			this->timer.start();
+		}
+	}
+	~StageTimer() {
+		if(this->timings != nullptr){
+			this->timings->add(this->stage, this->timer.nsecsElapsed());
+		}
+	}
+
+private:
+	StageTimings* timings;
+	TimingStage stage;
+	QElapsedTimer timer;
+	TraceScope trace;
+};
+
+#endif // STAGETIMINGS_H
@@ -0,0 +1,221 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#include "tracer.h"
+#include <QThread>
+#include <QFile>
+#include <QVector>
+#include <QCoreApplication>
+#include <cstring>
+
+
+QAtomicInt Tracer::enabledFlag(0);
+QAtomicInteger<quint64> Tracer::droppedEvents(0);
+QScopedArrayPointer<TraceThreadBuffer> Tracer::buffers;
+QElapsedTimer Tracer::clock;
+QMutex Tracer::controlMutex;
+
+namespace {
+	QByteArray escape(const char* text) {
+		QByteArray escaped(text);
+		escaped.replace('\\', "\\\\");
+		escaped.replace('"', "\\\"");
+		return escaped;
+	}
+
+	//destroyed when the thread exits and returns the claimed buffer, so threads that are recreated by a thread pool do not use up all buffers
+	struct TraceBufferRelease {
+		TraceThreadBuffer* buffer = nullptr;
+		~TraceBufferRelease() {
+			if(this->buffer != nullptr){
+				this->buffer->claimed.storeRelease(0);
+			}
+		}
+	};
+}
+
+
+void Tracer::setEnabled(bool enabled) {
+	QMutexLocker locker(&controlMutex);
+	if(enabled && buffers.isNull()){
+		buffers.reset(new TraceThreadBuffer[TRACER_MAX_THREADS]);
+		for(int i = 0; i < TRACER_MAX_THREADS; i++){
+			buffers[i].written.storeRelease(0);
+			buffers[i].claimed.storeRelease(0);
+			buffers[i].owner.threadId = 0;
+			buffers[i].owner.firstEvent = 0;
+			buffers[i].owner.threadName[0] = '\0';
+			buffers[i].previousOwner = buffers[i].owner;
+		}
+		clock.start();
+	}
+
+	//enabling again starts a new trace. Buffers stay claimed by their threads, only their content is discarded
+	if(enabled && !isEnabled()){
+		for(int i = 0; i < TRACER_MAX_THREADS; i++){
+			buffers[i].written.storeRelease(0);
+			buffers[i].owner.firstEvent = 0;
+			buffers[i].previousOwner.threadId = 0;
+		}
+		droppedEvents.storeRelease(0);
+	}
+	enabledFlag.storeRelease(enabled ? 1 : 0);
+}
+
+TraceThreadBuffer* Tracer::getThreadBuffer() {
+	//a thread claims its buffer with its first event and keeps it until it exits. If all buffers are in use, the claim is tried again with the next event
+	static thread_local TraceThreadBuffer* threadBuffer = nullptr;
+	static thread_local TraceBufferRelease release;
+	if(threadBuffer == nullptr){
+		threadBuffer = claimBuffer();
+		release.buffer = threadBuffer;
+	}
+	return threadBuffer;
+}
+
+TraceThreadBuffer* Tracer::claimBuffer() {
+	//the owner is changed under the control mutex so save() sees consistent owners. Recording does not wait for a running save(), the event is dropped instead
+	if(!controlMutex.tryLock()){
+		return nullptr;
+	}
+	TraceThreadBuffer* buffer = nullptr;
+	int index = 0;
+	for(; index < TRACER_MAX_THREADS; index++){
+		if(buffers[index].claimed.testAndSetOrdered(0, 1)){
+			buffer = &buffers[index];
+			break;
+		}
+	}
+	if(buffer != nullptr){
+		//only the last owner with events in the buffer is remembered, older events are not exported anymore
+		quint64 written = buffer->written.loadAcquire();
+		if(buffer->owner.threadId != 0 && written > buffer->owner.firstEvent){
+			buffer->previousOwner = buffer->owner;
+		}
+		buffer->owner.threadId = static_cast<quint64>(reinterpret_cast<quintptr>(QThread::currentThreadId()));
+		buffer->owner.firstEvent = written;
+		buffer->owner.threadName[0] = '\0';
+		if(QThread::currentThread() != nullptr){
+			//objectName() is implicitly shared, the characters are converted one by one because toLatin1() would allocate
+			const QString name = QThread::currentThread()->objectName();
+			int length = qMin(name.size(), TRACER_THREAD_NAME_SIZE-1);
+			for(int i = 0; i < length; i++){
+				buffer->owner.threadName[i] = name.at(i).toLatin1();
+			}
+			buffer->owner.threadName[length] = '\0';
+		}
+		if(buffer->owner.threadName[0] == '\0'){
+			qsnprintf(buffer->owner.threadName, TRACER_THREAD_NAME_SIZE, "thread %d", index);
+		}
+	}
+	controlMutex.unlock();
+	return buffer;
+}
+
+void Tracer::record(const char* name, char phase, quint64 id) {
+	if(!isEnabled()){
+		return;
+	}
+	TraceThreadBuffer* buffer = getThreadBuffer();
+	if(buffer == nullptr){
+		droppedEvents.fetchAndAddRelaxed(1);
+		return;
+	}
+	quint64 position = buffer->written.loadAcquire();
+	TraceEvent& event = buffer->events[position % TRACER_EVENTS_PER_THREAD];
+	event.name = name;
+	event.timestamp = clock.nsecsElapsed();
+	event.id = id;
+	event.phase = phase;
+	buffer->written.storeRelease(position + 1);
+}
+
+bool Tracer::save(const QString& fileName, int* numberOfEvents) {
+	QMutexLocker locker(&controlMutex);
+	*numberOfEvents = 0;
+	QFile file(fileName);
+	if(buffers.isNull() || !file.open(QFile::WriteOnly|QFile::Truncate)){
+		return false;
+	}
+
+	//events are copied out of the ring buffers while the threads keep recording, so a copied event can be torn if its thread overwrote it during the copy.
+	//The written count is read again after the copy and every event whose slot may have been overwritten in the meantime is dropped
+	QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+	QByteArray json = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+	bool first = true;
+	QVector<TraceEvent> events;
+	for(int i = 0; i < TRACER_MAX_THREADS; i++){
+		const TraceThreadBuffer& buffer = buffers[i];
+		quint64 written = buffer.written.loadAcquire();
+		if(written == 0 || buffer.owner.threadId == 0){
+			continue;
+		}
+		quint64 copyStart = written > TRACER_EVENTS_PER_THREAD ? written - TRACER_EVENTS_PER_THREAD + TRACER_OVERWRITE_MARGIN : 0;
+		events.resize(static_cast<int>(written - copyStart));
+		for(quint64 n = copyStart; n < written; n++){
+			events[static_cast<int>(n - copyStart)] = buffer.events[n % TRACER_EVENTS_PER_THREAD];
+		}
+		quint64 start = copyStart;
+		quint64 writtenAfterCopy = buffer.written.loadAcquire();
+		if(writtenAfterCopy >= TRACER_EVENTS_PER_THREAD){
+			start = qMax(start, writtenAfterCopy - TRACER_EVENTS_PER_THREAD + 1); //the event at writtenAfterCopy may be in progress and overwrites the slot of this index
+		}
+
+		const TraceThreadInfo* owners[] = {&buffer.previousOwner, &buffer.owner};
+		for(const TraceThreadInfo* owner : owners){
+			quint64 ownerStart = qMax(start, owner->firstEvent);
+			quint64 ownerEnd = owner == &buffer.owner ? written : qMin(written, buffer.owner.firstEvent);
+			if(owner->threadId == 0 || ownerStart >= ownerEnd){
+				continue;
+			}
+			QByteArray tid = QByteArray::number(owner->threadId);
+			json += QByteArray(first ? "" : ",") + "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + pid + ",\"tid\":" + tid + ",\"args\":{\"name\":\"" + escape(owner->threadName) + "\"}}";
+			first = false;
+			for(quint64 n = ownerStart; n < ownerEnd; n++){
+				const TraceEvent& event = events[static_cast<int>(n - copyStart)];
+				json += ",\n{\"name\":\"" + escape(event.name) + "\",\"cat\":\"phaseextraction\",\"ph\":\"" + QByteArray(1, event.phase) + "\",\"ts\":"
+						+ QByteArray::number(event.timestamp/1000.0, 'f', 3) + ",\"pid\":" + pid + ",\"tid\":" + tid;
+				if(event.phase == 's' || event.phase == 'f'){
+					json += ",\"id\":" + QByteArray::number(event.id);
+					if(event.phase == 'f'){
+						json += ",\"bp\":\"e\"";
+					}
+				}
+				if(event.phase == 'i'){
+					json += ",\"s\":\"t\"";
+				}
+				json += "}";
+			}
+			*numberOfEvents += static_cast<int>(ownerEnd - ownerStart);
+		}
+	}
+	json += "\n]}\n";
+	bool written = file.write(json) == json.size();
+	file.close();
+	return written;
+}
@@ -0,0 +1,115 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QScopedArrayPointer>
+
+#define TRACER_MAX_THREADS 16
+#define TRACER_EVENTS_PER_THREAD 32768 //ring buffer, the oldest events are overwritten
+#define TRACER_THREAD_NAME_SIZE 64
+#define TRACER_OVERWRITE_MARGIN 256 //events at the start of a wrapped ring buffer that are not copied on export because the writer is likely to overwrite them during the copy
+
+struct TraceEvent {
+	const char* name; //static string, only the pointer is stored
+	qint64 timestamp; //ns since tracing was first enabled
+	quint64 id; //flow id, only used for flow events
+	char phase; //chrome trace phase: B, E, i, s, f
+};
+
+struct TraceThreadInfo {
+	quint64 threadId; //0 if there is no thread
+	quint64 firstEvent; //index of the first event the thread wrote into the buffer
+	char threadName[TRACER_THREAD_NAME_SIZE];
+};
+
+//Events of one thread. Only the owning thread writes, the number of written events is published with release semantics so the exporting thread can read all events before it.
+//A buffer is released when its thread exits and is then claimed by the next new thread, e.g. a recreated thread pool thread. The events of the previous owner stay exported until they are overwritten
+struct TraceThreadBuffer {
+	QAtomicInteger<quint64> written;
+	QAtomicInt claimed;
+	TraceThreadInfo owner;
+	TraceThreadInfo previousOwner;
+	TraceEvent events[TRACER_EVENTS_PER_THREAD];
+};
+
+//Opt-in event tracer with Chrome trace JSON export (chrome://tracing, ui.perfetto.dev).
+//Every thread claims one preallocated ring buffer with its first event and writes into it without locks and without allocations. The buffer is returned when the thread exits. All buffers are allocated when tracing is enabled for the first time and are kept until the plugin is unloaded
+class Tracer
+{
+public:
+	static void setEnabled(bool enabled);
+	static bool isEnabled() { return enabledFlag.loadAcquire() != 0; }
+	static void begin(const char* name) { record(name, 'B', 0); }
+	static void end(const char* name) { record(name, 'E', 0); }
+	static void instant(const char* name) { record(name, 'i', 0); }
+	static void flowStart(const char* name, quint64 id) { record(name, 's', id); } //connects an event on one thread, e.g. an emitted signal, with flowEnd of the same id on another thread
+	static void flowEnd(const char* name, quint64 id) { record(name, 'f', id); }
+	static bool save(const QString& fileName, int* numberOfEvents);
+	static quint64 getDroppedEvents() { return droppedEvents.loadAcquire(); }
+
+private:
+	static void record(const char* name, char phase, quint64 id);
+	static TraceThreadBuffer* getThreadBuffer();
+	static TraceThreadBuffer* claimBuffer();
+
+	static QAtomicInt enabledFlag;
+	static QAtomicInteger<quint64> droppedEvents;
+	static QScopedArrayPointer<TraceThreadBuffer> buffers;
+	static QElapsedTimer clock;
+	static QMutex controlMutex; //serializes setEnabled, save and claiming of buffers, recording never waits for it
+};
+
+//Records a begin event on construction and the matching end event on destruction if tracing is enabled
+class TraceScope
+{
+public:
+	explicit TraceScope(const char* name) : name(name), traced(Tracer::isEnabled()) {
+		if(this->traced){
+			Tracer::begin(this->name);
+		}
+	}
+	~TraceScope() {
+		if(this->traced){
+			Tracer::end(this->name);
+		}
+	}
+
+private:
+	const char* name;
+	bool traced;
+};
+
+#endif // TRACER_H
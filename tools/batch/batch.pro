@@ -0,0 +1,24 @@
+#command line tool that calculates resampling curves of recorded raw files and session files without OCTproZ. Needs Qt, FFTW and Eigen, but no OCTproZ_DevKit
+QT -= gui
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+TARGET = phaseextractionbatch
+TEMPLATE = app
+
+include(../../calculator.pri)
+
+DEFINES += \
+	QT_DEPRECATED_WARNINGS #emit warnings if depracted Qt features are used
+
+SOURCES += \
+	$$PWD/../../src/sessionfile.cpp \
+	$$PWD/../../src/npyarchive.cpp \
+	batchprocessor.cpp \
+	main.cpp
+
+HEADERS += \
+	$$PWD/../../src/sessionfile.h \
+	$$PWD/../../src/npyarchive.h \
+	$$PWD/../../src/extensionparameters.h \
+	batchprocessor.h
@@ -0,0 +1,349 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#include "batchprocessor.h"
+#include "phaseextractioncalculator.h"
+#include "sessionfile.h"
+#include "extensionparameters.h"
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QtEndian>
+#include <QtMath>
+#include <QtConcurrent>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QDateTime>
+#include <QSysInfo>
+
+
+static bool isSessionFile(const QString& fileName) {
+	QFile file(fileName);
+	uchar magic[4];
+	if(!file.open(QIODevice::ReadOnly) || file.read(reinterpret_cast<char*>(magic), 4) != 4){
+		return false;
+	}
+	return qFromLittleEndian<quint32>(magic) == SESSIONFILE_MAGIC;
+}
+
+static QJsonObject psfToJson(const PsfMetrics& psf) {
+	QJsonObject object;
+	object["peakPosition"] = psf.peakPosition;
+	object["peakHeight"] = psf.peakHeight;
+	object["fwhm"] = psf.fwhm;
+	object["sideLobeLevel"] = psf.sideLobeLevel;
+	return object;
+}
+
+
+BatchProcessor::BatchProcessor(const BatchSettings& settings) {
+	this->settings = settings;
+}
+
+QVector<BatchResult> BatchProcessor::run(const QStringList& fileNames) {
+	//files are handed out one at a time to the threads of the global pool, so a large file does not hold back a batch of small ones
+	QVector<BatchResult> results(fileNames.size());
+	for(int i = 0; i < fileNames.size(); i++){
+		results[i].fileName = fileNames.at(i);
+	}
+	QtConcurrent::blockingMap(results, [this](BatchResult& result) {
+		result = this->process(result.fileName);
+		this->log(result);
+	});
+	return results;
+}
+
+BatchResult BatchProcessor::process(const QString& fileName) {
+	BatchResult result;
+	result.fileName = fileName;
+	QElapsedTimer timer;
+	timer.start();
+
+	//session files contain format and gui parameters of the capture, everything else is treated as plain raw file
+	SessionFile session;
+	QFile rawFile;
+	QVariantMap storedSettings;
+	unsigned char* data = nullptr;
+	size_t size = 0;
+	if(isSessionFile(fileName)){
+		if(!session.open(fileName, &result.errorMessage)){
+			return result;
+		}
+		data = session.getRawData();
+		size = session.getRawSize();
+		result.samplesPerLine = session.getInfo().samplesPerLine;
+		result.bytesPerSample = session.getInfo().bytesPerSample;
+		storedSettings = session.getInfo().settings;
+	}else{
+		if(this->settings.samplesPerLine <= 0 || this->settings.bitDepth <= 0){
+			result.errorMessage = QObject::tr("Samples per line and bit depth are needed for raw files");
+			return result;
+		}
+		result.samplesPerLine = this->settings.samplesPerLine;
+		result.bytesPerSample = static_cast<int>(ceil(static_cast<double>(this->settings.bitDepth) / 8.0));
+		rawFile.setFileName(fileName);
+		if(!rawFile.open(QIODevice::ReadOnly)){
+			result.errorMessage = QObject::tr("Could not open: ") + fileName;
+			return result;
+		}
+		size_t bytesPerLine = static_cast<size_t>(result.samplesPerLine)*static_cast<size_t>(result.bytesPerSample);
+		size = (static_cast<size_t>(rawFile.size())/bytesPerLine)*bytesPerLine;
+		data = size > 0 ? rawFile.map(0, static_cast<qint64>(size)) : nullptr;
+	}
+	if(data == nullptr || result.samplesPerLine <= 0 || result.bytesPerSample <= 0){
+		result.errorMessage = QObject::tr("File does not contain raw data: ") + fileName;
+		return result;
+	}
+	result.lines = static_cast<qint64>(size/(static_cast<size_t>(result.samplesPerLine)*static_cast<size_t>(result.bytesPerSample)));
+	if(result.lines < 2){
+		result.errorMessage = QObject::tr("At least two lines are needed");
+		return result;
+	}
+
+	//parameters given on the command line have priority over the ones stored in a session
+	bool stored = !storedSettings.isEmpty();
+	result.firstLine = this->settings.firstLine;
+	result.lastLine = this->settings.lastLine;
+	if(result.firstLine < 0 && stored && !storedSettings.value(SELECT_ALL_ASCANS).toBool()){
+		int first = storedSettings.value(FIRST_ASCAN).toInt();
+		int last = storedSettings.value(LAST_ASCAN).toInt();
+		result.firstLine = qAbs(qMin(first, last));
+		result.lastLine = qAbs(qMax(first, last));
+	}
+	if(result.firstLine < 0 || result.lastLine < result.firstLine){
+		result.firstLine = -1;
+		result.lastLine = -1;
+	}
+	result.startPos = this->settings.startPos;
+	result.endPos = this->settings.endPos;
+	if(result.startPos < 0 && stored && !this->settings.autoBand){
+		int start = storedSettings.value(PEAK_START).toInt();
+		int end = storedSettings.value(PEAK_END).toInt();
+		result.startPos = qAbs(qMin(start, end));
+		result.endPos = qAbs(qMax(start, end));
+	}
+	result.bandDetected = result.startPos < 0 || result.endPos <= result.startPos;
+	result.ignoreStart = this->settings.ignoreStart >= 0 ? this->settings.ignoreStart : (stored ? storedSettings.value(IGNORE_START).toInt() : 0);
+	result.ignoreEnd = this->settings.ignoreEnd >= 0 ? this->settings.ignoreEnd : (stored ? storedSettings.value(IGNORE_END).toInt() : 0);
+
+	//the calculator is used with direct calls, every slot publishes its result before it returns
+	PhaseExtractionCalculator calculator;
+	AnalysisResultPtr analysis;
+	QStringList errors;
+	QObject::connect(&calculator, &PhaseExtractionCalculator::resultReady, [&analysis](AnalysisResultPtr published) {
+		analysis = published;
+	});
+	QObject::connect(&calculator, &PhaseExtractionCalculator::error, [&errors](QString message) {
+		errors.append(message);
+	});
+	calculator.setPrecision(this->settings.precision);
+	calculator.setFftParams(this->settings.padToSmoothSize, this->settings.upsamplingFactor, this->settings.multithreadedFft);
+	calculator.setFitParams(result.ignoreStart, result.ignoreEnd);
+	calculator.setRefinementParams(this->settings.refinementIterations, this->settings.refinementTolerance);
+	calculator.setData(data, size, static_cast<size_t>(result.bytesPerSample), result.samplesPerLine);
+
+	calculator.averageAndFFT(result.firstLine, result.lastLine, this->settings.windowRaw, false);
+	if(analysis.isNull() || !errors.isEmpty()){
+		result.errorMessage = errors.isEmpty() ? QObject::tr("Averaging failed") : errors.join("; ");
+		return result;
+	}
+	if(result.bandDetected && !detectBand(analysis->spectrum, &result.startPos, &result.endPos)){
+		result.errorMessage = QObject::tr("No calibration peak found in the averaged spectrum");
+		return result;
+	}
+
+	analysis.clear();
+	calculator.analyze(result.startPos, result.endPos, this->settings.windowPeak);
+	if(analysis.isNull() || !analysis->isUpdated(STAGE_CURVE)){
+		result.errorMessage = errors.isEmpty() ? QObject::tr("Analysis failed") : errors.join("; ");
+		return result;
+	}
+	result.fitValid = analysis->fitValid;
+	result.k0 = analysis->k0;
+	result.k1 = analysis->k1;
+	result.k2 = analysis->k2;
+	result.k3 = analysis->k3;
+	result.nonLinearPhaseRms = PhaseExtractionEngineBase::getRms(analysis->nonLinearPhase);
+	result.refinement = analysis->refinement;
+	int curveSize = qMin(analysis->resamplingCurve.size(), analysis->fittedResamplingCurve.size());
+	for(int i = qBound(0, result.ignoreStart, curveSize); i < curveSize - qBound(0, result.ignoreEnd, curveSize); i++){
+		result.maxFitResidual = qMax(result.maxFitResidual, qAbs(analysis->resamplingCurve.at(i) - static_cast<double>(analysis->fittedResamplingCurve.at(i))));
+	}
+
+	if(this->settings.verify && result.fitValid){
+		calculator.verifyCalibration(result.firstLine, result.lastLine, result.startPos, result.endPos, this->settings.interpolation);
+		result.verification = analysis->verification;
+	}
+	result.ok = result.fitValid && errors.isEmpty();
+	if(!errors.isEmpty()){
+		result.errorMessage = errors.join("; ");
+	}else if(!result.fitValid){
+		result.errorMessage = QObject::tr("No valid fit of the resampling curve");
+	}
+	result.durationMs = timer.elapsed();
+	return result;
+}
+
+QStringList BatchProcessor::collectFiles(const QStringList& paths, const QStringList& suffixes, QStringList* missing) {
+	QStringList nameFilters;
+	for(const QString& suffix : suffixes){
+		nameFilters.append("*." + suffix);
+	}
+	QStringList files;
+	for(const QString& path : paths){
+		QFileInfo info(path);
+		if(info.isDir()){
+			QDir dir(path);
+			for(const QString& entry : dir.entryList(nameFilters, QDir::Files, QDir::Name)){
+				files.append(dir.filePath(entry));
+			}
+		}else if(info.isFile()){
+			files.append(path);
+		}else{
+			missing->append(path);
+		}
+	}
+	return files;
+}
+
+bool BatchProcessor::detectBand(const QVector<qreal>& spectrum, int* startPos, int* endPos) {
+	//the spectrum is the real part of the fft, so its magnitude oscillates within the peak. The maximum magnitude of the neighbouring bins is used as envelope
+	int size = spectrum.size();
+	if(size <= SPECTRUM_POS_AFTER_DC + 2*BATCH_BAND_ENVELOPE_RADIUS){
+		return false;
+	}
+	QVector<qreal> envelope(size, 0.0);
+	for(int i = 0; i < size; i++){
+		for(int j = qMax(0, i-BATCH_BAND_ENVELOPE_RADIUS); j <= qMin(size-1, i+BATCH_BAND_ENVELOPE_RADIUS); j++){
+			envelope[i] = qMax(envelope.at(i), qAbs(spectrum.at(j)));
+		}
+	}
+
+	//strongest peak after the DC peak and the bins around it that are above the threshold
+	int peak = SPECTRUM_POS_AFTER_DC;
+	for(int i = SPECTRUM_POS_AFTER_DC; i < size; i++){
+		if(envelope.at(i) > envelope.at(peak)){
+			peak = i;
+		}
+	}
+	if(envelope.at(peak) <= 0){
+		return false;
+	}
+	qreal threshold = envelope.at(peak)*BATCH_BAND_THRESHOLD;
+	int start = peak;
+	while(start > SPECTRUM_POS_AFTER_DC && envelope.at(start-1) >= threshold){
+		start--;
+	}
+	int end = peak;
+	while(end < size-1 && envelope.at(end+1) >= threshold){
+		end++;
+	}
+	int margin = qRound((end - start)*BATCH_BAND_MARGIN);
+	*startPos = qMax(SPECTRUM_POS_AFTER_DC, start - margin);
+	*endPos = qMin(size-1, end + margin);
+	return *endPos > *startPos;
+}
+
+QByteArray BatchProcessor::toJson(const QVector<BatchResult>& results, const BatchSettings& settings) {
+	QJsonArray files;
+	for(const BatchResult& result : results){
+		QJsonObject file;
+		file["file"] = result.fileName;
+		file["ok"] = result.ok;
+		if(!result.errorMessage.isEmpty()){
+			file["error"] = result.errorMessage;
+		}
+		file["samplesPerLine"] = result.samplesPerLine;
+		file["bytesPerSample"] = result.bytesPerSample;
+		file["lines"] = result.lines;
+		file["firstLine"] = result.firstLine;
+		file["lastLine"] = result.lastLine;
+		file["startPos"] = result.startPos;
+		file["endPos"] = result.endPos;
+		file["bandDetected"] = result.bandDetected;
+		file["ignoreStart"] = result.ignoreStart;
+		file["ignoreEnd"] = result.ignoreEnd;
+		file["fitValid"] = result.fitValid;
+		if(result.fitValid){
+			file["k0"] = result.k0;
+			file["k1"] = result.k1;
+			file["k2"] = result.k2;
+			file["k3"] = result.k3;
+			file["maxFitResidual"] = result.maxFitResidual;
+		}
+		file["nonLinearPhaseRms"] = result.nonLinearPhaseRms;
+		if(result.refinement.iterations > 0){
+			file["refinementIterations"] = result.refinement.iterations;
+			file["refinementConverged"] = result.refinement.converged;
+			file["refinementFinalRms"] = result.refinement.finalRms;
+		}
+		if(result.verification.valid){
+			QJsonObject verification;
+			verification["accepted"] = result.verification.accepted;
+			verification["lines"] = result.verification.lines;
+			verification["beforeLinearization"] = psfToJson(result.verification.beforeLinearization);
+			verification["rawCurve"] = psfToJson(result.verification.rawCurve);
+			verification["fittedCurve"] = psfToJson(result.verification.fittedCurve);
+			file["verification"] = verification;
+		}
+		file["durationMs"] = static_cast<double>(result.durationMs);
+		files.append(file);
+	}
+
+	QJsonObject report;
+	report["format"] = BATCH_REPORT_FORMAT;
+	report["date"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+	report["host"] = QSysInfo::machineHostName();
+	report["precision"] = settings.precision == SINGLE_PRECISION ? "single" : "double";
+	report["windowRaw"] = settings.windowRaw;
+	report["windowPeak"] = settings.windowPeak;
+	report["padToSmoothSize"] = settings.padToSmoothSize;
+	report["upsamplingFactor"] = settings.upsamplingFactor;
+	report["refinementIterations"] = settings.refinementIterations;
+	report["files"] = files;
+	return QJsonDocument(report).toJson(QJsonDocument::Indented);
+}
+
+void BatchProcessor::log(const BatchResult& result) {
+	QMutexLocker locker(&this->logMutex);
+	QTextStream err(stderr);
+	if(!result.ok){
+		err << "FAILED " << result.fileName << ": " << result.errorMessage << "\n";
+		return;
+	}
+	err << result.fileName << ": k0 " << result.k0 << ", k1 " << result.k1 << ", k2 " << result.k2 << ", k3 " << result.k3
+		<< ", band " << result.startPos << "-" << result.endPos << (result.bandDetected ? " (detected)" : "")
+		<< ", fit residual " << QString::number(result.maxFitResidual, 'g', 3) << " samples";
+	if(result.verification.valid){
+		err << ", verification " << (result.verification.accepted ? "passed" : "failed") << " (FWHM " << QString::number(result.verification.fittedCurve.fwhm, 'f', 2) << ")";
+	}
+	err << ", " << result.durationMs << " ms\n";
+}
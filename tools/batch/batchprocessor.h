@@ -0,0 +1,122 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+
+#ifndef BATCHPROCESSOR_H
+#define BATCHPROCESSOR_H
+
+#include <QVector>
+#include <QStringList>
+#include <QMutex>
+#include "analysisresult.h"
+#include "phaseextractionengine.h"
+
+#define BATCH_REPORT_FORMAT 1
+#define BATCH_DEFAULT_SUFFIXES "raw,bin,session"
+#define BATCH_BAND_ENVELOPE_RADIUS 2 //the spectrum is the real part of the fft, its envelope is the maximum magnitude within this many bins
+#define BATCH_BAND_THRESHOLD 0.1 //detected band ends where the envelope drops below this fraction of the peak (-20 dB)
+#define BATCH_BAND_MARGIN 0.25 //detected band is widened by this fraction of its width on both sides
+
+//Processing parameters. -1 for firstLine/lastLine, startPos/endPos and ignoreStart/ignoreEnd means: take it from the settings stored in a session file, otherwise use all lines, detect the band and ignore nothing
+struct BatchSettings {
+	BatchSettings() : samplesPerLine(0), bitDepth(0), firstLine(-1), lastLine(-1), startPos(-1), endPos(-1), ignoreStart(-1), ignoreEnd(-1), autoBand(false), windowRaw(false), windowPeak(false),
+		padToSmoothSize(false), upsamplingFactor(1), multithreadedFft(false), precision(DOUBLE_PRECISION), refinementIterations(0), refinementTolerance(0.001), verify(true), interpolation(LINEAR_INTERPOLATION) {}
+
+	int samplesPerLine; //format of plain raw files, session files contain their own format
+	int bitDepth;
+	int firstLine;
+	int lastLine;
+	int startPos;
+	int endPos;
+	int ignoreStart;
+	int ignoreEnd;
+	bool autoBand; //detect the band even if a session contains one
+	bool windowRaw;
+	bool windowPeak;
+	bool padToSmoothSize;
+	int upsamplingFactor;
+	bool multithreadedFft;
+	CalculationPrecision precision;
+	int refinementIterations;
+	double refinementTolerance;
+	bool verify;
+	InterpolationMethod interpolation;
+};
+
+//Coefficients and quality metrics of one file
+struct BatchResult {
+	BatchResult() : ok(false), samplesPerLine(0), bytesPerSample(0), lines(0), firstLine(-1), lastLine(-1), startPos(0), endPos(0), bandDetected(false), ignoreStart(0), ignoreEnd(0),
+		fitValid(false), k0(0), k1(0), k2(0), k3(0), nonLinearPhaseRms(0), maxFitResidual(0), durationMs(0) {}
+
+	QString fileName;
+	bool ok;
+	QString errorMessage;
+	int samplesPerLine;
+	int bytesPerSample;
+	qint64 lines;
+	int firstLine;
+	int lastLine;
+	int startPos;
+	int endPos;
+	bool bandDetected;
+	int ignoreStart;
+	int ignoreEnd;
+	bool fitValid;
+	double k0; //coefficients with OCTproZ scaling
+	double k1;
+	double k2;
+	double k3;
+	double nonLinearPhaseRms; //rad
+	double maxFitResidual; //largest deviation between raw and fitted resampling curve within the fit range in samples
+	RefinementStats refinement;
+	VerificationResult verification;
+	qint64 durationMs;
+};
+
+//Runs average, analysis, fit and verification of PhaseExtractionCalculator on recorded raw files and session files without gui.
+//Files are memory mapped. Every file gets its own calculator, files are processed in parallel by the threads of the global thread pool
+class BatchProcessor
+{
+public:
+	explicit BatchProcessor(const BatchSettings& settings);
+
+	QVector<BatchResult> run(const QStringList& fileNames);
+	BatchResult process(const QString& fileName);
+
+	static QStringList collectFiles(const QStringList& paths, const QStringList& suffixes, QStringList* missing); //directories are replaced by the files with one of the suffixes they contain
+	static bool detectBand(const QVector<qreal>& spectrum, int* startPos, int* endPos);
+	static QByteArray toJson(const QVector<BatchResult>& results, const BatchSettings& settings);
+
+private:
+	BatchSettings settings;
+	QMutex logMutex;
+
+	void log(const BatchResult& result);
+};
+
+#endif // BATCHPROCESSOR_H
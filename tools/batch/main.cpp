@@ -0,0 +1,179 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QThreadPool>
+#include <QFile>
+#include <QTextStream>
+#include "batchprocessor.h"
+#include "phaseextractioncalculator.h"
+
+
+static bool parsePair(const QString& text, int* first, int* second) {
+	QStringList items = text.split(',');
+	if(items.size() != 2){
+		return false;
+	}
+	bool firstOk = false;
+	bool secondOk = false;
+	*first = items.at(0).trimmed().toInt(&firstOk);
+	*second = items.at(1).trimmed().toInt(&secondOk);
+	return firstOk && secondOk && *first >= 0 && *second >= 0;
+}
+
+int main(int argc, char *argv[]) {
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("phaseextractionbatch");
+	QTextStream err(stderr);
+	BatchSettings defaults;
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Calculates the resampling curve and its coefficients for recorded raw files and session files without OCTproZ. Files are processed in parallel and the results are written as JSON.");
+	parser.addHelpOption();
+	parser.addPositionalArgument("files", "Raw files, session files or directories that contain them.", "files...");
+	QCommandLineOption outputOption(QStringList() << "o" << "output", "Write the JSON report to <file> instead of stdout.", "file");
+	QCommandLineOption samplesOption(QStringList() << "s" << "samples", "Samples per line of raw files.", "n");
+	QCommandLineOption bitDepthOption("bit-depth", "Bit depth of raw files.", "bits");
+	QCommandLineOption linesOption(QStringList() << "l" << "lines", "First and last line to average, e.g. 0,999. Default: stored in session or all lines.", "first,last");
+	QCommandLineOption bandOption("band", "First and last fft bin of the calibration peak, e.g. 200,320. Default: stored in session or detected.", "start,end");
+	QCommandLineOption autoBandOption("auto-band", "Detect the calibration peak even if a session contains a band.");
+	QCommandLineOption ignoreOption("ignore", "Samples ignored at start and end of the resampling curve for the fit, e.g. 10,10. Default: stored in session or 0,0.", "start,end");
+	QCommandLineOption windowRawOption("window-raw", "Apply a window to the averaged raw signal.");
+	QCommandLineOption windowPeakOption("window-peak", "Apply a window to the selected peak.");
+	QCommandLineOption padOption("pad", "Pad the fft to the next smooth size.");
+	QCommandLineOption upsamplingOption("upsampling", "Upsampling factor of the analytical signal.", "factor", QString::number(defaults.upsamplingFactor));
+	QCommandLineOption singlePrecisionOption("single", "Use single precision calculation.");
+	QCommandLineOption fftThreadsOption("fft-threads", "Allow multithreaded ffts within a file.");
+	QCommandLineOption refineOption("refine", "Maximum number of refinement iterations.", "n", QString::number(defaults.refinementIterations));
+	QCommandLineOption refineToleranceOption("refine-tolerance", "Refinement stops if the nonlinear phase rms improves less than this.", "rad", QString::number(defaults.refinementTolerance));
+	QCommandLineOption noVerifyOption("no-verify", "Skip the verification of the fitted curve.");
+	QCommandLineOption interpolationOption("interpolation", "Interpolation for verification: linear, cubic or sinc.", "method", "linear");
+	QCommandLineOption jobsOption(QStringList() << "j" << "jobs", "Number of files processed at the same time. Default: number of cores.", "n");
+	QCommandLineOption suffixesOption("suffixes", "Comma separated file suffixes that are taken from directories.", "list", BATCH_DEFAULT_SUFFIXES);
+	parser.addOption(outputOption);
+	parser.addOption(samplesOption);
+	parser.addOption(bitDepthOption);
+	parser.addOption(linesOption);
+	parser.addOption(bandOption);
+	parser.addOption(autoBandOption);
+	parser.addOption(ignoreOption);
+	parser.addOption(windowRawOption);
+	parser.addOption(windowPeakOption);
+	parser.addOption(padOption);
+	parser.addOption(upsamplingOption);
+	parser.addOption(singlePrecisionOption);
+	parser.addOption(fftThreadsOption);
+	parser.addOption(refineOption);
+	parser.addOption(refineToleranceOption);
+	parser.addOption(noVerifyOption);
+	parser.addOption(interpolationOption);
+	parser.addOption(jobsOption);
+	parser.addOption(suffixesOption);
+	parser.process(app);
+
+	BatchSettings settings;
+	settings.samplesPerLine = parser.value(samplesOption).toInt();
+	settings.bitDepth = parser.value(bitDepthOption).toInt();
+	if(parser.isSet(linesOption) && (!parsePair(parser.value(linesOption), &settings.firstLine, &settings.lastLine) || settings.lastLine < settings.firstLine)){
+		err << "Invalid line range: " << parser.value(linesOption) << "\n";
+		return 2;
+	}
+	if(parser.isSet(bandOption) && (!parsePair(parser.value(bandOption), &settings.startPos, &settings.endPos) || settings.endPos <= settings.startPos)){
+		err << "Invalid band: " << parser.value(bandOption) << "\n";
+		return 2;
+	}
+	if(parser.isSet(ignoreOption) && !parsePair(parser.value(ignoreOption), &settings.ignoreStart, &settings.ignoreEnd)){
+		err << "Invalid ignore range: " << parser.value(ignoreOption) << "\n";
+		return 2;
+	}
+	settings.autoBand = parser.isSet(autoBandOption);
+	settings.windowRaw = parser.isSet(windowRawOption);
+	settings.windowPeak = parser.isSet(windowPeakOption);
+	settings.padToSmoothSize = parser.isSet(padOption);
+	settings.upsamplingFactor = qMax(1, parser.value(upsamplingOption).toInt());
+	settings.precision = parser.isSet(singlePrecisionOption) ? SINGLE_PRECISION : DOUBLE_PRECISION;
+	if(!PhaseExtractionCalculator::isPrecisionAvailable(settings.precision)){
+		err << "Single precision is not available. Batch tool was built without fftw3f.\n";
+		return 2;
+	}
+	settings.multithreadedFft = parser.isSet(fftThreadsOption);
+	settings.refinementIterations = qMax(0, parser.value(refineOption).toInt());
+	settings.refinementTolerance = parser.value(refineToleranceOption).toDouble();
+	settings.verify = !parser.isSet(noVerifyOption);
+	QString interpolation = parser.value(interpolationOption).toLower();
+	if(interpolation == "linear"){
+		settings.interpolation = LINEAR_INTERPOLATION;
+	}else if(interpolation == "cubic"){
+		settings.interpolation = CUBIC_INTERPOLATION;
+	}else if(interpolation == "sinc"){
+		settings.interpolation = SINC_INTERPOLATION;
+	}else{
+		err << "Unknown interpolation: " << interpolation << "\n";
+		return 2;
+	}
+	if(parser.isSet(jobsOption)){
+		QThreadPool::globalInstance()->setMaxThreadCount(qMax(1, parser.value(jobsOption).toInt()));
+	}
+
+	QStringList suffixes;
+	for(const QString& item : parser.value(suffixesOption).split(',')){
+		if(!item.trimmed().isEmpty()){
+			suffixes.append(item.trimmed());
+		}
+	}
+	QStringList missing;
+	QStringList files = BatchProcessor::collectFiles(parser.positionalArguments(), suffixes, &missing);
+	for(const QString& path : missing){
+		err << "Not found: " << path << "\n";
+	}
+	if(files.isEmpty()){
+		err << "No input files\n";
+		return 2;
+	}
+
+	BatchProcessor processor(settings);
+	QVector<BatchResult> results = processor.run(files);
+	QByteArray report = BatchProcessor::toJson(results, settings);
+	if(parser.isSet(outputOption)){
+		QFile file(parser.value(outputOption));
+		if(!file.open(QIODevice::WriteOnly) || file.write(report) != report.size()){
+			err << "Could not save file to: " << parser.value(outputOption) << "\n";
+			return 2;
+		}
+	}else{
+		QTextStream(stdout) << report;
+	}
+
+	int failed = 0;
+	for(const BatchResult& result : results){
+		failed += (!result.ok || (result.verification.valid && !result.verification.accepted)) ? 1 : 0;
+	}
+	err << files.size() << " files processed, " << failed << " failed or not accepted\n";
+	return (failed > 0 || !missing.isEmpty()) ? 1 : 0;
+}
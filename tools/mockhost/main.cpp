@@ -0,0 +1,195 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QTextStream>
+#include <vector>
+#include "mockhost.h"
+#include "calibrationsignalgenerator.h"
+
+#define MOCKHOST_DEFAULT_SOURCE_BUFFERS 8
+
+
+int main(int argc, char *argv[]) {
+	//the extension creates its form on construction, without a display it is rendered offscreen
+	if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")){
+		qputenv("QT_QPA_PLATFORM", "offscreen");
+	}
+	QApplication app(argc, argv);
+	QCoreApplication::setApplicationName("mockhost");
+	QTextStream err(stderr);
+	ReplaySettings defaults;
+	MockHostSettings hostDefaults;
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Headless stand-in for OCTproZ. Streams recorded or synthetic raw buffers through rawDataReceived of PhaseExtractionExtension at a given line rate and measures callback latency, dropped buffers and the time to fetchingDone.");
+	parser.addHelpOption();
+	QCommandLineOption inputOption(QStringList() << "i" << "input", "Replay raw buffers from <file>, e.g. written by signalgenerator. Default: synthetic calibration signal.", "file");
+	QCommandLineOption outputOption(QStringList() << "o" << "output", "Write the JSON report to <file>.", "file");
+	QCommandLineOption samplesOption(QStringList() << "s" << "samples", "Samples per line.", "n", QString::number(defaults.samplesPerLine));
+	QCommandLineOption linesOption(QStringList() << "l" << "lines", "Lines per buffer.", "n", QString::number(defaults.linesPerBuffer));
+	QCommandLineOption bitDepthOption("bit-depth", "Bit depth, 1 to 32.", "bits", QString::number(defaults.bitDepth));
+	QCommandLineOption sourceBuffersOption("source-buffers", "Number of different synthetic buffers that are replayed round robin.", "n", QString::number(MOCKHOST_DEFAULT_SOURCE_BUFFERS));
+	QCommandLineOption noiseOption("noise", "Shot noise of the synthetic signal in units of sqrt(counts).", "factor", "1");
+	QCommandLineOption lineRateOption(QStringList() << "r" << "line-rate", "Line rate in Hz.", "Hz", QString::number(defaults.lineRate));
+	QCommandLineOption jitterOption("jitter", "Rms jitter of the buffer arrival time relative to the buffer period.", "fraction", "0.05");
+	QCommandLineOption buffersPerVolumeOption("buffers-per-volume", "Buffer ids count from 0 to this value - 1.", "n", QString::number(defaults.buffersPerVolume));
+	QCommandLineOption hostBuffersOption("host-buffers", "Buffers the host can queue while a callback is running before it drops the oldest one.", "n", QString::number(defaults.hostBuffers));
+	QCommandLineOption fetchOption(QStringList() << "f" << "fetch", "Buffers to fetch per fetch request.", "n", QString::number(hostDefaults.buffersToFetch));
+	QCommandLineOption fetchesOption("fetches", "Number of fetch requests.", "n", QString::number(hostDefaults.fetches));
+	QCommandLineOption warmupOption("warmup", "Streaming time before the first fetch request.", "ms", QString::number(hostDefaults.warmupMs));
+	QCommandLineOption intervalOption("interval", "Pause between fetchingDone and the next fetch request.", "ms", QString::number(hostDefaults.fetchIntervalMs));
+	QCommandLineOption timeoutOption("timeout", "Abort if the fetches are not done after this time.", "s", QString::number(hostDefaults.timeoutMs/1000));
+	QCommandLineOption previewOption("preview", "Enable the live spectrum preview of the extension.");
+	QCommandLineOption seedOption("seed", "Seed of the synthetic signal and of the jitter.", "n", QString::number(defaults.seed));
+	QCommandLineOption maxDroppedOption("max-dropped", "Exit code is 1 if more buffers were dropped.", "n");
+	QCommandLineOption maxP99Option("max-p99-us", "Exit code is 1 if the 99th percentile of the callback latency is higher.", "us");
+	parser.addOption(inputOption);
+	parser.addOption(outputOption);
+	parser.addOption(samplesOption);
+	parser.addOption(linesOption);
+	parser.addOption(bitDepthOption);
+	parser.addOption(sourceBuffersOption);
+	parser.addOption(noiseOption);
+	parser.addOption(lineRateOption);
+	parser.addOption(jitterOption);
+	parser.addOption(buffersPerVolumeOption);
+	parser.addOption(hostBuffersOption);
+	parser.addOption(fetchOption);
+	parser.addOption(fetchesOption);
+	parser.addOption(warmupOption);
+	parser.addOption(intervalOption);
+	parser.addOption(timeoutOption);
+	parser.addOption(previewOption);
+	parser.addOption(seedOption);
+	parser.addOption(maxDroppedOption);
+	parser.addOption(maxP99Option);
+	parser.process(app);
+
+	MockHostSettings settings;
+	ReplaySettings& replay = settings.replay;
+	int samplesPerLine = parser.value(samplesOption).toInt();
+	int linesPerBuffer = parser.value(linesOption).toInt();
+	int bitDepth = parser.value(bitDepthOption).toInt();
+	if(samplesPerLine <= 0 || linesPerBuffer <= 0 || bitDepth < 1 || bitDepth > 32){
+		err << "Invalid buffer format\n";
+		return 2;
+	}
+	replay.samplesPerLine = static_cast<unsigned int>(samplesPerLine);
+	replay.linesPerBuffer = static_cast<unsigned int>(linesPerBuffer);
+	replay.bitDepth = static_cast<unsigned int>(bitDepth);
+	replay.lineRate = parser.value(lineRateOption).toDouble();
+	replay.jitter = qMax(0.0, parser.value(jitterOption).toDouble());
+	replay.buffersPerVolume = static_cast<unsigned int>(qMax(1, parser.value(buffersPerVolumeOption).toInt()));
+	replay.hostBuffers = qMax(1, parser.value(hostBuffersOption).toInt());
+	replay.seed = parser.value(seedOption).toULongLong();
+	if(replay.lineRate <= 0.0){
+		err << "Line rate has to be positive\n";
+		return 2;
+	}
+	settings.buffersToFetch = qMax(1, parser.value(fetchOption).toInt());
+	settings.fetches = qMax(1, parser.value(fetchesOption).toInt());
+	settings.warmupMs = qMax(0, parser.value(warmupOption).toInt());
+	settings.fetchIntervalMs = qMax(0, parser.value(intervalOption).toInt());
+	settings.timeoutMs = qMax(1, parser.value(timeoutOption).toInt())*1000;
+	settings.livePreview = parser.isSet(previewOption);
+
+	//source buffers, either memory mapped from a recording or generated once before streaming starts
+	size_t bytesPerBuffer = static_cast<size_t>(samplesPerLine)*static_cast<size_t>(linesPerBuffer)*static_cast<size_t>(CalibrationSignalGenerator::bytesPerSampleFor(bitDepth));
+	QFile input;
+	std::vector<unsigned char> syntheticData;
+	if(parser.isSet(inputOption)){
+		input.setFileName(parser.value(inputOption));
+		if(!input.open(QIODevice::ReadOnly)){
+			err << "Could not open: " << input.fileName() << "\n";
+			return 2;
+		}
+		size_t buffers = static_cast<size_t>(input.size())/bytesPerBuffer;
+		uchar* data = buffers > 0 ? input.map(0, static_cast<qint64>(buffers*bytesPerBuffer)) : nullptr;
+		if(data == nullptr){
+			err << "File does not contain a complete buffer of " << linesPerBuffer << " x " << samplesPerLine << " samples at " << bitDepth << " bit: " << input.fileName() << "\n";
+			return 2;
+		}
+		for(size_t i = 0; i < buffers; i++){
+			replay.sourceBuffers.append(data + i*bytesPerBuffer);
+		}
+	}else{
+		CalibrationSignalParameters parameters;
+		parameters.samplesPerLine = samplesPerLine;
+		parameters.linesPerBuffer = linesPerBuffer;
+		parameters.bitDepth = bitDepth;
+		parameters.fringeCycles = samplesPerLine/8.0;
+		parameters.nonlinearity << 0.1 << -0.05;
+		parameters.shotNoise = parser.value(noiseOption).toDouble();
+		parameters.seed = replay.seed;
+		CalibrationSignalGenerator generator;
+		if(!generator.setParameters(parameters)){
+			err << "Invalid signal parameters\n";
+			return 2;
+		}
+		int buffers = qMax(1, parser.value(sourceBuffersOption).toInt());
+		syntheticData.resize(bytesPerBuffer*static_cast<size_t>(buffers));
+		for(int i = 0; i < buffers; i++){
+			unsigned char* buffer = syntheticData.data() + static_cast<size_t>(i)*bytesPerBuffer;
+			generator.generate(buffer, static_cast<quint64>(i));
+			replay.sourceBuffers.append(buffer);
+		}
+	}
+
+	MockHost host(settings);
+	QObject::connect(&host, &MockHost::finished, &app, &QCoreApplication::quit, Qt::QueuedConnection);
+	QTimer::singleShot(0, &host, &MockHost::start);
+	app.exec();
+
+	err << host.formatReport();
+	if(parser.isSet(outputOption)){
+		QByteArray report = host.toJson();
+		QFile file(parser.value(outputOption));
+		if(!file.open(QIODevice::WriteOnly) || file.write(report) != report.size()){
+			err << "Could not save file to: " << parser.value(outputOption) << "\n";
+			return 2;
+		}
+	}
+
+	const MockHostReport& report = host.getReport();
+	if(report.timedOut || report.errors > 0){
+		return 2;
+	}
+	bool failed = false;
+	if(parser.isSet(maxDroppedOption) && report.replay.droppedBuffers > parser.value(maxDroppedOption).toULongLong()){
+		err << "More dropped buffers than allowed\n";
+		failed = true;
+	}
+	if(parser.isSet(maxP99Option) && report.callbackP99Ns > parser.value(maxP99Option).toDouble()*1000.0){
+		err << "Callback p99 latency higher than allowed\n";
+		failed = true;
+	}
+	return failed ? 1 : 0;
+}
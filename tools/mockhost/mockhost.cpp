@@ -0,0 +1,205 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#include "mockhost.h"
+#include <algorithm>
+#include <QTextStream>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QDateTime>
+#include <QSysInfo>
+
+
+MockHost::MockHost(const MockHostSettings& settings, QObject* parent) : QObject(parent) {
+	this->settings = settings;
+	this->fetchRequestNs = 0;
+	this->fetchDoneNs.storeRelease(0);
+	this->running = false;
+	this->clock.start(); //started before the replay thread, which only reads it
+
+	this->extension = new MockHostExtension();
+	connect(this->extension, &PhaseExtractionExtension::error, this, [this](QString message) {
+		this->report.errors++;
+		QTextStream(stderr) << "Error: " << message << "\n";
+	});
+	connect(this->extension, &PhaseExtractionExtension::info, this, [](QString message) {
+		QTextStream(stderr) << message << "\n";
+	});
+	connect(this->extension, &PhaseExtractionExtension::acquisitionStatus, this, [this](QString message) {
+		this->report.extensionStatus = message;
+	});
+	//fetchingDone is emitted inside rawDataReceived on the replay thread, the time is taken there and evaluated in the thread of the host
+	connect(this->extension, &PhaseExtractionExtension::fetchingDone, this, [this]() {
+		this->fetchDoneNs.storeRelease(this->clock.nsecsElapsed());
+		QMetaObject::invokeMethod(this, "handleFetchingDone", Qt::QueuedConnection);
+	}, Qt::DirectConnection);
+
+	this->replayer = new StreamReplayer(this->extension, this->settings.replay, &this->clock);
+	this->replayer->moveToThread(&this->replayThread);
+	this->replayThread.setObjectName("MockAcquisition");
+	connect(&this->replayThread, &QThread::started, this->replayer, &StreamReplayer::replay);
+	connect(this->replayer, &StreamReplayer::finished, &this->replayThread, &QThread::quit, Qt::DirectConnection);
+
+	this->timeoutTimer.setSingleShot(true);
+	connect(&this->timeoutTimer, &QTimer::timeout, this, [this]() {
+		this->stop(true);
+	});
+}
+
+MockHost::~MockHost() {
+	this->replayer->stop();
+	this->replayThread.quit();
+	this->replayThread.wait();
+	delete this->replayer;
+	delete this->extension;
+}
+
+void MockHost::start() {
+	//OCTproZ restores the stored settings before the extension is activated
+	QVariantMap extensionSettings;
+	extensionSettings.insert(BUFFERS_TO_FETCH, this->settings.buffersToFetch);
+	extensionSettings.insert(START_WITH_FIRST_BUFFER, false);
+	extensionSettings.insert(LIVE_PREVIEW, this->settings.livePreview);
+	this->extension->settingsLoaded(extensionSettings);
+	this->extension->setBuffersToFetch(this->settings.buffersToFetch);
+	this->extension->activateExtension();
+	this->extension->setRawGrabbingAllowed(true);
+
+	this->running = true;
+	this->replayThread.start(QThread::TimeCriticalPriority);
+	this->timeoutTimer.start(this->settings.timeoutMs);
+	QTimer::singleShot(this->settings.warmupMs, this, &MockHost::requestFetch);
+}
+
+void MockHost::requestFetch() {
+	if(!this->running){
+		return;
+	}
+	this->fetchRequestNs = this->clock.nsecsElapsed();
+	this->extension->enableFetching(true);
+}
+
+void MockHost::handleFetchingDone() {
+	if(!this->running){
+		return;
+	}
+	this->report.fetchDurationsNs.append(this->fetchDoneNs.loadAcquire() - this->fetchRequestNs);
+	if(this->report.fetchDurationsNs.size() >= this->settings.fetches){
+		this->stop();
+		return;
+	}
+	QTimer::singleShot(this->settings.fetchIntervalMs, this, &MockHost::requestFetch);
+}
+
+void MockHost::stop(bool timedOut) {
+	if(!this->running){
+		return;
+	}
+	this->running = false;
+	this->timeoutTimer.stop();
+	this->replayer->stop();
+	this->replayThread.quit();
+	this->replayThread.wait();
+	this->extension->enableFetching(false);
+	this->extension->deactivateExtension(); //emits the final acquisition status
+
+	const LatencyHistogram& latency = this->replayer->getCallbackLatency();
+	this->report.replay = this->replayer->getStatistics();
+	this->report.callbackCount = latency.getCount();
+	this->report.callbackP50Ns = latency.getPercentile(50);
+	this->report.callbackP99Ns = latency.getPercentile(99);
+	this->report.callbackMaxNs = latency.getMax();
+	this->report.timedOut = timedOut;
+	emit finished();
+}
+
+QByteArray MockHost::toJson() const {
+	const ReplaySettings& replay = this->settings.replay;
+	QJsonArray fetches;
+	for(qint64 durationNs : this->report.fetchDurationsNs){
+		fetches.append(static_cast<double>(durationNs));
+	}
+	double seconds = this->report.replay.elapsedNs/1.0e9;
+
+	QJsonObject result;
+	result["format"] = MOCKHOST_REPORT_FORMAT;
+	result["date"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+	result["host"] = QSysInfo::machineHostName();
+	result["cpuArchitecture"] = QSysInfo::currentCpuArchitecture();
+	result["os"] = QSysInfo::prettyProductName();
+	result["qtVersion"] = QString(qVersion());
+	result["bitDepth"] = static_cast<int>(replay.bitDepth);
+	result["samplesPerLine"] = static_cast<int>(replay.samplesPerLine);
+	result["linesPerBuffer"] = static_cast<int>(replay.linesPerBuffer);
+	result["buffersPerVolume"] = static_cast<int>(replay.buffersPerVolume);
+	result["lineRate"] = replay.lineRate;
+	result["jitter"] = replay.jitter;
+	result["hostBuffers"] = replay.hostBuffers;
+	result["buffersToFetch"] = this->settings.buffersToFetch;
+	result["livePreview"] = this->settings.livePreview;
+	result["deliveredBuffers"] = static_cast<double>(this->report.replay.deliveredBuffers);
+	result["droppedBuffers"] = static_cast<double>(this->report.replay.droppedBuffers);
+	result["achievedLineRate"] = seconds > 0.0 ? this->report.replay.deliveredBuffers*replay.linesPerBuffer/seconds : 0.0;
+	result["maxLagNs"] = static_cast<double>(this->report.replay.maxLagNs);
+	result["callbackCount"] = static_cast<double>(this->report.callbackCount);
+	result["callbackP50Ns"] = static_cast<double>(this->report.callbackP50Ns);
+	result["callbackP99Ns"] = static_cast<double>(this->report.callbackP99Ns);
+	result["callbackMaxNs"] = static_cast<double>(this->report.callbackMaxNs);
+	result["fetchDurationsNs"] = fetches;
+	result["extensionStatus"] = this->report.extensionStatus;
+	result["errors"] = this->report.errors;
+	result["timedOut"] = this->report.timedOut;
+	return QJsonDocument(result).toJson(QJsonDocument::Indented);
+}
+
+QString MockHost::formatReport() const {
+	const ReplaySettings& replay = this->settings.replay;
+	double seconds = this->report.replay.elapsedNs/1.0e9;
+	double achievedLineRate = seconds > 0.0 ? this->report.replay.deliveredBuffers*replay.linesPerBuffer/seconds : 0.0;
+	QVector<qint64> fetchDurations = this->report.fetchDurationsNs;
+	std::sort(fetchDurations.begin(), fetchDurations.end());
+
+	QString text;
+	QTextStream out(&text);
+	out << "Streamed " << this->report.replay.deliveredBuffers << " buffers in " << QString::number(seconds, 'f', 2) << " s, line rate "
+		<< QString::number(achievedLineRate/1000.0, 'f', 1) << " kHz of " << QString::number(replay.lineRate/1000.0, 'f', 1) << " kHz\n";
+	out << "Dropped by host queue: " << this->report.replay.droppedBuffers << ", max delivery lag: " << QString::number(this->report.replay.maxLagNs/1000.0, 'f', 1) << " us\n";
+	out << "Callback p50: " << QString::number(this->report.callbackP50Ns/1000.0, 'f', 1) << " us, p99: " << QString::number(this->report.callbackP99Ns/1000.0, 'f', 1)
+		<< " us, max: " << QString::number(this->report.callbackMaxNs/1000.0, 'f', 1) << " us (buffer period " << QString::number(1.0e6*replay.linesPerBuffer/replay.lineRate, 'f', 1) << " us)\n";
+	if(!fetchDurations.isEmpty()){
+		out << "Time to fetchingDone for " << this->settings.buffersToFetch << " buffers, min: " << QString::number(fetchDurations.first()/1.0e6, 'f', 2)
+			<< " ms, median: " << QString::number(fetchDurations.at(fetchDurations.size()/2)/1.0e6, 'f', 2) << " ms, max: " << QString::number(fetchDurations.last()/1.0e6, 'f', 2)
+			<< " ms (" << fetchDurations.size() << "/" << this->settings.fetches << " fetches)\n";
+	}
+	out << "Extension: " << this->report.extensionStatus << "\n";
+	if(this->report.timedOut){
+		out << "Timed out after " << this->settings.timeoutMs << " ms\n";
+	}
+	return text;
+}
@@ -0,0 +1,112 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+
+#ifndef MOCKHOST_H
+#define MOCKHOST_H
+
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QAtomicInteger>
+#include "phaseextractionextension.h"
+#include "streamreplayer.h"
+
+#define MOCKHOST_REPORT_FORMAT 1
+
+//PhaseExtractionExtension with access to the switches that OCTproZ sets in the DevKit base class
+class MockHostExtension : public PhaseExtractionExtension
+{
+public:
+	void setRawGrabbingAllowed(bool allowed) { this->rawGrabbingAllowed = allowed; }
+};
+
+struct MockHostSettings {
+	MockHostSettings() : fetches(5), buffersToFetch(10), warmupMs(500), fetchIntervalMs(100), timeoutMs(60000), livePreview(false) {}
+
+	ReplaySettings replay;
+	int fetches; //number of fetch requests, each one waits for fetchingDone
+	int buffersToFetch;
+	int warmupMs; //streaming time before the first fetch request
+	int fetchIntervalMs; //pause between fetchingDone and the next fetch request
+	int timeoutMs;
+	bool livePreview;
+};
+
+struct MockHostReport {
+	MockHostReport() : callbackCount(0), callbackP50Ns(0), callbackP99Ns(0), callbackMaxNs(0), errors(0), timedOut(false) {}
+
+	ReplayStatistics replay;
+	quint64 callbackCount;
+	qint64 callbackP50Ns;
+	qint64 callbackP99Ns;
+	qint64 callbackMaxNs;
+	QVector<qint64> fetchDurationsNs; //from enableFetching(true) to fetchingDone
+	QString extensionStatus; //acquisition status of the extension itself, contains the lost buffers it detected from the buffer ids
+	int errors;
+	bool timedOut;
+};
+
+//Headless stand-in for OCTproZ: activates the extension, allows raw grabbing, streams buffers through rawDataReceived from a separate thread and requests fetches like the fetch button of the extension does
+class MockHost : public QObject
+{
+	Q_OBJECT
+public:
+	explicit MockHost(const MockHostSettings& settings, QObject* parent = nullptr);
+	~MockHost();
+
+	const MockHostReport& getReport() const { return this->report; }
+	QByteArray toJson() const;
+	QString formatReport() const;
+
+private:
+	MockHostSettings settings;
+	MockHostReport report;
+	MockHostExtension* extension;
+	StreamReplayer* replayer;
+	QThread replayThread;
+	QElapsedTimer clock;
+	QTimer timeoutTimer;
+	qint64 fetchRequestNs;
+	QAtomicInteger<qint64> fetchDoneNs;
+	bool running;
+
+public slots:
+	void start();
+
+private slots:
+	void requestFetch();
+	void handleFetchingDone();
+	void stop(bool timedOut = false);
+
+signals:
+	void finished();
+};
+
+#endif // MOCKHOST_H
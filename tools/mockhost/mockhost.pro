@@ -0,0 +1,24 @@
+#headless stand-in for OCTproZ that streams raw buffers through rawDataReceived of the extension. Links the extension sources directly, so it needs the same OCTproZ_DevKit, QCustomPlot and fftw setup as the extension
+QT += core gui widgets printsupport concurrent
+CONFIG += console c++11
+CONFIG -= app_bundle
+QMAKE_PROJECT_DEPTH = 0
+
+TARGET = mockhost
+TEMPLATE = app
+
+include(../../extension.pri)
+
+DEFINES += \
+	QT_DEPRECATED_WARNINGS #emit warnings if depracted Qt features are used
+
+SOURCES += \
+	$$PWD/../../src/calibrationsignalgenerator.cpp \
+	streamreplayer.cpp \
+	mockhost.cpp \
+	main.cpp
+
+HEADERS += \
+	$$PWD/../../src/calibrationsignalgenerator.h \
+	streamreplayer.h \
+	mockhost.h
@@ -0,0 +1,102 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#include "streamreplayer.h"
+#include <QThread>
+#include "calibrationsignalgenerator.h"
+
+
+StreamReplayer::StreamReplayer(Extension* extension, const ReplaySettings& settings, const QElapsedTimer* clock) : QObject() {
+	this->extension = extension;
+	this->settings = settings;
+	this->clock = clock;
+	this->stopRequested.storeRelease(0);
+}
+
+void StreamReplayer::replay() {
+	this->statistics = ReplayStatistics();
+	this->callbackLatency.reset();
+	if(this->settings.sourceBuffers.isEmpty() || this->settings.lineRate <= 0.0){
+		emit finished();
+		return;
+	}
+	const double periodNs = 1.0e9*this->settings.linesPerBuffer/this->settings.lineRate;
+	const quint64 hostBuffers = static_cast<quint64>(qMax(1, this->settings.hostBuffers));
+	const unsigned int buffersPerVolume = qMax(1u, this->settings.buffersPerVolume);
+	FastRandom random(this->settings.seed, 0);
+	float jitter[STREAMREPLAYER_JITTER_BLOCK];
+	int jitterIndex = STREAMREPLAYER_JITTER_BLOCK;
+
+	const qint64 startNs = this->clock->nsecsElapsed();
+	qint64 previousArrivalNs = startNs;
+	quint64 bufferNr = 0;
+	while(this->stopRequested.loadAcquire() == 0){
+		//arrival time of the next buffer. The jitter shifts single buffers but does not accumulate and keeps the order of the buffers
+		if(jitterIndex >= STREAMREPLAYER_JITTER_BLOCK){
+			random.fillGaussian(jitter, STREAMREPLAYER_JITTER_BLOCK);
+			jitterIndex = 0;
+		}
+		double offsetNs = qBound(-STREAMREPLAYER_MAX_JITTER, static_cast<double>(jitter[jitterIndex++]), STREAMREPLAYER_MAX_JITTER)*this->settings.jitter*periodNs;
+		qint64 arrivalNs = qMax(previousArrivalNs, startNs + static_cast<qint64>(bufferNr*periodNs + offsetNs));
+		previousArrivalNs = arrivalNs;
+		this->waitUntil(arrivalNs);
+
+		//buffers that arrived while the previous callback was running wait in the host queue. If the queue overflowed, the oldest ones are lost
+		qint64 nowNs = this->clock->nsecsElapsed();
+		quint64 arrivedBuffers = static_cast<quint64>((nowNs - startNs)/periodNs) + 1;
+		if(arrivedBuffers > bufferNr + hostBuffers){
+			quint64 dropped = arrivedBuffers - bufferNr - hostBuffers;
+			this->statistics.droppedBuffers += dropped;
+			bufferNr += dropped;
+			arrivalNs = qMax(arrivalNs, startNs + static_cast<qint64>(bufferNr*periodNs));
+			previousArrivalNs = arrivalNs;
+		}
+		this->statistics.maxLagNs = qMax(this->statistics.maxLagNs, nowNs - arrivalNs);
+
+		unsigned char* buffer = this->settings.sourceBuffers.at(static_cast<int>(bufferNr % static_cast<quint64>(this->settings.sourceBuffers.size())));
+		unsigned int bufferId = static_cast<unsigned int>(bufferNr % buffersPerVolume);
+		{
+			LatencyScope latency(&this->callbackLatency);
+			this->extension->rawDataReceived(buffer, this->settings.bitDepth, this->settings.samplesPerLine, this->settings.linesPerBuffer, 1, buffersPerVolume, bufferId);
+		}
+		this->statistics.deliveredBuffers++;
+		bufferNr++;
+	}
+	this->statistics.elapsedNs = this->clock->nsecsElapsed() - startNs;
+	emit finished();
+}
+
+void StreamReplayer::waitUntil(qint64 ns) {
+	qint64 remainingNs = ns - this->clock->nsecsElapsed();
+	if(remainingNs > STREAMREPLAYER_SLEEP_MARGIN_NS){
+		QThread::usleep(static_cast<unsigned long>((remainingNs - STREAMREPLAYER_SLEEP_MARGIN_NS)/1000));
+	}
+	while(this->clock->nsecsElapsed() < ns && this->stopRequested.loadAcquire() == 0){
+		//spin for the last part, the timing of a frame grabber callback is not bound to the scheduler tick
+	}
+}
@@ -0,0 +1,97 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+
+#ifndef STREAMREPLAYER_H
+#define STREAMREPLAYER_H
+
+#include <QObject>
+#include <QVector>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include "octproz_devkit.h"
+#include "latencyhistogram.h"
+
+#define STREAMREPLAYER_SLEEP_MARGIN_NS 200000 //waits longer than this are slept, the rest is spun, so the delivery time does not depend on the scheduler granularity
+#define STREAMREPLAYER_JITTER_BLOCK 256 //gaussian jitter values are drawn in blocks
+#define STREAMREPLAYER_MAX_JITTER 3.0 //jitter is clipped to this many standard deviations
+
+//Format and timing of the simulated acquisition
+struct ReplaySettings {
+	ReplaySettings() : bitDepth(12), samplesPerLine(2048), linesPerBuffer(1024), buffersPerVolume(16), lineRate(100000.0), jitter(0.0), hostBuffers(4), seed(1) {}
+
+	unsigned int bitDepth;
+	unsigned int samplesPerLine;
+	unsigned int linesPerBuffer;
+	unsigned int buffersPerVolume;
+	double lineRate; //lines per second
+	double jitter; //standard deviation of the buffer arrival time as fraction of the buffer period
+	int hostBuffers; //buffers the host can queue while a callback is running, older buffers are dropped when the queue is full
+	quint64 seed;
+	QVector<unsigned char*> sourceBuffers; //replayed round robin, each one linesPerBuffer lines
+};
+
+struct ReplayStatistics {
+	ReplayStatistics() : deliveredBuffers(0), droppedBuffers(0), elapsedNs(0), maxLagNs(0) {}
+
+	quint64 deliveredBuffers;
+	quint64 droppedBuffers; //buffers that were overwritten in the host queue before the callback could take them
+	qint64 elapsedNs;
+	qint64 maxLagNs; //largest delay between arrival of a buffer and the start of its callback
+};
+
+//Calls rawDataReceived of an extension from its own thread, like the acquisition thread of OCTproZ does.
+//Buffers arrive at the configured line rate with gaussian jitter that does not accumulate. If a callback takes longer than the buffers that arrive meanwhile fit into the host queue, the oldest buffers are dropped and the extension sees a gap in the buffer ids
+class StreamReplayer : public QObject
+{
+	Q_OBJECT
+public:
+	StreamReplayer(Extension* extension, const ReplaySettings& settings, const QElapsedTimer* clock);
+
+	void stop() { this->stopRequested.storeRelease(1); }
+	const LatencyHistogram& getCallbackLatency() const { return this->callbackLatency; }
+	ReplayStatistics getStatistics() const { return this->statistics; } //valid after finished()
+
+private:
+	Extension* extension;
+	ReplaySettings settings;
+	const QElapsedTimer* clock;
+	QAtomicInt stopRequested;
+	LatencyHistogram callbackLatency;
+	ReplayStatistics statistics;
+
+	void waitUntil(qint64 ns);
+
+public slots:
+	void replay(); //runs until stop() is called
+
+signals:
+	void finished();
+};
+
+#endif // STREAMREPLAYER_H
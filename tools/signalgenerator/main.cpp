@@ -0,0 +1,188 @@
+/**
+**  This file is part of PhaseExtractionExtension for OCTproZ.
+**  PhaseExtractionExtension is a plugin for OCTproZ that can be used
+**  to determine a suitable resampling curve for k-linearization.
+**  Copyright (C) 2024 Miroslav Zabic
+**
+**  PhaseExtractionExtension is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program. If not, see http://www.gnu.org/licenses/.
+**
+****
+** Author:	Miroslav Zabic
+** Contact:	zabic
+**			at
+**			spectralcode.de
+****
+**/
+
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+#include <QScopedArrayPointer>
+#include "calibrationsignalgenerator.h"
+
+
+static bool parseValues(const QString& text, QVector<double>* values) {
+	values->clear();
+	for(const QString& item : text.split(',')){
+		if(item.trimmed().isEmpty()){
+			continue;
+		}
+		bool ok = false;
+		values->append(item.trimmed().toDouble(&ok));
+		if(!ok){
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool loadCurve(const QString& fileName, QVector<double>* curve) {
+	//one value per line, as written with --truth
+	QFile file(fileName);
+	if(!file.open(QIODevice::ReadOnly | QIODevice::Text)){
+		return false;
+	}
+	curve->clear();
+	while(!file.atEnd()){
+		QByteArray line = file.readLine().trimmed();
+		if(line.isEmpty()){
+			continue;
+		}
+		bool ok = false;
+		curve->append(line.toDouble(&ok));
+		if(!ok){
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("signalgenerator");
+	QTextStream err(stderr);
+	CalibrationSignalParameters defaults;
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Writes raw buffers of a synthetic calibration measurement with a known k-nonlinearity, as OCTproZ would record them, and the ground truth resampling curve.");
+	parser.addHelpOption();
+	QCommandLineOption outputOption(QStringList() << "o" << "output", "Raw output file, buffers are written one after another.", "file");
+	QCommandLineOption truthOption("truth", "Write the ground truth resampling curve to <file>, one value per line.", "file");
+	QCommandLineOption samplesOption(QStringList() << "s" << "samples", "Samples per line.", "n", QString::number(defaults.samplesPerLine));
+	QCommandLineOption linesOption(QStringList() << "l" << "lines", "Lines per buffer.", "n", QString::number(defaults.linesPerBuffer));
+	QCommandLineOption buffersOption(QStringList() << "b" << "buffers", "Number of buffers.", "n", "1");
+	QCommandLineOption bitDepthOption("bit-depth", "Bit depth, 1 to 32.", "bits", QString::number(defaults.bitDepth));
+	QCommandLineOption cyclesOption("cycles", "Fringe periods per line. Default: samples/8.", "n");
+	QCommandLineOption nonlinearityOption("nonlinearity", "Comma separated coefficients of x^2, x^3, ... of the normalized resampling curve.", "list", "0.1,-0.05");
+	QCommandLineOption curveOption("curve", "Arbitrary ground truth resampling curve from <file>, one value per line. Overrides --nonlinearity.", "file");
+	QCommandLineOption jitterOption("jitter", "Rms sweep jitter in samples.", "samples", QString::number(defaults.sweepJitter));
+	QCommandLineOption dcOption("dc", "Background level relative to full scale.", "level", QString::number(defaults.dcLevel));
+	QCommandLineOption amplitudeOption("amplitude", "Fringe amplitude relative to full scale.", "level", QString::number(defaults.fringeAmplitude));
+	QCommandLineOption envelopeOption("envelope", "1/e half width of a gaussian source spectrum relative to the line length, 0 for a flat spectrum.", "width", QString::number(defaults.envelopeWidth));
+	QCommandLineOption noiseOption("noise", "Shot noise in units of sqrt(counts).", "factor", QString::number(defaults.shotNoise));
+	QCommandLineOption saturationOption("saturation", "Saturation level relative to full scale.", "level", QString::number(defaults.saturationLevel));
+	QCommandLineOption seedOption("seed", "Seed of the random numbers.", "n", QString::number(defaults.seed));
+	parser.addOption(outputOption);
+	parser.addOption(truthOption);
+	parser.addOption(samplesOption);
+	parser.addOption(linesOption);
+	parser.addOption(buffersOption);
+	parser.addOption(bitDepthOption);
+	parser.addOption(cyclesOption);
+	parser.addOption(nonlinearityOption);
+	parser.addOption(curveOption);
+	parser.addOption(jitterOption);
+	parser.addOption(dcOption);
+	parser.addOption(amplitudeOption);
+	parser.addOption(envelopeOption);
+	parser.addOption(noiseOption);
+	parser.addOption(saturationOption);
+	parser.addOption(seedOption);
+	parser.process(app);
+
+	if(!parser.isSet(outputOption) && !parser.isSet(truthOption)){
+		err << "Nothing to do, use --output and/or --truth\n";
+		return 2;
+	}
+	CalibrationSignalParameters parameters;
+	parameters.samplesPerLine = parser.value(samplesOption).toInt();
+	parameters.linesPerBuffer = parser.value(linesOption).toInt();
+	parameters.bitDepth = parser.value(bitDepthOption).toInt();
+	parameters.fringeCycles = parser.isSet(cyclesOption) ? parser.value(cyclesOption).toDouble() : parameters.samplesPerLine/8.0;
+	parameters.sweepJitter = parser.value(jitterOption).toDouble();
+	parameters.dcLevel = parser.value(dcOption).toDouble();
+	parameters.fringeAmplitude = parser.value(amplitudeOption).toDouble();
+	parameters.envelopeWidth = parser.value(envelopeOption).toDouble();
+	parameters.shotNoise = parser.value(noiseOption).toDouble();
+	parameters.saturationLevel = parser.value(saturationOption).toDouble();
+	parameters.seed = parser.value(seedOption).toULongLong();
+	if(!parseValues(parser.value(nonlinearityOption), &parameters.nonlinearity)){
+		err << "Invalid nonlinearity coefficients\n";
+		return 2;
+	}
+	if(parser.isSet(curveOption) && (!loadCurve(parser.value(curveOption), &parameters.customCurve) || parameters.customCurve.size() != parameters.samplesPerLine)){
+		err << "Could not read a curve with " << parameters.samplesPerLine << " values from " << parser.value(curveOption) << "\n";
+		return 2;
+	}
+	CalibrationSignalGenerator generator;
+	if(!generator.setParameters(parameters)){
+		err << "Invalid parameters. Sizes have to be positive and the resampling curve has to increase monotonically\n";
+		return 2;
+	}
+
+	if(parser.isSet(truthOption)){
+		QFile file(parser.value(truthOption));
+		if(!file.open(QIODevice::WriteOnly | QIODevice::Text)){
+			err << "Could not save file to: " << parser.value(truthOption) << "\n";
+			return 2;
+		}
+		QTextStream out(&file);
+		out.setRealNumberPrecision(12);
+		for(double value : generator.getGroundTruthCurve()){
+			out << value << "\n";
+		}
+	}
+
+	if(parser.isSet(outputOption)){
+		QFile file(parser.value(outputOption));
+		if(!file.open(QIODevice::WriteOnly)){
+			err << "Could not save file to: " << parser.value(outputOption) << "\n";
+			return 2;
+		}
+		qint64 bufferSize = static_cast<qint64>(generator.getBufferSizeInBytes());
+		QScopedArrayPointer<unsigned char> buffer(new unsigned char[bufferSize]);
+		int buffers = qMax(1, parser.value(buffersOption).toInt());
+		qint64 generationNs = 0;
+		QElapsedTimer timer;
+		timer.start();
+		for(int bufferNr = 0; bufferNr < buffers; bufferNr++){
+			QElapsedTimer generationTimer;
+			generationTimer.start();
+			generator.generate(buffer.data(), bufferNr);
+			generationNs += generationTimer.nsecsElapsed();
+			if(file.write(reinterpret_cast<const char*>(buffer.data()), bufferSize) != bufferSize){
+				err << "Could not write to: " << parser.value(outputOption) << "\n";
+				return 2;
+			}
+		}
+		double gigabytes = static_cast<double>(bufferSize)*buffers/1e9;
+		err << "Wrote " << buffers << " buffers of " << parameters.linesPerBuffer << " x " << parameters.samplesPerLine << " samples at " << parameters.bitDepth << " bit ("
+			<< QString::number(gigabytes, 'f', 3) << " GB) in " << QString::number(timer.nsecsElapsed()/1e9, 'f', 2) << " s, generation "
+			<< QString::number(gigabytes/qMax(1e-9, generationNs/1e9), 'f', 2) << " GB/s\n";
+	}
+	return 0;
+}
@@ -0,0 +1,21 @@
+#command line generator for synthetic calibration recordings with known ground truth resampling curve. Does not need OCTproZ, FFTW or Eigen
+QT -= gui
+QT += core concurrent
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+TARGET = signalgenerator
+TEMPLATE = app
+
+DEFINES += \
+	QT_DEPRECATED_WARNINGS #emit warnings if depracted Qt features are used
+
+SOURCES += \
+	$$PWD/../../src/calibrationsignalgenerator.cpp \
+	main.cpp
+
+HEADERS += \
+	$$PWD/../../src/calibrationsignalgenerator.h
+
+INCLUDEPATH += \
+	$$PWD/../../src